@@ -49,8 +49,11 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <unistd.h>
 #include <string.h>
 #include <stdlib.h>
+#include <errno.h>
 #include <alsa/asoundlib.h>
 
+#define SAL_ALSA_WAIT_TIMEOUT 100 /**< milliseconds the audio thread waits for a free period before checking whether to quit */
+
 /** ALSA subsystem device specific data 
  */
 typedef struct SAL_ALSAData
@@ -60,9 +63,37 @@ typedef struct SAL_ALSAData
     int                  alsad_mix_buffer_size_bytes;     /**< mixing buffer size in bytes */
     int                  alsad_mix_buffer_length_ms;      /**< approximate duration of the buffer in milliseconds */
     int                  alsad_kill_audio_thread;         /**< set to 1 when the audio thread should be killed */
+    snd_pcm_uframes_t    alsad_buffer_frames;             /**< size of the hardware buffer in frames */
+    snd_pcm_uframes_t    alsad_period_frames;             /**< size of a period in frames */
+    snd_pcm_uframes_t    alsad_target_frames;             /**< frames the audio thread currently keeps queued */
 } SAL_ALSAData;
 
 static void destroy_device_data_alsa( SAL_Device *device );
+static int s_alsa_set_sw_params( snd_pcm_t *pcm, snd_pcm_uframes_t start_threshold, snd_pcm_uframes_t avail_min );
+
+/** @internal
+    @brief Restarts the PCM after an underrun or a suspend
+    @param[in] device pointer to output device, must be locked
+    @param[in] alsad ALSA device data
+    @param[in] err negative error code returned by ALSA
+    @returns 0 if the PCM was restarted, a negative error code if it is unusable
+*/
+static
+int
+s_alsa_recover( SAL_Device *device, SAL_ALSAData *alsad, int err )
+{
+    if ( err == -EPIPE )
+    {
+        device->device_stats.ds_num_underruns++;
+    }
+
+    if ( ( err = snd_pcm_recover( alsad->alsad_playback_handle, err, 1 ) ) < 0 )
+    {
+        _SAL_warning( device, "Could not restart ALSA playback (%s)\n", snd_strerror( err ) );
+    }
+
+    return err;
+}
 
 static 
 void 
@@ -70,11 +101,19 @@ s_alsa_audio_thread( void *args )
 {
     SAL_Device *device = ( SAL_Device * ) args;
     SAL_ALSAData *alsad = ( SAL_ALSAData * ) device->device_data;
-    int frames_to_deliver, bytes_to_fill;
-    int sleep_time = alsad->alsad_mix_buffer_length_ms / 2;
+    snd_pcm_sframes_t frames_to_deliver, frames_written;
+    int bytes_per_frame = device->device_info.di_bytes_per_frame;
+    int max_frames = alsad->alsad_mix_buffer_size_bytes / bytes_per_frame;
+    snd_pcm_sframes_t queued;
+    sal_u32_t underruns;
+    int broken, err;
     
     while ( 1 )
     {
+        /* wait until avail_min frames are free, the timeout is only there so
+           we notice when to quit */
+        snd_pcm_wait( alsad->alsad_playback_handle, SAL_ALSA_WAIT_TIMEOUT );
+
         /* lock the device */
         _SAL_lock_device( device );
         
@@ -85,21 +124,237 @@ s_alsa_audio_thread( void *args )
             _SAL_unlock_device( device );
             return;
         }
+
+        device->device_stats.ds_num_wakeups++;
+        underruns = device->device_stats.ds_num_underruns;
+        broken = 0;
+        frames_written = 0;
         
-        frames_to_deliver = snd_pcm_avail_update( alsad->alsad_playback_handle );
-        
-        bytes_to_fill = frames_to_deliver * device->device_info.di_bytes_per_frame;
-        bytes_to_fill = bytes_to_fill > alsad->alsad_mix_buffer_size_bytes ? alsad->alsad_mix_buffer_size_bytes : bytes_to_fill;
+        if ( ( frames_to_deliver = snd_pcm_avail_update( alsad->alsad_playback_handle ) ) < 0 )
+        {
+            if ( s_alsa_recover( device, alsad, ( int ) frames_to_deliver ) < 0 )
+            {
+                broken = 1;
+            }
+            frames_to_deliver = broken ? 0 : snd_pcm_avail_update( alsad->alsad_playback_handle );
+        }
+
+        /* only top the buffer up to the latency target */
+        queued = ( snd_pcm_sframes_t ) alsad->alsad_buffer_frames - frames_to_deliver;
+        if ( frames_to_deliver > ( snd_pcm_sframes_t ) alsad->alsad_target_frames - queued )
+        {
+            frames_to_deliver = ( snd_pcm_sframes_t ) alsad->alsad_target_frames - queued;
+        }
+
+        frames_to_deliver = frames_to_deliver > max_frames ? max_frames : frames_to_deliver;
         
-        if ( bytes_to_fill > 0 )
+        if ( frames_to_deliver > 0 )
         {
-            _SAL_mix_chunk( device, alsad->alsad_mix_buffer, bytes_to_fill );
-            snd_pcm_writei( alsad->alsad_playback_handle, alsad->alsad_mix_buffer, frames_to_deliver );
+            /* the mix buffer is ours alone, so let the application back in
+               while it's filled and the driver copies it */
+            _SAL_unlock_device( device );
+            _SAL_render_chunk( device, alsad->alsad_mix_buffer, ( sal_u32_t ) frames_to_deliver * bytes_per_frame );
+            frames_written = snd_pcm_writei( alsad->alsad_playback_handle, alsad->alsad_mix_buffer, frames_to_deliver );
+            _SAL_lock_device( device );
+
+            if ( frames_written < 0 )
+            {
+                broken = s_alsa_recover( device, alsad, ( int ) frames_written ) < 0;
+                frames_written = 0;
+            }
+        }
+
+        if ( !broken )
+        {
+            _SAL_update_latency( device, ( sal_u32_t ) frames_written, device->device_stats.ds_num_underruns != underruns );
+
+            /* wake up when the queue has drained a period below the new target */
+            if ( _SAL_get_latency_frames( device ) != alsad->alsad_target_frames )
+            {
+                alsad->alsad_target_frames = _SAL_get_latency_frames( device );
+                if ( ( err = s_alsa_set_sw_params( alsad->alsad_playback_handle, 
+                                                   alsad->alsad_period_frames, 
+                                                   alsad->alsad_buffer_frames - alsad->alsad_target_frames + alsad->alsad_period_frames ) ) < 0 )
+                {
+                    _SAL_warning( device, "Could not set ALSA wakeup threshold (%s)\n", snd_strerror( err ) );
+                }
+            }
         }
         
         _SAL_unlock_device( device );
-        
-        SAL_sleep( device, sleep_time );
+
+        /* don't spin on a PCM that won't come back */
+        if ( broken )
+        {
+            SAL_sleep( device, SAL_ALSA_WAIT_TIMEOUT );
+        }
+    }
+}
+
+/** @internal
+    @brief ALSA implementation of device_fnc_get_delay
+    @remarks The audio thread may be inside snd_pcm_writei() at the same time,
+    which alsa-lib's own per-PCM locking makes safe.
+*/
+static
+sal_error_e
+s_alsa_get_delay( SAL_Device *device, sal_u32_t *p_frames )
+{
+    SAL_ALSAData *alsad = ( SAL_ALSAData * ) device->device_data;
+    snd_pcm_sframes_t delay;
+
+    if ( snd_pcm_delay( alsad->alsad_playback_handle, &delay ) < 0 )
+    {
+        return SALERR_SYSTEMFAILURE;
+    }
+
+    /* the delay goes negative when the PCM has underrun */
+    *p_frames = ( delay > 0 ) ? ( sal_u32_t ) delay : 0;
+
+    return SALERR_OK;
+}
+
+/** @internal
+    @brief Configures an open PCM for interleaved playback
+    @param[in] pcm PCM handle
+    @param[in] hw_params scratch hardware parameters
+    @param[in] kp_sp pointer to system parameters structure, for the period sizing
+    @param[in] channels number of channels
+    @param[in,out] p_bits bits per sample, 0 to take 16 or 8, whichever the PCM has
+    @param[in,out] p_rate sample rate, 0 to take the PCM's rate nearest to the default
+    @returns 0 on success, a negative ALSA error code on failure
+*/
+static
+int
+s_alsa_set_hw_params( snd_pcm_t *pcm, snd_pcm_hw_params_t *hw_params, const SAL_SystemParameters *kp_sp, sal_u32_t channels, sal_u32_t *p_bits, sal_u32_t *p_rate )
+{
+    snd_pcm_format_t format;
+    snd_pcm_uframes_t period_size, buffer_size;
+    sal_u32_t period_frames, num_periods;
+    unsigned int rate;
+    int err;
+
+    if ( ( err = snd_pcm_hw_params_any( pcm, hw_params ) ) < 0 ||
+         ( err = snd_pcm_hw_params_set_access( pcm, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED ) ) < 0 )
+    {
+        return err;
+    }
+
+    /* set the bit-depth format */
+    if ( *p_bits == 0 )
+    {
+        *p_bits = ( snd_pcm_hw_params_test_format( pcm, hw_params, SND_PCM_FORMAT_S16 ) == 0 ) ? 16 : 8;
+    }
+
+    format = ( *p_bits == 8 ) ? SND_PCM_FORMAT_U8 : SND_PCM_FORMAT_S16;
+
+    if ( ( err = snd_pcm_hw_params_set_format( pcm, hw_params, format ) ) < 0 ||
+         ( err = snd_pcm_hw_params_set_channels( pcm, hw_params, channels ) ) < 0 )
+    {
+        return err;
+    }
+
+    /* set the rate */
+    if ( *p_rate == 0 )
+    {
+        rate = DEFAULT_AUDIO_SAMPLE_RATE;
+        if ( ( err = snd_pcm_hw_params_set_rate_near( pcm, hw_params, &rate, 0 ) ) < 0 )
+        {
+            return err;
+        }
+        *p_rate = rate;
+    }
+    else if ( ( err = snd_pcm_hw_params_set_rate( pcm, hw_params, *p_rate, 0 ) ) < 0 )
+    {
+        return err;
+    }
+
+    /* size the periods, the PCM picks the nearest it can do */
+    _SAL_get_period_config( kp_sp, *p_rate, &period_frames, &num_periods );
+
+    period_size = period_frames;
+    buffer_size = ( snd_pcm_uframes_t ) period_frames * num_periods;
+
+    snd_pcm_hw_params_set_period_size_near( pcm, hw_params, &period_size, 0 );
+    buffer_size = ( buffer_size < period_size * 2 ) ? period_size * 2 : buffer_size;
+    snd_pcm_hw_params_set_buffer_size_near( pcm, hw_params, &buffer_size );
+
+    return snd_pcm_hw_params( pcm, hw_params );
+}
+
+/** @internal
+    @brief Sets when playback starts and when the audio thread wakes up
+    @param[in] pcm PCM handle, its hardware parameters must be set
+    @param[in] start_threshold frames that must be written before playback starts
+    @param[in] avail_min frames that must be free before the audio thread wakes up
+    @returns 0 on success, a negative ALSA error code on failure
+    @remarks Playback starts as soon as a period has been written.  With the
+    whole buffer queued the thread wakes up whenever a period is free; with a
+    smaller latency target avail_min is raised so it wakes up when the queue
+    has drained a period below the target.
+*/
+static
+int
+s_alsa_set_sw_params( snd_pcm_t *pcm, snd_pcm_uframes_t start_threshold, snd_pcm_uframes_t avail_min )
+{
+    snd_pcm_sw_params_t *sw_params;
+    int err;
+
+    if ( ( err = snd_pcm_sw_params_malloc( &sw_params ) ) < 0 )
+    {
+        return err;
+    }
+
+    if ( ( err = snd_pcm_sw_params_current( pcm, sw_params ) ) >= 0 &&
+         ( err = snd_pcm_sw_params_set_start_threshold( pcm, sw_params, start_threshold ) ) >= 0 &&
+         ( err = snd_pcm_sw_params_set_avail_min( pcm, sw_params, avail_min ) ) >= 0 )
+    {
+        err = snd_pcm_sw_params( pcm, sw_params );
+    }
+
+    snd_pcm_sw_params_free( sw_params );
+
+    return err;
+}
+
+/** @internal
+    @brief Describes the formats, channels and rates a PCM supports
+    @param[in] pcm PCM handle
+    @param[in] hw_params scratch hardware parameters
+    @param[out] buf destination for the description
+    @param[in] buf_size size of buf in bytes
+*/
+static
+void
+s_alsa_describe_native( snd_pcm_t *pcm, snd_pcm_hw_params_t *hw_params, char *buf, size_t buf_size )
+{
+    unsigned int min_channels = 0, max_channels = 0, min_rate = 0, max_rate = 0;
+    size_t len = 0;
+    int f;
+
+    buf[ 0 ] = 0;
+
+    if ( snd_pcm_hw_params_any( pcm, hw_params ) < 0 )
+    {
+        return;
+    }
+
+    for ( f = 0; f <= SND_PCM_FORMAT_LAST && len < buf_size; f++ )
+    {
+        if ( snd_pcm_format_name( ( snd_pcm_format_t ) f ) && snd_pcm_hw_params_test_format( pcm, hw_params, ( snd_pcm_format_t ) f ) == 0 )
+        {
+            len += snprintf( buf + len, buf_size - len, "%s ", snd_pcm_format_name( ( snd_pcm_format_t ) f ) );
+        }
+    }
+
+    snd_pcm_hw_params_get_channels_min( hw_params, &min_channels );
+    snd_pcm_hw_params_get_channels_max( hw_params, &max_channels );
+    snd_pcm_hw_params_get_rate_min( hw_params, &min_rate, 0 );
+    snd_pcm_hw_params_get_rate_max( hw_params, &max_rate, 0 );
+
+    if ( len < buf_size )
+    {
+        snprintf( buf + len, buf_size - len, "%u-%u channels %u-%u Hz", min_channels, max_channels, min_rate, max_rate );
     }
 }
 
@@ -111,6 +366,12 @@ s_alsa_audio_thread( void *args )
     may be 0 if you want it to use default preferences
     @param[in] desired_bits number of bits per sample, specify 0 for system default
     @param[in] desired_sample_rate desired sample rate, in samples/second, specify 0 for system default
+    @remarks Opens sp_device_name, or hw:0,0 if that is NULL.  A hw: device that can't
+    play the format natively is reopened through the plug layer, with a warning that lists
+    what the card does support, and @ref SAL_DIF_CONVERSION is set in the device info
+    whenever a software plugin sits between SAL and the hardware.  With a bits or rate of
+    0 the card's own format and rate are taken, so nothing needs converting.  Periods
+    are sized by _SAL_get_period_config() and the audio thread wakes once per period.
 */
 sal_error_e
 _SAL_create_device_data_alsa( SAL_Device *device, 
@@ -121,34 +382,27 @@ _SAL_create_device_data_alsa( SAL_Device *device,
 {
     SAL_ALSAData *alsad = 0;
     snd_pcm_hw_params_t *hw_params;
-    const char *device_name = "plughw:0,0";
-    snd_pcm_format_t format;
+    const char *device_name;
+    char plug_name[ 64 ];
+    sal_u32_t bits = desired_bits, rate = desired_sample_rate;
+    int err;
 
     desired_channels    = ( desired_channels == 0 ) ? DEFAULT_AUDIO_CHANNELS : desired_channels;
-    desired_bits        = ( desired_bits == 0 ) ? DEFAULT_AUDIO_BITS : desired_bits;
-    desired_sample_rate = ( desired_sample_rate == 0 ) ? DEFAULT_AUDIO_SAMPLE_RATE: desired_sample_rate;
     
-    if ( device == 0 || device_name == 0 || kp_sp == 0 )
+    if ( device == 0 || kp_sp == 0 )
     {
         return SALERR_INVALIDPARAM;
     }
 
-    format = ( desired_bits == 8 ) ? SND_PCM_FORMAT_U8 : SND_PCM_FORMAT_S16;
+    device_name = ( kp_sp->sp_device_name ) ? kp_sp->sp_device_name : "hw:0,0";
 
-    device->device_fnc_destroy = destroy_device_data_alsa;
+    device->device_fnc_destroy   = destroy_device_data_alsa;
+    device->device_fnc_get_delay = s_alsa_get_delay;
     
     alsad = ( SAL_ALSAData * ) device->device_callbacks.alloc( sizeof( *alsad ) );
 
     memset( alsad, 0, sizeof( *alsad ) );
 
-    /* allocate playback handle */
-    if ( snd_pcm_open( &alsad->alsad_playback_handle, device_name, SND_PCM_STREAM_PLAYBACK, 0) < 0 )
-    {
-        device->device_callbacks.free( alsad );
-        _SAL_warning( device, "Could not open audio device\n" );
-        return SALERR_SYSTEMFAILURE;
-    }
-
     /* allocate hw params */
     if ( snd_pcm_hw_params_malloc( &hw_params) < 0 )
     {
@@ -157,77 +411,93 @@ _SAL_create_device_data_alsa( SAL_Device *device,
         return SALERR_SYSTEMFAILURE;
     }
 
-    /* any parameters */
-    if ( snd_pcm_hw_params_any( alsad->alsad_playback_handle, hw_params ) < 0 )
+    /* allocate playback handle */
+    if ( ( err = snd_pcm_open( &alsad->alsad_playback_handle, device_name, SND_PCM_STREAM_PLAYBACK, 0 ) ) < 0 )
     {
-        snd_pcm_hw_params_free( hw_params );
-        device->device_callbacks.free( alsad );
-        _SAL_warning( device, "Failed call to snd_pcm_hw_params_any" );
-        return SALERR_SYSTEMFAILURE;
+        alsad->alsad_playback_handle = 0;
     }
-
-    /* set interleaved format */
-    if ( snd_pcm_hw_params_set_access( alsad->alsad_playback_handle, hw_params,SND_PCM_ACCESS_RW_INTERLEAVED ) < 0 )
+    else if ( ( err = s_alsa_set_hw_params( alsad->alsad_playback_handle, hw_params, kp_sp, desired_channels, &bits, &rate ) ) < 0 )
     {
-        snd_pcm_hw_params_free( hw_params );
-        device->device_callbacks.free( alsad );
-        _SAL_warning( device, "Failed to set interleaved format\n" );
-        return SALERR_SYSTEMFAILURE;
-    }
+        char native[ 256 ];
 
-    /* set the bit-depth format */
-    if ( snd_pcm_hw_params_set_format( alsad->alsad_playback_handle, hw_params, format ) < 0 )
-    {
-        snd_pcm_hw_params_free( hw_params );
-        device->device_callbacks.free( alsad );
-        _SAL_warning( device, "Could not set format" );
-        return SALERR_SYSTEMFAILURE;
+        s_alsa_describe_native( alsad->alsad_playback_handle, hw_params, native, sizeof( native ) );
+        snd_pcm_close( alsad->alsad_playback_handle );
+        alsad->alsad_playback_handle = 0;
+
+        if ( strncmp( device_name, "hw:", 3 ) == 0 )
+        {
+            _SAL_warning( device, "%s can't play %u-bit %u channel %u Hz natively (it supports %s), converting through plug%s\n",
+                          device_name, 
+                          desired_bits ? desired_bits : DEFAULT_AUDIO_BITS,
+                          desired_channels, 
+                          desired_sample_rate ? desired_sample_rate : DEFAULT_AUDIO_SAMPLE_RATE,
+                          native,
+                          device_name );
+        }
     }
 
-    /* set number of channels */
-    if ( snd_pcm_hw_params_set_channels( alsad->alsad_playback_handle, hw_params, desired_channels ) < 0 )
+    /* the plug layer converts whatever the card can't do */
+    if ( alsad->alsad_playback_handle == 0 && strncmp( device_name, "hw:", 3 ) == 0 )
     {
-        snd_pcm_hw_params_free( hw_params );
-        device->device_callbacks.free( alsad );
-        _SAL_warning( device, "Could not set number of channels" );
-        return SALERR_SYSTEMFAILURE;
-    }
+        snprintf( plug_name, sizeof( plug_name ), "plug%s", device_name );
+        device_name = plug_name;
+        bits = ( desired_bits == 0 ) ? DEFAULT_AUDIO_BITS : desired_bits;
+        rate = ( desired_sample_rate == 0 ) ? DEFAULT_AUDIO_SAMPLE_RATE : desired_sample_rate;
 
-    /* set the rate */
+        if ( ( err = snd_pcm_open( &alsad->alsad_playback_handle, device_name, SND_PCM_STREAM_PLAYBACK, 0 ) ) < 0 )
         {
-            if ( snd_pcm_hw_params_set_rate( alsad->alsad_playback_handle, hw_params, desired_sample_rate, 0 ) < 0 )
-            {
-                snd_pcm_hw_params_free( hw_params );
-                device->device_callbacks.free( alsad );
-                _SAL_warning( device, "Could not set number of channels" );
-                return SALERR_SYSTEMFAILURE;
-            }
+            alsad->alsad_playback_handle = 0;
         }
+        else if ( ( err = s_alsa_set_hw_params( alsad->alsad_playback_handle, hw_params, kp_sp, desired_channels, &bits, &rate ) ) < 0 )
+        {
+            snd_pcm_close( alsad->alsad_playback_handle );
+            alsad->alsad_playback_handle = 0;
+        }
+    }
 
-    /* set the params */
-    if ( snd_pcm_hw_params( alsad->alsad_playback_handle, hw_params ) < 0 )
+    if ( alsad->alsad_playback_handle == 0 )
     {
         snd_pcm_hw_params_free( hw_params );
         device->device_callbacks.free( alsad );
-        _SAL_warning( device, "Could not set hardware parameters" );
+        _SAL_warning( device, "Could not open audio device %s (%s)\n", device_name, snd_strerror( err ) );
         return SALERR_SYSTEMFAILURE;
     }
 
     /* do a quick query about the buffer */
         {
-            unsigned period_time, periods, buffer_time;
-            snd_pcm_uframes_t buffer_frames;
+            unsigned periods, buffer_time;
+            snd_pcm_uframes_t buffer_frames, period_frames;
             int dir = 0;
 
-            snd_pcm_hw_params_get_period_time( hw_params, &period_time, &dir );
+            snd_pcm_hw_params_get_period_size( hw_params, &period_frames, &dir );
             snd_pcm_hw_params_get_periods( hw_params, &periods, &dir );
             snd_pcm_hw_params_get_buffer_size( hw_params, &buffer_frames );
             snd_pcm_hw_params_get_buffer_time( hw_params, &buffer_time, &dir );
 
             alsad->alsad_mix_buffer_length_ms = buffer_time / 1000;
-            alsad->alsad_mix_buffer_size_bytes = buffer_frames * desired_channels * desired_bits / 8;
-            alsad->alsad_mix_buffer = (sal_byte_t*) device->device_callbacks.alloc( alsad->alsad_mix_buffer_size_bytes );
+            device->device_info.di_num_periods   = periods;
+            device->device_info.di_period_frames = ( sal_i32_t ) period_frames;
+
+            /* start small if adapting, the audio thread grows the target on trouble */
+            _SAL_init_latency( device, rate, ( sal_u32_t ) period_frames, periods, 
+                               ( kp_sp->sp_flags & SAL_SPF_ADAPTIVE_LATENCY ) != 0 );
+
+            alsad->alsad_buffer_frames = buffer_frames;
+            alsad->alsad_period_frames = period_frames;
+            alsad->alsad_target_frames = _SAL_get_latency_frames( device );
+
+            if ( ( err = s_alsa_set_sw_params( alsad->alsad_playback_handle, 
+                                               period_frames, 
+                                               buffer_frames - alsad->alsad_target_frames + period_frames ) ) < 0 )
+            {
+                _SAL_warning( device, "Could not set ALSA start and wakeup thresholds (%s)\n", snd_strerror( err ) );
+            }
+
+            alsad->alsad_mix_buffer_size_bytes = buffer_frames * desired_channels * bits / 8;
+            SAL_alloc_aligned( device, ( void ** ) &alsad->alsad_mix_buffer, alsad->alsad_mix_buffer_size_bytes, SAL_ALIGNMENT );
             memset( alsad->alsad_mix_buffer, 0, alsad->alsad_mix_buffer_size_bytes );
+            _SAL_lock_memory( device, alsad, sizeof( *alsad ) );
+            _SAL_lock_memory( device, alsad->alsad_mix_buffer, alsad->alsad_mix_buffer_size_bytes );
         }
 
     /* free hw params */
@@ -236,6 +506,8 @@ _SAL_create_device_data_alsa( SAL_Device *device,
     /* prepare handle */
     if ( snd_pcm_prepare( alsad->alsad_playback_handle ) < 0 )
     {
+        snd_pcm_close( alsad->alsad_playback_handle );
+        SAL_free_aligned( device, alsad->alsad_mix_buffer );
         device->device_callbacks.free( alsad );
         _SAL_warning( device, "Could not prepare playback handle" );
         return SALERR_SYSTEMFAILURE;
@@ -244,13 +516,18 @@ _SAL_create_device_data_alsa( SAL_Device *device,
     /* store parameters */
     device->device_info.di_size        = sizeof( device->device_info );
     device->device_info.di_channels    = desired_channels;
-    device->device_info.di_bits        = desired_bits;
-    device->device_info.di_sample_rate = desired_sample_rate;
+    device->device_info.di_bits        = bits;
+    device->device_info.di_sample_rate = rate;
+    device->device_info.di_bytes_per_sample = bits / 8;
+    device->device_info.di_bytes_per_frame  = desired_channels * bits / 8;
+    device->device_info.di_flags       = ( snd_pcm_type( alsad->alsad_playback_handle ) != SND_PCM_TYPE_HW ) ? SAL_DIF_CONVERSION : 0;
     device->device_data = alsad;
-    strncpy( device->device_info.di_name, "ALSA", sizeof( device->device_info.di_name ) );
+    snprintf( device->device_info.di_name, sizeof( device->device_info.di_name ), "ALSA %s", device_name );
+
+    _SAL_init_pipeline( device, ( sal_u32_t ) alsad->alsad_period_frames );
 
     /* kick off audio thread */
-    _SAL_create_thread( device, s_alsa_audio_thread, device );
+    _SAL_create_thread( device, s_alsa_audio_thread, device, SAL_THREAD_AUDIO );
 
     return SALERR_OK;
 }
@@ -278,6 +555,10 @@ destroy_device_data_alsa( SAL_Device *device )
     snd_pcm_close( alsad->alsad_playback_handle );
 
     /* free memory */
+    if ( alsad->alsad_mix_buffer )
+    {
+        SAL_free_aligned( device, alsad->alsad_mix_buffer );
+    }
     device->device_callbacks.free( device->device_data );
     device->device_data = 0;
 }
@@ -47,6 +47,15 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <CoreServices/CoreServices.h>
 #include <AudioUnit/AudioUnit.h>
 
+/** @internal
+    @ingroup osx
+    @brief private device data for the CoreAudio subsystem */
+typedef struct SAL_CoreAudioData_s
+{
+    AudioUnit		cad_audio_unit;     /**< audio unit */
+    UInt32          cad_render_frames;  /**< frames asked for by the most recent render callback */
+} SAL_CoreAudioData;
+
 static
 OSStatus	
 s_audio_renderer( void *inRefCon, 
@@ -59,6 +68,10 @@ s_audio_renderer( void *inRefCon,
     SAL_Device *device = ( SAL_Device * ) inRefCon;
     int channel;
 
+    _SAL_lock_device( device );
+
+    ( ( SAL_CoreAudioData * ) device->device_data )->cad_render_frames = inNumberFrames;
+
     for ( channel = 0; channel < ioData->mNumberBuffers; channel++)
     {
         /* mix into the first buffer */
@@ -66,6 +79,8 @@ s_audio_renderer( void *inRefCon,
                         ioData->mBuffers[ channel ].mData,
                         ioData->mBuffers[ channel ].mDataByteSize );
     }
+
+    _SAL_unlock_device( device );
 	
     return noErr;
 }
@@ -74,11 +89,32 @@ static void destroy_device_data_coreaudio( SAL_Device *device );
 
 /** @internal
     @ingroup osx
-    @brief private device data for the CoreAudio subsystem */
-typedef struct SAL_CoreAudioData_s
+    @brief CoreAudio implementation of device_fnc_get_delay
+    @remarks CoreAudio pulls audio rather than queueing it, so this is the
+    buffer being played plus the output unit's own latency.
+*/
+static
+sal_error_e
+s_coreaudio_get_delay( SAL_Device *device, sal_u32_t *p_frames )
 {
-    AudioUnit		cad_audio_unit;     /**< audio unit */
-} SAL_CoreAudioData;
+    SAL_CoreAudioData *cad = ( SAL_CoreAudioData * ) device->device_data;
+    Float64 latency = 0;
+    UInt32 sz = sizeof( latency );
+
+    if ( AudioUnitGetProperty( cad->cad_audio_unit,
+                               kAudioUnitProperty_Latency,
+                               kAudioUnitScope_Global,
+                               0,
+                               &latency,
+                               &sz ) != noErr )
+    {
+        latency = 0;
+    }
+
+    *p_frames = cad->cad_render_frames + ( sal_u32_t ) ( latency * device->device_info.di_sample_rate );
+
+    return SALERR_OK;
+}
 
 /** @internal
     @ingroup osx
@@ -100,7 +136,8 @@ _SAL_create_device_data_coreaudio( SAL_Device *device,
     AURenderCallbackStruct input;
     AudioStreamBasicDescription desired_format, device_format;
 
-    device->device_fnc_destroy = destroy_device_data_coreaudio;
+    device->device_fnc_destroy   = destroy_device_data_coreaudio;
+    device->device_fnc_get_delay = s_coreaudio_get_delay;
 	
     /* allocate memory for the coreaudio data */
     cad = device->device_callbacks.alloc( sizeof( *cad ) );
@@ -189,6 +226,8 @@ _SAL_create_device_data_coreaudio( SAL_Device *device,
     device->device_info.di_bits        = device_format.mBitsPerChannel;
     device->device_info.di_channels    = device_format.mChannelsPerFrame;
     device->device_info.di_sample_rate = (int)device_format.mSampleRate;
+    device->device_info.di_bytes_per_sample = device_format.mBitsPerChannel / 8;
+    device->device_info.di_bytes_per_frame  = device_format.mBitsPerChannel / 8 * device_format.mChannelsPerFrame;
     strncpy( device->device_info.di_name, "CoreAudio", sizeof( device->device_info.di_name ) );
 
     /* initialize the audio unit */
@@ -170,6 +170,31 @@ s_audio_thread( void *args )
     }
 }
 
+/** @internal
+    @ingroup Win32
+    @brief DirectSound implementation of device_fnc_get_delay, the distance
+    from the play cursor to where we've mixed up to in the secondary buffer */
+static
+sal_error_e
+s_dsound_get_delay( SAL_Device *device, sal_u32_t *p_frames )
+{
+    SAL_DirectSoundData *dsd = ( SAL_DirectSoundData * ) device->device_data;
+    DWORD dwCurrentPlayCursor, dwCurrentWriteCursor;
+    HRESULT hr;
+
+    if ( ( hr = dsd->dsd_lpSecondaryBuffer->lpVtbl->GetCurrentPosition( dsd->dsd_lpSecondaryBuffer, 
+                                                                        &dwCurrentPlayCursor, 
+                                                                        &dwCurrentWriteCursor ) ) != DS_OK )
+    {
+        return SALERR_SYSTEMFAILURE;
+    }
+
+    *p_frames = ( ( dsd->dsd_dwWriteLocation + dsd->dsd_dwBufferSize - dwCurrentPlayCursor ) % dsd->dsd_dwBufferSize ) / 
+                device->device_info.di_bytes_per_frame;
+
+    return SALERR_OK;
+}
+
 /** @internal
     @ingroup Win32
     @brief DirectSound specific device creation function
@@ -194,15 +219,21 @@ _SAL_create_device_data_dsound( SAL_Device *device,
     DSCAPS dsCaps;
     WAVEFORMATEX wfex;
     int buffer_length_ms = 0;
+    sal_u32_t sample_rate, period_frames, num_periods;
 
     if ( device == 0 || kp_sp == 0 )
     {
         return SALERR_INVALIDPARAM;
     }
 
-    buffer_length_ms = ( kp_sp->sp_buffer_length_ms == 0 ) ? DEFAULT_BUFFER_DURATION : kp_sp->sp_buffer_length_ms;
+    /* the secondary buffer holds all the periods */
+    sample_rate = ( desired_sample_rate == 0 ) ? DEFAULT_AUDIO_SAMPLE_RATE : desired_sample_rate;
+    _SAL_get_period_config( kp_sp, sample_rate, &period_frames, &num_periods );
+    buffer_length_ms = ( int ) ( ( sal_u64_t ) period_frames * num_periods * 1000 / sample_rate );
+    buffer_length_ms = ( buffer_length_ms == 0 ) ? 1 : buffer_length_ms;
 
-    device->device_fnc_destroy = destroy_device_data_dsound;
+    device->device_fnc_destroy   = destroy_device_data_dsound;
+    device->device_fnc_get_delay = s_dsound_get_delay;
     
     dsd = ( SAL_DirectSoundData * ) device->device_callbacks.alloc( sizeof( SAL_DirectSoundData ) );
 
@@ -381,13 +412,15 @@ _SAL_create_device_data_dsound( SAL_Device *device,
     device->device_info.di_bits        = wfex.wBitsPerSample;
     device->device_info.di_channels    = wfex.nChannels;
     device->device_info.di_sample_rate = wfex.nSamplesPerSec;
+    device->device_info.di_bytes_per_sample = wfex.wBitsPerSample / 8;
+    device->device_info.di_bytes_per_frame  = wfex.nBlockAlign;
     strncpy( device->device_info.di_name, "DirectSound", sizeof( device->device_info.di_name ) );
 
     /* store device data */
     device->device_data = dsd;
 
     /* kick off the audio filler thread */
-    _SAL_create_thread( device, s_audio_thread, device );
+    _SAL_create_thread( device, s_audio_thread, device, SAL_THREAD_AUDIO );
 
     return SALERR_OK;
 }
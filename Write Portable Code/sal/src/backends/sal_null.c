@@ -0,0 +1,225 @@
+/*
+Copyright (c) 2004, Brian Hook
+All rights reserved.
+
+http://www.bookofhook.com/sal
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+
+    * The names of this package'ss contributors contributors may not
+      be used to endorse or promote products derived from this
+      software without specific prior written permission.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/** @file sal_null.c
+    @brief Null backend, mixes in real time and throws the result away
+    @remarks Compiled in with SAL_SUPPORT_NULL and selected with
+    @ref SAL_SPF_NULL.  The audio thread wakes once a period and mixes a
+    period, just like a backend feeding hardware, so it is useful on
+    machines without sound hardware and for measuring SAL itself.
+*/
+#ifndef SAL_DOXYGEN
+#  define SAL_BUILDING_LIB 1
+#endif
+#include "../sal.h"
+
+#if defined SAL_DOXYGEN
+#  define SAL_SUPPORT_NULL /**< if defined, the null backend is compiled in */
+#endif
+
+#if defined SAL_SUPPORT_NULL || defined SAL_DOXYGEN
+
+#include <string.h>
+
+/** @internal
+    @brief private device data for the null backend */
+typedef struct SAL_NullData
+{
+    sal_byte_t *nd_mix_buffer;          /**< one period, discarded once it's mixed */
+    sal_u32_t   nd_period_bytes;        /**< size of a period, in bytes */
+    sal_u64_t   nd_period_ns;           /**< duration of a period, in nanoseconds */
+    int         nd_kill_audio_thread;   /**< set to 1 when the thread should die, cleared when it has */
+} SAL_NullData;
+
+static void destroy_device_data_null( SAL_Device *device );
+
+/** @internal
+    @brief audio thread that mixes one period every period */
+static
+void
+s_null_audio_thread( void *args )
+{
+    SAL_Device *device = ( SAL_Device * ) args;
+    SAL_NullData *nd = ( SAL_NullData * ) device->device_data;
+    sal_u64_t deadline = _SAL_get_time( device );
+
+    while ( 1 )
+    {
+        _SAL_wait_period( device, &deadline, nd->nd_period_ns );
+
+        _SAL_lock_device( device );
+
+        /* time to quit? */
+        if ( nd->nd_kill_audio_thread )
+        {
+            nd->nd_kill_audio_thread = 0;
+            _SAL_unlock_device( device );
+            return;
+        }
+
+        _SAL_unlock_device( device );
+
+        _SAL_render_chunk( device, nd->nd_mix_buffer, nd->nd_period_bytes );
+    }
+}
+
+/** @internal
+    @brief null implementation of device_fnc_get_delay, nothing is queued
+    once it has been mixed */
+static
+sal_error_e
+s_null_get_delay( SAL_Device *device, sal_u32_t *p_frames )
+{
+    device = device;
+
+    *p_frames = 0;
+
+    return SALERR_OK;
+}
+
+/** @internal
+    @brief null backend device creation function
+    @param[in] device pointer to output device
+    @param[in] kp_sp pointer to system parameters structure, may NOT be NULL
+    @param[in] desired_channels number of desired output channels, 0 for the default
+    @param[in] desired_bits number of bits per sample, 8 or 16, 0 for the default
+    @param[in] desired_sample_rate desired sample rate, in samples/second, 0 for the default
+    @remarks Any format SAL can mix is accepted as it is.  Nothing is
+    queued after mixing, so SAL_get_output_latency() reports 0.
+*/
+sal_error_e
+_SAL_create_device_data_null( SAL_Device *device,
+                              const SAL_SystemParameters *kp_sp,
+                              sal_u32_t desired_channels,
+                              sal_u32_t desired_bits,
+                              sal_u32_t desired_sample_rate )
+{
+    SAL_NullData *nd;
+    sal_u32_t period_frames, num_periods;
+    sal_error_e err;
+
+    if ( device == 0 || kp_sp == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    desired_channels    = ( desired_channels == 0 ) ? DEFAULT_AUDIO_CHANNELS : desired_channels;
+    desired_bits        = ( desired_bits     == 0 ) ? DEFAULT_AUDIO_BITS : desired_bits;
+    desired_sample_rate = ( desired_sample_rate == 0 ) ? DEFAULT_AUDIO_SAMPLE_RATE  : desired_sample_rate;
+
+    if ( ( desired_channels != 1 && desired_channels != 2 ) || ( desired_bits != 8 && desired_bits != 16 ) )
+    {
+        return SALERR_INVALIDFORMAT;
+    }
+
+    _SAL_get_period_config( kp_sp, desired_sample_rate, &period_frames, &num_periods );
+
+    device->device_fnc_destroy   = destroy_device_data_null;
+    device->device_fnc_get_delay = s_null_get_delay;
+
+    nd = ( SAL_NullData * ) device->device_callbacks.alloc( sizeof( *nd ) );
+
+    if ( nd == 0 )
+    {
+        return SALERR_OUTOFMEMORY;
+    }
+
+    memset( nd, 0, sizeof( *nd ) );
+
+    nd->nd_period_bytes = period_frames * desired_channels * ( desired_bits / 8 );
+    nd->nd_period_ns    = ( sal_u64_t ) period_frames * 1000000000 / desired_sample_rate;
+
+    if ( ( err = SAL_alloc_aligned( device, ( void ** ) &nd->nd_mix_buffer, nd->nd_period_bytes, SAL_ALIGNMENT ) ) != SALERR_OK )
+    {
+        device->device_callbacks.free( nd );
+        return err;
+    }
+
+    device->device_data                  = nd;
+    device->device_info.di_size          = sizeof( device->device_info );
+    device->device_info.di_bits          = desired_bits;
+    device->device_info.di_channels      = desired_channels;
+    device->device_info.di_sample_rate   = desired_sample_rate;
+    device->device_info.di_bytes_per_sample = desired_bits / 8;
+    device->device_info.di_bytes_per_frame  = desired_channels * ( desired_bits / 8 );
+    device->device_info.di_period_frames = period_frames;
+    device->device_info.di_num_periods   = num_periods;
+    strncpy( device->device_info.di_name, "Null", sizeof( device->device_info.di_name ) );
+
+    _SAL_lock_memory( device, nd->nd_mix_buffer, nd->nd_period_bytes );
+
+    _SAL_init_pipeline( device, period_frames );
+
+    /* kick off audio thread */
+    _SAL_create_thread( device, s_null_audio_thread, device, SAL_THREAD_AUDIO );
+
+    return SALERR_OK;
+}
+
+static
+void
+destroy_device_data_null( SAL_Device *device )
+{
+    SAL_NullData *nd;
+    int running = 1;
+
+    if ( device == 0 || device->device_data == 0 )
+        return;
+
+    nd = ( SAL_NullData * ) device->device_data;
+
+    _SAL_lock_device( device );
+    nd->nd_kill_audio_thread = 1;
+    _SAL_unlock_device( device );
+
+    /* the thread clears the flag on its way out */
+    while ( running )
+    {
+        SAL_sleep( device, 1 );
+
+        _SAL_lock_device( device );
+        running = nd->nd_kill_audio_thread;
+        _SAL_unlock_device( device );
+    }
+
+    if ( nd->nd_mix_buffer )
+    {
+        SAL_free_aligned( device, nd->nd_mix_buffer );
+    }
+    device->device_callbacks.free( nd );
+    device->device_data = 0;
+}
+
+#endif /* SAL_SUPPORT_NULL */
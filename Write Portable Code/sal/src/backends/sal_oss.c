@@ -51,33 +51,72 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <string.h>
 #include <stdlib.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/select.h>
 #include <sys/soundcard.h>
 #include <fcntl.h>
 
+#define SAL_OSS_SELECT_TIMEOUT 100000 /**< microseconds the audio thread waits for a free fragment before checking whether to quit */
+
 /** @internal
     @brief private device data for the OSS subsystem */
 typedef struct SAL_OSSData
 {
     int oss_fd;                 /**< file descriptor for OSS */
     int oss_kill_audio_thread;  /**< set to 1 when the thread should die */
-    sal_byte_t *oss_mix_buffer;      /**< mixing buffer */
+    sal_byte_t *oss_mix_buffer;      /**< mixing buffer, NULL in mmap mode */
     int         oss_mix_buffer_size; /**< size of the mix buffer, in bytes */
     int         oss_buffer_length_ms; /**< length of the mix buffer, in millseconds */
+    int         oss_bytes_per_frame;  /**< size of one frame on the device */
+    sal_u64_t   oss_period_ns;        /**< time it takes the device to play one fragment, in nanoseconds */
+    sal_byte_t *oss_dma_buffer;      /**< memory mapped DMA buffer, NULL unless in mmap mode */
+    int         oss_dma_buffer_size; /**< size of the DMA buffer, in bytes */
+    int         oss_dma_write_pos;   /**< offset in the DMA buffer that has been mixed up to */
 } SAL_OSSData;
 
 static void destroy_device_data_oss( SAL_Device *device );
 
+/** @internal
+    @brief audio thread that write()s to the device whenever the driver has a
+    free fragment, keeping no more than the latency target queued */
 static
 void
 s_oss_audio_thread( void *args )
 {
     SAL_Device *device = ( SAL_Device *) args;
     SAL_OSSData *ossd = ( SAL_OSSData * ) device->device_data;
+    sal_u64_t deadline = _SAL_get_time( device );
     int bytes_to_fill = 0;
+    int bytes_queued;
+    int target_bytes;
+    int primed = 0;
+    int underrun;
     audio_buf_info info;
+    fd_set fds;
+    struct timeval tv;
 
     while ( 1 )
     {
+        target_bytes = ( int ) _SAL_get_latency_frames( device ) * ossd->oss_bytes_per_frame;
+
+        if ( target_bytes < ossd->oss_mix_buffer_size )
+        {
+            /* the descriptor is always writable when we keep less than the
+               whole buffer queued, so wake up once a period instead */
+            _SAL_wait_period( device, &deadline, ossd->oss_period_ns );
+        }
+        else
+        {
+            /* the driver makes the descriptor writable once a fragment has been
+               played, the timeout is only there so we notice when to quit */
+            FD_ZERO( &fds );
+            FD_SET( ossd->oss_fd, &fds );
+            tv.tv_sec  = 0;
+            tv.tv_usec = SAL_OSS_SELECT_TIMEOUT;
+
+            select( ossd->oss_fd + 1, 0, &fds, 0, &tv );
+        }
+
         _SAL_lock_device( device );
        
         /* time to quit? */
@@ -87,24 +126,246 @@ s_oss_audio_thread( void *args )
             _SAL_unlock_device( device );
             return;
         }
+
+        if ( target_bytes >= ossd->oss_mix_buffer_size )
+        {
+            device->device_stats.ds_num_wakeups++;
+        }
        
         /* determine how much space we have to fill */
-        ioctl( ossd->oss_fd, SNDCTL_DSP_GETOSPACE, &info );
+        if ( ioctl( ossd->oss_fd, SNDCTL_DSP_GETOSPACE, &info ) == -1 )
+        {
+            info.bytes      = 0;
+            info.fragstotal = 0;
+            info.fragsize   = 0;
+        }
+
+        /* OSS doesn't report underruns, but an empty buffer after we started
+           writing means the device ran dry */
+        bytes_queued = info.fragstotal * info.fragsize - info.bytes;
+        underrun     = primed && info.fragstotal > 0 && bytes_queued <= 0;
+        if ( underrun )
+        {
+            device->device_stats.ds_num_underruns++;
+        }
        
         bytes_to_fill = ( info.bytes > ossd->oss_mix_buffer_size ) ? ossd->oss_mix_buffer_size : info.bytes;
+        bytes_to_fill = ( bytes_to_fill > target_bytes - bytes_queued ) ? target_bytes - bytes_queued : bytes_to_fill;
+        bytes_to_fill -= bytes_to_fill % ossd->oss_bytes_per_frame;
        
-        if ( bytes_to_fill )
+        if ( bytes_to_fill > 0 )
         {
-            _SAL_mix_chunk( device, ossd->oss_mix_buffer, bytes_to_fill );
+            /* the mix buffer is ours alone, so don't make the application
+               wait on the mixer or the driver */
+            _SAL_unlock_device( device );
+            _SAL_render_chunk( device, ossd->oss_mix_buffer, bytes_to_fill );
             write( ossd->oss_fd, ossd->oss_mix_buffer, bytes_to_fill );
+            _SAL_lock_device( device );
+            primed = 1;
+        }
+        else
+        {
+            bytes_to_fill = 0;
         }
+
+        _SAL_update_latency( device, bytes_to_fill / ossd->oss_bytes_per_frame, underrun );
        
         _SAL_unlock_device( device );
+    }
+}
+
+/** @internal
+    @brief audio thread that mixes straight into the memory mapped DMA buffer,
+    refilling whatever the hardware has played since it last woke up */
+static
+void
+s_oss_mmap_audio_thread( void *args )
+{
+    SAL_Device *device = ( SAL_Device *) args;
+    SAL_OSSData *ossd = ( SAL_OSSData * ) device->device_data;
+    sal_u64_t deadline = _SAL_get_time( device );
+    count_info ci;
+    int play_pos, write_pos;
+
+    while ( 1 )
+    {
+        _SAL_lock_device( device );
        
-        SAL_sleep( device, 10 );
+        /* time to quit? */
+        if ( ossd->oss_kill_audio_thread )
+        {
+            ossd->oss_kill_audio_thread = 0;
+            _SAL_unlock_device( device );
+            return;
+        }
+
+        _SAL_unlock_device( device );
+
+        if ( ioctl( ossd->oss_fd, SNDCTL_DSP_GETOPTR, &ci ) != -1 )
+        {
+            /* only this thread moves the write position, s_oss_get_delay()
+               just needs to see where it ends up */
+            play_pos  = ci.ptr - ci.ptr % ossd->oss_bytes_per_frame;
+            write_pos = ossd->oss_dma_write_pos;
+
+            /* wrapped around the end of the buffer */
+            if ( play_pos < write_pos )
+            {
+                _SAL_render_chunk( device, 
+                                   ossd->oss_dma_buffer + write_pos, 
+                                   ossd->oss_dma_buffer_size - write_pos );
+                write_pos = 0;
+            }
+
+            if ( play_pos > write_pos )
+            {
+                _SAL_render_chunk( device, 
+                                   ossd->oss_dma_buffer + write_pos, 
+                                   play_pos - write_pos );
+                write_pos = play_pos;
+            }
+
+            _SAL_lock_device( device );
+            ossd->oss_dma_write_pos = write_pos;
+            _SAL_unlock_device( device );
+        }
+       
+        _SAL_wait_period( device, &deadline, ossd->oss_period_ns );
     }
 }
 
+/** @internal
+    @brief OSS implementation of device_fnc_get_delay
+    @remarks In write mode the driver knows how much it has queued.  In mmap
+    mode it's however far the mixer has got ahead of the play pointer.
+*/
+static
+sal_error_e
+s_oss_get_delay( SAL_Device *device, sal_u32_t *p_frames )
+{
+    SAL_OSSData *ossd = ( SAL_OSSData * ) device->device_data;
+    count_info ci;
+    int bytes;
+
+    if ( ossd->oss_dma_buffer )
+    {
+        if ( ioctl( ossd->oss_fd, SNDCTL_DSP_GETOPTR, &ci ) == -1 )
+        {
+            return SALERR_SYSTEMFAILURE;
+        }
+
+        bytes = ossd->oss_dma_write_pos - ( ci.ptr - ci.ptr % ossd->oss_bytes_per_frame );
+        if ( bytes < 0 )
+        {
+            bytes += ossd->oss_dma_buffer_size;
+        }
+    }
+    else if ( ioctl( ossd->oss_fd, SNDCTL_DSP_GETODELAY, &bytes ) == -1 )
+    {
+        return SALERR_SYSTEMFAILURE;
+    }
+
+    *p_frames = ( sal_u32_t ) bytes / ossd->oss_bytes_per_frame;
+
+    return SALERR_OK;
+}
+
+/** @internal
+    @brief Asks the driver to split its buffer into fragments
+    @param[in] device pointer to output device
+    @param[in] ossd OSS device data, oss_fd must be open
+    @param[in] kp_sp pointer to system parameters structure
+    @param[in] bytes_per_frame size of one frame in the format that will be set
+    @param[in] sample_rate sample rate that will be set
+    @remarks The period comes from _SAL_get_period_config().  Fragments are a power
+    of two bytes, so the nearest one to the requested period is used.  Drivers only
+    honour this before the format is set, and a driver that refuses it just keeps its
+    own fragments.
+*/
+static
+void
+s_oss_set_fragments( SAL_Device *device, SAL_OSSData *ossd, const SAL_SystemParameters *kp_sp, int bytes_per_frame, int sample_rate )
+{
+    sal_u32_t period_frames, num_periods;
+    int num_fragments;
+    int fragment_bytes;
+    int shift = 4;
+    int fragment;
+
+    _SAL_get_period_config( kp_sp, sample_rate, &period_frames, &num_periods );
+
+    num_fragments  = ( num_periods > 0x7FFF ) ? 0x7FFF : ( int ) num_periods;
+    fragment_bytes = ( period_frames > 0x10000 ) ? 0x10000 * bytes_per_frame : ( int ) period_frames * bytes_per_frame;
+
+    if ( num_fragments < 2 )
+    {
+        num_fragments = 2;
+    }
+
+    while ( shift < 16 && ( 1 << shift ) + ( 1 << ( shift - 1 ) ) <= fragment_bytes )
+    {
+        shift++;
+    }
+
+    fragment = ( num_fragments << 16 ) | shift;
+
+    if ( ioctl( ossd->oss_fd, SNDCTL_DSP_SETFRAGMENT, &fragment ) == -1 )
+    {
+        _SAL_warning( device, "Could not set %d fragments of %d bytes, using the driver's default\n", num_fragments, 1 << shift );
+    }
+}
+
+/** @internal
+    @brief Maps the driver's DMA buffer and starts playback from it
+    @param[in] device pointer to output device
+    @param[in] ossd OSS device data, the format must be set
+    @param[in] info buffer layout returned by SNDCTL_DSP_GETOSPACE
+    @param[in] silence byte value of silence in the device's format
+    @returns SALERR_OK on success, SALERR_UNIMPLEMENTED if the driver can't
+    do it, in which case the caller should write() instead
+*/
+static
+sal_error_e
+s_oss_start_mmap( SAL_Device *device, SAL_OSSData *ossd, const audio_buf_info *info, int silence )
+{
+    int caps = 0;
+    int trigger;
+    void *p;
+
+    if ( ioctl( ossd->oss_fd, SNDCTL_DSP_GETCAPS, &caps ) == -1 || !( caps & DSP_CAP_MMAP ) || !( caps & DSP_CAP_TRIGGER ) )
+    {
+        _SAL_warning( device, "OSS driver does not support mmap, writing to it instead\n" );
+        return SALERR_UNIMPLEMENTED;
+    }
+
+    ossd->oss_dma_buffer_size = info->fragstotal * info->fragsize;
+
+    /* the mixer can't split a frame across the end of the buffer */
+    if ( ossd->oss_dma_buffer_size <= 0 || ossd->oss_dma_buffer_size % ossd->oss_bytes_per_frame )
+    {
+        _SAL_warning( device, "OSS DMA buffer of %d bytes does not hold whole frames, writing to it instead\n", ossd->oss_dma_buffer_size );
+        return SALERR_UNIMPLEMENTED;
+    }
+
+    if ( ( p = mmap( 0, ossd->oss_dma_buffer_size, PROT_WRITE, MAP_SHARED, ossd->oss_fd, 0 ) ) == MAP_FAILED )
+    {
+        _SAL_warning( device, "Could not mmap the OSS DMA buffer, writing to it instead\n" );
+        return SALERR_UNIMPLEMENTED;
+    }
+
+    ossd->oss_dma_buffer    = ( sal_byte_t * ) p;
+    ossd->oss_dma_write_pos = 0;
+    memset( ossd->oss_dma_buffer, silence, ossd->oss_dma_buffer_size );
+
+    /* playback starts at the beginning of the buffer, which is silent for now */
+    trigger = 0;
+    ioctl( ossd->oss_fd, SNDCTL_DSP_SETTRIGGER, &trigger );
+    trigger = PCM_ENABLE_OUTPUT;
+    ioctl( ossd->oss_fd, SNDCTL_DSP_SETTRIGGER, &trigger );
+
+    return SALERR_OK;
+}
+
 /** @internal
     @brief OSS specific device creation function
     @param[in] device pointer to output device
@@ -113,6 +374,10 @@ s_oss_audio_thread( void *args )
     may be 0 if you want it to use default preferences
     @param[in] desired_bits number of bits per sample, specify 0 for system default
     @param[in] desired_sample_rate desired sample rate, in samples/second, specify 0 for system default
+    @remarks The driver's buffer is split into sp_num_periods fragments of sp_period_frames
+    and the audio thread wakes up whenever a fragment has been played.  With
+    @ref SAL_SPF_OSS_MMAP it mixes straight into the DMA buffer, falling back to
+    write() if the driver can't do that.
 */
 sal_error_e
 _SAL_create_device_data_oss( SAL_Device *device, 
@@ -122,7 +387,9 @@ _SAL_create_device_data_oss( SAL_Device *device,
                              sal_u32_t desired_sample_rate )
 {
     SAL_OSSData *ossd = 0;
-    const char *device_name = "/dev/dsp";
+    const char *device_name = ( kp_sp && kp_sp->sp_device_name ) ? kp_sp->sp_device_name : "/dev/dsp";
+    int use_mmap;
+    audio_buf_info info;
 
     desired_channels    = ( desired_channels == 0 ) ? DEFAULT_AUDIO_CHANNELS : desired_channels;
     desired_bits        = ( desired_bits == 0 ) ? DEFAULT_AUDIO_BITS : desired_bits;
@@ -133,21 +400,34 @@ _SAL_create_device_data_oss( SAL_Device *device,
         return SALERR_INVALIDPARAM;
     }
 
-    device->device_fnc_destroy = destroy_device_data_oss;
+    device->device_fnc_destroy   = destroy_device_data_oss;
+    device->device_fnc_get_delay = s_oss_get_delay;
     
     ossd = ( SAL_OSSData * ) device->device_callbacks.alloc( sizeof( *ossd ) );
 
     memset( ossd, 0, sizeof( *ossd ) );
 
     ossd->oss_buffer_length_ms = ( kp_sp->sp_buffer_length_ms == 0 ) ? DEFAULT_BUFFER_DURATION : kp_sp->sp_buffer_length_ms;
+    ossd->oss_bytes_per_frame  = ( desired_bits / 8 ) * desired_channels;
+
+    /* open appropriate device, mapping it needs read access too */
+    use_mmap = ( kp_sp->sp_flags & SAL_SPF_OSS_MMAP ) != 0;
 
-    /* open appropriate device */
-    if ( ( ossd->oss_fd = open( device_name, O_WRONLY, 0 ) ) == -1 )
+    if ( use_mmap && ( ossd->oss_fd = open( device_name, O_RDWR, 0 ) ) == -1 )
+    {
+        _SAL_warning( device, "Could not open %s for mmap, writing to it instead\n", device_name );
+        use_mmap = 0;
+    }
+
+    if ( !use_mmap && ( ossd->oss_fd = open( device_name, O_WRONLY, 0 ) ) == -1 )
     {
         _SAL_warning( device, "Could not open %s\n", device_name );
+        device->device_callbacks.free( ossd );
         return SALERR_SYSTEMFAILURE;
     }
 
+    s_oss_set_fragments( device, ossd, kp_sp, ossd->oss_bytes_per_frame, desired_sample_rate );
+
     /* set format */
         {
             int format = ( int ) ( ( desired_bits == 8 ) ? AFMT_U8 : AFMT_S16_NE );
@@ -180,23 +460,62 @@ _SAL_create_device_data_oss( SAL_Device *device,
             }
         }
 
-    /* create mixing buffer */
-    ossd->oss_mix_buffer_size = ( desired_bits / 8 ) * desired_sample_rate * desired_channels * ossd->oss_buffer_length_ms / 1000;
+    /* find out what the driver made of our fragment request */
+    if ( ioctl( ossd->oss_fd, SNDCTL_DSP_GETOSPACE, &info ) == -1 || info.fragsize <= 0 || info.fragstotal <= 0 )
+    {
+        info.fragstotal = DEFAULT_NUM_PERIODS;
+        info.fragsize   = ( ( desired_bits / 8 ) * desired_sample_rate * desired_channels * ossd->oss_buffer_length_ms / 1000 ) / DEFAULT_NUM_PERIODS;
+        use_mmap = 0;
+    }
+
+    ossd->oss_period_ns = ( sal_u64_t ) ( info.fragsize / ossd->oss_bytes_per_frame ) * 1000000000 / desired_sample_rate;
+
+    if ( use_mmap && s_oss_start_mmap( device, ossd, &info, ( desired_bits == 8 ) ? 0x80 : 0 ) != SALERR_OK )
+    {
+        use_mmap = 0;
+    }
+
+    /* the write() thread can keep less than the whole buffer queued, the
+       hardware pointer in mmap mode can't be held back */
+    if ( use_mmap && ( kp_sp->sp_flags & SAL_SPF_ADAPTIVE_LATENCY ) )
+    {
+        _SAL_warning( device, "Adaptive latency is not supported in OSS mmap mode\n" );
+    }
 
-    /* forcibly align on 32-bit boundary */
-    ossd->oss_mix_buffer_size &= ~(( desired_bits * desired_channels / 8 )-1);
-    ossd->oss_mix_buffer = (sal_byte_t *) device->device_callbacks.alloc( ossd->oss_mix_buffer_size );
+    _SAL_init_latency( device, 
+                       desired_sample_rate, 
+                       info.fragsize / ossd->oss_bytes_per_frame, 
+                       info.fragstotal, 
+                       !use_mmap && ( kp_sp->sp_flags & SAL_SPF_ADAPTIVE_LATENCY ) );
+
+    if ( !use_mmap )
+    {
+        /* create mixing buffer, big enough to fill the driver's whole buffer at once */
+        ossd->oss_mix_buffer_size = info.fragstotal * info.fragsize;
+
+        /* forcibly align on 32-bit boundary */
+        ossd->oss_mix_buffer_size &= ~(( desired_bits * desired_channels / 8 )-1);
+        SAL_alloc_aligned( device, ( void ** ) &ossd->oss_mix_buffer, ossd->oss_mix_buffer_size, SAL_ALIGNMENT );
+        _SAL_lock_memory( device, ossd->oss_mix_buffer, ossd->oss_mix_buffer_size );
+    }
+    _SAL_lock_memory( device, ossd, sizeof( *ossd ) );
 
     /* save out parameters */
     device->device_info.di_size        = sizeof( device->device_info );
     device->device_info.di_channels    = desired_channels;
     device->device_info.di_bits        = desired_bits;
     device->device_info.di_sample_rate = desired_sample_rate;
+    device->device_info.di_bytes_per_sample = desired_bits / 8;
+    device->device_info.di_bytes_per_frame  = ossd->oss_bytes_per_frame;
+    device->device_info.di_period_frames    = info.fragsize / ossd->oss_bytes_per_frame;
+    device->device_info.di_num_periods      = info.fragstotal;
     device->device_data = ossd;
-    strncpy( device->device_info.di_name, "OSS", sizeof( device->device_info.di_name ) );
+    strncpy( device->device_info.di_name, use_mmap ? "OSS (mmap)" : "OSS", sizeof( device->device_info.di_name ) );
+
+    _SAL_init_pipeline( device, device->device_info.di_period_frames );
 
     /* kick off audio thread */
-    _SAL_create_thread( device, s_oss_audio_thread, device );
+    _SAL_create_thread( device, use_mmap ? s_oss_mmap_audio_thread : s_oss_audio_thread, device, SAL_THREAD_AUDIO );
 
     return SALERR_OK;
 }
@@ -220,13 +539,18 @@ destroy_device_data_oss( SAL_Device *device )
 
     SAL_sleep( device, 1000 );
 
+    if ( ossd->oss_dma_buffer )
+    {
+        munmap( ossd->oss_dma_buffer, ossd->oss_dma_buffer_size );
+    }
+
     /* close the file descriptor */
     close( ossd->oss_fd );
 
     /* free memory */
     if ( ossd->oss_mix_buffer )
     {
-        device->device_callbacks.free( ossd->oss_mix_buffer );
+        SAL_free_aligned( device, ossd->oss_mix_buffer );
     }
     device->device_callbacks.free( ossd );
     device->device_data = 0;
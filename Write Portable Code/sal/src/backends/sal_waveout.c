@@ -70,6 +70,8 @@ typedef struct
     int wod_buffer_length_ms;    /**< length of individual buffers, in ms */
     int wod_buffer_size;         /**< size of individual buffers, in bytes */
     int wod_next_buffer;         /**< index to next buffer to fill */
+    int wod_buffer_frames;       /**< size of individual buffers, in frames */
+    DWORD wod_frames_written;    /**< frames handed to waveOutWrite, wraps like the position does */
 
     int wod_kill_audio_thread;   /**< set to 1 when the thread should terminate */
 } SAL_WaveOutData;
@@ -116,6 +118,7 @@ s_audio_thread( void *args )
 
                 _SAL_mix_chunk( device, wod->wod_buffer[ i ], wod->wod_buffer_size );
                 waveOutWrite( wod->wod_hWaveOut, &wod->wod_wave_header[ i ], sizeof( wod->wod_wave_header[ 0 ] ) );
+                wod->wod_frames_written += wod->wod_buffer_frames;
 
                 i = ( i + 1 ) % _SAL_WAVEOUT_NUM_BUFFERS;
             }
@@ -133,6 +136,35 @@ s_audio_thread( void *args )
     }
 }
 
+/** @internal
+    @ingroup Win32
+    @brief WAVEOUT implementation of device_fnc_get_delay, the frames we've
+    written less the frames the driver says it has played */
+static
+sal_error_e
+s_waveout_get_delay( SAL_Device *device, sal_u32_t *p_frames )
+{
+    SAL_WaveOutData *wod = ( SAL_WaveOutData * ) device->device_data;
+    MMTIME mmt;
+
+    mmt.wType = TIME_SAMPLES;
+
+    if ( waveOutGetPosition( wod->wod_hWaveOut, &mmt, sizeof( mmt ) ) != MMSYSERR_NOERROR )
+    {
+        return SALERR_SYSTEMFAILURE;
+    }
+
+    /* the driver may not do sample positions */
+    if ( mmt.wType != TIME_SAMPLES )
+    {
+        return SALERR_UNIMPLEMENTED;
+    }
+
+    *p_frames = wod->wod_frames_written - mmt.u.sample;
+
+    return SALERR_OK;
+}
+
 static
 DWORD
 params_to_format( sal_u32_t desired_channels,
@@ -274,6 +306,7 @@ _SAL_create_device_data_waveout( SAL_Device *device,
     MMRESULT mmr;
     SAL_WaveOutData *wod = 0;
     int buffer_length_ms;
+    sal_u32_t period_frames, num_periods;
     UINT num_devices;
     int i;
     sal_error_e err=SALERR_UNKNOWN;
@@ -288,12 +321,15 @@ _SAL_create_device_data_waveout( SAL_Device *device,
     desired_bits        = ( desired_bits     == 0 ) ? DEFAULT_AUDIO_BITS : desired_bits;
     desired_sample_rate = ( desired_sample_rate == 0 ) ? DEFAULT_AUDIO_SAMPLE_RATE  : desired_sample_rate;
 
-    /* compute length of each buffer */
-    buffer_length_ms = ( kp_sp->sp_buffer_length_ms == 0 ) ? DEFAULT_BUFFER_DURATION : kp_sp->sp_buffer_length_ms;
+    /* compute length of each buffer, the periods' total is split across all of them */
+    _SAL_get_period_config( kp_sp, desired_sample_rate, &period_frames, &num_periods );
+    buffer_length_ms = ( int ) ( ( sal_u64_t ) period_frames * num_periods * 1000 / desired_sample_rate );
     buffer_length_ms /= _SAL_WAVEOUT_NUM_BUFFERS;
+    buffer_length_ms = ( buffer_length_ms == 0 ) ? 1 : buffer_length_ms;
 
     /* assign destructor */
-    device->device_fnc_destroy = destroy_device_waveout;
+    device->device_fnc_destroy   = destroy_device_waveout;
+    device->device_fnc_get_delay = s_waveout_get_delay;
 
     /* make sure we have at least one device */
     if ( ( num_devices = waveOutGetNumDevs() ) < 1 )
@@ -343,6 +379,7 @@ _SAL_create_device_data_waveout( SAL_Device *device,
 
     /* forcibly align on 32-bit boundary */
     wod->wod_buffer_size &= ~(( desired_bits * desired_channels / 8 )-1);
+    wod->wod_buffer_frames = wod->wod_buffer_size / ( desired_bits * desired_channels / 8 );
 
     /* create event */
     wod->wod_hEvent = CreateEvent( NULL, FALSE, FALSE, NULL );
@@ -375,7 +412,7 @@ _SAL_create_device_data_waveout( SAL_Device *device,
     /* allocate memory and clear it to silence */
     for ( i = 0; i < _SAL_WAVEOUT_NUM_BUFFERS; i++ )
     {
-        if ( ( wod->wod_buffer[ i ] = ( sal_byte_t * ) device->device_callbacks.alloc( wod->wod_buffer_size ) ) == 0 )
+        if ( SAL_alloc_aligned( device, ( void ** ) &wod->wod_buffer[ i ], wod->wod_buffer_size, SAL_ALIGNMENT ) != SALERR_OK )
         {
             _SAL_warning( device, "Out of memory allocating buffers\n" );
             err = SALERR_OUTOFMEMORY;
@@ -425,6 +462,7 @@ _SAL_create_device_data_waveout( SAL_Device *device,
             err = SALERR_SYSTEMFAILURE;
             goto fail;
         }
+        wod->wod_frames_written += wod->wod_buffer_frames;
     }
 
     /* save info */
@@ -434,9 +472,11 @@ _SAL_create_device_data_waveout( SAL_Device *device,
     device->device_info.di_bits        = wfx.wBitsPerSample;
     device->device_info.di_channels    = wfx.nChannels;
     device->device_info.di_sample_rate = wfx.nSamplesPerSec;
+    device->device_info.di_bytes_per_sample = wfx.wBitsPerSample / 8;
+    device->device_info.di_bytes_per_frame  = wfx.nBlockAlign;
 
     /* kick off our thread */
-    _SAL_create_thread( device, s_audio_thread, device );
+    _SAL_create_thread( device, s_audio_thread, device, SAL_THREAD_AUDIO );
 
     return SALERR_OK;
 fail:
@@ -452,7 +492,7 @@ fail:
             waveOutUnprepareHeader( wod->wod_hWaveOut, &wod->wod_wave_header[ i ], sizeof( wod->wod_wave_header ) );
             if ( wod->wod_buffer[ i ] )
             {
-                device->device_callbacks.free( wod->wod_buffer[ i ] );
+                SAL_free_aligned( device, wod->wod_buffer[ i ] );
             }
         }
         device->device_callbacks.free( wod );
@@ -530,7 +570,7 @@ destroy_device_waveout( SAL_Device *device )
 
     for ( i = 0; i < _SAL_WAVEOUT_NUM_BUFFERS; i++ )
     {
-        device->device_callbacks.free( wod->wod_buffer[ i ] );
+        SAL_free_aligned( device, wod->wod_buffer[ i ] );
     }
     device->device_callbacks.free( wod );
     device->device_data = 0;
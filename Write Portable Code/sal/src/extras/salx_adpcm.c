@@ -0,0 +1,751 @@
+/*
+Copyright (c) 2004, Brian Hook
+All rights reserved.
+
+http://www.bookofhook.com/sal
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+
+    * The names of this package'ss contributors contributors may not
+      be used to endorse or promote products derived from this
+      software without specific prior written permission.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/** @file salx_adpcm.c
+    @brief IMA ADPCM support for the Simple Audio Library
+
+    ADPCM samples keep their data compressed (4 bits per sample) and are
+    decoded by the mixer as they play.  Each channel's decoding state
+    depends on the previous sample, so a channel can't be decoded in
+    parallel with itself; instead the decoder handles all of a frame's
+    channels together, works through 8 frames at a time (one 32-bit word
+    per channel) with no branches in the inner loop, and converts straight
+    into the device's format.
+
+    Blocks are independent, so seeking only ever costs decoding from the
+    start of a block.  Every voice keeps its own decoding state, so a voice
+    playing straight through never seeks, and it also keeps a snapshot of
+    the state at its loop start, so looping back is free after the first
+    time round.
+*/
+#ifndef SAL_DOXYGEN
+#  define SAL_BUILDING_LIB 1
+#endif
+#include "../sal.h"
+#include "salx_adpcm.h"
+
+#include <string.h>
+
+#define SALX_ADPCM_MAX_CHANNELS  2     /**< most channels an ADPCM sample can have */
+#define SALX_ADPCM_RUN_FRAMES    256   /**< most frames decoded in one go */
+#define SALX_ADPCM_NO_FRAME      0xFFFFFFFFU  /**< marks a voice state that doesn't hold a position */
+
+/** @internal
+    @brief Decoding state of one voice playing an ADPCM sample */
+typedef struct
+{
+    sal_u32_t   vs_frame;                                    /**< frame the state is ready to decode */
+    sal_i32_t   vs_pred[ SALX_ADPCM_MAX_CHANNELS ];          /**< predictor of each channel */
+    sal_i32_t   vs_index[ SALX_ADPCM_MAX_CHANNELS ];         /**< step index of each channel */
+    sal_u32_t   vs_loop_frame;                               /**< frame the loop snapshot was taken at */
+    sal_i32_t   vs_loop_pred[ SALX_ADPCM_MAX_CHANNELS ];     /**< predictors at vs_loop_frame */
+    sal_i32_t   vs_loop_index[ SALX_ADPCM_MAX_CHANNELS ];    /**< step indices at vs_loop_frame */
+} _SALx_AdpcmVoice;
+
+/** @internal
+    @brief State bound to an ADPCM sample */
+typedef struct
+{
+    sal_i32_t         ad_channels;           /**< number of channels in the blocks */
+    sal_i32_t         ad_block_align;        /**< size of a block, in bytes */
+    sal_u32_t         ad_frames_per_block;   /**< frames encoded in each block */
+    sal_u32_t         ad_num_frames;         /**< frames in the whole sample */
+    _SALx_AdpcmVoice  ad_voices[ 1 ];        /**< one per device voice, allocated along with the rest */
+} _SALx_Adpcm;
+
+/** @internal
+    @brief Bytes of ADPCM state for a device, which has one _SALx_AdpcmVoice per voice */
+#define S_ADPCM_SIZE( device ) ( sizeof( _SALx_Adpcm ) + ( ( device )->device_max_voices - 1 ) * sizeof( _SALx_AdpcmVoice ) )
+
+static const sal_i32_t s_ima_steps[ 89 ] =
+{
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+    11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+    32767
+};
+
+static const sal_i32_t s_ima_index_adjust[ 16 ] =
+{
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+/* reads a little-endian 16-bit value from a byte array */
+#define S_LE16( p ) ( ( sal_i16_t ) ( ( p )[ 0 ] | ( ( p )[ 1 ] << 8 ) ) )
+
+/* decodes one nibble, updating a channel's predictor and step index.  Written
+   with masks instead of branches so the compiler keeps it branch-free. */
+#define S_IMA_DECODE( nibble, pred, index ) \
+{ \
+    sal_i32_t step_ = s_ima_steps[ index ]; \
+    sal_i32_t sign_ = -( ( ( nibble ) >> 3 ) & 1 ); \
+    sal_i32_t diff_ = ( step_ >> 3 ) + \
+                      ( step_ & -( ( ( nibble ) >> 2 ) & 1 ) ) + \
+                      ( ( step_ >> 1 ) & -( ( ( nibble ) >> 1 ) & 1 ) ) + \
+                      ( ( step_ >> 2 ) & -( ( nibble ) & 1 ) ); \
+    ( pred ) += ( diff_ ^ sign_ ) - sign_; \
+    ( pred ) = ( pred ) > 32767 ? 32767 : ( ( pred ) < -32768 ? -32768 : ( pred ) ); \
+    ( index ) += s_ima_index_adjust[ nibble ]; \
+    ( index ) = ( index ) > 88 ? 88 : ( ( index ) < 0 ? 0 : ( index ) ); \
+}
+
+/** Returns the number of frames held by each block of an ADPCM stream.
+    @ingroup extras
+    @param [in] channels number of channels, 1 or 2
+    @param [in] block_align size of a block in bytes, a multiple of 4 * channels
+    @returns the number of frames per block, or 0 if the parameters are invalid
+*/
+int
+SALx_get_adpcm_frames_per_block( int channels, 
+                                 int block_align )
+{
+    if ( channels < 1 || channels > SALX_ADPCM_MAX_CHANNELS || 
+         block_align <= 4 * channels || ( block_align % ( 4 * channels ) ) != 0 )
+    {
+        return 0;
+    }
+
+    /* the header holds one frame and every byte after it two samples */
+    return ( block_align - 4 * channels ) * 2 / channels + 1;
+}
+
+/** Returns the number of bytes SALx_encode_adpcm needs to encode some frames.
+    @ingroup extras
+    @param [in] channels number of channels, 1 or 2
+    @param [in] block_align size of a block in bytes, a multiple of 4 * channels
+    @param [in] num_frames number of frames to encode
+    @param [out] p_size receives the size in bytes
+    @returns SALERR_OK on success, @ref sal_error_e on failure
+*/
+sal_error_e
+SALx_get_adpcm_size( int channels, 
+                     int block_align, 
+                     int num_frames, 
+                     int *p_size )
+{
+    int frames_per_block = SALx_get_adpcm_frames_per_block( channels, block_align );
+
+    if ( frames_per_block == 0 || num_frames < 0 || p_size == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    *p_size = ( ( num_frames + frames_per_block - 1 ) / frames_per_block ) * block_align;
+
+    return SALERR_OK;
+}
+
+/** Encodes 16-bit PCM as IMA ADPCM blocks.
+    @ingroup extras
+    @param [in] kp_src interleaved 16-bit PCM in the host's byte order
+    @param [in] channels number of channels, 1 or 2
+    @param [in] block_align size of a block in bytes, a multiple of 4 * channels.
+                256 bytes per channel is typical.
+    @param [in] num_frames number of frames to encode
+    @param [out] p_dst destination for the blocks, SALx_get_adpcm_size bytes long
+    @returns SALERR_OK on success, @ref sal_error_e on failure
+    The last block is padded by repeating the final frame.
+*/
+sal_error_e
+SALx_encode_adpcm( const sal_i16_t *kp_src,
+                   int channels,
+                   int block_align,
+                   int num_frames,
+                   void *p_dst )
+{
+    int frames_per_block = SALx_get_adpcm_frames_per_block( channels, block_align );
+    sal_i32_t pred[ SALX_ADPCM_MAX_CHANNELS ];
+    sal_i32_t index[ SALX_ADPCM_MAX_CHANNELS ] = { 0 };
+    sal_byte_t *p_block = ( sal_byte_t * ) p_dst;
+    int block_start;
+    int c, f;
+
+    if ( frames_per_block == 0 || kp_src == 0 || p_dst == 0 || num_frames < 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    for ( block_start = 0; block_start < num_frames; block_start += frames_per_block, p_block += block_align )
+    {
+        memset( p_block, 0, block_align );
+
+        /* the header carries the first frame verbatim, and the step index
+           carries on from the previous block */
+        for ( c = 0; c < channels; c++ )
+        {
+            pred[ c ] = kp_src[ block_start * channels + c ];
+
+            p_block[ c * 4 + 0 ] = ( sal_byte_t ) ( pred[ c ] & 0xFF );
+            p_block[ c * 4 + 1 ] = ( sal_byte_t ) ( ( pred[ c ] >> 8 ) & 0xFF );
+            p_block[ c * 4 + 2 ] = ( sal_byte_t ) index[ c ];
+        }
+
+        for ( f = 1; f < frames_per_block; f++ )
+        {
+            int k = f - 1;
+            int frame = block_start + f;
+
+            /* pad the last block out with the final frame */
+            if ( frame >= num_frames )
+            {
+                frame = num_frames - 1;
+            }
+
+            for ( c = 0; c < channels; c++ )
+            {
+                sal_i32_t diff = kp_src[ frame * channels + c ] - pred[ c ];
+                sal_i32_t step = s_ima_steps[ index[ c ] ];
+                int nibble = 0;
+                sal_byte_t *p_byte = p_block + 4 * channels + ( k >> 3 ) * 4 * channels + c * 4 + ( ( k & 7 ) >> 1 );
+
+                if ( diff < 0 )
+                {
+                    nibble = 8;
+                    diff   = -diff;
+                }
+
+                if ( diff >= step )
+                {
+                    nibble |= 4;
+                    diff   -= step;
+                }
+                step >>= 1;
+
+                if ( diff >= step )
+                {
+                    nibble |= 2;
+                    diff   -= step;
+                }
+                step >>= 1;
+
+                if ( diff >= step )
+                {
+                    nibble |= 1;
+                }
+
+                /* track exactly what the decoder will reconstruct */
+                S_IMA_DECODE( nibble, pred[ c ], index[ c ] );
+
+                *p_byte |= ( sal_byte_t ) ( ( k & 1 ) ? ( nibble << 4 ) : nibble );
+            }
+        }
+    }
+
+    return SALERR_OK;
+}
+
+/** @internal
+    @brief Decodes frames of an ADPCM sample
+    @param[in] p_adpcm the sample's ADPCM state
+    @param[in] kp_blocks the sample's blocks
+    @param[in,out] p_voice decoding state, which must be positioned at a valid frame
+    @param[out] p_dst receives num_frames interleaved 16-bit frames in host order
+    @param[in] num_frames number of frames to decode, all of which must exist
+*/
+static
+void
+s_adpcm_decode( const _SALx_Adpcm *p_adpcm,
+                const sal_byte_t *kp_blocks,
+                _SALx_AdpcmVoice *p_voice,
+                sal_i16_t *p_dst,
+                int num_frames )
+{
+    const sal_i32_t channels = p_adpcm->ad_channels;
+    const sal_u32_t frames_per_block = p_adpcm->ad_frames_per_block;
+    sal_u32_t frame = p_voice->vs_frame;
+    sal_i32_t c, j;
+
+    while ( num_frames > 0 )
+    {
+        const sal_byte_t *kp_block = kp_blocks + ( frame / frames_per_block ) * p_adpcm->ad_block_align;
+        sal_u32_t f = frame % frames_per_block;
+        sal_u32_t k = f - 1;
+
+        if ( f == 0 )
+        {
+            /* start of a block, the header holds the frame itself */
+            for ( c = 0; c < channels; c++ )
+            {
+                p_voice->vs_pred[ c ]  = S_LE16( kp_block + c * 4 );
+                p_voice->vs_index[ c ] = ( kp_block[ c * 4 + 2 ] > 88 ) ? 88 : kp_block[ c * 4 + 2 ];
+                p_dst[ c ] = ( sal_i16_t ) p_voice->vs_pred[ c ];
+            }
+
+            p_dst += channels;
+            frame++;
+            num_frames--;
+        }
+        else if ( ( k & 7 ) == 0 && num_frames >= 8 && f + 8 <= frames_per_block )
+        {
+            /* a whole group: one 32-bit word of nibbles per channel */
+            const sal_byte_t *kp_group = kp_block + 4 * channels + ( k >> 3 ) * 4 * channels;
+
+            for ( c = 0; c < channels; c++ )
+            {
+                sal_u32_t word  = kp_group[ c * 4 ] | ( kp_group[ c * 4 + 1 ] << 8 ) | 
+                                  ( kp_group[ c * 4 + 2 ] << 16 ) | ( ( sal_u32_t ) kp_group[ c * 4 + 3 ] << 24 );
+                sal_i32_t pred  = p_voice->vs_pred[ c ];
+                sal_i32_t index = p_voice->vs_index[ c ];
+
+                for ( j = 0; j < 8; j++, word >>= 4 )
+                {
+                    sal_i32_t nibble = ( sal_i32_t ) ( word & 15 );
+
+                    S_IMA_DECODE( nibble, pred, index );
+                    p_dst[ j * channels + c ] = ( sal_i16_t ) pred;
+                }
+
+                p_voice->vs_pred[ c ]  = pred;
+                p_voice->vs_index[ c ] = index;
+            }
+
+            p_dst      += 8 * channels;
+            frame      += 8;
+            num_frames -= 8;
+        }
+        else
+        {
+            /* a single frame part way through a group */
+            const sal_byte_t *kp_group = kp_block + 4 * channels + ( k >> 3 ) * 4 * channels;
+
+            for ( c = 0; c < channels; c++ )
+            {
+                sal_byte_t byte = kp_group[ c * 4 + ( ( k & 7 ) >> 1 ) ];
+                sal_i32_t nibble = ( k & 1 ) ? ( byte >> 4 ) : ( byte & 15 );
+
+                S_IMA_DECODE( nibble, p_voice->vs_pred[ c ], p_voice->vs_index[ c ] );
+                p_dst[ c ] = ( sal_i16_t ) p_voice->vs_pred[ c ];
+            }
+
+            p_dst += channels;
+            frame++;
+            num_frames--;
+        }
+    }
+
+    p_voice->vs_frame = frame;
+}
+
+/** @internal
+    @brief Positions a voice's decoding state at a frame
+    @param[in] p_adpcm the sample's ADPCM state
+    @param[in] kp_blocks the sample's blocks
+    @param[in,out] p_voice decoding state to position
+    @param[in] frame frame to position at
+    @param[in] loop_frame the voice's loop start frame
+*/
+static
+void
+s_adpcm_seek( const _SALx_Adpcm *p_adpcm,
+              const sal_byte_t *kp_blocks,
+              _SALx_AdpcmVoice *p_voice,
+              sal_u32_t frame,
+              sal_u32_t loop_frame )
+{
+    sal_i16_t scratch[ SALX_ADPCM_RUN_FRAMES * SALX_ADPCM_MAX_CHANNELS ];
+    sal_u32_t skip;
+
+    if ( frame == p_voice->vs_loop_frame )
+    {
+        memcpy( p_voice->vs_pred, p_voice->vs_loop_pred, sizeof( p_voice->vs_pred ) );
+        memcpy( p_voice->vs_index, p_voice->vs_loop_index, sizeof( p_voice->vs_index ) );
+        p_voice->vs_frame = frame;
+        return;
+    }
+
+    /* decode forward from the start of the block */
+    p_voice->vs_frame = frame - frame % p_adpcm->ad_frames_per_block;
+
+    while ( ( skip = frame - p_voice->vs_frame ) > 0 )
+    {
+        s_adpcm_decode( p_adpcm, kp_blocks, p_voice, scratch, 
+                        ( int ) ( skip > SALX_ADPCM_RUN_FRAMES ? SALX_ADPCM_RUN_FRAMES : skip ) );
+    }
+
+    /* a block start needs no snapshot, its header is all the state there is */
+    if ( frame == loop_frame && ( frame % p_adpcm->ad_frames_per_block ) != 0 )
+    {
+        memcpy( p_voice->vs_loop_pred, p_voice->vs_pred, sizeof( p_voice->vs_pred ) );
+        memcpy( p_voice->vs_loop_index, p_voice->vs_index, sizeof( p_voice->vs_index ) );
+        p_voice->vs_loop_frame = frame;
+    }
+}
+
+/** @internal
+    @brief Decoder for ADPCM samples
+    @param[in] p_device pointer to output device
+    @param[in] voice voice that is being decoded
+    @param[out] p_dst destination buffer for decoding
+    @param[in] bytes_needed number of bytes we need to decode
+    @returns 1 if the voice has ended, 0 if not
+*/
+static
+int
+s_adpcm_decoder( SAL_Device *p_device,
+                 sal_voice_t voice,
+                 sal_byte_t *p_dst,
+                 int bytes_needed )
+{
+    SAL_Voice *p_voice = &p_device->device_voices[ voice ];
+    SAL_Sample *sample = p_voice->voice_sample;
+    _SALx_Adpcm *p_adpcm = ( _SALx_Adpcm * ) sample->sample_args.sarg_ptr;
+    _SALx_AdpcmVoice *p_state = &p_adpcm->ad_voices[ voice ];
+    const sal_i32_t dst_channels = p_device->device_info.di_channels;
+    const sal_i32_t src_channels = p_adpcm->ad_channels;
+    const sal_i32_t bytes_per_frame = p_device->device_info.di_bytes_per_sample * dst_channels;
+    sal_i16_t pcm[ SALX_ADPCM_RUN_FRAMES * SALX_ADPCM_MAX_CHANNELS ];
+    sal_byte_t silence = ( p_device->device_info.di_bits == 8 ) ? 0x80 : 0;
+
+    while ( bytes_needed >= bytes_per_frame )
+    {
+        sal_u32_t frame      = p_voice->voice_cursor / dst_channels;
+        sal_u32_t end_frame  = p_voice->voice_loop_end / dst_channels;
+        sal_i32_t num_frames = bytes_needed / bytes_per_frame;
+        sal_i32_t i;
+
+        if ( end_frame > p_adpcm->ad_num_frames )
+        {
+            end_frame = p_adpcm->ad_num_frames;
+        }
+
+        if ( frame >= end_frame )
+        {
+            /* nothing left to decode, let the voice run out */
+            memset( p_dst, silence, bytes_needed );
+            return !_SAL_advance_voice( p_device, voice, bytes_needed / p_device->device_info.di_bytes_per_sample );
+        }
+
+        if ( ( sal_u32_t ) num_frames > end_frame - frame )
+        {
+            num_frames = ( sal_i32_t ) ( end_frame - frame );
+        }
+
+        if ( num_frames > SALX_ADPCM_RUN_FRAMES )
+        {
+            num_frames = SALX_ADPCM_RUN_FRAMES;
+        }
+
+        if ( p_state->vs_frame != frame )
+        {
+            s_adpcm_seek( p_adpcm, sample->sample_data, p_state, frame, p_voice->voice_loop_start / dst_channels );
+        }
+
+        s_adpcm_decode( p_adpcm, sample->sample_data, p_state, pcm, num_frames );
+
+        /* convert to the device's format */
+        if ( p_device->device_info.di_bits == 16 )
+        {
+            sal_i16_t *p_dst16 = ( sal_i16_t * ) p_dst;
+
+            if ( src_channels == dst_channels )
+            {
+                memcpy( p_dst16, pcm, num_frames * src_channels * sizeof( sal_i16_t ) );
+            }
+            else if ( src_channels == 1 )
+            {
+                for ( i = 0; i < num_frames; i++ )
+                {
+                    p_dst16[ i * 2 ] = p_dst16[ i * 2 + 1 ] = pcm[ i ];
+                }
+            }
+            else
+            {
+                for ( i = 0; i < num_frames; i++ )
+                {
+                    p_dst16[ i ] = ( sal_i16_t ) ( ( pcm[ i * 2 ] + pcm[ i * 2 + 1 ] ) / 2 );
+                }
+            }
+        }
+        else
+        {
+            if ( src_channels == dst_channels )
+            {
+                for ( i = 0; i < num_frames * src_channels; i++ )
+                {
+                    p_dst[ i ] = I16_TO_U8( pcm[ i ] );
+                }
+            }
+            else if ( src_channels == 1 )
+            {
+                for ( i = 0; i < num_frames; i++ )
+                {
+                    p_dst[ i * 2 ] = p_dst[ i * 2 + 1 ] = I16_TO_U8( pcm[ i ] );
+                }
+            }
+            else
+            {
+                for ( i = 0; i < num_frames; i++ )
+                {
+                    p_dst[ i ] = I16_TO_U8( ( pcm[ i * 2 ] + pcm[ i * 2 + 1 ] ) / 2 );
+                }
+            }
+        }
+
+        p_dst        += num_frames * bytes_per_frame;
+        bytes_needed -= num_frames * bytes_per_frame;
+
+        if ( !_SAL_advance_voice( p_device, voice, num_frames * dst_channels ) )
+        {
+            memset( p_dst, silence, bytes_needed );
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/** @internal
+    @brief Destruction callback for ADPCM samples
+    @param[in] p_device pointer to output device, locked
+    @param[in] self pointer to sample being destroyed
+*/
+static
+void
+s_adpcm_destroy( SAL_Device *p_device,
+                 SAL_Sample *self )
+{
+    _SAL_pool_free_locked( p_device, self->sample_args.sarg_ptr, S_ADPCM_SIZE( p_device ) );
+    _SAL_generic_destroy_sample( p_device, self );
+}
+
+/** Creates a sample from IMA ADPCM blocks.
+    @ingroup extras
+    @param [in] device pointer to output device
+    @param [out] pp_sample address of a pointer to store the new sample
+    @param [in] kp_blocks the blocks, which are copied
+    @param [in] blocks_size number of bytes in kp_blocks
+    @param [in] kp_format layout of the blocks
+    @returns SALERR_OK on success, @ref sal_error_e on failure
+    The sample keeps the blocks compressed and decodes them as it plays, so
+    it takes about a quarter of the memory of the same sound as 16-bit PCM.
+*/
+sal_error_e
+SALx_create_sample_from_adpcm( SAL_Device *device,
+                               SAL_Sample **pp_sample,
+                               const void *kp_blocks,
+                               int blocks_size,
+                               const SALx_AdpcmFormat *kp_format )
+{
+    sal_error_e err;
+    SAL_SampleArgs args;
+    SAL_DeviceInfo dinfo;
+    _SALx_Adpcm *p_adpcm = 0;
+    void *p_data = 0;
+    int frames_per_block;
+    int needed_size;
+    int i;
+
+    if ( device == 0 || pp_sample == 0 || kp_blocks == 0 || kp_format == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    *pp_sample = 0;
+
+    frames_per_block = SALx_get_adpcm_frames_per_block( kp_format->af_channels, kp_format->af_block_align );
+
+    if ( frames_per_block == 0 || kp_format->af_num_frames <= 0 )
+    {
+        return SALERR_INVALIDFORMAT;
+    }
+
+    /* every frame's group has to be there, so a short last block is only
+       allowed to end on a group boundary */
+    needed_size = ( kp_format->af_num_frames / frames_per_block ) * kp_format->af_block_align;
+
+    if ( kp_format->af_num_frames % frames_per_block )
+    {
+        needed_size += 4 * kp_format->af_channels * 
+                       ( 1 + ( ( kp_format->af_num_frames % frames_per_block ) + 6 ) / 8 );
+    }
+
+    if ( blocks_size < needed_size )
+    {
+        return SALERR_INVALIDFORMAT;
+    }
+
+    memset( &dinfo, 0, sizeof( dinfo ) );
+    dinfo.di_size = sizeof( dinfo );
+    SAL_get_device_info( device, &dinfo );
+
+    if ( dinfo.di_sample_rate != kp_format->af_sample_rate )
+    {
+        _SAL_warning( device, "Sample frequency of %d does not match device's frequency of %d\n", kp_format->af_sample_rate, dinfo.di_sample_rate );
+        return SALERR_INVALIDFORMAT;
+    }
+
+    if ( ( p_adpcm = ( _SALx_Adpcm * ) _SAL_pool_alloc( device, S_ADPCM_SIZE( device ) ) ) == 0 )
+    {
+        return SALERR_OUTOFMEMORY;
+    }
+
+    /* _SAL_generic_destroy_sample() frees this */
+    if ( ( err = SAL_alloc_aligned( device, &p_data, needed_size, SAL_ALIGNMENT ) ) != SALERR_OK )
+    {
+        _SAL_pool_free( device, p_adpcm, S_ADPCM_SIZE( device ) );
+        return err;
+    }
+
+    memcpy( p_data, kp_blocks, needed_size );
+
+    p_adpcm->ad_channels         = kp_format->af_channels;
+    p_adpcm->ad_block_align      = kp_format->af_block_align;
+    p_adpcm->ad_frames_per_block = ( sal_u32_t ) frames_per_block;
+    p_adpcm->ad_num_frames       = ( sal_u32_t ) kp_format->af_num_frames;
+
+    for ( i = 0; i < device->device_max_voices; i++ )
+    {
+        p_adpcm->ad_voices[ i ].vs_frame      = SALX_ADPCM_NO_FRAME;
+        p_adpcm->ad_voices[ i ].vs_loop_frame = SALX_ADPCM_NO_FRAME;
+    }
+
+    args.sarg_ptr = p_adpcm;
+
+    if ( ( err = SAL_create_sample( device, pp_sample, 0, s_adpcm_decoder, s_adpcm_destroy, &args ) ) != SALERR_OK )
+    {
+        SAL_free_aligned( device, p_data );
+        _SAL_pool_free( device, p_adpcm, S_ADPCM_SIZE( device ) );
+        return err;
+    }
+
+    (*pp_sample)->sample_data         = ( sal_byte_t * ) p_data;
+    (*pp_sample)->sample_data_aligned = 1;
+    (*pp_sample)->sample_num_samples  = kp_format->af_num_frames * dinfo.di_channels;
+
+    return SALERR_OK;
+}
+
+/** Decodes an IMA ADPCM WAV file and creates a sample from it.
+    @ingroup extras
+    @param [in] device pointer to output device
+    @param [out] pp_sample address of a pointer to a sample to store the new sample
+    @param [in] kp_src source array of bytes
+    @param [in] src_size number of bytes in kp_src
+    @returns SALERR_OK on success, @ref sal_error_e on failure
+    Only the fmt, fact and data chunks are looked at, everything else is
+    skipped.  Without a fact chunk the frame count is worked out from the
+    size of the data.
+*/
+sal_error_e
+SALx_create_sample_from_ima_wave( SAL_Device *device,
+                                  SAL_Sample **pp_sample,
+                                  const void *kp_src,
+                                  int src_size )
+{
+    const sal_byte_t *kp_bytes = ( const sal_byte_t * ) kp_src;
+    const sal_byte_t *kp_data = 0;
+    sal_u32_t data_size = 0;
+    sal_i32_t fact_frames = -1;
+    int frames_per_block;
+    int offset;
+    SALx_AdpcmFormat format;
+
+    if ( device == 0 || pp_sample == 0 || kp_src == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    *pp_sample = 0;
+
+    memset( &format, 0, sizeof( format ) );
+
+    if ( src_size < 12 || memcmp( kp_bytes, "RIFF", 4 ) != 0 || memcmp( kp_bytes + 8, "WAVE", 4 ) != 0 )
+    {
+        return SALERR_INVALIDFORMAT;
+    }
+
+    /* walk the chunks */
+    for ( offset = 12; offset + 8 <= src_size; )
+    {
+        const sal_byte_t *kp_chunk = kp_bytes + offset;
+        sal_u32_t chunk_size = POSH_ReadU32FromLittle( kp_chunk + 4 );
+
+        if ( chunk_size > ( sal_u32_t ) ( src_size - offset - 8 ) )
+        {
+            chunk_size = ( sal_u32_t ) ( src_size - offset - 8 );
+        }
+
+        if ( memcmp( kp_chunk, "fmt ", 4 ) == 0 && chunk_size >= 16 )
+        {
+            if ( POSH_ReadU16FromLittle( kp_chunk + 8 ) != 0x11 || POSH_ReadU16FromLittle( kp_chunk + 22 ) != 4 )
+            {
+                _SAL_warning( device, "Not an IMA ADPCM WAV file\n" );
+                return SALERR_INVALIDFORMAT;
+            }
+
+            format.af_channels    = POSH_ReadU16FromLittle( kp_chunk + 10 );
+            format.af_sample_rate = ( sal_i32_t ) POSH_ReadU32FromLittle( kp_chunk + 12 );
+            format.af_block_align = POSH_ReadU16FromLittle( kp_chunk + 20 );
+        }
+        else if ( memcmp( kp_chunk, "fact", 4 ) == 0 && chunk_size >= 4 )
+        {
+            fact_frames = ( sal_i32_t ) POSH_ReadU32FromLittle( kp_chunk + 8 );
+        }
+        else if ( memcmp( kp_chunk, "data", 4 ) == 0 )
+        {
+            kp_data   = kp_chunk + 8;
+            data_size = chunk_size;
+        }
+
+        /* chunks are padded to an even size */
+        offset += 8 + ( int ) ( ( chunk_size + 1 ) & ~1U );
+    }
+
+    frames_per_block = SALx_get_adpcm_frames_per_block( format.af_channels, format.af_block_align );
+
+    if ( kp_data == 0 || frames_per_block == 0 )
+    {
+        return SALERR_INVALIDFORMAT;
+    }
+
+    /* whole blocks plus whatever whole groups the last one has */
+    format.af_num_frames = ( int ) ( data_size / format.af_block_align ) * frames_per_block;
+
+    if ( ( data_size % format.af_block_align ) > ( sal_u32_t ) ( 4 * format.af_channels ) )
+    {
+        format.af_num_frames += 1 + ( int ) ( ( data_size % format.af_block_align ) / ( 4 * format.af_channels ) - 1 ) * 8;
+    }
+
+    if ( fact_frames >= 0 && fact_frames < format.af_num_frames )
+    {
+        format.af_num_frames = fact_frames;
+    }
+
+    return SALx_create_sample_from_adpcm( device, pp_sample, kp_data, ( int ) data_size, &format );
+}
@@ -0,0 +1,85 @@
+/*
+Copyright (c) 2004, Brian Hook
+All rights reserved.
+
+http://www.bookofhook.com/sal
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+
+    * The names of this package'ss contributors contributors may not
+      be used to endorse or promote products derived from this
+      software without specific prior written permission.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/** @file salx_adpcm.h
+    @brief SAL extra IMA ADPCM support
+*/
+#ifndef SALX_ADPCM_H
+#define SALX_ADPCM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Layout of a run of IMA ADPCM blocks, as passed to SALx_create_sample_from_adpcm
+
+    Blocks use the same layout as IMA ADPCM WAV files (format tag 0x11): a
+    4 byte header per channel holding the first sample and the step index,
+    followed by 4 bytes (8 samples) of each channel in turn.
+*/
+typedef struct SALx_AdpcmFormat_s
+{
+    sal_i32_t   af_channels;      /**< number of channels, 1 or 2 */
+    sal_i32_t   af_sample_rate;   /**< in frames/second */
+    sal_i32_t   af_block_align;   /**< size of a block in bytes, a multiple of 4 * af_channels */
+    sal_i32_t   af_num_frames;    /**< number of frames encoded in the blocks */
+} SALx_AdpcmFormat;
+
+SAL_PUBLIC_API( int )         SALx_get_adpcm_frames_per_block( int channels, 
+                                                               int block_align );
+SAL_PUBLIC_API( sal_error_e ) SALx_get_adpcm_size( int channels, 
+                                                   int block_align, 
+                                                   int num_frames, 
+                                                   int *p_size );
+SAL_PUBLIC_API( sal_error_e ) SALx_encode_adpcm( const sal_i16_t *kp_src,
+                                                 int channels,
+                                                 int block_align,
+                                                 int num_frames,
+                                                 void *p_dst );
+SAL_PUBLIC_API( sal_error_e ) SALx_create_sample_from_adpcm( SAL_Device *device,
+                                                             SAL_Sample **pp_sample,
+                                                             const void *kp_blocks,
+                                                             int blocks_size,
+                                                             const SALx_AdpcmFormat *kp_format );
+SAL_PUBLIC_API( sal_error_e ) SALx_create_sample_from_ima_wave( SAL_Device *device,
+                                                                SAL_Sample **pp_sample,
+                                                                const void *kp_src,
+                                                                int src_size );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SALX_ADPCM_H */
@@ -0,0 +1,618 @@
+/*
+Copyright (c) 2004, Brian Hook
+All rights reserved.
+
+http://www.bookofhook.com/sal
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+
+    * The names of this package'ss contributors contributors may not
+      be used to endorse or promote products derived from this
+      software without specific prior written permission.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/** @file salx_bank.c
+    @brief Sound bank support for the Simple Audio Library
+
+    A bank is opened with a single open and mapping (or a single read on
+    systems without mmap()), and its index is checked once up front.  After
+    that, creating a sample from a PCM sound whose format matches the
+    device is a zero-copy view: the sample's data points into the mapping
+    and no allocation other than the sample itself takes place.  The bank
+    counts its live views and refuses to close while any exist.  ADPCM
+    sounds are handed to SALx_create_sample_from_adpcm, so banks that hold
+    them need salx_adpcm.c as well.
+
+    The bank format is described in salx_bank.h.
+*/
+#ifndef SAL_DOXYGEN
+#  define SAL_BUILDING_LIB 1
+#endif
+#include "../sal.h"
+#include "salx_bank.h"
+#include "salx_wave.h"
+#include "salx_adpcm.h"
+
+#ifdef SALX_SUPPORT_OGG
+#  include "salx_ogg.h"
+#endif
+
+#include <string.h>
+#include <stdio.h>
+
+#if defined POSH_OS_UNIX || defined POSH_OS_OSX
+#  define SALX_BANK_MMAP 1 /**< If defined, banks are memory mapped by SALx_open_bank */
+#  include <sys/types.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+/** @internal
+    @brief An open sound bank */
+struct SALx_Bank_s
+{
+    const sal_byte_t *bk_base;          /**< start of the bank's bytes */
+    size_t            bk_length;        /**< size of the bank, in bytes */
+    const sal_byte_t *bk_index;         /**< start of the index */
+    const char       *bk_names;         /**< start of the name table */
+    sal_u32_t         bk_num_sounds;    /**< number of entries in the index */
+    sal_u32_t         bk_entry_size;    /**< size of an index entry, which depends on the bank's version */
+    sal_i32_t         bk_channels;      /**< channels of the PCM and ADPCM sounds */
+    sal_i32_t         bk_bits;          /**< bits per sample of the PCM sounds */
+    sal_i32_t         bk_sample_rate;   /**< sample rate of the sounds */
+    sal_i32_t         bk_num_views;     /**< samples pointing into the bank, protected by the device lock */
+};
+
+/* reads the i'th 32-bit word of an index entry */
+#define S_ENTRY_WORD( p_bank, index, word ) \
+    POSH_ReadU32FromLittle( ( p_bank )->bk_index + ( index ) * ( p_bank )->bk_entry_size + ( word ) * 4 )
+
+#define S_ENTRY_HASH        0   /**< index entry word holding the name hash */
+#define S_ENTRY_NAME        1   /**< index entry word holding the name offset */
+#define S_ENTRY_ENCODING    2   /**< index entry word holding the encoding */
+#define S_ENTRY_OFFSET      3   /**< index entry word holding the payload offset */
+#define S_ENTRY_SIZE        4   /**< index entry word holding the payload size */
+#define S_ENTRY_FRAMES      5   /**< index entry word holding the number of frames */
+#define S_ENTRY_BLOCK_ALIGN 6   /**< index entry word holding the ADPCM block size, version 2 and up */
+
+/** Hashes a sound name the way banks index them.
+    @ingroup extras
+    @param [in] kp_name NUL terminated sound name
+    @returns 32-bit FNV-1a hash of the name
+*/
+sal_u32_t
+SALx_hash_bank_name( const char *kp_name )
+{
+    sal_u32_t hash = 2166136261U;
+
+    while ( *kp_name )
+    {
+        hash ^= ( sal_byte_t ) *kp_name++;
+        hash *= 16777619U;
+    }
+
+    return hash;
+}
+
+/** @internal
+    @brief Releases a bank's bytes */
+static
+void
+s_bank_release( SAL_Device *device, SALx_Bank *p_bank )
+{
+#ifdef SALX_BANK_MMAP
+    munmap( ( void * ) p_bank->bk_base, p_bank->bk_length );
+#else
+    SAL_free( device, ( void * ) p_bank->bk_base );
+#endif
+    SAL_free( device, p_bank );
+}
+
+/** @internal
+    @brief Checks a bank's header and index against its size
+    @returns SALERR_OK if every offset in the bank is in range, SALERR_INVALIDFORMAT if not
+*/
+static
+sal_error_e
+s_bank_validate( SAL_Device *device, SALx_Bank *p_bank )
+{
+    const sal_byte_t *kp_header = p_bank->bk_base;
+    sal_u32_t index_offset, names_offset, names_size;
+    sal_u32_t length = ( sal_u32_t ) p_bank->bk_length;
+    sal_u32_t version;
+    sal_u32_t i;
+
+    if ( length < SALX_BANK_HEADER_SIZE || memcmp( kp_header, SALX_BANK_MAGIC, 4 ) != 0 )
+    {
+        _SAL_warning( device, "Not a sound bank\n" );
+        return SALERR_INVALIDFORMAT;
+    }
+
+    version = POSH_ReadU32FromLittle( kp_header + 4 );
+
+    if ( version != SALX_BANK_VERSION && version != 1 )
+    {
+        _SAL_warning( device, "Unsupported sound bank version %u\n", version );
+        return SALERR_INVALIDFORMAT;
+    }
+
+    p_bank->bk_entry_size  = ( version == 1 ) ? SALX_BANK_ENTRY_V1_SIZE : SALX_BANK_ENTRY_SIZE;
+
+    p_bank->bk_num_sounds  = POSH_ReadU32FromLittle( kp_header + 8 );
+    p_bank->bk_channels    = ( sal_i32_t ) POSH_ReadU32FromLittle( kp_header + 12 );
+    p_bank->bk_bits        = ( sal_i32_t ) POSH_ReadU32FromLittle( kp_header + 16 );
+    p_bank->bk_sample_rate = ( sal_i32_t ) POSH_ReadU32FromLittle( kp_header + 20 );
+    index_offset           = POSH_ReadU32FromLittle( kp_header + 28 );
+    names_offset           = POSH_ReadU32FromLittle( kp_header + 32 );
+    names_size             = POSH_ReadU32FromLittle( kp_header + 36 );
+
+    if ( ( p_bank->bk_channels != 1 && p_bank->bk_channels != 2 ) ||
+         ( p_bank->bk_bits != 8 && p_bank->bk_bits != 16 ) ||
+         index_offset > length ||
+         p_bank->bk_num_sounds > ( length - index_offset ) / p_bank->bk_entry_size ||
+         names_offset > length || names_size > length - names_offset ||
+         ( names_size > 0 && p_bank->bk_base[ names_offset + names_size - 1 ] != 0 ) )
+    {
+        _SAL_warning( device, "Corrupt sound bank header\n" );
+        return SALERR_INVALIDFORMAT;
+    }
+
+    p_bank->bk_index = p_bank->bk_base + index_offset;
+    p_bank->bk_names = ( const char * ) p_bank->bk_base + names_offset;
+
+    /* since the name table ends in a NUL, any name inside it is terminated */
+    for ( i = 0; i < p_bank->bk_num_sounds; i++ )
+    {
+        sal_u32_t offset = S_ENTRY_WORD( p_bank, i, S_ENTRY_OFFSET );
+        sal_u32_t size   = S_ENTRY_WORD( p_bank, i, S_ENTRY_SIZE );
+
+        if ( S_ENTRY_WORD( p_bank, i, S_ENTRY_NAME ) >= names_size ||
+             offset > length || size > length - offset )
+        {
+            _SAL_warning( device, "Corrupt sound bank entry %u\n", i );
+            return SALERR_INVALIDFORMAT;
+        }
+    }
+
+    return SALERR_OK;
+}
+
+/** Opens a sound bank.
+    @ingroup extras
+    @param [in] device pointer to output device
+    @param [out] pp_bank address of a pointer to store the bank
+    @param [in] kp_filename name of the bank file
+    @returns SALERR_OK on success, @ref sal_error_e on failure
+    On systems with mmap() the whole bank is mapped, otherwise it is read
+    into memory.  Either way the file is opened exactly once, no matter how
+    many sounds it holds.
+*/
+sal_error_e
+SALx_open_bank( SAL_Device *device,
+                SALx_Bank **pp_bank,
+                const char *kp_filename )
+{
+    sal_error_e err;
+    SALx_Bank *p_bank = 0;
+#ifdef SALX_BANK_MMAP
+    int fd;
+    struct stat st;
+    void *p_base;
+#else
+    FILE *fp;
+    long length;
+    void *p_base = 0;
+#endif
+
+    if ( device == 0 || pp_bank == 0 || kp_filename == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    *pp_bank = 0;
+
+#ifdef SALX_BANK_MMAP
+    if ( ( fd = open( kp_filename, O_RDONLY ) ) == -1 )
+    {
+        _SAL_warning( device, "Could not open %s\n", kp_filename );
+        return SALERR_SYSTEMFAILURE;
+    }
+
+    if ( fstat( fd, &st ) == -1 || st.st_size <= 0 || st.st_size > 0x7FFFFFFF )
+    {
+        close( fd );
+        return SALERR_INVALIDPARAM;
+    }
+
+    p_base = mmap( 0, ( size_t ) st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+
+    /* the mapping holds its own reference to the file */
+    close( fd );
+
+    if ( p_base == MAP_FAILED )
+    {
+        _SAL_warning( device, "Could not map %s\n", kp_filename );
+        return SALERR_SYSTEMFAILURE;
+    }
+
+    if ( ( err = SAL_alloc( device, ( void ** ) &p_bank, sizeof( *p_bank ) ) ) != SALERR_OK )
+    {
+        munmap( p_base, ( size_t ) st.st_size );
+        return err;
+    }
+
+    memset( p_bank, 0, sizeof( *p_bank ) );
+    p_bank->bk_base   = ( const sal_byte_t * ) p_base;
+    p_bank->bk_length = ( size_t ) st.st_size;
+#else
+    if ( ( fp = fopen( kp_filename, "rb" ) ) == 0 )
+    {
+        _SAL_warning( device, "Could not open %s\n", kp_filename );
+        return SALERR_SYSTEMFAILURE;
+    }
+
+    fseek( fp, 0, SEEK_END );
+    length = ftell( fp );
+    fseek( fp, 0, SEEK_SET );
+
+    if ( length <= 0 )
+    {
+        fclose( fp );
+        return SALERR_INVALIDPARAM;
+    }
+
+    if ( ( err = SAL_alloc( device, &p_base, length ) ) != SALERR_OK )
+    {
+        fclose( fp );
+        return err;
+    }
+
+    if ( fread( p_base, length, 1, fp ) != 1 )
+    {
+        SAL_free( device, p_base );
+        fclose( fp );
+        return SALERR_SYSTEMFAILURE;
+    }
+
+    fclose( fp );
+
+    if ( ( err = SAL_alloc( device, ( void ** ) &p_bank, sizeof( *p_bank ) ) ) != SALERR_OK )
+    {
+        SAL_free( device, p_base );
+        return err;
+    }
+
+    memset( p_bank, 0, sizeof( *p_bank ) );
+    p_bank->bk_base   = ( const sal_byte_t * ) p_base;
+    p_bank->bk_length = ( size_t ) length;
+#endif /* SALX_BANK_MMAP */
+
+    if ( ( err = s_bank_validate( device, p_bank ) ) != SALERR_OK )
+    {
+        s_bank_release( device, p_bank );
+        return err;
+    }
+
+    *pp_bank = p_bank;
+
+    return SALERR_OK;
+}
+
+/** Closes a sound bank.
+    @ingroup extras
+    @param [in] device pointer to output device
+    @param [in] p_bank bank to close
+    @retval SALERR_OK on success
+    @retval SALERR_INUSE if samples created from the bank still point into it
+    @returns @ref sal_error_e on other failures
+*/
+sal_error_e
+SALx_close_bank( SAL_Device *device,
+                 SALx_Bank *p_bank )
+{
+    if ( device == 0 || p_bank == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    _SAL_lock_device( device );
+
+    if ( p_bank->bk_num_views > 0 )
+    {
+        _SAL_unlock_device( device );
+        return SALERR_INUSE;
+    }
+
+    _SAL_unlock_device( device );
+
+    s_bank_release( device, p_bank );
+
+    return SALERR_OK;
+}
+
+/** Returns information about a sound bank.
+    @ingroup extras
+    @param [in] device pointer to output device
+    @param [in] p_bank bank to query
+    @param [out] p_info receives the information.  bi_size must be set by the caller.
+    @returns SALERR_OK on success, @ref sal_error_e on failure
+*/
+sal_error_e
+SALx_get_bank_info( SAL_Device *device,
+                    SALx_Bank *p_bank,
+                    SALx_BankInfo *p_info )
+{
+    if ( device == 0 || p_bank == 0 || p_info == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    if ( p_info->bi_size != sizeof( SALx_BankInfo ) )
+    {
+        return SALERR_WRONGVERSION;
+    }
+
+    p_info->bi_num_sounds  = ( sal_i32_t ) p_bank->bk_num_sounds;
+    p_info->bi_channels    = p_bank->bk_channels;
+    p_info->bi_bits        = p_bank->bk_bits;
+    p_info->bi_sample_rate = p_bank->bk_sample_rate;
+
+    return SALERR_OK;
+}
+
+/** Returns the name of a sound in a bank.
+    @ingroup extras
+    @param [in] device pointer to output device
+    @param [in] p_bank bank to query
+    @param [in] index index of the sound, from 0 to bi_num_sounds - 1
+    @param [out] pkp_name receives a pointer to the name, valid until the bank is closed
+    @returns SALERR_OK on success, @ref sal_error_e on failure
+*/
+sal_error_e
+SALx_get_bank_sound_name( SAL_Device *device,
+                          SALx_Bank *p_bank,
+                          int index,
+                          const char **pkp_name )
+{
+    if ( device == 0 || p_bank == 0 || pkp_name == 0 || index < 0 || ( sal_u32_t ) index >= p_bank->bk_num_sounds )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    *pkp_name = p_bank->bk_names + S_ENTRY_WORD( p_bank, index, S_ENTRY_NAME );
+
+    return SALERR_OK;
+}
+
+/** Looks up a sound in a bank by name.
+    @ingroup extras
+    @param [in] device pointer to output device
+    @param [in] p_bank bank to search
+    @param [in] kp_name name of the sound
+    @param [out] p_index receives the index of the sound
+    @retval SALERR_OK on success
+    @retval SALERR_INVALIDPARAM if the bank has no sound with that name
+    The index is sorted by hash, so this is a binary search.
+*/
+sal_error_e
+SALx_find_bank_sound( SAL_Device *device,
+                      SALx_Bank *p_bank,
+                      const char *kp_name,
+                      int *p_index )
+{
+    sal_u32_t hash;
+    sal_u32_t lo, hi;
+
+    if ( device == 0 || p_bank == 0 || kp_name == 0 || p_index == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    hash = SALx_hash_bank_name( kp_name );
+    lo   = 0;
+    hi   = p_bank->bk_num_sounds;
+
+    /* find the first entry with this hash */
+    while ( lo < hi )
+    {
+        sal_u32_t mid = lo + ( hi - lo ) / 2;
+
+        if ( S_ENTRY_WORD( p_bank, mid, S_ENTRY_HASH ) < hash )
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    /* then step over any collisions */
+    for ( ; lo < p_bank->bk_num_sounds && S_ENTRY_WORD( p_bank, lo, S_ENTRY_HASH ) == hash; lo++ )
+    {
+        if ( strcmp( p_bank->bk_names + S_ENTRY_WORD( p_bank, lo, S_ENTRY_NAME ), kp_name ) == 0 )
+        {
+            *p_index = ( int ) lo;
+            return SALERR_OK;
+        }
+    }
+
+    return SALERR_INVALIDPARAM;
+}
+
+/** @internal
+    @brief Release callback for samples that point into a bank
+    @param[in] p_device pointer to output device, locked
+    @param[in] p_data the sound's data inside the bank
+    @param[in] p_arg the bank
+*/
+static
+void
+s_bank_view_release( SAL_Device *p_device,
+                     void *p_data,
+                     void *p_arg )
+{
+    SALx_Bank *p_bank = ( SALx_Bank * ) p_arg;
+
+    p_device = p_device;
+    p_data = p_data;
+
+    p_bank->bk_num_views--;
+}
+
+/** Creates a sample from a sound in a bank.
+    @ingroup extras
+    @param [in] device pointer to output device
+    @param [in] p_bank bank holding the sound
+    @param [in] index index of the sound, from SALx_find_bank_sound
+    @param [out] pp_sample address of a pointer to store the new sample
+    @returns SALERR_OK on success, @ref sal_error_e on failure
+    If the sound is PCM in the device's format, the sample's data points
+    straight into the bank and the bank can't be closed until the sample
+    is destroyed.  PCM in another channel count or bit depth is converted
+    into a sample of its own.  ADPCM sounds are copied into a sample that
+    decodes them as it plays, see SALx_create_sample_from_adpcm.  Ogg
+    sounds are decoded with SALx_create_sample_from_ogg when SAL is built
+    with SALX_SUPPORT_OGG.
+*/
+sal_error_e
+SALx_create_sample_from_bank( SAL_Device *device,
+                              SALx_Bank *p_bank,
+                              int index,
+                              SAL_Sample **pp_sample )
+{
+    sal_error_e err;
+    SAL_DeviceInfo dinfo;
+    const sal_byte_t *kp_data;
+    sal_u32_t size;
+    sal_u32_t num_frames;
+    SALx_AdpcmFormat af;
+
+    if ( device == 0 || p_bank == 0 || pp_sample == 0 || index < 0 || ( sal_u32_t ) index >= p_bank->bk_num_sounds )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    *pp_sample = 0;
+
+    kp_data    = p_bank->bk_base + S_ENTRY_WORD( p_bank, index, S_ENTRY_OFFSET );
+    size       = S_ENTRY_WORD( p_bank, index, S_ENTRY_SIZE );
+    num_frames = S_ENTRY_WORD( p_bank, index, S_ENTRY_FRAMES );
+
+    switch ( S_ENTRY_WORD( p_bank, index, S_ENTRY_ENCODING ) )
+    {
+    case SALX_BANK_ENCODING_PCM:
+        break;
+
+    case SALX_BANK_ENCODING_OGG:
+#ifdef SALX_SUPPORT_OGG
+        return SALx_create_sample_from_ogg( device, pp_sample, kp_data, ( int ) size );
+#else
+        _SAL_warning( device, "Ogg sounds in banks need SALX_SUPPORT_OGG\n" );
+        return SALERR_UNIMPLEMENTED;
+#endif
+
+    case SALX_BANK_ENCODING_ADPCM:
+        if ( p_bank->bk_entry_size < SALX_BANK_ENTRY_SIZE || size > 0x7FFFFFFF || num_frames > 0x7FFFFFFF )
+        {
+            return SALERR_INVALIDFORMAT;
+        }
+
+        af.af_channels    = p_bank->bk_channels;
+        af.af_sample_rate = p_bank->bk_sample_rate;
+        af.af_block_align = ( sal_i32_t ) S_ENTRY_WORD( p_bank, index, S_ENTRY_BLOCK_ALIGN );
+        af.af_num_frames  = ( sal_i32_t ) num_frames;
+
+        return SALx_create_sample_from_adpcm( device, pp_sample, kp_data, ( int ) size, &af );
+
+    default:
+        _SAL_warning( device, "Unknown sound bank encoding %u\n", S_ENTRY_WORD( p_bank, index, S_ENTRY_ENCODING ) );
+        return SALERR_INVALIDFORMAT;
+    }
+
+    if ( num_frames > size / ( p_bank->bk_channels * ( p_bank->bk_bits / 8 ) ) )
+    {
+        return SALERR_INVALIDFORMAT;
+    }
+
+    memset( &dinfo, 0, sizeof( dinfo ) );
+    dinfo.di_size = sizeof( dinfo );
+    SAL_get_device_info( device, &dinfo );
+
+    if ( dinfo.di_sample_rate != p_bank->bk_sample_rate )
+    {
+        _SAL_warning( device, "Sample frequency of %d does not match device's frequency of %d\n", p_bank->bk_sample_rate, dinfo.di_sample_rate );
+        return SALERR_INVALIDFORMAT;
+    }
+
+    /* zero-copy is only possible if the data is exactly what the mixer expects:
+       same format, host byte order and naturally aligned samples */
+    if ( p_bank->bk_channels == dinfo.di_channels &&
+         p_bank->bk_bits     == dinfo.di_bits &&
+#ifdef POSH_BIG_ENDIAN
+         dinfo.di_bits == 8 &&
+#endif
+         ( ( kp_data - p_bank->bk_base ) % dinfo.di_bytes_per_sample ) == 0 )
+    {
+        if ( ( err = SAL_create_sample_from_buffer( device, pp_sample, ( void * ) kp_data, num_frames * dinfo.di_channels, s_bank_view_release, p_bank ) ) != SALERR_OK )
+        {
+            return err;
+        }
+
+        _SAL_lock_device( device );
+        p_bank->bk_num_views++;
+        _SAL_unlock_device( device );
+
+#ifdef SALX_BANK_MMAP
+        /* get the start of the sound in flight before the first play */
+        {
+            long page_size  = sysconf( _SC_PAGESIZE );
+            size_t start    = ( size_t ) ( kp_data - p_bank->bk_base );
+
+            start -= start % page_size;
+            madvise( ( sal_byte_t * ) p_bank->bk_base + start, ( size_t ) ( kp_data - p_bank->bk_base ) - start + size, MADV_WILLNEED );
+        }
+#endif
+
+        return SALERR_OK;
+    }
+
+    if ( ( err = SAL_create_sample( device, pp_sample, num_frames * dinfo.di_channels, _SAL_generic_decode_sample, _SAL_generic_destroy_sample, NULL ) ) != SALERR_OK )
+    {
+        return err;
+    }
+
+    if ( ( err = SALx_convert_pcm( kp_data, p_bank->bk_channels, p_bank->bk_bits,
+                                   (*pp_sample)->sample_data, dinfo.di_channels, dinfo.di_bits,
+                                   ( int ) num_frames ) ) != SALERR_OK )
+    {
+        SAL_destroy_sample( device, *pp_sample );
+        *pp_sample = 0;
+    }
+
+    return err;
+}
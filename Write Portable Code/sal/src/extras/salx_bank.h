@@ -0,0 +1,143 @@
+/*
+Copyright (c) 2004, Brian Hook
+All rights reserved.
+
+http://www.bookofhook.com/sal
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+
+    * The names of this package'ss contributors contributors may not
+      be used to endorse or promote products derived from this
+      software without specific prior written permission.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/** @file salx_bank.h
+    @brief SAL extra sound bank support
+
+    A sound bank packs many sounds into a single file so they can all be
+    loaded with one open and one mapping.  Sounds are stored in the format
+    the bank was built for and samples created from a bank point straight
+    into it.  Banks are built offline with the salbank tool.
+
+    All values are little-endian 32-bit words.  The file starts with a
+    header:
+
+    @verbatim
+    offset  field
+     0      magic, "SALB"
+     4      version, SALX_BANK_VERSION
+     8      number of sounds
+    12      channels
+    16      bits per sample
+    20      sample rate
+    24      payload alignment, in bytes
+    28      offset of the index
+    32      offset of the name table
+    36      size of the name table, in bytes
+    @endverbatim
+
+    The index holds one entry per sound, sorted by name hash
+    (SALx_hash_bank_name) and then by name:
+
+    @verbatim
+    offset  field
+     0      hash of the name
+     4      offset of the NUL terminated name, relative to the name table
+     8      encoding, @ref salx_bank_encoding_e
+    12      offset of the payload from the start of the file
+    16      size of the payload, in bytes
+    20      number of frames, 0 for Ogg payloads
+    24      size of an ADPCM block in bytes, 0 for other payloads
+    @endverbatim
+
+    Version 1 banks have no block size and 24 byte index entries, and are
+    still read.
+
+    Payloads start on a multiple of the payload alignment, so each sound
+    begins on its own page.  PCM payloads are in the bank's channels and
+    bits, 8-bit unsigned or 16-bit signed.  ADPCM payloads are IMA ADPCM
+    blocks in the bank's channels, laid out as described for
+    SALx_AdpcmFormat.
+*/
+#ifndef SALX_BANK_H
+#define SALX_BANK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SALX_BANK_MAGIC        "SALB"   /**< first four bytes of every sound bank */
+#define SALX_BANK_VERSION      2        /**< version of the bank format described in salx_bank.h */
+#define SALX_BANK_HEADER_SIZE  40       /**< size of a bank header, in bytes */
+#define SALX_BANK_ENTRY_SIZE   28       /**< size of an index entry, in bytes */
+#define SALX_BANK_ENTRY_V1_SIZE 24      /**< size of an index entry in a version 1 bank, in bytes */
+
+/** @brief How a sound's payload is stored in a bank */
+typedef enum
+{
+    SALX_BANK_ENCODING_PCM   = 0, /**< raw PCM in the bank's format */
+    SALX_BANK_ENCODING_OGG   = 1, /**< a complete Ogg Vorbis file */
+    SALX_BANK_ENCODING_ADPCM = 2  /**< IMA ADPCM blocks in the bank's channels */
+} salx_bank_encoding_e;
+
+typedef struct SALx_Bank_s SALx_Bank; /**< opaque handle to an open sound bank */
+
+/** @brief Information about a sound bank, as returned by SALx_get_bank_info */
+typedef struct SALx_BankInfo_s
+{
+    sal_i32_t   bi_size;          /**< size of the info structure */
+    sal_i32_t   bi_num_sounds;    /**< number of sounds in the bank */
+    sal_i32_t   bi_channels;      /**< number of channels PCM and ADPCM sounds are stored with */
+    sal_i32_t   bi_bits;          /**< bits per sample PCM sounds are stored with */
+    sal_i32_t   bi_sample_rate;   /**< sample rate of the bank's sounds, in frames/second */
+} SALx_BankInfo;
+
+SAL_PUBLIC_API( sal_u32_t )   SALx_hash_bank_name( const char *kp_name );
+SAL_PUBLIC_API( sal_error_e ) SALx_open_bank( SAL_Device *device,
+                                              SALx_Bank **pp_bank,
+                                              const char *kp_filename );
+SAL_PUBLIC_API( sal_error_e ) SALx_close_bank( SAL_Device *device,
+                                               SALx_Bank *p_bank );
+SAL_PUBLIC_API( sal_error_e ) SALx_get_bank_info( SAL_Device *device,
+                                                  SALx_Bank *p_bank,
+                                                  SALx_BankInfo *p_info );
+SAL_PUBLIC_API( sal_error_e ) SALx_get_bank_sound_name( SAL_Device *device,
+                                                        SALx_Bank *p_bank,
+                                                        int index,
+                                                        const char **pkp_name );
+SAL_PUBLIC_API( sal_error_e ) SALx_find_bank_sound( SAL_Device *device,
+                                                    SALx_Bank *p_bank,
+                                                    const char *kp_name,
+                                                    int *p_index );
+SAL_PUBLIC_API( sal_error_e ) SALx_create_sample_from_bank( SAL_Device *device,
+                                                            SALx_Bank *p_bank,
+                                                            int index,
+                                                            SAL_Sample **pp_sample );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SALX_BANK_H */
@@ -0,0 +1,653 @@
+/*
+Copyright (c) 2004, Brian Hook
+All rights reserved.
+
+http://www.bookofhook.com/sal
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+
+    * The names of this package'ss contributors contributors may not
+      be used to endorse or promote products derived from this
+      software without specific prior written permission.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/** @file salx_cache.c
+    @brief Sample cache for the Simple Audio Library
+
+    The cache maps asset keys (usually file names) to samples and keeps the
+    total size of their data under a byte budget.  Every cached sample holds
+    one reference owned by the cache; SALx_cache_get_sample hands out an
+    extra reference that the application drops with SAL_destroy_sample as
+    usual.  When the cache is over budget it evicts samples in least
+    recently used order, but only those nobody else holds a reference to
+    (ref count of 1), so a sample that's playing or still held by the
+    application is never pulled out from under it.
+
+    Resident bytes are taken from each sample's data as it is now, so lazy
+    samples (see salx_lazy.c) only count while their data is loaded.
+*/
+#ifndef SAL_DOXYGEN
+#  define SAL_BUILDING_LIB 1
+#endif
+#include "../sal.h"
+#include "salx_cache.h"
+#include "salx_wave.h"
+
+#include <string.h>
+
+#define SALX_CACHE_DEFAULT_BUDGET   ( 64 * 1024 * 1024 )   /**< default budget, in bytes */
+#define SALX_CACHE_DEFAULT_BUCKETS  256                    /**< default number of hash buckets */
+
+/** @internal
+    @brief A cached sample */
+typedef struct _SALx_CacheEntry_s
+{
+    struct _SALx_CacheEntry_s *ce_next_hash;   /**< next entry in the same bucket */
+    struct _SALx_CacheEntry_s *ce_lru_prev;    /**< more recently used neighbour */
+    struct _SALx_CacheEntry_s *ce_lru_next;    /**< less recently used neighbour */
+    sal_u32_t                  ce_hash;        /**< hash of ce_key */
+    SAL_Sample                *ce_sample;      /**< the sample, holding a reference owned by the cache */
+    char                       ce_key[ 1 ];    /**< asset key, allocated along with the entry */
+} _SALx_CacheEntry;
+
+/** @internal
+    @brief The sample cache */
+struct SALx_SampleCache_s
+{
+    SAL_Device        *sc_device;         /**< device samples are created on */
+    sal_mutex_t        sc_mutex;          /**< protects everything below */
+    _SALx_CacheEntry **sc_buckets;        /**< hash table */
+    sal_u32_t          sc_bucket_mask;    /**< number of buckets - 1 */
+    _SALx_CacheEntry  *sc_lru_head;       /**< most recently used entry */
+    _SALx_CacheEntry  *sc_lru_tail;       /**< least recently used entry */
+    salx_load_fnc_t    sc_load_fnc;       /**< loads assets on a miss */
+    void              *sc_load_arg;       /**< argument passed to sc_load_fnc */
+    sal_u32_t          sc_budget_bytes;   /**< how much sample data we try to stay under */
+    sal_u32_t          sc_hits;           /**< see SALx_SampleCacheStats */
+    sal_u32_t          sc_misses;         /**< see SALx_SampleCacheStats */
+    sal_u32_t          sc_evictions;      /**< see SALx_SampleCacheStats */
+    sal_u32_t          sc_num_entries;    /**< see SALx_SampleCacheStats */
+};
+
+/** @internal
+    @brief Default load function, which treats the key as the name of a WAV file */
+static
+sal_error_e
+s_cache_load_wave_file( SAL_Device *device, SAL_Sample **pp_sample, const char *kp_key, void *load_arg )
+{
+    load_arg = load_arg;
+
+    return SALx_create_sample_from_wave_file( device, pp_sample, kp_key );
+}
+
+/** @internal
+    @brief 32-bit FNV-1a hash of a key */
+static
+sal_u32_t
+s_cache_hash( const char *kp_key )
+{
+    sal_u32_t hash = 2166136261U;
+
+    while ( *kp_key )
+    {
+        hash ^= ( sal_byte_t ) *kp_key++;
+        hash *= 16777619U;
+    }
+
+    return hash;
+}
+
+/** @internal
+    @brief Number of bytes of sample data a sample holds right now */
+static
+sal_u32_t
+s_cache_sample_bytes( SAL_Device *device, const SAL_Sample *p_sample )
+{
+    if ( p_sample->sample_data == 0 )
+    {
+        return 0;
+    }
+
+    return ( sal_u32_t ) p_sample->sample_num_samples * device->device_info.di_bytes_per_sample;
+}
+
+/** @internal
+    @brief Unlinks an entry from the LRU list
+    @remarks Assumes the cache is locked.
+*/
+static
+void
+s_lru_unlink( SALx_SampleCache *p_cache, _SALx_CacheEntry *p_entry )
+{
+    if ( p_entry->ce_lru_prev )
+    {
+        p_entry->ce_lru_prev->ce_lru_next = p_entry->ce_lru_next;
+    }
+    else
+    {
+        p_cache->sc_lru_head = p_entry->ce_lru_next;
+    }
+
+    if ( p_entry->ce_lru_next )
+    {
+        p_entry->ce_lru_next->ce_lru_prev = p_entry->ce_lru_prev;
+    }
+    else
+    {
+        p_cache->sc_lru_tail = p_entry->ce_lru_prev;
+    }
+
+    p_entry->ce_lru_prev = p_entry->ce_lru_next = 0;
+}
+
+/** @internal
+    @brief Puts an entry at the most recently used end of the LRU list
+    @remarks Assumes the cache is locked and the entry isn't linked.
+*/
+static
+void
+s_lru_push_front( SALx_SampleCache *p_cache, _SALx_CacheEntry *p_entry )
+{
+    p_entry->ce_lru_prev = 0;
+    p_entry->ce_lru_next = p_cache->sc_lru_head;
+
+    if ( p_cache->sc_lru_head )
+    {
+        p_cache->sc_lru_head->ce_lru_prev = p_entry;
+    }
+    else
+    {
+        p_cache->sc_lru_tail = p_entry;
+    }
+
+    p_cache->sc_lru_head = p_entry;
+}
+
+/** @internal
+    @brief Looks up a key
+    @returns the entry, or NULL if the key isn't cached
+    @remarks Assumes the cache is locked.
+*/
+static
+_SALx_CacheEntry *
+s_cache_find( SALx_SampleCache *p_cache, const char *kp_key, sal_u32_t hash )
+{
+    _SALx_CacheEntry *p_entry = p_cache->sc_buckets[ hash & p_cache->sc_bucket_mask ];
+
+    while ( p_entry )
+    {
+        if ( p_entry->ce_hash == hash && strcmp( p_entry->ce_key, kp_key ) == 0 )
+        {
+            return p_entry;
+        }
+        p_entry = p_entry->ce_next_hash;
+    }
+
+    return 0;
+}
+
+/** @internal
+    @brief Removes an entry from the cache and drops the cache's reference to its sample
+    @remarks Assumes the cache and the device are locked.
+*/
+static
+void
+s_cache_remove( SALx_SampleCache *p_cache, _SALx_CacheEntry *p_entry )
+{
+    _SALx_CacheEntry **pp_link = &p_cache->sc_buckets[ p_entry->ce_hash & p_cache->sc_bucket_mask ];
+
+    while ( *pp_link != p_entry )
+    {
+        pp_link = &( *pp_link )->ce_next_hash;
+    }
+
+    *pp_link = p_entry->ce_next_hash;
+
+    s_lru_unlink( p_cache, p_entry );
+    p_cache->sc_num_entries--;
+
+    _SAL_destroy_sample_locked( p_cache->sc_device, p_entry->ce_sample );
+    SAL_free( p_cache->sc_device, p_entry );
+}
+
+/** @internal
+    @brief Evicts unreferenced samples, least recently used first, until the cache is within budget
+    @remarks Assumes the cache is locked.
+*/
+static
+void
+s_cache_trim( SALx_SampleCache *p_cache )
+{
+    SAL_Device *device = p_cache->sc_device;
+    _SALx_CacheEntry *p_entry;
+    sal_u32_t resident = 0;
+
+    _SAL_lock_device( device );
+
+    for ( p_entry = p_cache->sc_lru_head; p_entry; p_entry = p_entry->ce_lru_next )
+    {
+        resident += s_cache_sample_bytes( device, p_entry->ce_sample );
+    }
+
+    p_entry = p_cache->sc_lru_tail;
+
+    while ( p_entry && resident > p_cache->sc_budget_bytes )
+    {
+        _SALx_CacheEntry *p_prev = p_entry->ce_lru_prev;
+
+        /* the cache's reference is the only one, so nobody will notice it going */
+        if ( p_entry->ce_sample->sample_ref_count == 1 )
+        {
+            resident -= s_cache_sample_bytes( device, p_entry->ce_sample );
+            s_cache_remove( p_cache, p_entry );
+            p_cache->sc_evictions++;
+        }
+
+        p_entry = p_prev;
+    }
+
+    _SAL_unlock_device( device );
+}
+
+/** @internal
+    @brief Adds a sample to the cache, taking over the caller's reference
+    @remarks Assumes the cache is locked and the key isn't cached yet.
+*/
+static
+sal_error_e
+s_cache_add( SALx_SampleCache *p_cache, const char *kp_key, sal_u32_t hash, SAL_Sample *p_sample )
+{
+    sal_error_e err;
+    size_t length = strlen( kp_key );
+    _SALx_CacheEntry *p_entry = 0;
+
+    if ( ( err = SAL_alloc( p_cache->sc_device, ( void ** ) &p_entry, sizeof( *p_entry ) + length ) ) != SALERR_OK )
+    {
+        return err;
+    }
+
+    memset( p_entry, 0, sizeof( *p_entry ) );
+    memcpy( p_entry->ce_key, kp_key, length + 1 );
+    p_entry->ce_hash   = hash;
+    p_entry->ce_sample = p_sample;
+
+    p_entry->ce_next_hash = p_cache->sc_buckets[ hash & p_cache->sc_bucket_mask ];
+    p_cache->sc_buckets[ hash & p_cache->sc_bucket_mask ] = p_entry;
+
+    s_lru_push_front( p_cache, p_entry );
+    p_cache->sc_num_entries++;
+
+    return SALERR_OK;
+}
+
+/** Creates a sample cache.
+    @ingroup extras
+    @param [in] device pointer to output device
+    @param [out] pp_cache address of a pointer to store the new cache
+    @param [in] kp_params pointer to cache parameters, may be NULL to use the defaults
+    @returns SALERR_OK on success, @ref sal_error_e on failure
+*/
+sal_error_e
+SALx_create_sample_cache( SAL_Device *device,
+                          SALx_SampleCache **pp_cache,
+                          const SALx_SampleCacheParams *kp_params )
+{
+    sal_error_e err;
+    sal_u32_t num_buckets = 1;
+    SALx_SampleCache *p_cache = 0;
+    SALx_SampleCacheParams params;
+
+    if ( device == 0 || pp_cache == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    memset( &params, 0, sizeof( params ) );
+
+    if ( kp_params )
+    {
+        if ( kp_params->cp_size != sizeof( SALx_SampleCacheParams ) )
+        {
+            return SALERR_WRONGVERSION;
+        }
+        params = *kp_params;
+    }
+
+    params.cp_budget_bytes = ( params.cp_budget_bytes == 0 ) ? SALX_CACHE_DEFAULT_BUDGET : params.cp_budget_bytes;
+    params.cp_num_buckets  = ( params.cp_num_buckets <= 0 ) ? SALX_CACHE_DEFAULT_BUCKETS : params.cp_num_buckets;
+
+    while ( num_buckets < ( sal_u32_t ) params.cp_num_buckets )
+    {
+        num_buckets <<= 1;
+    }
+
+    if ( ( err = SAL_alloc( device, ( void ** ) &p_cache, sizeof( *p_cache ) ) ) != SALERR_OK )
+    {
+        return err;
+    }
+
+    memset( p_cache, 0, sizeof( *p_cache ) );
+
+    p_cache->sc_device       = device;
+    p_cache->sc_bucket_mask  = num_buckets - 1;
+    p_cache->sc_budget_bytes = params.cp_budget_bytes;
+    p_cache->sc_load_fnc     = params.cp_load_fnc ? params.cp_load_fnc : s_cache_load_wave_file;
+    p_cache->sc_load_arg     = params.cp_load_arg;
+
+    if ( ( err = SAL_alloc( device, ( void ** ) &p_cache->sc_buckets, sizeof( _SALx_CacheEntry * ) * num_buckets ) ) != SALERR_OK )
+    {
+        SAL_free( device, p_cache );
+        return err;
+    }
+
+    memset( p_cache->sc_buckets, 0, sizeof( _SALx_CacheEntry * ) * num_buckets );
+
+    if ( ( err = _SAL_create_mutex( device, &p_cache->sc_mutex ) ) != SALERR_OK )
+    {
+        SAL_free( device, p_cache->sc_buckets );
+        SAL_free( device, p_cache );
+        return err;
+    }
+
+    *pp_cache = p_cache;
+
+    return SALERR_OK;
+}
+
+/** Destroys a sample cache.
+    @ingroup extras
+    @param [in] device pointer to output device
+    @param [in] p_cache cache to destroy
+    @returns SALERR_OK on success, @ref sal_error_e on failure
+    The cache's references to its samples are dropped.  Samples the
+    application still holds stay valid until it destroys them.
+*/
+sal_error_e
+SALx_destroy_sample_cache( SAL_Device *device,
+                           SALx_SampleCache *p_cache )
+{
+    if ( device == 0 || p_cache == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    _SAL_lock_mutex( device, p_cache->sc_mutex );
+    _SAL_lock_device( device );
+
+    while ( p_cache->sc_lru_head )
+    {
+        s_cache_remove( p_cache, p_cache->sc_lru_head );
+    }
+
+    _SAL_unlock_device( device );
+
+    _SAL_unlock_mutex( device, p_cache->sc_mutex );
+
+    _SAL_destroy_mutex( device, p_cache->sc_mutex );
+    SAL_free( device, p_cache->sc_buckets );
+    SAL_free( device, p_cache );
+
+    return SALERR_OK;
+}
+
+/** Gets a sample from the cache, loading it if it isn't there.
+    @ingroup extras
+    @param [in] device pointer to output device
+    @param [in] p_cache cache to look in
+    @param [in] kp_key asset key
+    @param [out] pp_sample receives the sample
+    @returns SALERR_OK on success, @ref sal_error_e on failure
+    The caller gets its own reference to the sample and must release it
+    with SAL_destroy_sample.  On a miss the asset is loaded with the cache's
+    load function on the calling thread; for background loading, load with
+    a SALx_Loader and add the result with SALx_cache_insert_sample, or
+    insert lazy samples.  The cache isn't locked while the load function
+    runs, so other threads can keep using it.  If two threads miss on the
+    same key at once both load it, and the sample cached first is the one
+    both get.
+*/
+sal_error_e
+SALx_cache_get_sample( SAL_Device *device,
+                       SALx_SampleCache *p_cache,
+                       const char *kp_key,
+                       SAL_Sample **pp_sample )
+{
+    sal_error_e err;
+    sal_u32_t hash;
+    SAL_Sample *p_sample = 0;
+    SAL_Sample *p_duplicate = 0;
+    _SALx_CacheEntry *p_entry;
+
+    if ( device == 0 || p_cache == 0 || kp_key == 0 || pp_sample == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    *pp_sample = 0;
+    hash = s_cache_hash( kp_key );
+
+    _SAL_lock_mutex( device, p_cache->sc_mutex );
+
+    if ( ( p_entry = s_cache_find( p_cache, kp_key, hash ) ) != 0 )
+    {
+        p_cache->sc_hits++;
+
+        s_lru_unlink( p_cache, p_entry );
+        s_lru_push_front( p_cache, p_entry );
+    }
+    else
+    {
+        p_cache->sc_misses++;
+
+        /* loading can take a long time, so don't hold up everyone else meanwhile */
+        _SAL_unlock_mutex( device, p_cache->sc_mutex );
+
+        if ( ( err = p_cache->sc_load_fnc( device, &p_sample, kp_key, p_cache->sc_load_arg ) ) != SALERR_OK )
+        {
+            return err;
+        }
+
+        _SAL_lock_mutex( device, p_cache->sc_mutex );
+
+        /* someone else may have cached the key while we were loading, in which case theirs wins */
+        if ( ( p_entry = s_cache_find( p_cache, kp_key, hash ) ) != 0 )
+        {
+            s_lru_unlink( p_cache, p_entry );
+            s_lru_push_front( p_cache, p_entry );
+
+            p_duplicate = p_sample;
+        }
+        else if ( ( err = s_cache_add( p_cache, kp_key, hash, p_sample ) ) != SALERR_OK )
+        {
+            _SAL_unlock_mutex( device, p_cache->sc_mutex );
+            SAL_destroy_sample( device, p_sample );
+            return err;
+        }
+        else
+        {
+            p_entry = p_cache->sc_lru_head;
+        }
+    }
+
+    /* the caller's reference */
+    _SAL_lock_device( device );
+    p_entry->ce_sample->sample_ref_count++;
+    _SAL_unlock_device( device );
+
+    *pp_sample = p_entry->ce_sample;
+
+    /* the new sample is referenced by the caller, so it can't be evicted by this */
+    s_cache_trim( p_cache );
+
+    _SAL_unlock_mutex( device, p_cache->sc_mutex );
+
+    if ( p_duplicate )
+    {
+        SAL_destroy_sample( device, p_duplicate );
+    }
+
+    return SALERR_OK;
+}
+
+/** Adds a sample to the cache.
+    @ingroup extras
+    @param [in] device pointer to output device
+    @param [in] p_cache cache to add to
+    @param [in] kp_key asset key
+    @param [in] p_sample sample to add.  The cache takes over the caller's reference.
+    @retval SALERR_OK on success
+    @retval SALERR_INUSE if the key is already cached, in which case the caller keeps its reference
+    @returns @ref sal_error_e on other failures
+*/
+sal_error_e
+SALx_cache_insert_sample( SAL_Device *device,
+                          SALx_SampleCache *p_cache,
+                          const char *kp_key,
+                          SAL_Sample *p_sample )
+{
+    sal_error_e err;
+    sal_u32_t hash;
+
+    if ( device == 0 || p_cache == 0 || kp_key == 0 || p_sample == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    hash = s_cache_hash( kp_key );
+
+    _SAL_lock_mutex( device, p_cache->sc_mutex );
+
+    if ( s_cache_find( p_cache, kp_key, hash ) )
+    {
+        _SAL_unlock_mutex( device, p_cache->sc_mutex );
+        return SALERR_INUSE;
+    }
+
+    if ( ( err = s_cache_add( p_cache, kp_key, hash, p_sample ) ) == SALERR_OK )
+    {
+        s_cache_trim( p_cache );
+    }
+
+    _SAL_unlock_mutex( device, p_cache->sc_mutex );
+
+    return err;
+}
+
+/** Evicts unreferenced samples until the cache is within its budget.
+    @ingroup extras
+    @param [in] device pointer to output device
+    @param [in] p_cache cache to trim
+    @returns SALERR_OK on success, @ref sal_error_e on failure
+    The cache trims itself whenever something is added, but samples the
+    application was holding at that point couldn't be evicted, so it's
+    worth calling this once they've been released.
+*/
+sal_error_e
+SALx_cache_trim( SAL_Device *device,
+                 SALx_SampleCache *p_cache )
+{
+    if ( device == 0 || p_cache == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    _SAL_lock_mutex( device, p_cache->sc_mutex );
+    s_cache_trim( p_cache );
+    _SAL_unlock_mutex( device, p_cache->sc_mutex );
+
+    return SALERR_OK;
+}
+
+/** Changes the cache's budget, evicting samples if it's now over it.
+    @ingroup extras
+    @param [in] device pointer to output device
+    @param [in] p_cache cache to change
+    @param [in] budget_bytes new budget, in bytes
+    @returns SALERR_OK on success, @ref sal_error_e on failure
+*/
+sal_error_e
+SALx_cache_set_budget( SAL_Device *device,
+                       SALx_SampleCache *p_cache,
+                       sal_u32_t budget_bytes )
+{
+    if ( device == 0 || p_cache == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    _SAL_lock_mutex( device, p_cache->sc_mutex );
+    p_cache->sc_budget_bytes = budget_bytes;
+    s_cache_trim( p_cache );
+    _SAL_unlock_mutex( device, p_cache->sc_mutex );
+
+    return SALERR_OK;
+}
+
+/** Returns statistics about a sample cache.
+    @ingroup extras
+    @param [in] device pointer to output device
+    @param [in] p_cache cache to query
+    @param [out] p_stats receives the statistics.  cs_size must be set by the caller.
+    @returns SALERR_OK on success, @ref sal_error_e on failure
+*/
+sal_error_e
+SALx_get_sample_cache_stats( SAL_Device *device,
+                             SALx_SampleCache *p_cache,
+                             SALx_SampleCacheStats *p_stats )
+{
+    _SALx_CacheEntry *p_entry;
+
+    if ( device == 0 || p_cache == 0 || p_stats == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    if ( p_stats->cs_size != sizeof( SALx_SampleCacheStats ) )
+    {
+        return SALERR_WRONGVERSION;
+    }
+
+    _SAL_lock_mutex( device, p_cache->sc_mutex );
+
+    p_stats->cs_hits           = p_cache->sc_hits;
+    p_stats->cs_misses         = p_cache->sc_misses;
+    p_stats->cs_evictions      = p_cache->sc_evictions;
+    p_stats->cs_num_entries    = p_cache->sc_num_entries;
+    p_stats->cs_budget_bytes   = p_cache->sc_budget_bytes;
+    p_stats->cs_resident_bytes = 0;
+
+    _SAL_lock_device( device );
+
+    for ( p_entry = p_cache->sc_lru_head; p_entry; p_entry = p_entry->ce_lru_next )
+    {
+        p_stats->cs_resident_bytes += s_cache_sample_bytes( device, p_entry->ce_sample );
+    }
+
+    _SAL_unlock_device( device );
+
+    _SAL_unlock_mutex( device, p_cache->sc_mutex );
+
+    return SALERR_OK;
+}
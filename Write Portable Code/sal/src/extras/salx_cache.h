@@ -0,0 +1,100 @@
+/*
+Copyright (c) 2004, Brian Hook
+All rights reserved.
+
+http://www.bookofhook.com/sal
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+
+    * The names of this package'ss contributors contributors may not
+      be used to endorse or promote products derived from this
+      software without specific prior written permission.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/** @file salx_cache.h
+    @brief SAL extra sample cache
+*/
+#ifndef SALX_CACHE_H
+#define SALX_CACHE_H
+
+#include "salx_loader.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct SALx_SampleCache_s SALx_SampleCache; /**< opaque handle to a sample cache */
+
+/** @brief Parameters passed to SALx_create_sample_cache.  Zeroed fields select the defaults.
+*/
+typedef struct SALx_SampleCacheParams
+{
+    sal_i32_t       cp_size;          /**< size of the parameters structure */
+    sal_u32_t       cp_budget_bytes;  /**< sample data the cache tries to stay under, in bytes */
+    sal_i32_t       cp_num_buckets;   /**< number of hash buckets, rounded up to a power of two */
+    salx_load_fnc_t cp_load_fnc;      /**< loads an asset on a miss, defaults to loading the key as a WAV file */
+    void           *cp_load_arg;      /**< argument passed through to cp_load_fnc */
+} SALx_SampleCacheParams;
+
+/** @brief Sample cache statistics, as returned by SALx_get_sample_cache_stats
+*/
+typedef struct SALx_SampleCacheStats
+{
+    sal_i32_t   cs_size;             /**< size of the statistics structure */
+    sal_u32_t   cs_hits;             /**< lookups that found the asset in the cache */
+    sal_u32_t   cs_misses;           /**< lookups that had to load the asset */
+    sal_u32_t   cs_evictions;        /**< assets dropped to stay within the budget */
+    sal_u32_t   cs_num_entries;      /**< assets currently in the cache */
+    sal_u32_t   cs_resident_bytes;   /**< sample data currently held by cached assets, in bytes */
+    sal_u32_t   cs_budget_bytes;     /**< current budget, in bytes */
+} SALx_SampleCacheStats;
+
+SAL_PUBLIC_API( sal_error_e ) SALx_create_sample_cache( SAL_Device *device,
+                                                        SALx_SampleCache **pp_cache,
+                                                        const SALx_SampleCacheParams *kp_params );
+SAL_PUBLIC_API( sal_error_e ) SALx_destroy_sample_cache( SAL_Device *device,
+                                                         SALx_SampleCache *p_cache );
+SAL_PUBLIC_API( sal_error_e ) SALx_cache_get_sample( SAL_Device *device,
+                                                     SALx_SampleCache *p_cache,
+                                                     const char *kp_key,
+                                                     SAL_Sample **pp_sample );
+SAL_PUBLIC_API( sal_error_e ) SALx_cache_insert_sample( SAL_Device *device,
+                                                        SALx_SampleCache *p_cache,
+                                                        const char *kp_key,
+                                                        SAL_Sample *p_sample );
+SAL_PUBLIC_API( sal_error_e ) SALx_cache_trim( SAL_Device *device,
+                                               SALx_SampleCache *p_cache );
+SAL_PUBLIC_API( sal_error_e ) SALx_cache_set_budget( SAL_Device *device,
+                                                     SALx_SampleCache *p_cache,
+                                                     sal_u32_t budget_bytes );
+SAL_PUBLIC_API( sal_error_e ) SALx_get_sample_cache_stats( SAL_Device *device,
+                                                           SALx_SampleCache *p_cache,
+                                                           SALx_SampleCacheStats *p_stats );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SALX_CACHE_H */
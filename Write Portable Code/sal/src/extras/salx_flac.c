@@ -0,0 +1,1214 @@
+/*
+Copyright (c) 2004, Brian Hook
+All rights reserved.
+
+http://www.bookofhook.com/sal
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+
+    * The names of this package'ss contributors contributors may not
+      be used to endorse or promote products derived from this
+      software without specific prior written permission.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/** @file salx_flac.c
+    @brief SAL extra FLAC support
+
+    A self-contained FLAC decoder.  Like the Ogg extra, a FLAC sample keeps
+    its compressed data in memory and decodes it as it plays.  When the
+    sample is created every frame is located (checking each one's CRCs) and
+    the results go into a seek table, so the mixer can go straight to the
+    frame holding any position.  For fixed block size streams, which is
+    what encoders produce, finding a frame is a single division.
+
+    Each voice decodes whole frames into a buffer of its own and plays out
+    of it, so a voice playing straight through decodes every frame once and
+    jumping to a loop point costs decoding one frame.
+*/
+#ifndef SAL_DOXYGEN
+#  define SAL_BUILDING_LIB 1
+#endif
+#include "../sal.h"
+#include "salx_flac.h"
+
+#include <string.h>
+
+#define SALX_FLAC_MAX_CHANNELS  2            /**< most channels a FLAC sample can have */
+#define SALX_FLAC_NO_FRAME      0xFFFFFFFFU  /**< marks a voice buffer that holds no frame */
+
+#if defined __GNUC__
+#  define S_CLZ64( x ) __builtin_clzll( x )
+#else
+static
+int
+s_clz64( sal_u64_t x )
+{
+    int n = 0;
+
+    while ( !( x & ( ( sal_u64_t ) 1 << 63 ) ) )
+    {
+        x <<= 1;
+        n++;
+    }
+
+    return n;
+}
+#  define S_CLZ64( x ) s_clz64( x )
+#endif
+
+/** @internal
+    @brief Where a frame starts in the stream */
+typedef struct
+{
+    sal_u32_t   fs_offset;   /**< byte offset of the frame in the stream */
+    sal_u32_t   fs_first;    /**< first sample frame held by the frame */
+} _SALx_FlacSeekPoint;
+
+/** @internal
+    @brief A voice's decoded frame */
+typedef struct
+{
+    sal_u32_t   fv_frame;    /**< FLAC frame held in fv_pcm, or SALX_FLAC_NO_FRAME */
+    sal_i16_t  *fv_pcm;      /**< the frame's samples, interleaved 16-bit */
+} _SALx_FlacVoice;
+
+/** @internal
+    @brief A decoded frame header */
+typedef struct
+{
+    sal_u32_t   fh_block_size;   /**< sample frames in the frame */
+    sal_u32_t   fh_number;       /**< frame number, or first sample number for variable block sizes */
+    int         fh_variable;     /**< 1 if the stream uses variable block sizes */
+    int         fh_assignment;   /**< channel assignment */
+    int         fh_length;       /**< size of the header in bytes */
+} _SALx_FlacHeader;
+
+/** @internal
+*/
+typedef struct
+{
+    sal_byte_t          *fa_buffer;        /**< pointer to compressed data */
+    int                  fa_size;          /**< size of the buffer */
+    int                  fa_num_channels;  /**< number of channels */
+    int                  fa_sample_rate;   /**< sample rate */
+    int                  fa_bits;          /**< bits per sample */
+    sal_u32_t            fa_max_block;     /**< largest block size, in sample frames */
+    sal_u32_t            fa_fixed_block;   /**< block size of every frame but the last, or 0 if it varies */
+    sal_u32_t            fa_num_frames;    /**< number of FLAC frames */
+    _SALx_FlacSeekPoint *fa_seek_table;    /**< fa_num_frames + 1 entries, the last marking the end */
+    sal_i32_t           *fa_scratch;       /**< decoding space, fa_max_block per channel */
+    _SALx_FlacVoice     *fa_voices;        /**< one per device voice */
+} SALx_FlacArgs;
+
+/** @internal
+    @brief MSB first bit reader */
+typedef struct
+{
+    const sal_byte_t *br_start;    /**< where reading started */
+    const sal_byte_t *br_p;        /**< next byte to load */
+    const sal_byte_t *br_end;      /**< end of the readable bytes */
+    sal_u64_t         br_cache;    /**< loaded bits, left aligned */
+    int               br_bits;     /**< number of bits in br_cache */
+    int               br_padding;  /**< zero bytes loaded past br_end */
+} _SALx_BitReader;
+
+/* tops the cache up to at least 57 bits, past the end it reads zeros */
+#define S_BR_REFILL( br ) \
+    while ( ( br )->br_bits <= 56 ) \
+    { \
+        if ( ( br )->br_p < ( br )->br_end ) \
+        { \
+            ( br )->br_cache |= ( sal_u64_t ) *( br )->br_p++ << ( 56 - ( br )->br_bits ); \
+        } \
+        else \
+        { \
+            ( br )->br_padding++; \
+        } \
+        ( br )->br_bits += 8; \
+    }
+
+/** @internal
+    @brief Reads up to 32 bits */
+static
+sal_u32_t
+s_br_read( _SALx_BitReader *br, int n )
+{
+    sal_u32_t v;
+
+    if ( n == 0 )
+    {
+        return 0;
+    }
+
+    S_BR_REFILL( br );
+
+    v = ( sal_u32_t ) ( br->br_cache >> ( 64 - n ) );
+    br->br_cache <<= n;
+    br->br_bits   -= n;
+
+    return v;
+}
+
+/** @internal
+    @brief Reads a signed value of up to 32 bits */
+static
+sal_i32_t
+s_br_read_signed( _SALx_BitReader *br, int n )
+{
+    sal_u32_t sign;
+
+    if ( n == 0 )
+    {
+        return 0;
+    }
+
+    sign = 1U << ( n - 1 );
+
+    return ( sal_i32_t ) ( ( s_br_read( br, n ) ^ sign ) - sign );
+}
+
+/** @internal
+    @brief Reads a unary coded value, the number of 0 bits before the next 1 bit */
+static
+sal_u32_t
+s_br_read_unary( _SALx_BitReader *br )
+{
+    sal_u32_t q = 0;
+
+    for ( ;; )
+    {
+        S_BR_REFILL( br );
+
+        if ( br->br_cache )
+        {
+            int zeros = S_CLZ64( br->br_cache );
+
+            /* two shifts as zeros + 1 can be all 64 bits */
+            br->br_cache <<= zeros;
+            br->br_cache <<= 1;
+            br->br_bits   -= zeros + 1;
+
+            return q + zeros;
+        }
+
+        q           += br->br_bits;
+        br->br_cache = 0;
+        br->br_bits  = 0;
+
+        /* nothing but padding left, give up and let the caller notice the overrun */
+        if ( br->br_padding > 8 )
+        {
+            return q;
+        }
+    }
+}
+
+/** @internal
+    @brief Returns 1 if the reader has consumed more than the bytes it was given */
+static
+int
+s_br_overrun( const _SALx_BitReader *br )
+{
+    return ( ( br->br_p - br->br_start ) + br->br_padding ) * 8 - br->br_bits > ( br->br_end - br->br_start ) * 8;
+}
+
+/** @internal
+    @brief Parses a frame header
+    @returns 1 if a valid header that fits the stream was found, 0 if not
+*/
+static
+int
+s_flac_parse_header( const SALx_FlacArgs *p_args,
+                     const sal_byte_t *kp_src,
+                     const sal_byte_t *kp_end,
+                     _SALx_FlacHeader *p_header )
+{
+    const sal_byte_t *p = kp_src + 4;
+    const sal_byte_t *q;
+    sal_u64_t number;
+    int extra, i, bits;
+    sal_byte_t crc = 0;
+
+    /* longest possible header is 16 bytes, but a short one can sit right at the end */
+    if ( kp_end - kp_src < 6 || kp_src[ 0 ] != 0xFF || ( kp_src[ 1 ] & 0xFE ) != 0xF8 || ( kp_src[ 3 ] & 1 ) )
+    {
+        return 0;
+    }
+
+    p_header->fh_variable   = kp_src[ 1 ] & 1;
+    p_header->fh_assignment = kp_src[ 3 ] >> 4;
+
+    /* channels */
+    if ( p_header->fh_assignment > 10 ||
+         ( p_header->fh_assignment < 8 ? p_header->fh_assignment + 1 : 2 ) != p_args->fa_num_channels )
+    {
+        return 0;
+    }
+
+    /* bits per sample, which must match the stream */
+    switch ( ( kp_src[ 3 ] >> 1 ) & 7 )
+    {
+    case 0: bits = p_args->fa_bits; break;
+    case 1: bits = 8;  break;
+    case 2: bits = 12; break;
+    case 4: bits = 16; break;
+    case 5: bits = 20; break;
+    case 6: bits = 24; break;
+    default: return 0;
+    }
+
+    if ( bits != p_args->fa_bits )
+    {
+        return 0;
+    }
+
+    /* frame or sample number, UTF-8 style */
+    if ( *p < 0x80 )       { number = *p & 0x7F; extra = 0; }
+    else if ( *p < 0xC0 )  { return 0; }
+    else if ( *p < 0xE0 )  { number = *p & 0x1F; extra = 1; }
+    else if ( *p < 0xF0 )  { number = *p & 0x0F; extra = 2; }
+    else if ( *p < 0xF8 )  { number = *p & 0x07; extra = 3; }
+    else if ( *p < 0xFC )  { number = *p & 0x03; extra = 4; }
+    else if ( *p < 0xFE )  { number = *p & 0x01; extra = 5; }
+    else if ( *p == 0xFE ) { number = 0; extra = 6; }
+    else                   { return 0; }
+
+    if ( kp_end - p < extra + 1 + 4 )
+    {
+        return 0;
+    }
+
+    for ( p++; extra > 0; extra--, p++ )
+    {
+        if ( ( *p & 0xC0 ) != 0x80 )
+        {
+            return 0;
+        }
+        number = ( number << 6 ) | ( *p & 0x3F );
+    }
+
+    if ( number > 0xFFFFFFFFU )
+    {
+        return 0;
+    }
+
+    p_header->fh_number = ( sal_u32_t ) number;
+
+    /* block size */
+    switch ( kp_src[ 2 ] >> 4 )
+    {
+    case 0:  return 0;
+    case 1:  p_header->fh_block_size = 192; break;
+    case 6:  p_header->fh_block_size = *p++ + 1; break;
+    case 7:  p_header->fh_block_size = ( ( p[ 0 ] << 8 ) | p[ 1 ] ) + 1; p += 2; break;
+    default:
+        p_header->fh_block_size = ( kp_src[ 2 ] >> 4 ) < 8 ? 576U << ( ( kp_src[ 2 ] >> 4 ) - 2 ) : 256U << ( ( kp_src[ 2 ] >> 4 ) - 8 );
+        break;
+    }
+
+    /* sample rate, only needed to find the end of the header */
+    switch ( kp_src[ 2 ] & 15 )
+    {
+    case 12: p += 1; break;
+    case 13:
+    case 14: p += 2; break;
+    case 15: return 0;
+    default: break;
+    }
+
+    if ( p >= kp_end || p_header->fh_block_size > p_args->fa_max_block )
+    {
+        return 0;
+    }
+
+    /* CRC-8, polynomial x^8 + x^2 + x + 1 */
+    for ( q = kp_src; q < p; q++ )
+    {
+        crc ^= *q;
+
+        for ( i = 0; i < 8; i++ )
+        {
+            crc = ( sal_byte_t ) ( ( crc & 0x80 ) ? ( ( crc << 1 ) ^ 0x07 ) : ( crc << 1 ) );
+        }
+    }
+
+    if ( crc != *p )
+    {
+        return 0;
+    }
+
+    p_header->fh_length = ( int ) ( p + 1 - kp_src );
+
+    return 1;
+}
+
+/** @internal
+    @brief Decodes a subframe's partitioned Rice coded residual
+    @returns 1 on success, 0 if the residual is corrupt
+*/
+static
+int
+s_flac_decode_residual( _SALx_BitReader *br,
+                        sal_i32_t *p_dst,
+                        sal_u32_t block_size,
+                        sal_u32_t order )
+{
+    sal_u32_t method = s_br_read( br, 2 );
+    sal_u32_t partition_order = s_br_read( br, 4 );
+    sal_u32_t partition_size = block_size >> partition_order;
+    sal_u32_t param_bits = method ? 5 : 4;
+    sal_u32_t escape = method ? 31 : 15;
+    sal_u32_t p, i;
+
+    if ( method > 1 || ( partition_size << partition_order ) != block_size || partition_size < order )
+    {
+        return 0;
+    }
+
+    for ( p = 0; p < ( 1U << partition_order ); p++ )
+    {
+        sal_u32_t k = s_br_read( br, param_bits );
+        sal_u32_t n = partition_size - ( p == 0 ? order : 0 );
+
+        if ( k == escape )
+        {
+            int bits = ( int ) s_br_read( br, 5 );
+
+            for ( i = 0; i < n; i++ )
+            {
+                *p_dst++ = s_br_read_signed( br, bits );
+            }
+        }
+        else
+        {
+            for ( i = 0; i < n; i++ )
+            {
+                sal_u32_t u = ( s_br_read_unary( br ) << k ) | s_br_read( br, ( int ) k );
+
+                *p_dst++ = ( sal_i32_t ) ( u >> 1 ) ^ -( sal_i32_t ) ( u & 1 );
+            }
+        }
+    }
+
+    return 1;
+}
+
+/** @internal
+    @brief Decodes a subframe
+    @returns 1 on success, 0 if the subframe is corrupt
+*/
+static
+int
+s_flac_decode_subframe( _SALx_BitReader *br,
+                        sal_i32_t *p_dst,
+                        sal_u32_t block_size,
+                        int bits )
+{
+    sal_u32_t *p_u = ( sal_u32_t * ) p_dst;
+    sal_u32_t type, order, i;
+    int wasted = 0;
+
+    if ( s_br_read( br, 1 ) != 0 )
+    {
+        return 0;
+    }
+
+    type = s_br_read( br, 6 );
+
+    if ( s_br_read( br, 1 ) )
+    {
+        wasted = ( int ) s_br_read_unary( br ) + 1;
+        bits  -= wasted;
+
+        if ( bits <= 0 )
+        {
+            return 0;
+        }
+    }
+
+    if ( type == 0 )
+    {
+        /* constant */
+        sal_i32_t value = s_br_read_signed( br, bits );
+
+        for ( i = 0; i < block_size; i++ )
+        {
+            p_dst[ i ] = value;
+        }
+    }
+    else if ( type == 1 )
+    {
+        /* verbatim */
+        for ( i = 0; i < block_size; i++ )
+        {
+            p_dst[ i ] = s_br_read_signed( br, bits );
+        }
+    }
+    else if ( type >= 8 && type <= 12 )
+    {
+        /* fixed polynomial predictor */
+        order = type - 8;
+
+        if ( order > block_size )
+        {
+            return 0;
+        }
+
+        for ( i = 0; i < order; i++ )
+        {
+            p_dst[ i ] = s_br_read_signed( br, bits );
+        }
+
+        if ( !s_flac_decode_residual( br, p_dst + order, block_size, order ) )
+        {
+            return 0;
+        }
+
+        /* unsigned so a corrupt frame wraps around instead of overflowing */
+        switch ( order )
+        {
+        case 1:
+            for ( i = 1; i < block_size; i++ )
+                p_u[ i ] += p_u[ i - 1 ];
+            break;
+        case 2:
+            for ( i = 2; i < block_size; i++ )
+                p_u[ i ] += 2 * p_u[ i - 1 ] - p_u[ i - 2 ];
+            break;
+        case 3:
+            for ( i = 3; i < block_size; i++ )
+                p_u[ i ] += 3 * ( p_u[ i - 1 ] - p_u[ i - 2 ] ) + p_u[ i - 3 ];
+            break;
+        case 4:
+            for ( i = 4; i < block_size; i++ )
+                p_u[ i ] += 4 * ( p_u[ i - 1 ] + p_u[ i - 3 ] ) - 6 * p_u[ i - 2 ] - p_u[ i - 4 ];
+            break;
+        }
+    }
+    else if ( type >= 32 )
+    {
+        /* linear predictor */
+        sal_i32_t coefs[ 32 ];
+        sal_u32_t precision;
+        sal_i32_t shift;
+        sal_u32_t j;
+        int order_bits = 0;
+
+        order = type - 31;
+
+        if ( order > block_size )
+        {
+            return 0;
+        }
+
+        for ( i = 0; i < order; i++ )
+        {
+            p_dst[ i ] = s_br_read_signed( br, bits );
+        }
+
+        if ( ( precision = s_br_read( br, 4 ) + 1 ) == 16 || ( shift = s_br_read_signed( br, 5 ) ) < 0 )
+        {
+            return 0;
+        }
+
+        for ( i = 0; i < order; i++ )
+        {
+            coefs[ i ] = s_br_read_signed( br, ( int ) precision );
+        }
+
+        if ( !s_flac_decode_residual( br, p_dst + order, block_size, order ) )
+        {
+            return 0;
+        }
+
+        while ( ( 1U << order_bits ) < order )
+        {
+            order_bits++;
+        }
+
+        /* 32-bit sums are enough unless the samples, coefficients and order are all large */
+        if ( bits + precision + order_bits <= 32 )
+        {
+            for ( i = order; i < block_size; i++ )
+            {
+                sal_u32_t sum = 0;
+
+                for ( j = 0; j < order; j++ )
+                {
+                    sum += ( sal_u32_t ) coefs[ j ] * p_u[ i - 1 - j ];
+                }
+
+                p_u[ i ] += ( sal_u32_t ) ( ( sal_i32_t ) sum >> shift );
+            }
+        }
+        else
+        {
+            for ( i = order; i < block_size; i++ )
+            {
+                sal_i64_t sum = 0;
+
+                for ( j = 0; j < order; j++ )
+                {
+                    sum += ( sal_i64_t ) coefs[ j ] * p_dst[ i - 1 - j ];
+                }
+
+                p_u[ i ] += ( sal_u32_t ) ( sum >> shift );
+            }
+        }
+    }
+    else
+    {
+        return 0;
+    }
+
+    if ( wasted )
+    {
+        for ( i = 0; i < block_size; i++ )
+        {
+            p_dst[ i ] = ( sal_i32_t ) ( ( sal_u32_t ) p_dst[ i ] << wasted );
+        }
+    }
+
+    return 1;
+}
+
+/** @internal
+    @brief Decodes a frame into interleaved 16-bit samples
+    @param[in] p_args the sample's FLAC state
+    @param[in] index index of the frame in the seek table
+    @param[out] p_dst receives the frame's samples, or 0 to only check that the frame decodes
+    @returns 1 on success, 0 if the frame is corrupt
+*/
+static
+int
+s_flac_decode_frame( SALx_FlacArgs *p_args,
+                     sal_u32_t index,
+                     sal_i16_t *p_dst )
+{
+    const sal_byte_t *kp_frame = p_args->fa_buffer + p_args->fa_seek_table[ index ].fs_offset;
+    const sal_byte_t *kp_end   = p_args->fa_buffer + p_args->fa_seek_table[ index + 1 ].fs_offset;
+    sal_i32_t *p_ch0 = p_args->fa_scratch;
+    sal_i32_t *p_ch1 = p_args->fa_scratch + p_args->fa_max_block;
+    _SALx_FlacHeader header;
+    _SALx_BitReader br;
+    sal_u32_t i, n;
+    int c;
+    int shift = p_args->fa_bits - 16;
+
+    if ( !s_flac_parse_header( p_args, kp_frame, kp_end, &header ) )
+    {
+        return 0;
+    }
+
+    memset( &br, 0, sizeof( br ) );
+    br.br_start = br.br_p = kp_frame + header.fh_length;
+    br.br_end   = kp_end;
+    n           = header.fh_block_size;
+
+    for ( c = 0; c < p_args->fa_num_channels; c++ )
+    {
+        /* the side channel carries an extra bit */
+        int side = ( header.fh_assignment == 8 && c == 1 ) ||
+                   ( header.fh_assignment == 9 && c == 0 ) ||
+                   ( header.fh_assignment == 10 && c == 1 );
+
+        if ( !s_flac_decode_subframe( &br, p_args->fa_scratch + c * p_args->fa_max_block, n, p_args->fa_bits + side ) )
+        {
+            return 0;
+        }
+    }
+
+    if ( s_br_overrun( &br ) )
+    {
+        return 0;
+    }
+
+    if ( p_dst == 0 )
+    {
+        return 1;
+    }
+
+    switch ( header.fh_assignment )
+    {
+    case 8:     /* left/side */
+        for ( i = 0; i < n; i++ )
+            p_ch1[ i ] = ( sal_i32_t ) ( ( sal_u32_t ) p_ch0[ i ] - ( sal_u32_t ) p_ch1[ i ] );
+        break;
+    case 9:     /* side/right */
+        for ( i = 0; i < n; i++ )
+            p_ch0[ i ] = ( sal_i32_t ) ( ( sal_u32_t ) p_ch0[ i ] + ( sal_u32_t ) p_ch1[ i ] );
+        break;
+    case 10:    /* mid/side */
+        for ( i = 0; i < n; i++ )
+        {
+            sal_u32_t mid  = ( ( sal_u32_t ) p_ch0[ i ] << 1 ) | ( p_ch1[ i ] & 1 );
+            sal_u32_t side = ( sal_u32_t ) p_ch1[ i ];
+
+            p_ch0[ i ] = ( sal_i32_t ) ( mid + side ) >> 1;
+            p_ch1[ i ] = ( sal_i32_t ) ( mid - side ) >> 1;
+        }
+        break;
+    }
+
+    /* down to 16 bits and interleaved */
+    for ( c = 0; c < p_args->fa_num_channels; c++ )
+    {
+        const sal_i32_t *kp_src = p_args->fa_scratch + c * p_args->fa_max_block;
+        sal_i16_t *p_out = p_dst + c;
+
+        if ( shift >= 0 )
+        {
+            for ( i = 0; i < n; i++, p_out += p_args->fa_num_channels )
+                *p_out = ( sal_i16_t ) ( kp_src[ i ] >> shift );
+        }
+        else
+        {
+            for ( i = 0; i < n; i++, p_out += p_args->fa_num_channels )
+                *p_out = ( sal_i16_t ) ( ( sal_u32_t ) kp_src[ i ] << -shift );
+        }
+    }
+
+    return 1;
+}
+
+/** @internal
+    @brief Finds the frame holding a sample frame
+    @returns the frame's index in the seek table
+*/
+static
+sal_u32_t
+s_flac_find_frame( const SALx_FlacArgs *p_args,
+                   sal_u32_t position )
+{
+    sal_u32_t lo = 0;
+    sal_u32_t hi = p_args->fa_num_frames;
+
+    if ( p_args->fa_fixed_block )
+    {
+        lo = position / p_args->fa_fixed_block;
+        return ( lo < p_args->fa_num_frames ) ? lo : p_args->fa_num_frames - 1;
+    }
+
+    /* last frame whose first sample is <= position */
+    while ( hi - lo > 1 )
+    {
+        sal_u32_t mid = lo + ( hi - lo ) / 2;
+
+        if ( p_args->fa_seek_table[ mid ].fs_first <= position )
+        {
+            lo = mid;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+/** @internal
+    @brief Decoder for FLAC samples
+    @param[in] p_device pointer to output device
+    @param[in] voice voice that is being decoded
+    @param[out] p_dst destination buffer for decoding
+    @param[in] bytes_needed number of bytes we need to decode
+    @returns 1 if the voice has ended, 0 if not
+*/
+static
+int
+s_flac_decoder( SAL_Device *p_device,
+                sal_voice_t voice,
+                sal_byte_t *p_dst,
+                int bytes_needed )
+{
+    SAL_Voice *p_voice = &p_device->device_voices[ voice ];
+    SALx_FlacArgs *flac_args = ( SALx_FlacArgs * ) p_voice->voice_sample->sample_args.sarg_ptr;
+    _SALx_FlacVoice *p_state = &flac_args->fa_voices[ voice ];
+    const int dst_channels = p_device->device_info.di_channels;
+    const int src_channels = flac_args->fa_num_channels;
+    const int bytes_per_frame = p_device->device_info.di_bytes_per_sample * dst_channels;
+    const sal_u32_t total = flac_args->fa_seek_table[ flac_args->fa_num_frames ].fs_first;
+    sal_byte_t silence = ( p_device->device_info.di_bits == 8 ) ? 0x80 : 0;
+
+    while ( bytes_needed >= bytes_per_frame )
+    {
+        sal_u32_t position  = p_voice->voice_cursor / dst_channels;
+        sal_u32_t end       = p_voice->voice_loop_end / dst_channels;
+        sal_u32_t index;
+        const sal_i16_t *kp_src;
+        int num_frames, i;
+
+        if ( end > total )
+        {
+            end = total;
+        }
+
+        if ( position >= end )
+        {
+            /* nothing left to decode, let the voice run out */
+            memset( p_dst, silence, bytes_needed );
+            return !_SAL_advance_voice( p_device, voice, bytes_needed / p_device->device_info.di_bytes_per_sample );
+        }
+
+        index = s_flac_find_frame( flac_args, position );
+
+        if ( p_state->fv_frame != index )
+        {
+            /* a frame that won't decode plays as silence */
+            if ( !s_flac_decode_frame( flac_args, index, p_state->fv_pcm ) )
+            {
+                memset( p_state->fv_pcm, 0, flac_args->fa_max_block * src_channels * sizeof( sal_i16_t ) );
+            }
+            p_state->fv_frame = index;
+        }
+
+        kp_src     = p_state->fv_pcm + ( position - flac_args->fa_seek_table[ index ].fs_first ) * src_channels;
+        num_frames = ( int ) ( flac_args->fa_seek_table[ index + 1 ].fs_first - position );
+
+        if ( ( sal_u32_t ) num_frames > end - position )
+        {
+            num_frames = ( int ) ( end - position );
+        }
+
+        if ( num_frames > bytes_needed / bytes_per_frame )
+        {
+            num_frames = bytes_needed / bytes_per_frame;
+        }
+
+        /* convert to the device's format */
+        if ( p_device->device_info.di_bits == 16 )
+        {
+            sal_i16_t *p_dst16 = ( sal_i16_t * ) p_dst;
+
+            if ( src_channels == dst_channels )
+            {
+                memcpy( p_dst16, kp_src, num_frames * src_channels * sizeof( sal_i16_t ) );
+            }
+            else if ( src_channels == 1 )
+            {
+                for ( i = 0; i < num_frames; i++ )
+                {
+                    p_dst16[ i * 2 ] = p_dst16[ i * 2 + 1 ] = kp_src[ i ];
+                }
+            }
+            else
+            {
+                for ( i = 0; i < num_frames; i++ )
+                {
+                    p_dst16[ i ] = ( sal_i16_t ) ( ( kp_src[ i * 2 ] + kp_src[ i * 2 + 1 ] ) / 2 );
+                }
+            }
+        }
+        else
+        {
+            if ( src_channels == dst_channels )
+            {
+                for ( i = 0; i < num_frames * src_channels; i++ )
+                {
+                    p_dst[ i ] = I16_TO_U8( kp_src[ i ] );
+                }
+            }
+            else if ( src_channels == 1 )
+            {
+                for ( i = 0; i < num_frames; i++ )
+                {
+                    p_dst[ i * 2 ] = p_dst[ i * 2 + 1 ] = I16_TO_U8( kp_src[ i ] );
+                }
+            }
+            else
+            {
+                for ( i = 0; i < num_frames; i++ )
+                {
+                    p_dst[ i ] = I16_TO_U8( ( kp_src[ i * 2 ] + kp_src[ i * 2 + 1 ] ) / 2 );
+                }
+            }
+        }
+
+        p_dst        += num_frames * bytes_per_frame;
+        bytes_needed -= num_frames * bytes_per_frame;
+
+        if ( !_SAL_advance_voice( p_device, voice, num_frames * dst_channels ) )
+        {
+            memset( p_dst, silence, bytes_needed );
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/** @internal
+    @brief Frees everything a FLAC sample holds
+    @remarks Assumes the device is locked. */
+static
+void
+s_flac_free_args( SAL_Device *p_device,
+                  SALx_FlacArgs *flac_args )
+{
+    if ( flac_args->fa_voices )
+    {
+        SAL_free_aligned( p_device, flac_args->fa_voices[ 0 ].fv_pcm );
+        _SAL_pool_free_locked( p_device, flac_args->fa_voices, p_device->device_max_voices * sizeof( _SALx_FlacVoice ) );
+    }
+
+    SAL_free( p_device, flac_args->fa_scratch );
+    SAL_free( p_device, flac_args->fa_seek_table );
+    SAL_free( p_device, flac_args->fa_buffer );
+    _SAL_pool_free_locked( p_device, flac_args, sizeof( *flac_args ) );
+}
+
+static
+void
+s_flac_destructor( SAL_Device *p_device, 
+                   SAL_Sample *self )
+{
+    s_flac_free_args( p_device, ( SALx_FlacArgs * ) self->sample_args.sarg_ptr );
+}
+
+/** @internal
+    @brief Adds a frame to the seek table, growing it as needed */
+static
+sal_error_e
+s_flac_add_seek_point( SAL_Device *device,
+                       SALx_FlacArgs *flac_args,
+                       sal_u32_t *p_capacity,
+                       sal_u32_t offset,
+                       sal_u32_t first )
+{
+    sal_error_e err;
+
+    /* leave room for the end marker */
+    if ( flac_args->fa_num_frames + 1 >= *p_capacity )
+    {
+        _SALx_FlacSeekPoint *p_table = 0;
+
+        if ( ( err = SAL_alloc( device, ( void ** ) &p_table, *p_capacity * 2 * sizeof( *p_table ) ) ) != SALERR_OK )
+        {
+            return err;
+        }
+
+        memcpy( p_table, flac_args->fa_seek_table, flac_args->fa_num_frames * sizeof( *p_table ) );
+        SAL_free( device, flac_args->fa_seek_table );
+
+        flac_args->fa_seek_table = p_table;
+        *p_capacity *= 2;
+    }
+
+    flac_args->fa_seek_table[ flac_args->fa_num_frames ].fs_offset = offset;
+    flac_args->fa_seek_table[ flac_args->fa_num_frames ].fs_first  = first;
+    flac_args->fa_num_frames++;
+
+    return SALERR_OK;
+}
+
+/** @internal
+    @brief Finds every frame in the stream and builds the seek table
+    @param[in] device pointer to output device
+    @param[in] flac_args the sample's FLAC state
+    @param[in] offset offset of the first frame
+    @returns SALERR_OK on success, @ref sal_error_e on failure
+    A frame ends where its CRC-16 matches and is followed either by the
+    end of the stream or by a valid header with the next frame's number.
+*/
+static
+sal_error_e
+s_flac_scan( SAL_Device *device,
+             SALx_FlacArgs *flac_args,
+             sal_u32_t offset )
+{
+    const sal_byte_t *kp_buffer = flac_args->fa_buffer;
+    const sal_u32_t size = ( sal_u32_t ) flac_args->fa_size;
+    sal_u16_t crc_table[ 256 ];
+    sal_u32_t capacity = 64;
+    sal_u32_t first = 0;
+    sal_u32_t block_size = 0;
+    int variable_sizes = 0;
+    _SALx_FlacHeader header;
+    sal_error_e err;
+    sal_u32_t i;
+    int j;
+
+    /* CRC-16, polynomial x^16 + x^15 + x^2 + 1 */
+    for ( i = 0; i < 256; i++ )
+    {
+        sal_u16_t crc = ( sal_u16_t ) ( i << 8 );
+
+        for ( j = 0; j < 8; j++ )
+        {
+            crc = ( sal_u16_t ) ( ( crc & 0x8000 ) ? ( ( crc << 1 ) ^ 0x8005 ) : ( crc << 1 ) );
+        }
+
+        crc_table[ i ] = crc;
+    }
+
+    if ( ( err = SAL_alloc( device, ( void ** ) &flac_args->fa_seek_table, capacity * sizeof( _SALx_FlacSeekPoint ) ) ) != SALERR_OK )
+    {
+        return err;
+    }
+
+    if ( !s_flac_parse_header( flac_args, kp_buffer + offset, kp_buffer + size, &header ) )
+    {
+        return SALERR_INVALIDFORMAT;
+    }
+
+    for ( ;; )
+    {
+        sal_u16_t crc = 0;
+        sal_u32_t last_end = 0;
+        sal_u32_t q;
+        _SALx_FlacHeader next;
+        sal_u32_t expected = header.fh_variable ? first + header.fh_block_size : flac_args->fa_num_frames + 1;
+
+        if ( ( err = s_flac_add_seek_point( device, flac_args, &capacity, offset, first ) ) != SALERR_OK )
+        {
+            return err;
+        }
+
+        if ( flac_args->fa_num_frames == 1 )
+        {
+            block_size = header.fh_block_size;
+        }
+
+        first += header.fh_block_size;
+
+        /* q is where the frame's CRC would be, with the CRC of everything before it in crc */
+        for ( q = offset; q + 2 <= size; q++ )
+        {
+            if ( q >= offset + header.fh_length && ( ( kp_buffer[ q ] << 8 ) | kp_buffer[ q + 1 ] ) == crc )
+            {
+                if ( q + 2 < size &&
+                     s_flac_parse_header( flac_args, kp_buffer + q + 2, kp_buffer + size, &next ) && 
+                     next.fh_number == expected && next.fh_variable == header.fh_variable )
+                {
+                    break;
+                }
+
+                /* the last frame, possibly with a tag tacked on after it, if it decodes right up to here */
+                flac_args->fa_seek_table[ flac_args->fa_num_frames ].fs_offset = q;
+
+                if ( s_flac_decode_frame( flac_args, flac_args->fa_num_frames - 1, 0 ) )
+                {
+                    last_end = q + 2;
+                    break;
+                }
+            }
+
+            crc = ( sal_u16_t ) ( ( crc << 8 ) ^ crc_table[ ( crc >> 8 ) ^ kp_buffer[ q ] ] );
+        }
+
+        if ( last_end != 0 || q + 2 > size )
+        {
+            if ( last_end == 0 )
+            {
+                /* the last frame is damaged, play what came before it */
+                _SAL_warning( device, "FLAC stream ends with a damaged frame\n" );
+                flac_args->fa_num_frames--;
+                first -= header.fh_block_size;
+
+                if ( flac_args->fa_num_frames == 0 )
+                {
+                    return SALERR_INVALIDFORMAT;
+                }
+
+                last_end = offset;
+            }
+
+            /* end marker */
+            flac_args->fa_seek_table[ flac_args->fa_num_frames ].fs_offset = last_end;
+            flac_args->fa_seek_table[ flac_args->fa_num_frames ].fs_first  = first;
+            break;
+        }
+
+        /* only the last frame may be shorter if frames are to be found by division */
+        if ( header.fh_block_size != block_size )
+        {
+            variable_sizes = 1;
+        }
+
+        offset = q + 2;
+        header = next;
+    }
+
+    flac_args->fa_fixed_block = variable_sizes ? 0 : block_size;
+
+    return SALERR_OK;
+}
+
+/** Creates a sample that decodes from an in-memory FLAC image.
+    @ingroup extras
+    @param [in] device pointer to output device
+    @param [out] pp_sample address of a pointer to a sample to store the new sample
+    @param [in] kp_src source array of bytes.  This data is copied.
+    @param [in] src_size number of bytes in kp_src
+    @returns SALERR_OK on success, @ref sal_error_e on failure
+    The stream is kept compressed and decoded as it plays.  Mono and stereo
+    streams of 8 to 24 bits are supported, and are played at 16 bits or
+    less.  The sample rate must match the device's.
+*/
+sal_error_e 
+SALx_create_sample_from_flac( SAL_Device *device,
+                              SAL_Sample **pp_sample,
+                              const void *kp_src,
+                              int src_size )
+{
+    const sal_byte_t *kp_bytes = ( const sal_byte_t * ) kp_src;
+    SAL_Sample *p_sample = 0;
+    SAL_SampleArgs args;
+    sal_error_e err;
+    SALx_FlacArgs *p_flac_args = 0;
+    SAL_DeviceInfo dinfo;
+    sal_i16_t *p_pcm = 0;
+    sal_u32_t offset = 4;
+    int last = 0;
+    int found_info = 0;
+    int i;
+
+    if ( device == 0 || pp_sample == 0 || kp_src == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    *pp_sample = 0;
+
+    if ( src_size < 8 || memcmp( kp_bytes, "fLaC", 4 ) != 0 )
+    {
+        return SALERR_INVALIDFORMAT;
+    }
+
+    if ( ( p_flac_args = ( SALx_FlacArgs * ) _SAL_pool_alloc( device, sizeof( *p_flac_args ) ) ) == 0 )
+    {
+        return SALERR_OUTOFMEMORY;
+    }
+
+    memset( p_flac_args, 0, sizeof( *p_flac_args ) );
+
+    /* metadata blocks, of which only STREAMINFO matters */
+    while ( !last )
+    {
+        sal_u32_t length;
+
+        if ( offset + 4 > ( sal_u32_t ) src_size )
+        {
+            _SAL_pool_free( device, p_flac_args, sizeof( *p_flac_args ) );
+            return SALERR_INVALIDFORMAT;
+        }
+
+        last   = kp_bytes[ offset ] >> 7;
+        length = ( kp_bytes[ offset + 1 ] << 16 ) | ( kp_bytes[ offset + 2 ] << 8 ) | kp_bytes[ offset + 3 ];
+
+        if ( length > ( sal_u32_t ) src_size - offset - 4 )
+        {
+            _SAL_pool_free( device, p_flac_args, sizeof( *p_flac_args ) );
+            return SALERR_INVALIDFORMAT;
+        }
+
+        if ( ( kp_bytes[ offset ] & 0x7F ) == 0 && length >= 34 )
+        {
+            const sal_byte_t *kp_info = kp_bytes + offset + 4;
+
+            p_flac_args->fa_max_block    = ( kp_info[ 2 ] << 8 ) | kp_info[ 3 ];
+            p_flac_args->fa_sample_rate  = ( kp_info[ 10 ] << 12 ) | ( kp_info[ 11 ] << 4 ) | ( kp_info[ 12 ] >> 4 );
+            p_flac_args->fa_num_channels = ( ( kp_info[ 12 ] >> 1 ) & 7 ) + 1;
+            p_flac_args->fa_bits         = ( ( ( kp_info[ 12 ] & 1 ) << 4 ) | ( kp_info[ 13 ] >> 4 ) ) + 1;
+            found_info = 1;
+        }
+
+        offset += 4 + length;
+    }
+
+    memset( &dinfo, 0, sizeof( dinfo ) );
+    dinfo.di_size = sizeof( dinfo );
+    SAL_get_device_info( device, &dinfo );
+
+    if ( !found_info || 
+         p_flac_args->fa_num_channels > SALX_FLAC_MAX_CHANNELS ||
+         p_flac_args->fa_bits < 8 || p_flac_args->fa_bits > 24 ||
+         p_flac_args->fa_max_block < 16 )
+    {
+        _SAL_warning( device, "Unsupported FLAC stream\n" );
+        _SAL_pool_free( device, p_flac_args, sizeof( *p_flac_args ) );
+        return SALERR_INVALIDFORMAT;
+    }
+
+    if ( p_flac_args->fa_sample_rate != dinfo.di_sample_rate )
+    {
+        _SAL_warning( device, "Sample frequency of %d does not match device's frequency of %d\n", p_flac_args->fa_sample_rate, dinfo.di_sample_rate );
+        _SAL_pool_free( device, p_flac_args, sizeof( *p_flac_args ) );
+        return SALERR_INVALIDFORMAT;
+    }
+
+    if ( ( err = SAL_alloc( device, ( void ** ) &p_flac_args->fa_buffer, src_size ) ) != SALERR_OK )
+    {
+        _SAL_pool_free( device, p_flac_args, sizeof( *p_flac_args ) );
+        return err;
+    }
+
+    memcpy( p_flac_args->fa_buffer, kp_src, src_size );
+    p_flac_args->fa_size = src_size;
+
+    if ( ( err = SAL_alloc( device, ( void ** ) &p_flac_args->fa_scratch, p_flac_args->fa_max_block * p_flac_args->fa_num_channels * sizeof( sal_i32_t ) ) ) != SALERR_OK ||
+         ( err = s_flac_scan( device, p_flac_args, offset ) ) != SALERR_OK ||
+         ( p_flac_args->fa_voices = ( _SALx_FlacVoice * ) _SAL_pool_alloc( device, device->device_max_voices * sizeof( _SALx_FlacVoice ) ) ) == 0 )
+    {
+        err = ( err != SALERR_OK ) ? err : SALERR_OUTOFMEMORY;
+        _SAL_lock_device( device );
+        s_flac_free_args( device, p_flac_args );
+        _SAL_unlock_device( device );
+        return err;
+    }
+
+    p_flac_args->fa_voices[ 0 ].fv_pcm = 0;
+
+    if ( ( err = SAL_alloc_aligned( device, ( void ** ) &p_pcm, device->device_max_voices * p_flac_args->fa_max_block * p_flac_args->fa_num_channels * sizeof( sal_i16_t ), SAL_ALIGNMENT ) ) != SALERR_OK )
+    {
+        _SAL_lock_device( device );
+        s_flac_free_args( device, p_flac_args );
+        _SAL_unlock_device( device );
+        return err;
+    }
+
+    for ( i = 0; i < device->device_max_voices; i++ )
+    {
+        p_flac_args->fa_voices[ i ].fv_frame = SALX_FLAC_NO_FRAME;
+        p_flac_args->fa_voices[ i ].fv_pcm   = p_pcm + i * p_flac_args->fa_max_block * p_flac_args->fa_num_channels;
+    }
+
+    args.sarg_ptr = p_flac_args;
+
+    if ( ( err = SAL_create_sample( device, &p_sample, 0, s_flac_decoder, s_flac_destructor, &args ) ) != SALERR_OK )
+    {
+        _SAL_lock_device( device );
+        s_flac_free_args( device, p_flac_args );
+        _SAL_unlock_device( device );
+        return err;
+    }
+
+    p_sample->sample_num_samples = p_flac_args->fa_seek_table[ p_flac_args->fa_num_frames ].fs_first * dinfo.di_channels;
+
+    *pp_sample = p_sample;
+
+    return SALERR_OK;
+}
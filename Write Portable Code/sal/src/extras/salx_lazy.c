@@ -0,0 +1,414 @@
+/*
+Copyright (c) 2004, Brian Hook
+All rights reserved.
+
+http://www.bookofhook.com/sal
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+
+    * The names of this package'ss contributors contributors may not
+      be used to endorse or promote products derived from this
+      software without specific prior written permission.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/** @file salx_lazy.c
+    @brief Lazily loaded samples for the Simple Audio Library
+
+    A lazy sample is created from just the header of a WAV file, so it
+    knows its length and format but holds no PCM data.  The first time a
+    voice mixes it, its decoder queues the file on a SALx_Loader and the
+    voice plays silence, with its cursor held at the start, until the
+    loader is done.  From then on it plays like any other PCM sample.
+    SALx_evict_sample drops the data again, and the next play reloads it.
+
+    The loaded data lives in a second, hidden sample that the lazy sample
+    borrows its sample_data from, so whatever the loader produced (for
+    instance a memory mapped file) is released the way it was created.
+*/
+#ifndef SAL_DOXYGEN
+#  define SAL_BUILDING_LIB 1
+#endif
+#include "../sal.h"
+#include "salx_lazy.h"
+#include "salx_wave.h"
+
+#include <string.h>
+#include <stdio.h>
+
+/** @internal
+    @brief Per-sample state of a lazy sample */
+typedef struct
+{
+    SALx_Loader     *lz_loader;       /**< loader used to bring the data in */
+    char            *lz_filename;     /**< file the data comes from */
+    SAL_Sample      *lz_resident;     /**< sample holding the loaded data, or NULL if not resident */
+    SALx_LoadHandle  lz_load;         /**< outstanding load, or SALX_INVALID_LOAD */
+    int              lz_failed;       /**< set if the last load failed, so it isn't retried every mix */
+} _SALx_LazyState;
+
+static int s_lazy_decoder( SAL_Device *p_device, sal_voice_t voice, sal_byte_t *p_dst, int bytes_needed );
+
+/** @internal
+    @brief Returns the lazy state of a sample, or NULL if it isn't a lazy sample */
+static
+_SALx_LazyState *
+s_lazy_state( const SAL_Sample *p_sample )
+{
+    if ( p_sample->sample_fnc_decoder != s_lazy_decoder )
+    {
+        return 0;
+    }
+
+    return ( _SALx_LazyState * ) p_sample->sample_args.sarg_ptr;
+}
+
+/** @internal
+    @brief Starts loading a lazy sample's data if it isn't resident or on its way
+    @remarks Assumes the device is locked.
+*/
+static
+sal_error_e
+s_lazy_request( SAL_Device *p_device, _SALx_LazyState *p_lazy )
+{
+    if ( p_lazy->lz_resident || p_lazy->lz_load != SALX_INVALID_LOAD || p_lazy->lz_failed )
+    {
+        return SALERR_OK;
+    }
+
+    return SALx_load_sample_async( p_device, p_lazy->lz_loader, p_lazy->lz_filename, 0, 0, &p_lazy->lz_load );
+}
+
+/** @internal
+    @brief Picks up a finished load and makes its data the lazy sample's
+    @remarks Assumes the device is locked.
+*/
+static
+void
+s_lazy_adopt( SAL_Device *p_device, SAL_Sample *self, _SALx_LazyState *p_lazy )
+{
+    SAL_Sample *p_loaded = 0;
+    sal_error_e result = SALERR_OK;
+
+    if ( p_lazy->lz_load == SALX_INVALID_LOAD ||
+         SALx_poll_load( p_device, p_lazy->lz_loader, p_lazy->lz_load, &p_loaded, &result ) == SALERR_INUSE )
+    {
+        return;
+    }
+
+    p_lazy->lz_load = SALX_INVALID_LOAD;
+
+    /* the file changed under us since the header was read, so don't trust it */
+    if ( p_loaded && p_loaded->sample_num_samples < self->sample_num_samples )
+    {
+        _SAL_warning( p_device, "%s is shorter than when it was registered\n", p_lazy->lz_filename );
+        _SAL_destroy_sample_raw( p_device, p_loaded );
+        p_loaded = 0;
+    }
+
+    if ( p_loaded == 0 )
+    {
+        p_lazy->lz_failed = 1;
+        return;
+    }
+
+    p_lazy->lz_resident = p_loaded;
+    self->sample_data   = p_loaded->sample_data;
+}
+
+/** @internal
+    @brief Decoder callback for lazy samples
+    @param[in] p_device pointer to output device
+    @param[in] voice voice that is being decoded
+    @param[out] p_dst destination buffer for decoding
+    @param[in] bytes_needed number of bytes we need to decode
+    @returns 1 if the voice has ended, 0 if not
+    Decodes straight from the loaded data once it's resident.  Until then
+    it requests a load and outputs silence without advancing the cursor.
+    If the load fails the voice ends.
+*/
+static
+int
+s_lazy_decoder( SAL_Device *p_device, 
+                sal_voice_t voice,
+                sal_byte_t *p_dst, 
+                int bytes_needed )
+{
+    SAL_Sample *sample = 0;
+    _SALx_LazyState *p_lazy;
+
+    _SAL_get_voice_sample_locked( p_device, voice, &sample );
+
+    p_lazy = ( _SALx_LazyState * ) sample->sample_args.sarg_ptr;
+
+    if ( p_lazy->lz_resident == 0 )
+    {
+        s_lazy_request( p_device, p_lazy );
+        s_lazy_adopt( p_device, sample, p_lazy );
+    }
+
+    if ( p_lazy->lz_resident )
+    {
+        return _SAL_generic_decode_sample( p_device, voice, p_dst, bytes_needed );
+    }
+
+    if ( p_lazy->lz_failed )
+    {
+        return 1;
+    }
+
+    memset( p_dst, ( p_device->device_info.di_bits == 8 ) ? 0x80 : 0, bytes_needed );
+
+    return 0;
+}
+
+/** @internal
+    @brief Drops a lazy sample's data and any load in progress
+    @remarks Assumes the device is locked.
+*/
+static
+void
+s_lazy_release( SAL_Device *p_device, SAL_Sample *self, _SALx_LazyState *p_lazy )
+{
+    if ( p_lazy->lz_load != SALX_INVALID_LOAD )
+    {
+        /* the load may have finished, in which case cancelling destroys what it loaded */
+        _SALx_cancel_load_locked( p_device, p_lazy->lz_loader, p_lazy->lz_load );
+        p_lazy->lz_load = SALX_INVALID_LOAD;
+    }
+
+    /* the data belongs to the resident sample, not to us */
+    self->sample_data = 0;
+
+    if ( p_lazy->lz_resident )
+    {
+        _SAL_destroy_sample_raw( p_device, p_lazy->lz_resident );
+        p_lazy->lz_resident = 0;
+    }
+
+    p_lazy->lz_failed = 0;
+}
+
+/** @internal
+    @brief Destruction callback for lazy samples */
+static
+void
+s_lazy_destroy( SAL_Device *p_device, 
+                SAL_Sample *self )
+{
+    _SALx_LazyState *p_lazy = ( _SALx_LazyState * ) self->sample_args.sarg_ptr;
+
+    s_lazy_release( p_device, self, p_lazy );
+
+    SAL_free( p_device, p_lazy->lz_filename );
+    SAL_free( p_device, p_lazy );
+}
+
+/** Creates a sample whose data isn't loaded until it's first played.
+    @ingroup extras
+    @param [in] device pointer to output device
+    @param [in] p_loader loader used to load the data.  It must outlive the sample.
+    @param [out] pp_sample address of a pointer to a sample to store the new sample
+    @param [in] kp_filename name of the WAV file.  The string is copied.
+    @returns SALERR_OK on success, @ref sal_error_e on failure
+    Only the file's header is read here, to get the sample's length and to
+    check that its sample rate matches the device.  The data is loaded
+    through p_loader's load function, which defaults to the WAV loader.
+*/
+sal_error_e
+SALx_create_lazy_sample( SAL_Device *device,
+                         SALx_Loader *p_loader,
+                         SAL_Sample **pp_sample,
+                         const char *kp_filename )
+{
+    FILE *fp = 0;
+    int header_size;
+    sal_byte_t header[ 64 ];
+    size_t length;
+    sal_error_e err;
+    SALx_WaveInfo info;
+    SAL_DeviceInfo dinfo;
+    SAL_SampleArgs args;
+    _SALx_LazyState *p_lazy = 0;
+
+    if ( device == 0 || p_loader == 0 || pp_sample == 0 || kp_filename == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    *pp_sample = 0;
+
+    if ( ( fp = fopen( kp_filename, "rb" ) ) == 0 )
+    {
+        _SAL_warning( device, "Could not open %s\n", kp_filename );
+        return SALERR_SYSTEMFAILURE;
+    }
+
+    header_size = ( int ) fread( header, 1, sizeof( header ), fp );
+    fclose( fp );
+
+    if ( ( err = SALx_get_wave_info( header, header_size, &info ) ) != SALERR_OK )
+    {
+        return err;
+    }
+
+    memset( &dinfo, 0, sizeof( dinfo ) );
+    dinfo.di_size = sizeof( dinfo );
+    SAL_get_device_info( device, &dinfo );
+
+    if ( info.wi_sample_rate != dinfo.di_sample_rate )
+    {
+        _SAL_warning( device, "Sample frequency of %d does not match device's frequency of %d\n", info.wi_sample_rate, dinfo.di_sample_rate );
+        return SALERR_INVALIDFORMAT;
+    }
+
+    if ( ( err = SAL_alloc( device, ( void ** ) &p_lazy, sizeof( *p_lazy ) ) ) != SALERR_OK )
+    {
+        return err;
+    }
+
+    memset( p_lazy, 0, sizeof( *p_lazy ) );
+
+    length = strlen( kp_filename ) + 1;
+
+    if ( ( err = SAL_alloc( device, ( void ** ) &p_lazy->lz_filename, length ) ) != SALERR_OK )
+    {
+        SAL_free( device, p_lazy );
+        return err;
+    }
+
+    memcpy( p_lazy->lz_filename, kp_filename, length );
+    p_lazy->lz_loader = p_loader;
+    p_lazy->lz_load   = SALX_INVALID_LOAD;
+
+    args.sarg_ptr = p_lazy;
+
+    if ( ( err = SAL_create_sample( device, pp_sample, 0, s_lazy_decoder, s_lazy_destroy, &args ) ) != SALERR_OK )
+    {
+        SAL_free( device, p_lazy->lz_filename );
+        SAL_free( device, p_lazy );
+        return err;
+    }
+
+    /* same length the WAV loader will produce once it's converted to the device's format */
+    (*pp_sample)->sample_num_samples = ( info.wi_data_size / ( info.wi_bits / 8 ) ) * dinfo.di_channels / info.wi_channels;
+
+    return SALERR_OK;
+}
+
+/** Starts loading a lazy sample's data ahead of it being played.
+    @ingroup extras
+    @param [in] device pointer to output device
+    @param [in] p_sample lazy sample to load
+    @returns SALERR_OK on success, @ref sal_error_e on failure
+    Does nothing if the data is already resident or being loaded.
+*/
+sal_error_e
+SALx_prefetch_sample( SAL_Device *device,
+                      SAL_Sample *p_sample )
+{
+    sal_error_e err;
+    _SALx_LazyState *p_lazy;
+
+    if ( device == 0 || p_sample == 0 || ( p_lazy = s_lazy_state( p_sample ) ) == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    _SAL_lock_device( device );
+
+    /* a prefetch is an explicit request, so give a failed file another go */
+    p_lazy->lz_failed = 0;
+
+    err = s_lazy_request( device, p_lazy );
+
+    _SAL_unlock_device( device );
+
+    return err;
+}
+
+/** Releases a lazy sample's data, which is reloaded the next time it's played.
+    @ingroup extras
+    @param [in] device pointer to output device
+    @param [in] p_sample lazy sample to evict
+    @retval SALERR_OK on success
+    @retval SALERR_INUSE if a voice is playing the sample
+    @retval SALERR_INVALIDPARAM if p_sample isn't a lazy sample
+*/
+sal_error_e
+SALx_evict_sample( SAL_Device *device,
+                   SAL_Sample *p_sample )
+{
+    _SALx_LazyState *p_lazy;
+
+    if ( device == 0 || p_sample == 0 || ( p_lazy = s_lazy_state( p_sample ) ) == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    _SAL_lock_device( device );
+
+    /* every playing voice holds a reference */
+    if ( p_sample->sample_ref_count > 1 )
+    {
+        _SAL_unlock_device( device );
+        return SALERR_INUSE;
+    }
+
+    s_lazy_release( device, p_sample, p_lazy );
+
+    _SAL_unlock_device( device );
+
+    return SALERR_OK;
+}
+
+/** Tells whether a sample's data is in memory.
+    @ingroup extras
+    @param [in] device pointer to output device
+    @param [in] p_sample sample to check
+    @param [out] p_resident receives 1 if the data is resident, 0 if not
+    @returns SALERR_OK on success, @ref sal_error_e on failure
+    Samples that aren't lazy are always resident.
+*/
+sal_error_e
+SALx_is_sample_resident( SAL_Device *device,
+                         const SAL_Sample *p_sample,
+                         int *p_resident )
+{
+    _SALx_LazyState *p_lazy;
+
+    if ( device == 0 || p_sample == 0 || p_resident == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    _SAL_lock_device( device );
+
+    p_lazy = s_lazy_state( p_sample );
+    *p_resident = ( p_lazy == 0 || p_lazy->lz_resident != 0 );
+
+    _SAL_unlock_device( device );
+
+    return SALERR_OK;
+}
@@ -0,0 +1,64 @@
+/*
+Copyright (c) 2004, Brian Hook
+All rights reserved.
+
+http://www.bookofhook.com/sal
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+
+    * The names of this package'ss contributors contributors may not
+      be used to endorse or promote products derived from this
+      software without specific prior written permission.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/** @file salx_lazy.h
+    @brief SAL extra lazily loaded samples
+*/
+#ifndef SALX_LAZY_H
+#define SALX_LAZY_H
+
+#include "salx_loader.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+SAL_PUBLIC_API( sal_error_e ) SALx_create_lazy_sample( SAL_Device *device,
+                                                       SALx_Loader *p_loader,
+                                                       SAL_Sample **pp_sample,
+                                                       const char *kp_filename );
+SAL_PUBLIC_API( sal_error_e ) SALx_prefetch_sample( SAL_Device *device,
+                                                    SAL_Sample *p_sample );
+SAL_PUBLIC_API( sal_error_e ) SALx_evict_sample( SAL_Device *device,
+                                                 SAL_Sample *p_sample );
+SAL_PUBLIC_API( sal_error_e ) SALx_is_sample_resident( SAL_Device *device,
+                                                       const SAL_Sample *p_sample,
+                                                       int *p_resident );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SALX_LAZY_H */
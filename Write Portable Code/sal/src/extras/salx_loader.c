@@ -0,0 +1,699 @@
+/*
+Copyright (c) 2004, Brian Hook
+All rights reserved.
+
+http://www.bookofhook.com/sal
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+
+    * The names of this package'ss contributors contributors may not
+      be used to endorse or promote products derived from this
+      software without specific prior written permission.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/** @file salx_loader.c
+    @brief Asynchronous sample loading for the Simple Audio Library
+
+    A loader is a small pool of worker threads that read, parse and convert
+    sample files off the caller's thread.  SALx_load_sample_async() queues a
+    file and returns immediately with a handle.  The finished sample is
+    either handed to a completion callback, which runs on the worker thread
+    that did the load, or kept until the application picks it up with
+    SALx_poll_load().  Loads are started in the order they're queued, but
+    with more than one worker they can finish in any order.
+
+    Since workers call the device's allocation callbacks, those must be
+    thread safe (the default malloc/free callbacks are).  The loader never
+    takes the device lock while holding its own, so the polling and
+    queueing functions can be used from a sample decoder.
+*/
+#ifndef SAL_DOXYGEN
+#  define SAL_BUILDING_LIB 1
+#endif
+#include "../sal.h"
+#include "salx_loader.h"
+#include "salx_wave.h"
+
+#include <string.h>
+
+#define SALX_LOADER_DEFAULT_WORKERS   4     /**< default number of worker threads */
+#define SALX_LOADER_DEFAULT_MAX_LOADS 64    /**< default maximum number of outstanding loads */
+#define SALX_LOADER_IDLE_MS           5     /**< how long an idle worker sleeps before looking for work again */
+
+/** @internal
+    @brief State of a load slot */
+typedef enum
+{
+    SALX_LOAD_FREE,             /**< slot isn't in use */
+    SALX_LOAD_QUEUED,           /**< waiting for a worker */
+    SALX_LOAD_LOADING,          /**< a worker is loading it */
+    SALX_LOAD_DELIVERING,       /**< a worker is running its completion callback */
+    SALX_LOAD_DONE              /**< finished, waiting for SALx_poll_load */
+} _SALx_LoadState;
+
+/** @internal
+    @brief A single outstanding load */
+typedef struct
+{
+    sal_i32_t             ld_state;          /**< one of _SALx_LoadState */
+    sal_u32_t             ld_generation;     /**< bumped every time the slot is freed, so stale handles are caught */
+    sal_u32_t             ld_sequence;       /**< order the load was queued in */
+    int                   ld_cancelled;      /**< set when cancelled while a worker was loading it */
+    char                 *ld_filename;       /**< copy of the file name */
+    salx_load_callback_t  ld_callback;       /**< completion callback, may be NULL */
+    void                 *ld_user_data;      /**< passed to ld_callback */
+    SAL_Sample           *ld_sample;         /**< loaded sample, once done */
+    sal_error_e           ld_result;         /**< result of the load, once done */
+} _SALx_Load;
+
+/** @internal
+    @brief The loader */
+struct SALx_Loader_s
+{
+    SAL_Device      *ldr_device;           /**< device samples are created on */
+    sal_mutex_t      ldr_mutex;            /**< protects everything below */
+    _SALx_Load      *ldr_loads;            /**< table of load slots */
+    int              ldr_max_loads;        /**< number of entries in ldr_loads */
+    sal_u32_t        ldr_next_sequence;    /**< sequence number given to the next queued load */
+    salx_load_fnc_t  ldr_load_fnc;         /**< function that does the actual loading */
+    void            *ldr_load_arg;         /**< argument passed to ldr_load_fnc */
+    int              ldr_num_workers;      /**< number of worker threads still running */
+    int              ldr_kill_workers;     /**< set to 1 when the workers should exit */
+};
+
+/** @internal
+    @brief Default load function, which loads WAV files */
+static
+sal_error_e
+s_load_wave_file( SAL_Device *device, SAL_Sample **pp_sample, const char *kp_filename, void *load_arg )
+{
+    load_arg = load_arg;
+
+    return SALx_create_sample_from_wave_file( device, pp_sample, kp_filename );
+}
+
+/** @internal
+    @brief Returns the handle for a slot */
+static
+SALx_LoadHandle
+s_load_handle( SALx_Loader *p_loader, int index )
+{
+    return ( ( p_loader->ldr_loads[ index ].ld_generation & 0xFFFF ) << 16 ) | ( sal_u32_t ) ( index + 1 );
+}
+
+/** @internal
+    @brief Finds the slot a handle refers to
+    @returns pointer to the slot, or NULL if the handle is stale or invalid
+    @remarks Assumes the loader is locked.
+*/
+static
+_SALx_Load *
+s_find_load( SALx_Loader *p_loader, SALx_LoadHandle handle )
+{
+    int index = ( int ) ( handle & 0xFFFF ) - 1;
+
+    if ( index < 0 || index >= p_loader->ldr_max_loads ||
+         p_loader->ldr_loads[ index ].ld_state == SALX_LOAD_FREE ||
+         s_load_handle( p_loader, index ) != handle )
+    {
+        return 0;
+    }
+
+    return &p_loader->ldr_loads[ index ];
+}
+
+/** @internal
+    @brief Returns a slot to the free list, invalidating its handle
+    @remarks Assumes the loader is locked.
+*/
+static
+void
+s_free_load( SALx_Loader *p_loader, _SALx_Load *p_load )
+{
+    SAL_free( p_loader->ldr_device, p_load->ld_filename );
+
+    p_load->ld_filename = 0;
+    p_load->ld_sample   = 0;
+    p_load->ld_state    = SALX_LOAD_FREE;
+    p_load->ld_generation++;
+
+    /* generation 0 would let handle 0 be valid for slot 0 */
+    if ( ( p_load->ld_generation & 0xFFFF ) == 0 )
+    {
+        p_load->ld_generation++;
+    }
+}
+
+/** @internal
+    @brief Worker thread
+    Picks the oldest queued load, loads it without holding the loader's
+    lock, and then either delivers it to the callback or parks it for
+    SALx_poll_load.
+*/
+static
+void
+s_loader_thread( void *args )
+{
+    SALx_Loader *p_loader = ( SALx_Loader * ) args;
+    SAL_Device *device = p_loader->ldr_device;
+
+    while ( 1 )
+    {
+        int i;
+        int index = -1;
+        _SALx_Load *p_load;
+        SAL_Sample *p_sample = 0;
+        sal_error_e result;
+        SALx_LoadHandle handle;
+
+        _SAL_lock_mutex( device, p_loader->ldr_mutex );
+
+        /* time to quit? */
+        if ( p_loader->ldr_kill_workers )
+        {
+            p_loader->ldr_num_workers--;
+            _SAL_unlock_mutex( device, p_loader->ldr_mutex );
+            return;
+        }
+
+        for ( i = 0; i < p_loader->ldr_max_loads; i++ )
+        {
+            if ( p_loader->ldr_loads[ i ].ld_state == SALX_LOAD_QUEUED &&
+                 ( index < 0 || 
+                   ( sal_i32_t ) ( p_loader->ldr_loads[ i ].ld_sequence - p_loader->ldr_loads[ index ].ld_sequence ) < 0 ) )
+            {
+                index = i;
+            }
+        }
+
+        if ( index < 0 )
+        {
+            _SAL_unlock_mutex( device, p_loader->ldr_mutex );
+            SAL_sleep( device, SALX_LOADER_IDLE_MS );
+            continue;
+        }
+
+        p_load = &p_loader->ldr_loads[ index ];
+        p_load->ld_state = SALX_LOAD_LOADING;
+        handle = s_load_handle( p_loader, index );
+
+        _SAL_unlock_mutex( device, p_loader->ldr_mutex );
+
+        /* the slot's filename stays put while we're loading, since only we can free it now */
+        result = p_loader->ldr_load_fnc( device, &p_sample, p_load->ld_filename, p_loader->ldr_load_arg );
+
+        if ( result != SALERR_OK )
+        {
+            p_sample = 0;
+        }
+
+        _SAL_lock_mutex( device, p_loader->ldr_mutex );
+
+        if ( p_load->ld_cancelled )
+        {
+            /* samples are never destroyed with the loader locked, since that takes the device lock */
+            if ( p_sample )
+            {
+                _SAL_unlock_mutex( device, p_loader->ldr_mutex );
+                SAL_destroy_sample( device, p_sample );
+                _SAL_lock_mutex( device, p_loader->ldr_mutex );
+                p_sample = 0;
+            }
+            result = SALERR_CANCELLED;
+        }
+
+        if ( p_load->ld_callback )
+        {
+            salx_load_callback_t callback = p_load->ld_callback;
+            void *user_data = p_load->ld_user_data;
+
+            /* run the callback unlocked so it can queue more loads */
+            p_load->ld_state = SALX_LOAD_DELIVERING;
+            _SAL_unlock_mutex( device, p_loader->ldr_mutex );
+
+            callback( device, handle, p_sample, result, user_data );
+
+            _SAL_lock_mutex( device, p_loader->ldr_mutex );
+            s_free_load( p_loader, p_load );
+        }
+        else if ( p_load->ld_cancelled )
+        {
+            s_free_load( p_loader, p_load );
+        }
+        else
+        {
+            p_load->ld_sample = p_sample;
+            p_load->ld_result = result;
+            p_load->ld_state  = SALX_LOAD_DONE;
+        }
+
+        _SAL_unlock_mutex( device, p_loader->ldr_mutex );
+    }
+}
+
+/** Creates a loader, a pool of worker threads that load samples in the background.
+    @ingroup extras
+    @param [in] device pointer to output device
+    @param [out] pp_loader address of a pointer to store the new loader
+    @param [in] kp_params pointer to loader parameters, may be NULL to use the defaults
+    @returns SALERR_OK on success, @ref sal_error_e on failure
+*/
+sal_error_e
+SALx_create_loader( SAL_Device *device,
+                    SALx_Loader **pp_loader,
+                    const SALx_LoaderParams *kp_params )
+{
+    int i;
+    sal_error_e err;
+    SALx_Loader *p_loader = 0;
+    SALx_LoaderParams params;
+
+    if ( device == 0 || pp_loader == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    memset( &params, 0, sizeof( params ) );
+
+    if ( kp_params )
+    {
+        if ( kp_params->lp_size != sizeof( SALx_LoaderParams ) )
+        {
+            return SALERR_WRONGVERSION;
+        }
+        params = *kp_params;
+    }
+
+    params.lp_num_workers = ( params.lp_num_workers <= 0 ) ? SALX_LOADER_DEFAULT_WORKERS : params.lp_num_workers;
+    params.lp_max_loads   = ( params.lp_max_loads <= 0 ) ? SALX_LOADER_DEFAULT_MAX_LOADS : params.lp_max_loads;
+
+    /* handles only have room for a 16-bit index */
+    if ( params.lp_max_loads > 0xFFFF )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    if ( ( err = SAL_alloc( device, ( void ** ) &p_loader, sizeof( *p_loader ) ) ) != SALERR_OK )
+    {
+        return err;
+    }
+
+    memset( p_loader, 0, sizeof( *p_loader ) );
+
+    p_loader->ldr_device    = device;
+    p_loader->ldr_max_loads = params.lp_max_loads;
+    p_loader->ldr_load_fnc  = params.lp_load_fnc ? params.lp_load_fnc : s_load_wave_file;
+    p_loader->ldr_load_arg  = params.lp_load_arg;
+
+    if ( ( err = SAL_alloc( device, ( void ** ) &p_loader->ldr_loads, sizeof( _SALx_Load ) * params.lp_max_loads ) ) != SALERR_OK )
+    {
+        SAL_free( device, p_loader );
+        return err;
+    }
+
+    memset( p_loader->ldr_loads, 0, sizeof( _SALx_Load ) * params.lp_max_loads );
+
+    for ( i = 0; i < params.lp_max_loads; i++ )
+    {
+        p_loader->ldr_loads[ i ].ld_generation = 1;
+    }
+
+    if ( ( err = _SAL_create_mutex( device, &p_loader->ldr_mutex ) ) != SALERR_OK )
+    {
+        SAL_free( device, p_loader->ldr_loads );
+        SAL_free( device, p_loader );
+        return err;
+    }
+
+    for ( i = 0; i < params.lp_num_workers; i++ )
+    {
+        _SAL_lock_mutex( device, p_loader->ldr_mutex );
+        p_loader->ldr_num_workers++;
+        _SAL_unlock_mutex( device, p_loader->ldr_mutex );
+
+        if ( ( err = _SAL_create_thread( device, s_loader_thread, p_loader, 0 ) ) != SALERR_OK )
+        {
+            _SAL_lock_mutex( device, p_loader->ldr_mutex );
+            p_loader->ldr_num_workers--;
+            _SAL_unlock_mutex( device, p_loader->ldr_mutex );
+
+            SALx_destroy_loader( device, p_loader );
+            return err;
+        }
+    }
+
+    *pp_loader = p_loader;
+
+    return SALERR_OK;
+}
+
+/** Destroys a loader.
+    @ingroup extras
+    @param [in] device pointer to output device
+    @param [in] p_loader pointer to the loader to destroy
+    @returns SALERR_OK on success, @ref sal_error_e on failure
+    Loads that haven't started yet are cancelled, loads in progress are
+    waited for, and samples that were never picked up with SALx_poll_load
+    are destroyed.  Callbacks are made as usual, with SALERR_CANCELLED for
+    loads that never ran.
+*/
+sal_error_e
+SALx_destroy_loader( SAL_Device *device,
+                     SALx_Loader *p_loader )
+{
+    int i;
+
+    if ( device == 0 || p_loader == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    /* cancel everything that's still waiting, so the workers don't pick it up */
+    for ( i = 0; i < p_loader->ldr_max_loads; i++ )
+    {
+        SALx_LoadHandle handle;
+        int queued;
+
+        _SAL_lock_mutex( device, p_loader->ldr_mutex );
+        queued = ( p_loader->ldr_loads[ i ].ld_state == SALX_LOAD_QUEUED );
+        handle = s_load_handle( p_loader, i );
+        _SAL_unlock_mutex( device, p_loader->ldr_mutex );
+
+        if ( queued )
+        {
+            SALx_cancel_load( device, p_loader, handle );
+        }
+    }
+
+    /* ask the workers to exit once they're done with what they're doing, and wait for them */
+    _SAL_lock_mutex( device, p_loader->ldr_mutex );
+
+    p_loader->ldr_kill_workers = 1;
+
+    while ( p_loader->ldr_num_workers > 0 )
+    {
+        _SAL_unlock_mutex( device, p_loader->ldr_mutex );
+        SAL_sleep( device, SALX_LOADER_IDLE_MS );
+        _SAL_lock_mutex( device, p_loader->ldr_mutex );
+    }
+
+    _SAL_unlock_mutex( device, p_loader->ldr_mutex );
+
+    /* anything left is finished but unclaimed */
+    for ( i = 0; i < p_loader->ldr_max_loads; i++ )
+    {
+        _SALx_Load *p_load = &p_loader->ldr_loads[ i ];
+
+        if ( p_load->ld_state == SALX_LOAD_DONE && p_load->ld_sample )
+        {
+            SAL_destroy_sample( device, p_load->ld_sample );
+        }
+
+        SAL_free( device, p_load->ld_filename );
+    }
+
+    _SAL_destroy_mutex( device, p_loader->ldr_mutex );
+    SAL_free( device, p_loader->ldr_loads );
+    SAL_free( device, p_loader );
+
+    return SALERR_OK;
+}
+
+/** Queues a sample file to be loaded on one of a loader's worker threads.
+    @ingroup extras
+    @param [in] device pointer to output device
+    @param [in] p_loader loader that will do the loading
+    @param [in] kp_filename name of the file to load.  The string is copied.
+    @param [in] callback function called on the worker thread when the load finishes, may be NULL
+    @param [in] user_data passed through to callback
+    @param [out] p_handle receives a handle identifying the load, may be NULL if callback isn't
+    @retval SALERR_OK on success
+    @retval SALERR_OUTOFMEMORY if the loader already has lp_max_loads loads outstanding
+    @returns @ref sal_error_e on other failures
+    With a callback, the callback receives the sample and the handle stops
+    being valid once it returns.  Without one, the application must collect
+    the result with SALx_poll_load, which also releases the handle.
+*/
+sal_error_e
+SALx_load_sample_async( SAL_Device *device,
+                        SALx_Loader *p_loader,
+                        const char *kp_filename,
+                        salx_load_callback_t callback,
+                        void *user_data,
+                        SALx_LoadHandle *p_handle )
+{
+    int i;
+    sal_error_e err;
+    char *p_filename = 0;
+    _SALx_Load *p_load;
+    size_t length;
+
+    if ( p_handle )
+    {
+        *p_handle = SALX_INVALID_LOAD;
+    }
+
+    if ( device == 0 || p_loader == 0 || kp_filename == 0 || ( callback == 0 && p_handle == 0 ) )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    length = strlen( kp_filename ) + 1;
+
+    if ( ( err = SAL_alloc( device, ( void ** ) &p_filename, length ) ) != SALERR_OK )
+    {
+        return err;
+    }
+
+    memcpy( p_filename, kp_filename, length );
+
+    _SAL_lock_mutex( device, p_loader->ldr_mutex );
+
+    for ( i = 0; i < p_loader->ldr_max_loads; i++ )
+    {
+        if ( p_loader->ldr_loads[ i ].ld_state == SALX_LOAD_FREE )
+        {
+            break;
+        }
+    }
+
+    if ( i == p_loader->ldr_max_loads )
+    {
+        _SAL_unlock_mutex( device, p_loader->ldr_mutex );
+        SAL_free( device, p_filename );
+        return SALERR_OUTOFMEMORY;
+    }
+
+    p_load = &p_loader->ldr_loads[ i ];
+
+    p_load->ld_state     = SALX_LOAD_QUEUED;
+    p_load->ld_sequence  = p_loader->ldr_next_sequence++;
+    p_load->ld_cancelled = 0;
+    p_load->ld_filename  = p_filename;
+    p_load->ld_callback  = callback;
+    p_load->ld_user_data = user_data;
+    p_load->ld_sample    = 0;
+    p_load->ld_result    = SALERR_OK;
+
+    if ( p_handle )
+    {
+        *p_handle = s_load_handle( p_loader, i );
+    }
+
+    _SAL_unlock_mutex( device, p_loader->ldr_mutex );
+
+    return SALERR_OK;
+}
+
+/** Checks whether an asynchronous load without a callback has finished.
+    @ingroup extras
+    @param [in] device pointer to output device
+    @param [in] p_loader loader the load was queued on
+    @param [in] handle handle returned by SALx_load_sample_async
+    @param [out] pp_sample receives the loaded sample, or NULL if the load failed
+    @param [out] p_result receives the result of the load, may be NULL
+    @retval SALERR_OK if the load has finished.  The handle is no longer valid and the caller owns the sample.
+    @retval SALERR_INUSE if the load is still queued or in progress
+    @retval SALERR_INVALIDPARAM if the handle isn't valid, or belongs to a load with a callback
+*/
+sal_error_e
+SALx_poll_load( SAL_Device *device,
+                SALx_Loader *p_loader,
+                SALx_LoadHandle handle,
+                SAL_Sample **pp_sample,
+                sal_error_e *p_result )
+{
+    _SALx_Load *p_load;
+
+    if ( device == 0 || p_loader == 0 || pp_sample == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    *pp_sample = 0;
+
+    _SAL_lock_mutex( device, p_loader->ldr_mutex );
+
+    if ( ( p_load = s_find_load( p_loader, handle ) ) == 0 || p_load->ld_callback != 0 )
+    {
+        _SAL_unlock_mutex( device, p_loader->ldr_mutex );
+        return SALERR_INVALIDPARAM;
+    }
+
+    if ( p_load->ld_state != SALX_LOAD_DONE )
+    {
+        _SAL_unlock_mutex( device, p_loader->ldr_mutex );
+        return SALERR_INUSE;
+    }
+
+    *pp_sample = p_load->ld_sample;
+
+    if ( p_result )
+    {
+        *p_result = p_load->ld_result;
+    }
+
+    s_free_load( p_loader, p_load );
+
+    _SAL_unlock_mutex( device, p_loader->ldr_mutex );
+
+    return SALERR_OK;
+}
+
+/** @internal
+    @brief Shared body of SALx_cancel_load and _SALx_cancel_load_locked
+    @param[in] device_locked non-zero if the caller holds the device lock
+*/
+static
+sal_error_e
+s_cancel_load( SAL_Device *device,
+               SALx_Loader *p_loader,
+               SALx_LoadHandle handle,
+               int device_locked )
+{
+    _SALx_Load *p_load;
+    SAL_Sample *p_discard = 0;
+
+    if ( device == 0 || p_loader == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    _SAL_lock_mutex( device, p_loader->ldr_mutex );
+
+    if ( ( p_load = s_find_load( p_loader, handle ) ) == 0 || p_load->ld_cancelled )
+    {
+        _SAL_unlock_mutex( device, p_loader->ldr_mutex );
+        return SALERR_INVALIDPARAM;
+    }
+
+    switch ( p_load->ld_state )
+    {
+    case SALX_LOAD_QUEUED:
+        if ( p_load->ld_callback )
+        {
+            salx_load_callback_t callback = p_load->ld_callback;
+            void *user_data = p_load->ld_user_data;
+
+            /* keep the handle valid, but out of the workers' reach, until the callback returns */
+            p_load->ld_state     = SALX_LOAD_DELIVERING;
+            p_load->ld_cancelled = 1;
+            _SAL_unlock_mutex( device, p_loader->ldr_mutex );
+
+            callback( device, handle, 0, SALERR_CANCELLED, user_data );
+
+            _SAL_lock_mutex( device, p_loader->ldr_mutex );
+        }
+        s_free_load( p_loader, p_load );
+        break;
+
+    case SALX_LOAD_LOADING:
+        /* the worker cleans up when it's done */
+        p_load->ld_cancelled = 1;
+        break;
+
+    case SALX_LOAD_DONE:
+        p_discard = p_load->ld_sample;
+        s_free_load( p_loader, p_load );
+        break;
+
+    case SALX_LOAD_DELIVERING:
+    default:
+        _SAL_unlock_mutex( device, p_loader->ldr_mutex );
+        return SALERR_INUSE;
+    }
+
+    _SAL_unlock_mutex( device, p_loader->ldr_mutex );
+
+    if ( p_discard )
+    {
+        if ( device_locked )
+        {
+            _SAL_destroy_sample_locked( device, p_discard );
+        }
+        else
+        {
+            SAL_destroy_sample( device, p_discard );
+        }
+    }
+
+    return SALERR_OK;
+}
+
+/** Cancels an asynchronous load.
+    @ingroup extras
+    @param [in] device pointer to output device
+    @param [in] p_loader loader the load was queued on
+    @param [in] handle handle returned by SALx_load_sample_async
+    @retval SALERR_OK if the load was cancelled.  The handle is no longer valid.
+    @retval SALERR_INUSE if the load's callback is running right now
+    @retval SALERR_INVALIDPARAM if the handle isn't valid
+    A load that hasn't started is dropped right away.  One that's in
+    progress finishes on its worker, and the sample is then thrown away.
+    A finished load that hasn't been polled yet has its sample destroyed.
+    If the load has a callback it's still called, with SALERR_CANCELLED;
+    for a load that hadn't started it's called before this returns, on the
+    calling thread.
+*/
+sal_error_e
+SALx_cancel_load( SAL_Device *device,
+                  SALx_Loader *p_loader,
+                  SALx_LoadHandle handle )
+{
+    return s_cancel_load( device, p_loader, handle, 0 );
+}
+
+/** @internal
+    @brief SALx_cancel_load for callers that already hold the device lock
+    @remarks A load with a callback would have it called with the device
+    locked, so this is only meant for loads queued without one.
+*/
+sal_error_e
+_SALx_cancel_load_locked( SAL_Device *device,
+                          SALx_Loader *p_loader,
+                          SALx_LoadHandle handle )
+{
+    return s_cancel_load( device, p_loader, handle, 1 );
+}
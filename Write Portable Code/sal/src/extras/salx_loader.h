@@ -0,0 +1,108 @@
+/*
+Copyright (c) 2004, Brian Hook
+All rights reserved.
+
+http://www.bookofhook.com/sal
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+
+    * The names of this package'ss contributors contributors may not
+      be used to endorse or promote products derived from this
+      software without specific prior written permission.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/** @file salx_loader.h
+    @brief SAL extra asynchronous sample loading
+*/
+#ifndef SALX_LOADER_H
+#define SALX_LOADER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct SALx_Loader_s SALx_Loader; /**< opaque handle to a pool of sample loading threads */
+typedef sal_u32_t SALx_LoadHandle;        /**< identifies an outstanding asynchronous load */
+
+#define SALX_INVALID_LOAD 0               /**< never returned as a valid SALx_LoadHandle */
+
+/** Function a loader calls on a worker thread to turn a file into a sample.
+    SALx_create_sample_from_wave_file has this signature apart from load_arg.
+*/
+typedef sal_error_e (POSH_CDECL *salx_load_fnc_t)( SAL_Device *device, 
+                                                   SAL_Sample **pp_sample, 
+                                                   const char *kp_filename, 
+                                                   void *load_arg );
+
+/** Function called on a worker thread when an asynchronous load completes.
+    The callback owns p_sample and must eventually pass it to
+    SAL_destroy_sample.  result is SALERR_CANCELLED and p_sample is NULL
+    if the load was cancelled.
+*/
+typedef void (POSH_CDECL *salx_load_callback_t)( SAL_Device *device, 
+                                                 SALx_LoadHandle handle, 
+                                                 SAL_Sample *p_sample, 
+                                                 sal_error_e result, 
+                                                 void *user_data );
+
+/** @brief Parameters passed to SALx_create_loader.  Zeroed fields select the defaults.
+*/
+typedef struct SALx_LoaderParams
+{
+    sal_i32_t      lp_size;          /**< size of the parameters structure */
+    sal_i32_t      lp_num_workers;   /**< number of worker threads loading in parallel */
+    sal_i32_t      lp_max_loads;     /**< maximum number of loads that may be outstanding at once */
+    salx_load_fnc_t lp_load_fnc;     /**< function that loads a file, defaults to loading WAV files */
+    void          *lp_load_arg;      /**< argument passed through to lp_load_fnc */
+} SALx_LoaderParams;
+
+SAL_PUBLIC_API( sal_error_e ) SALx_create_loader( SAL_Device *device,
+                                                  SALx_Loader **pp_loader,
+                                                  const SALx_LoaderParams *kp_params );
+SAL_PUBLIC_API( sal_error_e ) SALx_destroy_loader( SAL_Device *device,
+                                                   SALx_Loader *p_loader );
+SAL_PUBLIC_API( sal_error_e ) SALx_load_sample_async( SAL_Device *device,
+                                                      SALx_Loader *p_loader,
+                                                      const char *kp_filename,
+                                                      salx_load_callback_t callback,
+                                                      void *user_data,
+                                                      SALx_LoadHandle *p_handle );
+SAL_PUBLIC_API( sal_error_e ) SALx_poll_load( SAL_Device *device,
+                                              SALx_Loader *p_loader,
+                                              SALx_LoadHandle handle,
+                                              SAL_Sample **pp_sample,
+                                              sal_error_e *p_result );
+SAL_PUBLIC_API( sal_error_e ) SALx_cancel_load( SAL_Device *device,
+                                                SALx_Loader *p_loader,
+                                                SALx_LoadHandle handle );
+SAL_PUBLIC_API( sal_error_e ) _SALx_cancel_load_locked( SAL_Device *device,
+                                                        SALx_Loader *p_loader,
+                                                        SALx_LoadHandle handle );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SALX_LOADER_H */
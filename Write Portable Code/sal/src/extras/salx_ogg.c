@@ -163,8 +163,8 @@ s_ogg_decoder( SAL_Device *p_device,
     big_endian = 1;
 #endif
 
-    SAL_get_voice_sample( p_device, voice, &sample );
-    SAL_get_voice_cursor( p_device, voice, &cursor );
+    _SAL_get_voice_sample_locked( p_device, voice, &sample );
+    _SAL_get_voice_cursor_locked( p_device, voice, &cursor );
 
     ogg_args = ( SALx_OggArgs * ) sample->sample_args.sarg_ptr;
 
@@ -217,6 +217,8 @@ s_ogg_destructor( SAL_Device *p_device,
     SALx_OggArgs *ogg_args = ( SALx_OggArgs * ) self->sample_args.sarg_ptr;
 
     ov_clear( &ogg_args->oa_file );
+    SAL_free( p_device, ogg_args->oa_buffer );
+    _SAL_pool_free_locked( p_device, ogg_args, sizeof( *ogg_args ) );
 }
 
 /** Creates a sample that decodes from an in-memory Ogg image.
@@ -251,9 +253,9 @@ SALx_create_sample_from_ogg( SAL_Device *device,
     SALx_OggArgs *p_ogg_args = 0;
     SAL_DeviceInfo dinfo;
 
-    if ( ( err = SAL_alloc( device, &p_ogg_args, sizeof( *p_ogg_args ) ) ) != SALERR_OK )
+    if ( ( p_ogg_args = ( SALx_OggArgs * ) _SAL_pool_alloc( device, sizeof( *p_ogg_args ) ) ) == 0 )
     {
-        return err;
+        return SALERR_OUTOFMEMORY;
     }
 
     memset( &dinfo, 0, sizeof( dinfo ) );
@@ -266,7 +268,7 @@ SALx_create_sample_from_ogg( SAL_Device *device,
 
     if ( ( err = SAL_alloc( device, &p_ogg_args->oa_buffer, src_size ) ) != SALERR_OK )
     {
-        SAL_free( device, p_ogg_args );
+        _SAL_pool_free( device, p_ogg_args, sizeof( *p_ogg_args ) );
         return err;
     }
     p_ogg_args->oa_size   = src_size;
@@ -276,13 +278,13 @@ SALx_create_sample_from_ogg( SAL_Device *device,
     
     if ( ( err = SAL_create_sample( device, &p_sample, 0, s_ogg_decoder, s_ogg_destructor, &args ) ) != SALERR_OK )
     {
-        SAL_free( device, p_ogg_args );
+        _SAL_pool_free( device, p_ogg_args, sizeof( *p_ogg_args ) );
         return err;
     }
 
     if ( ov_open_callbacks( p_ogg_args, &p_ogg_args->oa_file, NULL, 0, ogg_callbacks ) < 0 )
     {
-        SAL_free( device, p_ogg_args );
+        _SAL_pool_free( device, p_ogg_args, sizeof( *p_ogg_args ) );
         return SALERR_SYSTEMFAILURE;
     }
     
@@ -295,7 +297,7 @@ SALx_create_sample_from_ogg( SAL_Device *device,
          p_ogg_args->oa_num_channels != dinfo.di_channels )
     {
         ov_clear( &p_ogg_args->oa_file );
-        SAL_free( device, p_ogg_args );
+        _SAL_pool_free( device, p_ogg_args, sizeof( *p_ogg_args ) );
         return SALERR_INVALIDFORMAT;
     }
 
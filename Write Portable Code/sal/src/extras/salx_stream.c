@@ -0,0 +1,991 @@
+/*
+Copyright (c) 2004, Brian Hook
+All rights reserved.
+
+http://www.bookofhook.com/sal
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+
+    * The names of this package'ss contributors contributors may not
+      be used to endorse or promote products derived from this
+      software without specific prior written permission.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/** @file salx_stream.c
+    @brief Streaming sample support for the Simple Audio Library
+
+    Streaming samples don't keep their data in memory.  Instead a streamer
+    owns an I/O thread and a fixed pool of read-ahead blocks, and every
+    stream created on it gets its own slice of that pool.  The I/O thread
+    keeps each stream's blocks filled in playback order (wrapping at the
+    playing voice's loop end), while the stream's decoder simply copies out
+    of whichever block is at the head of the ring.  Resident memory per
+    stream is therefore blocks_per_stream x block_size no matter how long
+    the underlying file is.
+
+    Since a stream only has a single read position, a streaming sample can
+    only be played by one voice at a time.  Any other voice trying to play
+    it will just get silence.
+*/
+#ifndef SAL_DOXYGEN
+#  define SAL_BUILDING_LIB 1
+#endif
+#include "../sal.h"
+#include "salx_stream.h"
+#include "salx_stream_private.h"
+#include "salx_wave.h"
+
+#include <string.h>
+#include <stdio.h>
+
+#if defined POSH_OS_UNIX || defined POSH_OS_OSX
+#  define SALX_STREAM_PREAD 1
+#  include <sys/types.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+#define SALX_STREAM_DEFAULT_MAX_STREAMS 16          /**< default maximum number of streams per streamer */
+#define SALX_STREAM_DEFAULT_BLOCKS      4           /**< default number of read-ahead blocks per stream */
+#define SALX_STREAM_DEFAULT_BLOCK_SIZE  ( 64 * 1024 ) /**< default size of a read-ahead block, in bytes */
+#define SALX_STREAM_IDLE_MS             5           /**< how long the I/O thread sleeps when it has nothing to do */
+
+/** @internal
+    @brief Throws away all buffered data and restarts reading at a new position
+    @remarks Assumes the streamer is locked.  Reads that are in flight are
+    discarded when they complete, since their generation no longer matches.
+*/
+static
+void
+s_stream_flush( _SALx_Stream *p_stream, sal_i64_t position )
+{
+    int i;
+
+    p_stream->st_generation++;
+
+    for ( i = 0; i < p_stream->st_streamer->str_blocks_per_stream; i++ )
+    {
+        if ( p_stream->st_blocks[ i ].sb_state == SALX_BLOCK_FILLED )
+        {
+            p_stream->st_blocks[ i ].sb_state = SALX_BLOCK_EMPTY;
+        }
+    }
+
+    p_stream->st_head        = p_stream->st_tail;
+    p_stream->st_read_offset = position;
+}
+
+/** @internal
+    @brief Closes a stream's handle and frees it
+    @remarks Assumes the streamer is locked and that no reads are in flight.
+*/
+static
+void
+s_stream_release( _SALx_Stream *p_stream )
+{
+    SALx_Streamer *p_streamer = p_stream->st_streamer;
+
+    p_streamer->str_streams[ p_stream->st_slot ] = 0;
+    p_streamer->str_num_streams--;
+
+    if ( p_stream->st_io.sio_close )
+    {
+        p_stream->st_io.sio_close( p_stream->st_handle );
+    }
+
+    SAL_free( p_streamer->str_device, p_stream->st_blocks );
+    SAL_free( p_streamer->str_device, p_stream );
+}
+
+/** @internal
+    @brief Claims the next block of a stream for reading, if there's one to read
+    @returns 1 if p_req was filled in, 0 if the stream doesn't need anything
+    @remarks Assumes the streamer is locked.
+*/
+static
+int
+s_stream_plan( _SALx_Stream *p_stream, _SALx_StreamRequest *p_req )
+{
+    _SALx_StreamBlock *p_block = &p_stream->st_blocks[ p_stream->st_tail ];
+    sal_i64_t end;
+
+    if ( p_stream->st_closing || p_stream->st_error || p_block->sb_state != SALX_BLOCK_EMPTY )
+    {
+        return 0;
+    }
+
+    /* reads follow the voice around its loop */
+    if ( p_stream->st_read_offset >= p_stream->st_loop_end )
+    {
+        p_stream->st_read_offset = p_stream->st_loop_start;
+    }
+
+    /* blocks never straddle the loop end, so the decoder never has to advance past it */
+    end = p_stream->st_read_offset + p_stream->st_streamer->str_block_size;
+
+    if ( end > p_stream->st_loop_end )
+    {
+        end = p_stream->st_loop_end;
+    }
+
+    if ( end <= p_stream->st_read_offset )
+    {
+        return 0;
+    }
+
+    p_block->sb_state      = SALX_BLOCK_PENDING;
+    p_block->sb_offset     = p_stream->st_read_offset;
+    p_block->sb_bytes      = 0;
+    p_block->sb_generation = p_stream->st_generation;
+
+    p_req->sr_stream     = p_stream;
+    p_req->sr_block      = p_stream->st_tail;
+    p_req->sr_generation = p_stream->st_generation;
+    p_req->sr_offset     = p_stream->st_data_offset + p_stream->st_read_offset;
+    p_req->sr_bytes      = ( sal_i32_t ) ( end - p_stream->st_read_offset );
+    p_req->sr_result     = 0;
+
+    p_stream->st_read_offset = end;
+    p_stream->st_tail        = ( p_stream->st_tail + 1 ) % p_stream->st_streamer->str_blocks_per_stream;
+    p_stream->st_pending++;
+
+    return 1;
+}
+
+/** @internal
+    @brief Performs a read request synchronously, with pread() if the stream
+    has a file descriptor and the stream's I/O callbacks otherwise
+    @remarks Called without the streamer locked.  This is safe because a
+    stream with a read in flight is never freed, and the block being read
+    into belongs to the I/O thread until the request is committed.
+*/
+static
+void
+s_stream_read( _SALx_StreamRequest *p_req )
+{
+    _SALx_Stream *p_stream = p_req->sr_stream;
+    sal_byte_t *p_dst = p_stream->st_blocks[ p_req->sr_block ].sb_data;
+    int bytes_read = 0;
+
+#ifdef SALX_STREAM_PREAD
+    /* positioned reads don't touch the handle's file position at all */
+    if ( p_stream->st_fd >= 0 )
+    {
+        while ( bytes_read < p_req->sr_bytes )
+        {
+            ssize_t result = pread( p_stream->st_fd, 
+                                    p_dst + bytes_read, 
+                                    p_req->sr_bytes - bytes_read, 
+                                    ( off_t ) ( p_req->sr_offset + bytes_read ) );
+
+            if ( result <= 0 )
+            {
+                break;
+            }
+
+            bytes_read += ( int ) result;
+        }
+
+        p_req->sr_result = ( bytes_read > 0 ) ? bytes_read : -1;
+        return;
+    }
+#endif
+
+    if ( p_stream->st_io_position != p_req->sr_offset )
+    {
+        if ( p_stream->st_io.sio_seek( p_stream->st_handle, p_req->sr_offset ) != 0 )
+        {
+            p_stream->st_io_position = -1;
+            p_req->sr_result = -1;
+            return;
+        }
+        p_stream->st_io_position = p_req->sr_offset;
+    }
+
+    while ( bytes_read < p_req->sr_bytes )
+    {
+        int result = p_stream->st_io.sio_read( p_stream->st_handle, p_dst + bytes_read, p_req->sr_bytes - bytes_read );
+
+        if ( result <= 0 )
+        {
+            break;
+        }
+
+        bytes_read += result;
+    }
+
+    p_stream->st_io_position += bytes_read;
+    p_req->sr_result = ( bytes_read > 0 ) ? bytes_read : -1;
+}
+
+/** @internal
+    @brief Hands a completed read over to the decoder
+    @remarks Assumes the streamer is locked.
+*/
+static
+void
+s_stream_commit( _SALx_StreamRequest *p_req )
+{
+    _SALx_Stream *p_stream = p_req->sr_stream;
+    _SALx_StreamBlock *p_block = &p_stream->st_blocks[ p_req->sr_block ];
+    int bytes_per_sample = p_stream->st_streamer->str_device->device_info.di_bytes_per_sample;
+
+    p_stream->st_pending--;
+
+    if ( p_stream->st_closing )
+    {
+        p_block->sb_state = SALX_BLOCK_EMPTY;
+
+        if ( p_stream->st_pending == 0 )
+        {
+            s_stream_release( p_stream );
+        }
+        return;
+    }
+
+    /* the decoder moved on while we were reading */
+    if ( p_req->sr_generation != p_stream->st_generation )
+    {
+        p_block->sb_state = SALX_BLOCK_EMPTY;
+        return;
+    }
+
+    if ( p_req->sr_result < p_req->sr_bytes )
+    {
+        p_stream->st_error = 1;
+    }
+
+    if ( p_req->sr_result <= 0 )
+    {
+        p_block->sb_state = SALX_BLOCK_EMPTY;
+        return;
+    }
+
+    p_block->sb_bytes = p_req->sr_result - ( p_req->sr_result % bytes_per_sample );
+    p_block->sb_state = ( p_block->sb_bytes > 0 ) ? SALX_BLOCK_FILLED : SALX_BLOCK_EMPTY;
+}
+
+/** @internal
+    @brief The streamer's I/O thread
+    Each pass claims every empty block of every stream, then reads them.
+    With io_uring all the reads on file descriptors go to the kernel as a
+    single batch, so the disk sees them concurrently; the rest are read one
+    at a time and handed over to their decoders as soon as each completes.
+    When every stream's read-ahead is full the thread sleeps for a little
+    while.
+*/
+static
+void
+s_streamer_thread( void *args )
+{
+    SALx_Streamer *p_streamer = ( SALx_Streamer * ) args;
+    SAL_Device *device = p_streamer->str_device;
+    _SALx_StreamRequest *p_reqs = p_streamer->str_requests;
+
+    while ( 1 )
+    {
+        int i;
+        int num_reqs = 0;
+        int num_async = 0;
+
+        _SAL_lock_mutex( device, p_streamer->str_mutex );
+
+        /* time to quit? */
+        if ( p_streamer->str_kill_thread )
+        {
+            p_streamer->str_kill_thread = 0;
+            _SAL_unlock_mutex( device, p_streamer->str_mutex );
+            return;
+        }
+
+        for ( i = 0; i < p_streamer->str_max_streams; i++ )
+        {
+            _SALx_Stream *p_stream = p_streamer->str_streams[ ( p_streamer->str_next_slot + i ) % p_streamer->str_max_streams ];
+
+            if ( p_stream == 0 )
+            {
+                continue;
+            }
+
+            while ( num_reqs < p_streamer->str_max_requests && s_stream_plan( p_stream, &p_reqs[ num_reqs ] ) )
+            {
+                num_reqs++;
+            }
+        }
+
+        /* whoever was first this time goes last next time */
+        p_streamer->str_next_slot = ( p_streamer->str_next_slot + 1 ) % p_streamer->str_max_streams;
+
+        _SAL_unlock_mutex( device, p_streamer->str_mutex );
+
+        if ( num_reqs == 0 )
+        {
+            SAL_sleep( device, SALX_STREAM_IDLE_MS );
+            continue;
+        }
+
+#ifdef SALX_STREAM_URING
+        /* move the requests io_uring can handle to the front and submit them in one go */
+        if ( p_streamer->str_uring )
+        {
+            for ( i = 0; i < num_reqs; i++ )
+            {
+                if ( p_reqs[ i ].sr_stream->st_fd >= 0 )
+                {
+                    _SALx_StreamRequest tmp = p_reqs[ num_async ];
+
+                    p_reqs[ num_async++ ] = p_reqs[ i ];
+                    p_reqs[ i ] = tmp;
+                }
+            }
+
+            if ( num_async > 0 )
+            {
+                _SALx_uring_read( p_streamer, p_reqs, num_async );
+
+                _SAL_lock_mutex( device, p_streamer->str_mutex );
+                for ( i = 0; i < num_async; i++ )
+                {
+                    s_stream_commit( &p_reqs[ i ] );
+                }
+                _SAL_unlock_mutex( device, p_streamer->str_mutex );
+            }
+        }
+#endif
+
+        for ( i = num_async; i < num_reqs; i++ )
+        {
+            s_stream_read( &p_reqs[ i ] );
+
+            _SAL_lock_mutex( device, p_streamer->str_mutex );
+            s_stream_commit( &p_reqs[ i ] );
+            _SAL_unlock_mutex( device, p_streamer->str_mutex );
+        }
+    }
+}
+
+/** @internal
+    @brief Decoder callback for streaming samples
+    @param[in] p_device pointer to output device
+    @param[in] voice voice that is being decoded
+    @param[out] p_dst destination buffer for decoding
+    @param[in] bytes_needed number of bytes we need to decode
+    @returns 1 if the voice has ended, 0 if not
+    Copies data out of the blocks at the head of the stream's ring.  If the
+    voice's cursor isn't where the read-ahead expected it to be (the voice
+    was restarted or its loop points changed) the buffered data is flushed
+    and reading restarts at the cursor.  When there isn't enough data
+    buffered the remainder is filled with silence and the cursor is left
+    alone, so the voice resumes where it starved.  Each dropout posts one
+    @ref SALVE_STARVED event for the voice.
+*/
+static
+int
+s_stream_decoder( SAL_Device *p_device, 
+                  sal_voice_t voice,
+                  sal_byte_t *p_dst, 
+                  int bytes_needed )
+{
+    SAL_Sample *sample = 0;
+    SAL_Voice *p_voice = &p_device->device_voices[ voice ];
+    _SALx_Stream *p_stream;
+    SALx_Streamer *p_streamer;
+    int bytes_per_sample = p_device->device_info.di_bytes_per_sample;
+    int silence = ( p_device->device_info.di_bits == 8 ) ? 0x80 : 0;
+    sal_i64_t loop_start, loop_end;
+    int voice_ended = 0;
+
+    _SAL_get_voice_sample_locked( p_device, voice, &sample );
+
+    p_stream   = ( _SALx_Stream * ) sample->sample_args.sarg_ptr;
+    p_streamer = p_stream->st_streamer;
+
+    _SAL_lock_mutex( p_device, p_streamer->str_mutex );
+
+    /* only one voice at a time can own the stream's read position */
+    if ( p_stream->st_voice != voice )
+    {
+        if ( p_stream->st_voice != SAL_INVALID_SOUND &&
+             p_device->device_voices[ p_stream->st_voice ].voice_sample == sample )
+        {
+            _SAL_unlock_mutex( p_device, p_streamer->str_mutex );
+            memset( p_dst, silence, bytes_needed );
+            return 0;
+        }
+
+        p_stream->st_voice    = voice;
+        p_stream->st_starving = 0;
+    }
+
+    /* keep the read-ahead in step with the voice's loop */
+    loop_start = ( sal_i64_t ) p_voice->voice_loop_start * bytes_per_sample;
+    loop_end   = ( sal_i64_t ) p_voice->voice_loop_end * bytes_per_sample;
+
+    if ( loop_end == 0 || loop_end > p_stream->st_data_size )
+    {
+        loop_end = p_stream->st_data_size;
+    }
+
+    if ( loop_start != p_stream->st_loop_start || loop_end != p_stream->st_loop_end )
+    {
+        p_stream->st_loop_start = loop_start;
+        p_stream->st_loop_end   = loop_end;
+        s_stream_flush( p_stream, ( sal_i64_t ) p_voice->voice_cursor * bytes_per_sample );
+    }
+
+    while ( bytes_needed > 0 )
+    {
+        _SALx_StreamBlock *p_block = &p_stream->st_blocks[ p_stream->st_head ];
+        sal_i64_t position = ( sal_i64_t ) p_voice->voice_cursor * bytes_per_sample;
+        int bytes;
+
+        if ( p_block->sb_state != SALX_BLOCK_FILLED )
+        {
+            /* a stream that can't be read any further ends its voice once drained */
+            if ( p_stream->st_error && p_stream->st_pending == 0 )
+            {
+                voice_ended = 1;
+            }
+            break;
+        }
+
+        if ( position < p_block->sb_offset || position >= p_block->sb_offset + p_block->sb_bytes )
+        {
+            s_stream_flush( p_stream, position );
+            break;
+        }
+
+        bytes = ( int ) ( p_block->sb_offset + p_block->sb_bytes - position );
+        bytes = ( bytes > bytes_needed ) ? bytes_needed : bytes;
+
+        memcpy( p_dst, p_block->sb_data + ( position - p_block->sb_offset ), bytes );
+        p_dst        += bytes;
+        bytes_needed -= bytes;
+
+        /* done with this block, so hand it back to the I/O thread */
+        if ( position + bytes == p_block->sb_offset + p_block->sb_bytes )
+        {
+            p_block->sb_state = SALX_BLOCK_EMPTY;
+            p_stream->st_head = ( p_stream->st_head + 1 ) % p_streamer->str_blocks_per_stream;
+        }
+
+        if ( !_SAL_advance_voice( p_device, voice, bytes / bytes_per_sample ) )
+        {
+            voice_ended = 1;
+            break;
+        }
+    }
+
+    if ( bytes_needed > 0 && !voice_ended )
+    {
+        p_stream->st_starved++;
+
+        if ( !p_stream->st_starving )
+        {
+            p_stream->st_starving = 1;
+            _SAL_post_voice_event( p_device, voice, SALVE_STARVED );
+        }
+    }
+    else
+    {
+        p_stream->st_starving = 0;
+    }
+
+    if ( voice_ended )
+    {
+        p_stream->st_voice = SAL_INVALID_SOUND;
+    }
+
+    _SAL_unlock_mutex( p_device, p_streamer->str_mutex );
+
+    if ( bytes_needed > 0 )
+    {
+        memset( p_dst, silence, bytes_needed );
+    }
+
+    return voice_ended;
+}
+
+/** @internal
+    @brief Removes a stream from its streamer
+    If the I/O thread is in the middle of reading for this stream, it's left
+    to the thread to release the stream once the read completes.
+*/
+static
+void
+s_stream_unregister( SAL_Device *p_device, 
+                     _SALx_Stream *p_stream )
+{
+    SALx_Streamer *p_streamer = p_stream->st_streamer;
+
+    _SAL_lock_mutex( p_device, p_streamer->str_mutex );
+
+    if ( p_stream->st_pending > 0 )
+    {
+        p_stream->st_closing = 1;
+    }
+    else
+    {
+        s_stream_release( p_stream );
+    }
+
+    _SAL_unlock_mutex( p_device, p_streamer->str_mutex );
+}
+
+/** @internal
+    @brief Destruction callback for streaming samples
+*/
+static
+void
+s_stream_destroy( SAL_Device *p_device, 
+                  SAL_Sample *self )
+{
+    s_stream_unregister( p_device, ( _SALx_Stream * ) self->sample_args.sarg_ptr );
+}
+
+/** @internal
+    @brief Frees a streamer and everything it allocated, except its mutex
+*/
+static
+void
+s_streamer_free( SALx_Streamer *p_streamer )
+{
+    SAL_Device *device = p_streamer->str_device;
+
+#ifdef SALX_STREAM_URING
+    if ( p_streamer->str_uring )
+    {
+        _SALx_uring_destroy( p_streamer );
+    }
+#endif
+
+    SAL_free( device, p_streamer->str_pool );
+    SAL_free( device, p_streamer->str_requests );
+    SAL_free( device, p_streamer->str_streams );
+    SAL_free( device, p_streamer );
+}
+
+/** Creates a streamer, which services streaming samples with an I/O thread.
+    @ingroup extras
+    @param [in] device pointer to output device
+    @param [out] pp_streamer address of a pointer to store the new streamer
+    @param [in] kp_params pointer to streamer parameters, may be NULL to use the defaults
+    @returns SALERR_OK on success, @ref sal_error_e on failure
+    The streamer allocates its whole buffer pool up front, max_streams x
+    blocks_per_stream x block_size bytes, so creating and destroying streams
+    afterwards never allocates block memory.
+    @remarks On Linux, when built with SALX_SUPPORT_IO_URING and running on
+    a kernel that supports it, streams backed by file descriptors are read
+    through io_uring, with the buffer pool registered with the kernel.
+    Otherwise they're read with pread().
+*/
+sal_error_e
+SALx_create_streamer( SAL_Device *device,
+                      SALx_Streamer **pp_streamer,
+                      const SALx_StreamerParams *kp_params )
+{
+    sal_error_e err;
+    SALx_Streamer *p_streamer = 0;
+    SALx_StreamerParams params;
+
+    if ( device == 0 || pp_streamer == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    memset( &params, 0, sizeof( params ) );
+
+    if ( kp_params )
+    {
+        if ( kp_params->stp_size != sizeof( SALx_StreamerParams ) )
+        {
+            return SALERR_WRONGVERSION;
+        }
+        params = *kp_params;
+    }
+
+    params.stp_max_streams       = ( params.stp_max_streams <= 0 ) ? SALX_STREAM_DEFAULT_MAX_STREAMS : params.stp_max_streams;
+    params.stp_blocks_per_stream = ( params.stp_blocks_per_stream <= 1 ) ? SALX_STREAM_DEFAULT_BLOCKS : params.stp_blocks_per_stream;
+    params.stp_block_size        = ( params.stp_block_size <= 0 ) ? SALX_STREAM_DEFAULT_BLOCK_SIZE : params.stp_block_size;
+
+    /* keep blocks a whole number of frames for any device format */
+    params.stp_block_size &= ~63;
+
+    if ( params.stp_block_size == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    if ( ( err = SAL_alloc( device, ( void ** ) &p_streamer, sizeof( *p_streamer ) ) ) != SALERR_OK )
+    {
+        return err;
+    }
+
+    memset( p_streamer, 0, sizeof( *p_streamer ) );
+
+    p_streamer->str_device            = device;
+    p_streamer->str_max_streams       = params.stp_max_streams;
+    p_streamer->str_blocks_per_stream = params.stp_blocks_per_stream;
+    p_streamer->str_block_size        = params.stp_block_size;
+    p_streamer->str_max_requests      = params.stp_max_streams * params.stp_blocks_per_stream;
+
+    if ( ( err = SAL_alloc( device, ( void ** ) &p_streamer->str_streams, sizeof( _SALx_Stream * ) * params.stp_max_streams ) ) != SALERR_OK ||
+         ( err = SAL_alloc( device, ( void ** ) &p_streamer->str_requests, sizeof( _SALx_StreamRequest ) * p_streamer->str_max_requests ) ) != SALERR_OK ||
+         ( err = SAL_alloc( device, 
+                            ( void ** ) &p_streamer->str_pool, 
+                            ( size_t ) params.stp_max_streams * params.stp_blocks_per_stream * params.stp_block_size ) ) != SALERR_OK )
+    {
+        s_streamer_free( p_streamer );
+        return err;
+    }
+
+    memset( p_streamer->str_streams, 0, sizeof( _SALx_Stream * ) * params.stp_max_streams );
+
+#ifdef SALX_STREAM_URING
+    /* io_uring is purely an optimization, so if the kernel doesn't have it we quietly read synchronously */
+    if ( !( params.stp_flags & SALX_STREAMERF_NO_IO_URING ) )
+    {
+        _SALx_uring_create( p_streamer );
+    }
+#endif
+
+    if ( ( err = _SAL_create_mutex( device, &p_streamer->str_mutex ) ) != SALERR_OK )
+    {
+        s_streamer_free( p_streamer );
+        return err;
+    }
+
+    if ( ( err = _SAL_create_thread( device, s_streamer_thread, p_streamer, 0 ) ) != SALERR_OK )
+    {
+        _SAL_destroy_mutex( device, p_streamer->str_mutex );
+        s_streamer_free( p_streamer );
+        return err;
+    }
+
+    *pp_streamer = p_streamer;
+
+    return SALERR_OK;
+}
+
+/** Destroys a streamer.
+    @ingroup extras
+    @param [in] device pointer to output device
+    @param [in] p_streamer pointer to the streamer to destroy
+    @retval SALERR_OK on success
+    @retval SALERR_INUSE if streaming samples created on this streamer still exist
+*/
+sal_error_e
+SALx_destroy_streamer( SAL_Device *device,
+                       SALx_Streamer *p_streamer )
+{
+    if ( device == 0 || p_streamer == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    _SAL_lock_mutex( device, p_streamer->str_mutex );
+
+    if ( p_streamer->str_num_streams > 0 )
+    {
+        _SAL_unlock_mutex( device, p_streamer->str_mutex );
+        return SALERR_INUSE;
+    }
+
+    /* ask the I/O thread to exit and wait until it has */
+    p_streamer->str_kill_thread = 1;
+
+    while ( p_streamer->str_kill_thread )
+    {
+        _SAL_unlock_mutex( device, p_streamer->str_mutex );
+        SAL_sleep( device, SALX_STREAM_IDLE_MS );
+        _SAL_lock_mutex( device, p_streamer->str_mutex );
+    }
+
+    _SAL_unlock_mutex( device, p_streamer->str_mutex );
+
+    _SAL_destroy_mutex( device, p_streamer->str_mutex );
+    s_streamer_free( p_streamer );
+
+    return SALERR_OK;
+}
+
+/** Creates a sample that streams its PCM data through user I/O callbacks.
+    @ingroup extras
+    @param [in] device pointer to output device
+    @param [in] p_streamer streamer that will service the new sample
+    @param [out] pp_sample address of a pointer to a sample to store the new sample
+    @param [in] kp_io pointer to the I/O callbacks used to read the data.  The contents are copied.
+    @param [in] io_handle handle passed to the I/O callbacks
+    @param [in] data_offset offset of the PCM data within the handle, in bytes
+    @param [in] data_size size of the PCM data, in bytes
+    @retval SALERR_OK on success
+    @retval SALERR_OUTOFMEMORY if the streamer has no free slots left
+    @returns @ref sal_error_e on other failures
+    The data must already be in the device's format.  Once created, the
+    sample owns io_handle and closes it through the sio_close callback when
+    it is destroyed, including when this function fails.
+*/
+sal_error_e
+SALx_create_sample_from_stream( SAL_Device *device,
+                                SALx_Streamer *p_streamer,
+                                SAL_Sample **pp_sample,
+                                const SALx_StreamIO *kp_io,
+                                void *io_handle,
+                                sal_i64_t data_offset,
+                                sal_i64_t data_size )
+{
+    int i;
+    int slot;
+    sal_error_e err;
+    _SALx_Stream *p_stream = 0;
+    SAL_SampleArgs args;
+    SAL_DeviceInfo dinfo;
+
+    if ( device == 0 || p_streamer == 0 || pp_sample == 0 || kp_io == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    *pp_sample = 0;
+
+    if ( kp_io->sio_size != sizeof( SALx_StreamIO ) || kp_io->sio_read == 0 || kp_io->sio_seek == 0 ||
+         data_offset < 0 || data_size <= 0 )
+    {
+        if ( kp_io->sio_close )
+        {
+            kp_io->sio_close( io_handle );
+        }
+        return ( kp_io->sio_size != sizeof( SALx_StreamIO ) ) ? SALERR_WRONGVERSION : SALERR_INVALIDPARAM;
+    }
+
+    memset( &dinfo, 0, sizeof( dinfo ) );
+    dinfo.di_size = sizeof( dinfo );
+    SAL_get_device_info( device, &dinfo );
+
+    /* trim off any partial frame at the end */
+    data_size -= data_size % dinfo.di_bytes_per_frame;
+
+    if ( ( err = SAL_alloc( device, ( void ** ) &p_stream, sizeof( *p_stream ) ) ) != SALERR_OK )
+    {
+        if ( kp_io->sio_close )
+        {
+            kp_io->sio_close( io_handle );
+        }
+        return err;
+    }
+
+    memset( p_stream, 0, sizeof( *p_stream ) );
+
+    if ( ( err = SAL_alloc( device, ( void ** ) &p_stream->st_blocks, sizeof( _SALx_StreamBlock ) * p_streamer->str_blocks_per_stream ) ) != SALERR_OK )
+    {
+        SAL_free( device, p_stream );
+        if ( kp_io->sio_close )
+        {
+            kp_io->sio_close( io_handle );
+        }
+        return err;
+    }
+
+    memset( p_stream->st_blocks, 0, sizeof( _SALx_StreamBlock ) * p_streamer->str_blocks_per_stream );
+
+    p_stream->st_streamer    = p_streamer;
+    p_stream->st_io          = *kp_io;
+    p_stream->st_handle      = io_handle;
+    p_stream->st_data_offset = data_offset;
+    p_stream->st_data_size   = data_size;
+    p_stream->st_io_position = -1;
+    p_stream->st_fd          = ( kp_io->sio_get_fd ) ? kp_io->sio_get_fd( io_handle ) : -1;
+    p_stream->st_loop_start  = 0;
+    p_stream->st_loop_end    = data_size;
+    p_stream->st_voice       = SAL_INVALID_SOUND;
+
+    /* grab a slot, and with it a slice of the buffer pool */
+    _SAL_lock_mutex( device, p_streamer->str_mutex );
+
+    for ( slot = 0; slot < p_streamer->str_max_streams; slot++ )
+    {
+        if ( p_streamer->str_streams[ slot ] == 0 )
+        {
+            break;
+        }
+    }
+
+    if ( slot == p_streamer->str_max_streams )
+    {
+        _SAL_unlock_mutex( device, p_streamer->str_mutex );
+
+        SAL_free( device, p_stream->st_blocks );
+        SAL_free( device, p_stream );
+        if ( kp_io->sio_close )
+        {
+            kp_io->sio_close( io_handle );
+        }
+        return SALERR_OUTOFMEMORY;
+    }
+
+    p_stream->st_slot = slot;
+
+    for ( i = 0; i < p_streamer->str_blocks_per_stream; i++ )
+    {
+        p_stream->st_blocks[ i ].sb_data  = p_streamer->str_pool + ( ( size_t ) slot * p_streamer->str_blocks_per_stream + i ) * p_streamer->str_block_size;
+        p_stream->st_blocks[ i ].sb_state = SALX_BLOCK_EMPTY;
+    }
+
+    /* once it's in the table the I/O thread starts filling it */
+    p_streamer->str_streams[ slot ] = p_stream;
+    p_streamer->str_num_streams++;
+
+    _SAL_unlock_mutex( device, p_streamer->str_mutex );
+
+    args.sarg_ptr = p_stream;
+
+    if ( ( err = SAL_create_sample( device, pp_sample, 0, s_stream_decoder, s_stream_destroy, &args ) ) != SALERR_OK )
+    {
+        s_stream_unregister( device, p_stream );
+        return err;
+    }
+
+    (*pp_sample)->sample_num_samples = ( sal_i32_t ) ( data_size / dinfo.di_bytes_per_sample );
+
+    return SALERR_OK;
+}
+
+/** @internal
+    @brief stdio read callback used by SALx_create_sample_from_wave_stream */
+static
+int
+s_file_read( void *handle, void *p_dst, int bytes )
+{
+    size_t result = fread( p_dst, 1, bytes, ( FILE * ) handle );
+
+    if ( result == 0 && ferror( ( FILE * ) handle ) )
+    {
+        return -1;
+    }
+
+    return ( int ) result;
+}
+
+/** @internal
+    @brief stdio seek callback used by SALx_create_sample_from_wave_stream */
+static
+int
+s_file_seek( void *handle, sal_i64_t offset )
+{
+    return fseek( ( FILE * ) handle, ( long ) offset, SEEK_SET );
+}
+
+/** @internal
+    @brief stdio close callback used by SALx_create_sample_from_wave_stream */
+static
+void
+s_file_close( void *handle )
+{
+    fclose( ( FILE * ) handle );
+}
+
+#ifdef SALX_STREAM_PREAD
+/** @internal
+    @brief Lets the streamer pread() straight from the file underneath the FILE */
+static
+int
+s_file_get_fd( void *handle )
+{
+    return fileno( ( FILE * ) handle );
+}
+#endif
+
+/** Creates a sample that streams a WAV file from disk.
+    @ingroup extras
+    @param [in] device pointer to output device
+    @param [in] p_streamer streamer that will service the new sample
+    @param [out] pp_sample address of a pointer to a sample to store the new sample
+    @param [in] kp_filename name of the WAV file to stream
+    @returns SALERR_OK on success, @ref sal_error_e on failure
+    Only the WAV header is read up front.  Since no conversion is done on
+    the fly, the file must match the device's channels, bits per sample and
+    sample rate, otherwise SALERR_INVALIDFORMAT is returned.
+*/
+sal_error_e
+SALx_create_sample_from_wave_stream( SAL_Device *device,
+                                     SALx_Streamer *p_streamer,
+                                     SAL_Sample **pp_sample,
+                                     const char *kp_filename )
+{
+    FILE *fp = 0;
+    int header_size;
+    sal_byte_t header[ 64 ];
+    sal_error_e err;
+    SALx_WaveInfo info;
+    SAL_DeviceInfo dinfo;
+    SALx_StreamIO io;
+
+    if ( device == 0 || p_streamer == 0 || pp_sample == 0 || kp_filename == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    if ( ( fp = fopen( kp_filename, "rb" ) ) == 0 )
+    {
+        _SAL_warning( device, "Could not open %s\n", kp_filename );
+        return SALERR_SYSTEMFAILURE;
+    }
+
+    header_size = ( int ) fread( header, 1, sizeof( header ), fp );
+
+    if ( ( err = SALx_get_wave_info( header, header_size, &info ) ) != SALERR_OK )
+    {
+        fclose( fp );
+        return err;
+    }
+
+    memset( &dinfo, 0, sizeof( dinfo ) );
+    dinfo.di_size = sizeof( dinfo );
+    SAL_get_device_info( device, &dinfo );
+
+    if ( info.wi_channels != dinfo.di_channels ||
+         info.wi_bits != dinfo.di_bits ||
+         info.wi_sample_rate != dinfo.di_sample_rate 
+#ifdef POSH_BIG_ENDIAN
+         || info.wi_bits != 8
+#endif
+       )
+    {
+        _SAL_warning( device, "%s does not match the device's format and cannot be streamed\n", kp_filename );
+        fclose( fp );
+        return SALERR_INVALIDFORMAT;
+    }
+
+    memset( &io, 0, sizeof( io ) );
+    io.sio_size  = sizeof( io );
+    io.sio_read  = s_file_read;
+    io.sio_seek  = s_file_seek;
+    io.sio_close = s_file_close;
+#ifdef SALX_STREAM_PREAD
+    io.sio_get_fd = s_file_get_fd;
+#endif
+
+    return SALx_create_sample_from_stream( device, p_streamer, pp_sample, &io, fp, info.wi_data_offset, info.wi_data_size );
+}
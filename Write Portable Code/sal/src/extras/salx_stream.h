@@ -0,0 +1,98 @@
+/*
+Copyright (c) 2004, Brian Hook
+All rights reserved.
+
+http://www.bookofhook.com/sal
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+
+    * The names of this package'ss contributors contributors may not
+      be used to endorse or promote products derived from this
+      software without specific prior written permission.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/** @file salx_stream.h
+    @brief SAL extra streaming sample support
+*/
+#ifndef SALX_STREAM_H
+#define SALX_STREAM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief I/O callbacks a streaming sample uses to pull its data from wherever it lives
+*/
+typedef struct SALx_StreamIO
+{
+    sal_i32_t sio_size;                                                    /**< size of the I/O structure */
+
+    int  (POSH_CDECL *sio_read)( void *handle, void *p_dst, int bytes );  /**< reads up to bytes bytes, returning the number read, 0 at end of file or < 0 on error */
+    int  (POSH_CDECL *sio_seek)( void *handle, sal_i64_t offset );        /**< seeks to an absolute byte offset, returning 0 on success */
+    void (POSH_CDECL *sio_close)( void *handle );                         /**< closes the handle when the sample is destroyed, may be NULL */
+    int  (POSH_CDECL *sio_get_fd)( void *handle );                        /**< returns a POSIX file descriptor the streamer may pread() from directly, or -1.  May be NULL. */
+} SALx_StreamIO;
+
+/** flags for SALx_StreamerParams::stp_flags */
+typedef enum
+{
+    SALX_STREAMERF_NO_IO_URING = 0x0001     /**< never use io_uring, even where it's supported */
+} salx_streamer_flags_e;
+
+/** @brief Parameters passed to SALx_create_streamer.  Zeroed fields select the defaults.
+*/
+typedef struct SALx_StreamerParams
+{
+    sal_i32_t stp_size;              /**< size of the parameters structure */
+    sal_i32_t stp_max_streams;       /**< maximum number of streaming samples that may exist at once */
+    sal_i32_t stp_blocks_per_stream; /**< number of read-ahead blocks buffered for each stream */
+    sal_i32_t stp_block_size;        /**< size of each read-ahead block, in bytes */
+    sal_u32_t stp_flags;             /**< combination of @ref salx_streamer_flags_e values */
+} SALx_StreamerParams;
+
+typedef struct SALx_Streamer_s SALx_Streamer; /**< opaque handle to the I/O service that feeds streaming samples */
+
+SAL_PUBLIC_API( sal_error_e ) SALx_create_streamer( SAL_Device *device,
+                                                    SALx_Streamer **pp_streamer,
+                                                    const SALx_StreamerParams *kp_params );
+SAL_PUBLIC_API( sal_error_e ) SALx_destroy_streamer( SAL_Device *device,
+                                                     SALx_Streamer *p_streamer );
+SAL_PUBLIC_API( sal_error_e ) SALx_create_sample_from_stream( SAL_Device *device,
+                                                              SALx_Streamer *p_streamer,
+                                                              SAL_Sample **pp_sample,
+                                                              const SALx_StreamIO *kp_io,
+                                                              void *io_handle,
+                                                              sal_i64_t data_offset,
+                                                              sal_i64_t data_size );
+SAL_PUBLIC_API( sal_error_e ) SALx_create_sample_from_wave_stream( SAL_Device *device,
+                                                                   SALx_Streamer *p_streamer,
+                                                                   SAL_Sample **pp_sample,
+                                                                   const char *kp_filename );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SALX_STREAM_H */
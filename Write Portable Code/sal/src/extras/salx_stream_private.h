@@ -0,0 +1,143 @@
+/*
+Copyright (c) 2004, Brian Hook
+All rights reserved.
+
+http://www.bookofhook.com/sal
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+
+    * The names of this package'ss contributors contributors may not
+      be used to endorse or promote products derived from this
+      software without specific prior written permission.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/** @file salx_stream_private.h
+    @brief Streamer internals shared between the streamer and its readers
+*/
+#ifndef SALX_STREAM_PRIVATE_H
+#define SALX_STREAM_PRIVATE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @internal
+    @brief State of a single read-ahead block */
+typedef enum
+{
+    SALX_BLOCK_EMPTY,           /**< block is free to be filled */
+    SALX_BLOCK_PENDING,         /**< block is being read by the I/O thread */
+    SALX_BLOCK_FILLED           /**< block holds data the decoder hasn't consumed yet */
+} _SALx_BlockState;
+
+/** @internal
+    @brief A read-ahead block, which is a slice of the streamer's buffer pool */
+typedef struct
+{
+    sal_byte_t *sb_data;        /**< pointer to the block's memory */
+    sal_i64_t   sb_offset;      /**< offset of the block's contents within the stream's data, in bytes */
+    sal_i32_t   sb_bytes;       /**< number of valid bytes in the block */
+    sal_i32_t   sb_state;       /**< one of _SALx_BlockState */
+    sal_u32_t   sb_generation;  /**< stream generation the block was requested for */
+} _SALx_StreamBlock;
+
+/** @internal
+    @brief Per-sample streaming state */
+typedef struct
+{
+    struct SALx_Streamer_s *st_streamer;   /**< streamer servicing this stream */
+    int                st_slot;            /**< index of this stream in the streamer's table and pool */
+
+    SALx_StreamIO      st_io;              /**< user I/O callbacks */
+    void              *st_handle;          /**< user I/O handle */
+    sal_i64_t          st_data_offset;     /**< offset of the PCM data within the handle, in bytes */
+    sal_i64_t          st_data_size;       /**< size of the PCM data, in bytes */
+    sal_i64_t          st_io_position;     /**< current position of the handle, or -1 if unknown */
+    int                st_fd;              /**< POSIX file descriptor backing the handle, or -1 if there isn't one */
+
+    _SALx_StreamBlock *st_blocks;          /**< ring of read-ahead blocks */
+    int                st_head;            /**< next block the decoder consumes */
+    int                st_tail;            /**< next block the I/O thread fills */
+    int                st_pending;         /**< number of reads in flight */
+
+    sal_i64_t          st_read_offset;     /**< data offset of the next block to read */
+    sal_i64_t          st_loop_start;      /**< data offset reads wrap around to, in bytes */
+    sal_i64_t          st_loop_end;        /**< data offset reads wrap around at, in bytes */
+    sal_u32_t          st_generation;      /**< bumped whenever buffered data is thrown away */
+
+    sal_voice_t        st_voice;           /**< voice currently playing this stream, or SAL_INVALID_SOUND */
+    sal_u32_t          st_starved;         /**< number of times the decoder ran out of data */
+    int                st_starving;        /**< set while the decoder is out of data, so the voice gets one SALVE_STARVED event per dropout */
+    int                st_error;           /**< set when a read fails */
+    int                st_closing;         /**< set when the sample has been destroyed while a read was in flight */
+} _SALx_Stream;
+
+/** @internal
+    @brief A read request built by the I/O thread */
+typedef struct
+{
+    _SALx_Stream *sr_stream;       /**< stream to read for */
+    int           sr_block;        /**< index of the block being filled */
+    sal_u32_t     sr_generation;   /**< stream generation at the time of the request */
+    sal_i64_t     sr_offset;       /**< offset within the handle, in bytes */
+    sal_i32_t     sr_bytes;        /**< number of bytes to read */
+    sal_i32_t     sr_result;       /**< number of bytes actually read, < 0 on error */
+} _SALx_StreamRequest;
+
+/** @internal
+    @brief The streamer, which services all the streams created on it */
+struct SALx_Streamer_s
+{
+    SAL_Device    *str_device;             /**< device the streamer was created on */
+    sal_mutex_t    str_mutex;              /**< protects the streams and their blocks */
+    sal_byte_t    *str_pool;               /**< buffer pool shared by all streams */
+    _SALx_Stream **str_streams;            /**< table of streams, indexed by slot */
+    int            str_max_streams;        /**< number of entries in str_streams */
+    int            str_num_streams;        /**< number of live streams */
+    int            str_blocks_per_stream;  /**< number of blocks each stream gets */
+    int            str_block_size;         /**< size of a block, in bytes */
+    int            str_next_slot;          /**< slot the I/O thread looks at first, for round robin service */
+    int            str_kill_thread;        /**< set to 1 when the I/O thread should exit, cleared by the thread */
+
+    _SALx_StreamRequest *str_requests;     /**< request batch, one entry per block in the pool */
+    int            str_max_requests;       /**< number of entries in str_requests */
+    void          *str_uring;              /**< io_uring reader state, or NULL if reads are done synchronously */
+};
+
+#if defined SALX_SUPPORT_IO_URING && defined POSH_OS_LINUX
+#  define SALX_STREAM_URING 1
+#endif
+
+#ifdef SALX_STREAM_URING
+sal_error_e _SALx_uring_create( SALx_Streamer *p_streamer );
+void        _SALx_uring_destroy( SALx_Streamer *p_streamer );
+void        _SALx_uring_read( SALx_Streamer *p_streamer, _SALx_StreamRequest *p_reqs, int num_reqs );
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SALX_STREAM_PRIVATE_H */
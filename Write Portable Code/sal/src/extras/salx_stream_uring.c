@@ -0,0 +1,485 @@
+/*
+Copyright (c) 2004, Brian Hook
+All rights reserved.
+
+http://www.bookofhook.com/sal
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+
+    * The names of this package'ss contributors contributors may not
+      be used to endorse or promote products derived from this
+      software without specific prior written permission.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/** @file salx_stream_uring.c
+    @brief io_uring reader for streaming samples
+
+    When SALX_SUPPORT_IO_URING is defined, Linux builds of the streamer hand
+    every read on a file descriptor to the kernel through an io_uring
+    instance instead of issuing blocking pread() calls one after another.
+    A whole pass worth of reads, across all streams, goes in with a single
+    io_uring_enter() call, so slow disks service them concurrently and a
+    single I/O thread can keep well over a hundred streams fed.
+
+    The streamer's buffer pool is registered with the kernel once at
+    startup and reads are issued as IORING_OP_READ_FIXED straight into the
+    stream blocks.  If registration fails (usually because of
+    RLIMIT_MEMLOCK) plain IORING_OP_READV is used instead.  If the kernel
+    doesn't support io_uring at all the streamer never gets a ring and
+    falls back to pread().
+
+    This talks to the kernel with raw system calls so that liburing isn't
+    required to build SAL.
+*/
+#ifndef SAL_DOXYGEN
+#  define SAL_BUILDING_LIB 1
+#endif
+#include "../sal.h"
+#include "salx_stream.h"
+#include "salx_stream_private.h"
+
+#ifdef SALX_STREAM_URING
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+#define SALX_URING_MAX_ENTRIES 1024    /**< upper limit on the size of the submission queue */
+
+/** @internal
+    @brief io_uring instance and the mappings of its queues */
+typedef struct
+{
+    int                  ur_fd;             /**< ring file descriptor */
+    unsigned             ur_entries;        /**< number of submission queue entries */
+    int                  ur_fixed;          /**< 1 if the buffer pool is registered, so reads can use READ_FIXED */
+
+    void                *ur_sq_ring;        /**< mapping of the submission queue ring */
+    size_t               ur_sq_ring_size;   /**< size of ur_sq_ring */
+    void                *ur_cq_ring;        /**< mapping of the completion queue ring, may be the same as ur_sq_ring */
+    size_t               ur_cq_ring_size;   /**< size of ur_cq_ring */
+    struct io_uring_sqe *ur_sqes;           /**< mapping of the submission queue entries */
+    size_t               ur_sqes_size;      /**< size of ur_sqes */
+
+    unsigned            *ur_sq_tail;        /**< our submission queue tail */
+    unsigned            *ur_sq_mask;        /**< submission queue index mask */
+    unsigned            *ur_sq_array;       /**< submission queue index array */
+    unsigned            *ur_cq_head;        /**< our completion queue head */
+    unsigned            *ur_cq_tail;        /**< kernel's completion queue tail */
+    unsigned            *ur_cq_mask;        /**< completion queue index mask */
+    struct io_uring_cqe *ur_cqes;           /**< completion queue entries */
+
+    struct iovec        *ur_iovecs;         /**< one iovec per entry, used when the pool isn't registered */
+    sal_byte_t          *ur_finished;       /**< one flag per entry, set once its read is complete, hit the end of the file or failed */
+    int                  ur_failed;         /**< 1 once io_uring_enter() has failed for good, reads then use pread() */
+} _SALx_URing;
+
+static
+int
+s_uring_setup( unsigned entries, struct io_uring_params *p_params )
+{
+    return ( int ) syscall( __NR_io_uring_setup, entries, p_params );
+}
+
+static
+int
+s_uring_enter( int fd, unsigned to_submit, unsigned min_complete, unsigned flags )
+{
+    return ( int ) syscall( __NR_io_uring_enter, fd, to_submit, min_complete, flags, ( void * ) 0, ( size_t ) 0 );
+}
+
+static
+int
+s_uring_register( int fd, unsigned opcode, void *arg, unsigned num_args )
+{
+    return ( int ) syscall( __NR_io_uring_register, fd, opcode, arg, num_args );
+}
+
+/** @internal
+    @brief Unmaps and closes whatever parts of a ring were set up, and frees it */
+static
+void
+s_uring_free( SAL_Device *device, _SALx_URing *p_ring )
+{
+    if ( p_ring->ur_sqes != MAP_FAILED )
+    {
+        munmap( p_ring->ur_sqes, p_ring->ur_sqes_size );
+    }
+
+    if ( p_ring->ur_cq_ring != MAP_FAILED && p_ring->ur_cq_ring != p_ring->ur_sq_ring )
+    {
+        munmap( p_ring->ur_cq_ring, p_ring->ur_cq_ring_size );
+    }
+
+    if ( p_ring->ur_sq_ring != MAP_FAILED )
+    {
+        munmap( p_ring->ur_sq_ring, p_ring->ur_sq_ring_size );
+    }
+
+    if ( p_ring->ur_fd >= 0 )
+    {
+        close( p_ring->ur_fd );
+    }
+
+    SAL_free( device, p_ring->ur_iovecs );
+    SAL_free( device, p_ring->ur_finished );
+    SAL_free( device, p_ring );
+}
+
+/** @internal
+    @brief Creates an io_uring instance for a streamer and registers its buffer pool
+    @returns SALERR_OK on success, SALERR_SYSTEMFAILURE if the kernel
+    doesn't support io_uring, @ref sal_error_e on other failures
+    @remarks On failure str_uring is left NULL and the streamer reads synchronously.
+*/
+sal_error_e
+_SALx_uring_create( SALx_Streamer *p_streamer )
+{
+    SAL_Device *device = p_streamer->str_device;
+    _SALx_URing *p_ring = 0;
+    struct io_uring_params params;
+    struct iovec pool;
+    unsigned entries = 1;
+    sal_error_e err;
+
+    while ( entries < ( unsigned ) p_streamer->str_max_requests && entries < SALX_URING_MAX_ENTRIES )
+    {
+        entries <<= 1;
+    }
+
+    if ( ( err = SAL_alloc( device, ( void ** ) &p_ring, sizeof( *p_ring ) ) ) != SALERR_OK )
+    {
+        return err;
+    }
+
+    memset( p_ring, 0, sizeof( *p_ring ) );
+    p_ring->ur_fd      = -1;
+    p_ring->ur_sq_ring = MAP_FAILED;
+    p_ring->ur_cq_ring = MAP_FAILED;
+    p_ring->ur_sqes    = MAP_FAILED;
+
+    if ( ( err = SAL_alloc( device, ( void ** ) &p_ring->ur_iovecs, sizeof( struct iovec ) * entries ) ) != SALERR_OK ||
+         ( err = SAL_alloc( device, ( void ** ) &p_ring->ur_finished, entries ) ) != SALERR_OK )
+    {
+        s_uring_free( device, p_ring );
+        return err;
+    }
+
+    memset( &params, 0, sizeof( params ) );
+
+    /* ENOSYS here just means an older kernel, which is what pread() is for */
+    if ( ( p_ring->ur_fd = s_uring_setup( entries, &params ) ) < 0 )
+    {
+        s_uring_free( device, p_ring );
+        return SALERR_SYSTEMFAILURE;
+    }
+
+    p_ring->ur_entries      = params.sq_entries;
+    p_ring->ur_sq_ring_size = params.sq_off.array + params.sq_entries * sizeof( unsigned );
+    p_ring->ur_cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof( struct io_uring_cqe );
+    p_ring->ur_sqes_size    = params.sq_entries * sizeof( struct io_uring_sqe );
+
+    /* newer kernels put both rings in one mapping */
+    if ( params.features & IORING_FEAT_SINGLE_MMAP )
+    {
+        if ( p_ring->ur_cq_ring_size > p_ring->ur_sq_ring_size )
+        {
+            p_ring->ur_sq_ring_size = p_ring->ur_cq_ring_size;
+        }
+        p_ring->ur_cq_ring_size = p_ring->ur_sq_ring_size;
+    }
+
+    p_ring->ur_sq_ring = mmap( 0, p_ring->ur_sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, p_ring->ur_fd, IORING_OFF_SQ_RING );
+
+    if ( p_ring->ur_sq_ring == MAP_FAILED )
+    {
+        s_uring_free( device, p_ring );
+        return SALERR_SYSTEMFAILURE;
+    }
+
+    if ( params.features & IORING_FEAT_SINGLE_MMAP )
+    {
+        p_ring->ur_cq_ring = p_ring->ur_sq_ring;
+    }
+    else if ( ( p_ring->ur_cq_ring = mmap( 0, p_ring->ur_cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, p_ring->ur_fd, IORING_OFF_CQ_RING ) ) == MAP_FAILED )
+    {
+        s_uring_free( device, p_ring );
+        return SALERR_SYSTEMFAILURE;
+    }
+
+    if ( ( p_ring->ur_sqes = mmap( 0, p_ring->ur_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, p_ring->ur_fd, IORING_OFF_SQES ) ) == MAP_FAILED )
+    {
+        s_uring_free( device, p_ring );
+        return SALERR_SYSTEMFAILURE;
+    }
+
+    p_ring->ur_sq_tail  = ( unsigned * ) ( ( char * ) p_ring->ur_sq_ring + params.sq_off.tail );
+    p_ring->ur_sq_mask  = ( unsigned * ) ( ( char * ) p_ring->ur_sq_ring + params.sq_off.ring_mask );
+    p_ring->ur_sq_array = ( unsigned * ) ( ( char * ) p_ring->ur_sq_ring + params.sq_off.array );
+    p_ring->ur_cq_head  = ( unsigned * ) ( ( char * ) p_ring->ur_cq_ring + params.cq_off.head );
+    p_ring->ur_cq_tail  = ( unsigned * ) ( ( char * ) p_ring->ur_cq_ring + params.cq_off.tail );
+    p_ring->ur_cq_mask  = ( unsigned * ) ( ( char * ) p_ring->ur_cq_ring + params.cq_off.ring_mask );
+    p_ring->ur_cqes     = ( struct io_uring_cqe * ) ( ( char * ) p_ring->ur_cq_ring + params.cq_off.cqes );
+
+    /* pin the pool so the kernel can read straight into it without mapping pages per request */
+    pool.iov_base = p_streamer->str_pool;
+    pool.iov_len  = ( size_t ) p_streamer->str_max_requests * p_streamer->str_block_size;
+
+    p_ring->ur_fixed = ( s_uring_register( p_ring->ur_fd, IORING_REGISTER_BUFFERS, &pool, 1 ) == 0 );
+
+    p_streamer->str_uring = p_ring;
+
+    return SALERR_OK;
+}
+
+/** @internal
+    @brief Destroys a streamer's io_uring instance
+    @remarks Only called once the I/O thread has exited, so nothing is in flight.
+*/
+void
+_SALx_uring_destroy( SALx_Streamer *p_streamer )
+{
+    _SALx_URing *p_ring = ( _SALx_URing * ) p_streamer->str_uring;
+
+    if ( p_ring->ur_fixed )
+    {
+        s_uring_register( p_ring->ur_fd, IORING_UNREGISTER_BUFFERS, 0, 0 );
+    }
+
+    s_uring_free( p_streamer->str_device, p_ring );
+    p_streamer->str_uring = 0;
+}
+
+/** @internal
+    @brief Reads whatever is left of a request with pread()
+    @remarks sr_result holds the number of bytes read so far and ends up
+    as the total, or -1 if nothing could be read.
+*/
+static
+void
+s_uring_read_sync( _SALx_StreamRequest *p_req )
+{
+    _SALx_Stream *p_stream = p_req->sr_stream;
+    sal_byte_t *p_dst = p_stream->st_blocks[ p_req->sr_block ].sb_data;
+
+    while ( p_req->sr_result < p_req->sr_bytes )
+    {
+        ssize_t result = pread( p_stream->st_fd, 
+                                p_dst + p_req->sr_result, 
+                                ( size_t ) ( p_req->sr_bytes - p_req->sr_result ), 
+                                ( off_t ) ( p_req->sr_offset + p_req->sr_result ) );
+
+        if ( result <= 0 )
+        {
+            break;
+        }
+
+        p_req->sr_result += ( sal_i32_t ) result;
+    }
+
+    if ( p_req->sr_result == 0 )
+    {
+        p_req->sr_result = -1;
+    }
+}
+
+/** @internal
+    @brief Puts a read of the rest of a request in the submission queue
+    @param[in] p_ring ring to queue on, must have a free entry
+    @param[in] p_req request to read, sr_result holds the number of bytes read so far
+    @param[in] slot the request's position in the batch, handed back in the completion
+*/
+static
+void
+s_uring_queue( _SALx_URing *p_ring, _SALx_StreamRequest *p_req, unsigned slot )
+{
+    _SALx_Stream *p_stream = p_req->sr_stream;
+    sal_byte_t *p_dst = p_stream->st_blocks[ p_req->sr_block ].sb_data + p_req->sr_result;
+    __u32 bytes = ( __u32 ) ( p_req->sr_bytes - p_req->sr_result );
+    unsigned tail = *p_ring->ur_sq_tail;
+    unsigned index = tail & *p_ring->ur_sq_mask;
+    struct io_uring_sqe *p_sqe = &p_ring->ur_sqes[ index ];
+
+    memset( p_sqe, 0, sizeof( *p_sqe ) );
+    p_sqe->fd        = p_stream->st_fd;
+    p_sqe->off       = ( __u64 ) ( p_req->sr_offset + p_req->sr_result );
+    p_sqe->user_data = ( __u64 ) slot;
+
+    if ( p_ring->ur_fixed )
+    {
+        p_sqe->opcode    = IORING_OP_READ_FIXED;
+        p_sqe->addr      = ( __u64 ) ( size_t ) p_dst;
+        p_sqe->len       = bytes;
+        p_sqe->buf_index = 0;
+    }
+    else
+    {
+        p_ring->ur_iovecs[ slot ].iov_base = p_dst;
+        p_ring->ur_iovecs[ slot ].iov_len  = ( size_t ) bytes;
+
+        p_sqe->opcode = IORING_OP_READV;
+        p_sqe->addr   = ( __u64 ) ( size_t ) &p_ring->ur_iovecs[ slot ];
+        p_sqe->len    = 1;
+    }
+
+    p_ring->ur_sq_array[ index ] = index;
+
+    /* the kernel must see the entry before it sees the new tail */
+    __atomic_store_n( p_ring->ur_sq_tail, tail + 1, __ATOMIC_RELEASE );
+}
+
+/** @internal
+    @brief Performs a batch of reads through io_uring and waits for all of them
+    @param[in] p_streamer streamer the requests belong to
+    @param[in,out] p_reqs requests to perform, all on streams with file descriptors
+    @param[in] num_reqs number of requests
+    Fills in sr_result for each request.  Called by the I/O thread without
+    the streamer locked, same as a synchronous read.
+    
+    A read can complete short of what was asked for without being at the
+    end of the file, so the rest of it is queued again until it's done,
+    hits the end of the file or fails.  If the kernel takes only some of
+    the queued entries the others are submitted again on the next trip
+    around.  Should the ring stop working altogether it is marked failed,
+    and this and every later read is finished with pread().
+*/
+void
+_SALx_uring_read( SALx_Streamer *p_streamer, _SALx_StreamRequest *p_reqs, int num_reqs )
+{
+    _SALx_URing *p_ring = ( _SALx_URing * ) p_streamer->str_uring;
+    int first = 0;
+    int i;
+
+    while ( first < num_reqs && !p_ring->ur_failed )
+    {
+        unsigned slot;
+        unsigned batch = ( unsigned ) ( num_reqs - first );
+        unsigned queued = 0;       /* in the submission queue, not yet taken by the kernel */
+        unsigned in_flight = 0;    /* taken by the kernel, not completed yet */
+
+        if ( batch > p_ring->ur_entries )
+        {
+            batch = p_ring->ur_entries;
+        }
+
+        for ( slot = 0; slot < batch; slot++ )
+        {
+            p_reqs[ first + slot ].sr_result = 0;
+            p_ring->ur_finished[ slot ] = 0;
+            s_uring_queue( p_ring, &p_reqs[ first + slot ], slot );
+            queued++;
+        }
+
+        while ( queued > 0 || in_flight > 0 )
+        {
+            unsigned head;
+            unsigned cq_tail;
+            int result = s_uring_enter( p_ring->ur_fd, queued, 1, IORING_ENTER_GETEVENTS );
+
+            if ( result > 0 || ( result == 0 && in_flight > 0 ) )
+            {
+                queued    -= ( unsigned ) result;
+                in_flight += ( unsigned ) result;
+            }
+            else if ( result < 0 && errno == EINTR )
+            {
+                continue;
+            }
+            /* out of resources for now, so wait for something to finish and try again */
+            else if ( result < 0 && ( errno == EAGAIN || errno == EBUSY ) && in_flight > 0 )
+            {
+                s_uring_enter( p_ring->ur_fd, 0, 1, IORING_ENTER_GETEVENTS );
+            }
+            else
+            {
+                /* the ring is unusable, so take back the entries it never saw and give up on it */
+                *p_ring->ur_sq_tail -= queued;
+                p_ring->ur_failed = 1;
+                break;
+            }
+
+            head    = *p_ring->ur_cq_head;
+            cq_tail = __atomic_load_n( p_ring->ur_cq_tail, __ATOMIC_ACQUIRE );
+
+            while ( head != cq_tail )
+            {
+                struct io_uring_cqe *p_cqe = &p_ring->ur_cqes[ head & *p_ring->ur_cq_mask ];
+                _SALx_StreamRequest *p_req;
+
+                slot  = ( unsigned ) p_cqe->user_data;
+                p_req = &p_reqs[ first + slot ];
+
+                head++;
+                in_flight--;
+
+                if ( p_cqe->res > 0 )
+                {
+                    p_req->sr_result += p_cqe->res;
+                }
+
+                if ( p_cqe->res > 0 && p_req->sr_result < p_req->sr_bytes )
+                {
+                    s_uring_queue( p_ring, p_req, slot );
+                    queued++;
+                }
+                else
+                {
+                    p_ring->ur_finished[ slot ] = 1;
+                }
+            }
+
+            __atomic_store_n( p_ring->ur_cq_head, head, __ATOMIC_RELEASE );
+        }
+
+        for ( slot = 0; slot < batch; slot++ )
+        {
+            _SALx_StreamRequest *p_req = &p_reqs[ first + slot ];
+
+            if ( !p_ring->ur_finished[ slot ] )
+            {
+                s_uring_read_sync( p_req );
+            }
+            else if ( p_req->sr_result == 0 )
+            {
+                p_req->sr_result = -1;
+            }
+        }
+
+        first += batch;
+    }
+
+    /* anything left over gets read the old fashioned way */
+    for ( i = first; i < num_reqs; i++ )
+    {
+        p_reqs[ i ].sr_result = 0;
+        s_uring_read_sync( &p_reqs[ i ] );
+    }
+}
+
+#endif /* SALX_STREAM_URING */
@@ -42,8 +42,24 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #  define SAL_BUILDING_LIB 1
 #endif
 #include "../sal.h"
+#include "salx_wave.h"
 
 #include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined POSH_OS_UNIX || defined POSH_OS_OSX
+#  define SALX_WAVE_MMAP 1 /**< If defined, WAV files are memory mapped by SALx_create_sample_from_wave_file */
+#  include <sys/types.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+/** @internal
+    Number of bytes of a mapped sample that are advised for read-ahead in front of a voice's cursor */
+#define SALX_WAVE_READAHEAD_BYTES ( 64 * 1024 )
 
 /** @internal
     @brief WAV file header structure */
@@ -70,153 +86,271 @@ typedef struct
     sal_i32_t       wc_data_size;         /**< size of the data in this chunk */
 } _SAL_WaveChunk;
 
-static 
-void 
-transform_identity_mono_8( const sal_byte_t *kp_src,
-                           sal_byte_t *p_dst )
+#ifdef SALX_WAVE_MMAP
+/** @internal
+    @brief State bound to a sample whose data points straight into a file mapping */
+typedef struct
 {
-    *p_dst = *kp_src;
-}
+    void       *wm_base;              /**< base address of the file mapping */
+    size_t      wm_length;            /**< length of the file mapping, in bytes */
+    sal_u32_t  *wm_advised_windows;   /**< read-ahead window most recently passed to madvise, one per voice */
+} _SAL_WaveMapping;
+#endif
 
-static 
-void 
-transform_mono_8_to_stereo_8( const sal_byte_t *kp_src,
-                              sal_byte_t *p_dst )
-{
-    p_dst[ 1 ] = p_dst[ 0 ] = *kp_src;
-}
+/* reads the i'th little-endian 16-bit sample of a byte array without a function call */
+#define S_LE16( p, i ) ( ( sal_i16_t ) ( ( p )[ 2 * ( i ) ] | ( ( p )[ 2 * ( i ) + 1 ] << 8 ) ) )
 
-static 
-void 
-transform_mono_16_to_stereo_16( const sal_byte_t *kp_src,
-                                sal_byte_t *p_dst )
+/** Converts a block of WAV style PCM data to another channel count and bit depth.
+    @ingroup extras
+    @param [in] kp_src source PCM data, 8-bit unsigned or 16-bit signed little-endian
+    @param [in] src_channels number of channels in the source, 1 or 2
+    @param [in] src_bits bits per sample in the source, 8 or 16
+    @param [out] p_dst destination buffer, num_frames * dst_channels * dst_bits / 8 bytes long
+    @param [in] dst_channels number of channels to convert to, 1 or 2
+    @param [in] dst_bits bits per sample to convert to, 8 or 16
+    @param [in] num_frames number of frames to convert
+    @returns SALERR_OK on success, SALERR_INVALIDFORMAT if a format isn't supported
+    The destination is in the host's byte order, which is what SAL samples
+    use.  Every conversion is a single tight loop over the whole block, and
+    when nothing but the byte order needs to change on a little-endian host
+    it's a straight memcpy.  Stereo is mixed down to mono by averaging the
+    channels and mono is expanded to stereo by duplicating it.  The buffers
+    must not overlap.
+*/
+sal_error_e
+SALx_convert_pcm( const void *kp_src,
+                  int src_channels,
+                  int src_bits,
+                  void *p_dst,
+                  int dst_channels,
+                  int dst_bits,
+                  int num_frames )
 {
-	sal_i16_t *dst_16 = ( sal_i16_t * ) p_dst;
-	
-	dst_16[ 1 ] = dst_16[ 0 ] = POSH_ReadI16FromLittle( kp_src );
-}
+    int i;
+    const sal_byte_t *s8 = ( const sal_byte_t * ) kp_src;
+    sal_byte_t *d8 = ( sal_byte_t * ) p_dst;
+    sal_i16_t *d16 = ( sal_i16_t * ) p_dst;
 
-static 
-void 
-transform_identity_stereo_8( const sal_byte_t *kp_src,
-                             sal_byte_t *p_dst )
-{
-    p_dst[ 0 ] = kp_src[ 0 ];
-    p_dst[ 1 ] = kp_src[ 1 ];
-}
+    if ( kp_src == 0 || p_dst == 0 || num_frames < 0 ||
+         ( src_channels != 1 && src_channels != 2 ) || ( dst_channels != 1 && dst_channels != 2 ) ||
+         ( src_bits != 8 && src_bits != 16 ) || ( dst_bits != 8 && dst_bits != 16 ) )
+    {
+        return SALERR_INVALIDFORMAT;
+    }
 
-static 
-void 
-transform_identity_mono_16( const sal_byte_t *kp_src,
-                            sal_byte_t *p_dst )
-{
-    * ( sal_i16_t * ) p_dst = POSH_ReadI16FromLittle( kp_src );
-}
+    /* same number of channels, so work on samples rather than frames */
+    if ( src_channels == dst_channels )
+    {
+        int n = num_frames * src_channels;
 
-static 
-void 
-transform_identity_stereo_16( const sal_byte_t *kp_src,
-                              sal_byte_t *p_dst )
-{
-    * ( sal_i16_t * ) p_dst  = POSH_ReadI16FromLittle( kp_src );
-    p_dst += 2; kp_src += 2;
-    * ( sal_i16_t * ) p_dst  = POSH_ReadI16FromLittle( kp_src );
-}
+        if ( src_bits == dst_bits )
+        {
+            if ( src_bits == 8 )
+            {
+                memcpy( p_dst, kp_src, n );
+            }
+            else
+            {
+                POSH_ReadU16ArrayFromLittle( ( posh_u16_t * ) p_dst, kp_src, n );
+            }
+        }
+        else if ( src_bits == 8 )
+        {
+            for ( i = 0; i < n; i++ )
+            {
+                d16[ i ] = U8_TO_I16( s8[ i ] );
+            }
+        }
+        else
+        {
+            for ( i = 0; i < n; i++ )
+            {
+                d8[ i ] = I16_TO_U8( S_LE16( s8, i ) );
+            }
+        }
+    }
+    /* mono to stereo */
+    else if ( src_channels == 1 )
+    {
+        if ( src_bits == 8 && dst_bits == 8 )
+        {
+            for ( i = 0; i < num_frames; i++ )
+            {
+                d8[ i * 2 ] = d8[ i * 2 + 1 ] = s8[ i ];
+            }
+        }
+        else if ( src_bits == 16 && dst_bits == 16 )
+        {
+            for ( i = 0; i < num_frames; i++ )
+            {
+                d16[ i * 2 ] = d16[ i * 2 + 1 ] = S_LE16( s8, i );
+            }
+        }
+        else if ( src_bits == 8 )
+        {
+            for ( i = 0; i < num_frames; i++ )
+            {
+                d16[ i * 2 ] = d16[ i * 2 + 1 ] = U8_TO_I16( s8[ i ] );
+            }
+        }
+        else
+        {
+            for ( i = 0; i < num_frames; i++ )
+            {
+                d8[ i * 2 ] = d8[ i * 2 + 1 ] = I16_TO_U8( S_LE16( s8, i ) );
+            }
+        }
+    }
+    /* stereo to mono */
+    else
+    {
+        if ( src_bits == 8 && dst_bits == 8 )
+        {
+            for ( i = 0; i < num_frames; i++ )
+            {
+                d8[ i ] = ( sal_byte_t ) ( ( s8[ i * 2 ] + s8[ i * 2 + 1 ] ) / 2 );
+            }
+        }
+        else if ( src_bits == 16 && dst_bits == 16 )
+        {
+            for ( i = 0; i < num_frames; i++ )
+            {
+                d16[ i ] = ( sal_i16_t ) ( ( S_LE16( s8, i * 2 ) + S_LE16( s8, i * 2 + 1 ) ) / 2 );
+            }
+        }
+        else if ( src_bits == 8 )
+        {
+            for ( i = 0; i < num_frames; i++ )
+            {
+                d16[ i ] = U8_TO_I16( ( s8[ i * 2 ] + s8[ i * 2 + 1 ] ) / 2 );
+            }
+        }
+        else
+        {
+            for ( i = 0; i < num_frames; i++ )
+            {
+                d8[ i ] = I16_TO_U8( ( S_LE16( s8, i * 2 ) + S_LE16( s8, i * 2 + 1 ) ) / 2 );
+            }
+        }
+    }
 
-static
-void
-transform_mono_16_to_mono_8( const sal_byte_t *kp_src,
-                             sal_byte_t *p_dst )
-{
-    *p_dst = I16_TO_U8( POSH_ReadI16FromLittle( kp_src ) );
+    return SALERR_OK;
 }
 
+/** @internal
+    @brief Parses the header of an in-memory WAV image
+    @param[in] kp_src source array of bytes
+    @param[in] src_size number of bytes in kp_src
+    @param[out] p_wc chunk structure that receives the format of the data
+    @param[out] pp_data address of a pointer that receives the start of the PCM data
+    @param[in] check_size if non-zero, fail if the data chunk runs past the end of kp_src
+    @returns SALERR_OK on success, SALERR_INVALIDPARAM if this isn't a WAV file we understand
+*/
 static
-void
-transform_mono_8_to_mono_16( const sal_byte_t *kp_src,
-                             sal_byte_t *p_dst )
+sal_error_e
+s_parse_wave( const void *kp_src,
+              int src_size,
+              _SAL_WaveChunk *p_wc,
+              const sal_byte_t **pp_data,
+              int check_size )
 {
-    * ( sal_i16_t * ) p_dst = U8_TO_I16( *kp_src );
-}
+    _SAL_WaveHeader wh;
+    const sal_byte_t *kp_bytes = ( const sal_byte_t * ) kp_src;
 
-static
-void
-transform_stereo_8_to_stereo_16( const sal_byte_t *kp_src,
-                                 sal_byte_t *p_dst )
-{
-    * ( sal_i16_t * ) ( p_dst + 0 ) = U8_TO_I16( kp_src[ 0 ] );
-    * ( sal_i16_t * ) ( p_dst + 2 ) = U8_TO_I16( kp_src[ 1 ] );
-}
+    if ( src_size < ( int ) ( sizeof( _SAL_WaveHeader ) + sizeof( _SAL_WaveChunk ) ) )
+    {
+        return SALERR_INVALIDPARAM;
+    }
 
-static
-void
-transform_stereo_16_to_stereo_8( const sal_byte_t *kp_src,
-                                 sal_byte_t *p_dst )
-{
-    p_dst[ 0 ] = I16_TO_U8( POSH_ReadI16FromLittle( kp_src ) );
-    p_dst[ 1 ] = I16_TO_U8( POSH_ReadI16FromLittle( kp_src + 2 ) );
-}
+    /* read out wave header */
+    memcpy( wh.wh_riff, kp_bytes, 4 );
+    kp_bytes += 4;
+    wh.wh_size = POSH_ReadU32FromLittle( kp_bytes );
+    kp_bytes += 4;
+    memcpy( wh.wh_wave, kp_bytes, 4 );
+    kp_bytes += 4;
+    memcpy( wh.wh_fmt, kp_bytes, 4 );
+    kp_bytes += 4;
+    wh.wh_chunk_header_size = POSH_ReadU32FromLittle( kp_bytes );
+    kp_bytes += 4;
 
-static
-void
-transform_stereo_16_to_mono_8( const sal_byte_t *kp_src,
-                               sal_byte_t *p_dst )
-{
-    sal_i32_t s16 = ( POSH_ReadI16FromLittle( kp_src ) + POSH_ReadI16FromLittle( kp_src + 2 ) ) / 2;
-    *p_dst = I16_TO_U8( s16 );
-}
+    /* verify that this is a legit WAV file */
+    if ( strncmp( wh.wh_riff, "RIFF", 4 ) ||
+         strncmp( wh.wh_wave, "WAVE", 4 ) ||
+         wh.wh_chunk_header_size != 16 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
 
-static
-void
-transform_stereo_16_to_mono_16( const sal_byte_t *kp_src,
-                                sal_byte_t *p_dst )
-{
-    sal_i32_t s16 = ( POSH_ReadI16FromLittle( kp_src ) + POSH_ReadI16FromLittle( kp_src + 2 ) ) / 2;
-    *( sal_i16_t * ) p_dst = s16;
-}
+    /* read in the chunk */
+    p_wc->wc_tag                = POSH_ReadI16FromLittle( kp_bytes ); kp_bytes += 2;
+    p_wc->wc_num_channels       = POSH_ReadI16FromLittle( kp_bytes ); kp_bytes += 2;
+    p_wc->wc_sample_rate        = POSH_ReadI32FromLittle( kp_bytes ); kp_bytes += 4;
+    p_wc->wc_bytes_per_second   = POSH_ReadI32FromLittle( kp_bytes ); kp_bytes += 4;
+    p_wc->wc_alignment          = POSH_ReadI16FromLittle( kp_bytes ); kp_bytes += 2;
+    p_wc->wc_bits_per_sample    = POSH_ReadI16FromLittle( kp_bytes ); kp_bytes += 2;
+    memcpy( p_wc->wc_data, kp_bytes, 4 ); kp_bytes += 4;
+    p_wc->wc_data_size          = POSH_ReadI32FromLittle( kp_bytes ); kp_bytes += 4;
+
+    if ( strncmp( p_wc->wc_data, "data", 4 ) )
+    {
+        return SALERR_INVALIDPARAM;
+    }
 
-static
-void
-transform_stereo_8_to_mono_16( const sal_byte_t *kp_src,
-                               sal_byte_t *p_dst )
-{
-    sal_i16_t l = kp_src[ 0 ];
-    sal_i16_t r = kp_src[ 1 ];
-    sal_i16_t u = ( l + r ) / 2;
+    if ( ( p_wc->wc_num_channels != 1 && p_wc->wc_num_channels != 2 ) ||
+         ( p_wc->wc_bits_per_sample != 8 && p_wc->wc_bits_per_sample != 16 ) )
+    {
+        return SALERR_INVALIDPARAM;
+    }
 
-    * ( sal_i16_t * ) p_dst = U8_TO_I16( u );
-}
+    /* don't trust a data size that runs off the end of the image */
+    if ( p_wc->wc_data_size < 0 || 
+         ( check_size && p_wc->wc_data_size > src_size - ( kp_bytes - ( const sal_byte_t * ) kp_src ) ) )
+    {
+        return SALERR_INVALIDPARAM;
+    }
 
-static
-void
-transform_stereo_8_to_mono_8( const sal_byte_t *kp_src,
-                              sal_byte_t *p_dst )
-{
-    sal_i16_t l = kp_src[ 0 ];
-    sal_i16_t r = kp_src[ 1 ];
-    sal_i16_t u = ( l + r ) /2;
+    *pp_data = kp_bytes;
 
-    *p_dst = ( sal_byte_t ) u;
+    return SALERR_OK;
 }
 
-static
-void
-transform_mono_16_to_stereo_8( const sal_byte_t *kp_src,
-                               sal_byte_t *p_dst )
+/** Retrieves the format and data location of an in-memory WAV image.
+    @ingroup extras
+    @param [in] kp_src source array of bytes, which only needs to contain the WAV header
+    @param [in] src_size number of bytes in kp_src
+    @param [out] p_info pointer to a SALx_WaveInfo structure that receives the results
+    @returns SALERR_OK on success, @ref sal_error_e on failure
+    This only parses the header, so it's suitable for code that wants to find
+    out about a WAV file without loading all of it, such as streaming samples.
+    The data chunk is not required to be present in kp_src.
+*/
+sal_error_e
+SALx_get_wave_info( const void *kp_src,
+                    int src_size,
+                    SALx_WaveInfo *p_info )
 {
-    sal_byte_t s8 = I16_TO_U8( POSH_ReadI16FromLittle( kp_src ) );
-    p_dst[ 0 ] = s8;
-    p_dst[ 1 ] = s8;
-}
+    sal_error_e err;
+    _SAL_WaveChunk wc;
+    const sal_byte_t *kp_data = 0;
 
-static
-void
-transform_mono_8_to_stereo_16( const sal_byte_t *kp_src,
-                               sal_byte_t *p_dst )
-{
-    sal_i16_t s16 = U8_TO_I16( *kp_src );
-    * ( sal_i16_t * ) ( p_dst + 0 ) = s16;
-    * ( sal_i16_t * ) ( p_dst + 2 ) = s16;
+    if ( kp_src == 0 || p_info == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    if ( ( err = s_parse_wave( kp_src, src_size, &wc, &kp_data, 0 ) ) != SALERR_OK )
+    {
+        return err;
+    }
+
+    p_info->wi_channels    = wc.wc_num_channels;
+    p_info->wi_bits        = wc.wc_bits_per_sample;
+    p_info->wi_sample_rate = wc.wc_sample_rate;
+    p_info->wi_data_offset = ( sal_i32_t ) ( kp_data - ( const sal_byte_t * ) kp_src );
+    p_info->wi_data_size   = wc.wc_data_size;
+
+    return SALERR_OK;
 }
 
 /** Decodes a WAV file and creates a sample from it.
@@ -237,60 +371,27 @@ SALx_create_sample_from_wave( SAL_Device *device,
                              const void *kp_src,
                              int src_size )
 {
-    int i;
     int src_frame_size;
     int num_samples;
+    sal_error_e err;
     SAL_DeviceInfo dinfo;
-    _SAL_WaveHeader wh;
     _SAL_WaveChunk  wc;
-    const sal_byte_t *kp_bytes = ( const sal_byte_t * ) kp_src;
-    sal_byte_t *p_dst = 0;
-    void (*transform)( const sal_byte_t *, sal_byte_t * ) = 0;
+    const sal_byte_t *kp_bytes = 0;
 
-    if ( device == 0 || pp_sample == 0 || kp_src == 0 || src_size < sizeof( _SAL_WaveHeader ) )
+    if ( device == 0 || pp_sample == 0 || kp_src == 0 )
     {
         return SALERR_INVALIDPARAM;
     }
 
     *pp_sample = 0;
 
-    /* read out wave header */
-    memcpy( wh.wh_riff, kp_bytes, 4 );
-    kp_bytes += 4;
-    wh.wh_size = POSH_ReadU32FromLittle( kp_bytes );
-    kp_bytes += 4;
-    memcpy( wh.wh_wave, kp_bytes, 4 );
-    kp_bytes += 4;
-    memcpy( wh.wh_fmt, kp_bytes, 4 );
-    kp_bytes += 4;
-    wh.wh_chunk_header_size = POSH_ReadU32FromLittle( kp_bytes );
-    kp_bytes += 4;
-
-    /* verify that this is a legit WAV file */
-    if ( strncmp( wh.wh_riff, "RIFF", 4 ) ||
-         strncmp( wh.wh_wave, "WAVE", 4 ) ||
-         wh.wh_chunk_header_size != 16 )
+    if ( ( err = s_parse_wave( kp_src, src_size, &wc, &kp_bytes, 1 ) ) != SALERR_OK )
     {
-        return SALERR_INVALIDPARAM;
+        return err;
     }
 
-    /* read in the chunk */
-    wc.wc_tag                = POSH_ReadI16FromLittle( kp_bytes ); kp_bytes += 2;
-    wc.wc_num_channels       = POSH_ReadI16FromLittle( kp_bytes ); kp_bytes += 2;
-    wc.wc_sample_rate        = POSH_ReadI32FromLittle( kp_bytes ); kp_bytes += 4;
-    wc.wc_bytes_per_second   = POSH_ReadI32FromLittle( kp_bytes ); kp_bytes += 4;
-    wc.wc_alignment          = POSH_ReadI16FromLittle( kp_bytes ); kp_bytes += 2;
-    wc.wc_bits_per_sample    = POSH_ReadI16FromLittle( kp_bytes ); kp_bytes += 2;
-    memcpy( wc.wc_data, kp_bytes, 4 ); kp_bytes += 4;
-    wc.wc_data_size          = POSH_ReadI32FromLittle( kp_bytes ); kp_bytes += 4;
-
     src_frame_size  = ( wc.wc_bits_per_sample / 8 ) * wc.wc_num_channels;
 
-    if ( strncmp( wc.wc_data, "data", 4 ) )
-    {
-        return SALERR_INVALIDPARAM;
-    }
-
     /* get device info */
     memset( &dinfo, 0, sizeof( dinfo ) );
     dinfo.di_size = sizeof( dinfo );
@@ -304,135 +405,304 @@ SALx_create_sample_from_wave( SAL_Device *device,
         return SALERR_INVALIDFORMAT;
     }
 
-    /* unity transform */
-    if ( dinfo.di_channels == wc.wc_num_channels &&
-         dinfo.di_bits == wc.wc_bits_per_sample )
+    /* # samples = num_frames * num_channels */
+    num_samples = ( wc.wc_data_size / ( wc.wc_bits_per_sample / 8 )) * dinfo.di_channels / wc.wc_num_channels;
+
+    /* allocate new sample and zero it out */
+    if ( ( err = SAL_create_sample( device, pp_sample, num_samples, _SAL_generic_decode_sample, _SAL_generic_destroy_sample, NULL ) ) != SALERR_OK )
     {
-        if ( dinfo.di_channels == 1 && dinfo.di_bits == 8 )
-        {
-            transform = transform_identity_mono_8;
-        }
-        else if ( dinfo.di_channels == 2 && dinfo.di_bits == 8 )
-        {
-            transform = transform_identity_stereo_8;
-        }
-        else if ( dinfo.di_channels == 1 && dinfo.di_bits == 16 )
-        {
-            transform = transform_identity_mono_16;
-        }
-        else
+        return err;
+    }
+
+    /* convert the whole data chunk in one go */
+    if ( ( err = SALx_convert_pcm( kp_bytes, wc.wc_num_channels, wc.wc_bits_per_sample, 
+                                   (*pp_sample)->sample_data, dinfo.di_channels, dinfo.di_bits, 
+                                   wc.wc_data_size / src_frame_size ) ) != SALERR_OK )
+    {
+        SAL_destroy_sample( device, *pp_sample );
+        *pp_sample = 0;
+        return err;
+    }
+
+    return SALERR_OK;
+}
+
+#ifdef SALX_WAVE_MMAP
+
+/** @internal
+    @brief Asks the OS to start paging in the read-ahead window at a byte offset of a mapped sample
+    @param[in] p_mapping pointer to the sample's mapping state
+    @param[in] kp_data start of the sample's PCM data inside the mapping
+    @param[in] offset byte offset into the PCM data
+    @param[in] length number of bytes to advise
+*/
+static
+void
+s_wave_advise( _SAL_WaveMapping *p_mapping,
+               const sal_byte_t *kp_data,
+               sal_u32_t offset,
+               sal_u32_t length )
+{
+    long page_size = sysconf( _SC_PAGESIZE );
+    size_t start   = ( size_t ) ( kp_data + offset - ( const sal_byte_t * ) p_mapping->wm_base );
+    size_t end     = start + length;
+
+    if ( end > p_mapping->wm_length )
+    {
+        end = p_mapping->wm_length;
+    }
+
+    /* madvise wants a page aligned address */
+    start -= start % page_size;
+
+    if ( end > start )
+    {
+        madvise( ( sal_byte_t * ) p_mapping->wm_base + start, end - start, MADV_WILLNEED );
+    }
+}
+
+/** @internal
+    @brief Decoder for samples that point directly into a file mapping
+    @param[in] p_device pointer to output device
+    @param[in] voice voice that is being decoded
+    @param[out] p_dst destination buffer for decoding
+    @param[in] bytes_needed number of bytes we need to decode
+    @returns 1 if the voice has ended, 0 if not
+    The PCM data is already in the device's format, so this defers to the
+    generic decoder.  Before doing so it checks whether the voice's cursor has
+    moved into a new read-ahead window and, if so, hints the kernel to page in
+    the data the voice is about to hit (including the loop start when the
+    window runs into the loop end) so the mixer doesn't stall on page faults.
+*/
+static
+int
+s_wave_mmap_decoder( SAL_Device *p_device,
+                     sal_voice_t voice,
+                     sal_byte_t *p_dst,
+                     int bytes_needed )
+{
+    SAL_Sample *sample = 0;
+    _SAL_WaveMapping *p_mapping;
+    SAL_Voice *p_voice = &p_device->device_voices[ voice ];
+    sal_u32_t offset;
+    sal_u32_t window;
+
+    _SAL_get_voice_sample_locked( p_device, voice, &sample );
+
+    p_mapping = ( _SAL_WaveMapping * ) sample->sample_args.sarg_ptr;
+    offset    = p_voice->voice_cursor * p_device->device_info.di_bytes_per_sample;
+    window    = offset / SALX_WAVE_READAHEAD_BYTES;
+
+    /* each voice has its own window, so voices sharing the sample don't undo each other's advice */
+    if ( window != p_mapping->wm_advised_windows[ voice ] )
+    {
+        sal_u32_t loop_end_offset = p_voice->voice_loop_end * p_device->device_info.di_bytes_per_sample;
+
+        p_mapping->wm_advised_windows[ voice ] = window;
+
+        s_wave_advise( p_mapping, sample->sample_data, window * SALX_WAVE_READAHEAD_BYTES, 2 * SALX_WAVE_READAHEAD_BYTES );
+
+        /* about to wrap around, so make sure the loop start is resident too */
+        if ( loop_end_offset && loop_end_offset <= ( window + 2 ) * SALX_WAVE_READAHEAD_BYTES )
         {
-            transform = transform_identity_stereo_16;
+            s_wave_advise( p_mapping, 
+                           sample->sample_data, 
+                           p_voice->voice_loop_start * p_device->device_info.di_bytes_per_sample, 
+                           SALX_WAVE_READAHEAD_BYTES );
         }
     }
-    /* non-unity transform */
-    else
+
+    return _SAL_generic_decode_sample( p_device, voice, p_dst, bytes_needed );
+}
+
+/** @internal
+    @brief Destruction callback for samples that point directly into a file mapping
+    @param[in] p_device pointer to output device
+    @param[in] self pointer to sample being destroyed
+*/
+static
+void
+s_wave_mmap_destroy( SAL_Device *p_device, 
+                     SAL_Sample *self )
+{
+    _SAL_WaveMapping *p_mapping = ( _SAL_WaveMapping * ) self->sample_args.sarg_ptr;
+
+    /* the data belongs to the mapping, so it must not be freed */
+    self->sample_data = 0;
+
+    munmap( p_mapping->wm_base, p_mapping->wm_length );
+    SAL_free( p_device, p_mapping );
+}
+
+#endif /* SALX_WAVE_MMAP */
+
+/** Loads a WAV file from disk and creates a sample from it.
+    @ingroup extras
+    @param [in] device pointer to output device
+    @param [out] pp_sample address of a pointer to a sample to store the new sample
+    @param [in] kp_filename name of the WAV file to load
+    @returns SALERR_OK on success, @ref sal_error_e on failure
+    On systems with mmap() the file is mapped instead of read.  If the file's
+    data chunk already matches the device's format, the sample's data points
+    directly into the mapping, so no conversion or copy takes place, load time
+    is independent of the file's size, and processes playing the same file
+    share its pages through the page cache.  While such a sample plays, the
+    kernel is given read-ahead hints based on each voice's cursor.  Files that
+    don't match the device's format are converted out of the mapping exactly
+    as SALx_create_sample_from_wave() would do, and the mapping is released
+    right away.  On other systems the file is simply read into memory and
+    handed to SALx_create_sample_from_wave().
+*/
+sal_error_e
+SALx_create_sample_from_wave_file( SAL_Device *device,
+                                   SAL_Sample **pp_sample,
+                                   const char *kp_filename )
+{
+#ifdef SALX_WAVE_MMAP
+    int fd;
+    struct stat st;
+    void *p_base;
+    sal_error_e err;
+    SAL_DeviceInfo dinfo;
+    _SAL_WaveChunk wc;
+    const sal_byte_t *kp_data = 0;
+
+    if ( device == 0 || pp_sample == 0 || kp_filename == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    *pp_sample = 0;
+
+    if ( ( fd = open( kp_filename, O_RDONLY ) ) == -1 )
+    {
+        _SAL_warning( device, "Could not open %s\n", kp_filename );
+        return SALERR_SYSTEMFAILURE;
+    }
+
+    if ( fstat( fd, &st ) == -1 || st.st_size <= 0 || st.st_size > 0x7FFFFFFF )
+    {
+        close( fd );
+        return SALERR_INVALIDPARAM;
+    }
+
+    p_base = mmap( 0, ( size_t ) st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+
+    /* the mapping holds its own reference to the file */
+    close( fd );
+
+    if ( p_base == MAP_FAILED )
+    {
+        _SAL_warning( device, "Could not map %s\n", kp_filename );
+        return SALERR_SYSTEMFAILURE;
+    }
+
+    if ( ( err = s_parse_wave( p_base, ( int ) st.st_size, &wc, &kp_data, 1 ) ) != SALERR_OK )
+    {
+        munmap( p_base, ( size_t ) st.st_size );
+        return err;
+    }
+
+    memset( &dinfo, 0, sizeof( dinfo ) );
+    dinfo.di_size = sizeof( dinfo );
+    SAL_get_device_info( device, &dinfo );
+
+    /* zero-copy is only possible if the data is exactly what the mixer expects:
+       same format, host byte order and naturally aligned samples */
+    if ( wc.wc_sample_rate     == dinfo.di_sample_rate &&
+         wc.wc_num_channels    == dinfo.di_channels &&
+         wc.wc_bits_per_sample == dinfo.di_bits &&
+#ifdef POSH_BIG_ENDIAN
+         dinfo.di_bits == 8 &&
+#endif
+         ( ( kp_data - ( const sal_byte_t * ) p_base ) % dinfo.di_bytes_per_sample ) == 0 )
     {
-        /* same number of channels */
-        if ( dinfo.di_channels == wc.wc_num_channels )
+        SAL_SampleArgs args;
+        _SAL_WaveMapping *p_mapping = 0;
+
+        /* the per-voice windows live in the same block, right after the mapping */
+        if ( ( err = SAL_alloc( device, ( void ** ) &p_mapping, sizeof( *p_mapping ) + device->device_max_voices * sizeof( sal_u32_t ) ) ) != SALERR_OK )
         {
-            if ( dinfo.di_channels == 1 )
-            {
-                if ( dinfo.di_bits == 8 && wc.wc_bits_per_sample == 16 )
-                {
-                    transform = transform_mono_16_to_mono_8;
-                }
-                else if ( dinfo.di_bits == 16 && wc.wc_bits_per_sample == 8 )
-                {
-                    transform = transform_mono_8_to_mono_16;
-                }
-            }
-            else if ( dinfo.di_channels == 2 )
-            {
-                if ( dinfo.di_bits == 8 && wc.wc_bits_per_sample == 16 )
-                {
-                    transform = transform_stereo_16_to_stereo_8;
-                }
-                else if ( dinfo.di_bits == 16 && wc.wc_bits_per_sample == 8 )
-                {
-                    transform = transform_stereo_8_to_stereo_16;
-                }
-            }
+            munmap( p_base, ( size_t ) st.st_size );
+            return err;
         }
-        /* different number of channels */
-        else
+
+        p_mapping->wm_base           = p_base;
+        p_mapping->wm_length         = ( size_t ) st.st_size;
+        p_mapping->wm_advised_windows = ( sal_u32_t * ) ( p_mapping + 1 );
+        memset( p_mapping->wm_advised_windows, 0, device->device_max_voices * sizeof( sal_u32_t ) );
+
+        args.sarg_ptr = p_mapping;
+
+        if ( ( err = SAL_create_sample( device, pp_sample, 0, s_wave_mmap_decoder, s_wave_mmap_destroy, &args ) ) != SALERR_OK )
         {
-            /* stereo to mono conversion */
-            if ( dinfo.di_channels == 1 )
-            {
-                /* with bit conversion */
-                if ( dinfo.di_bits != wc.wc_bits_per_sample )
-                {
-                    if ( dinfo.di_bits == 8 )
-                    {
-                        transform = transform_stereo_16_to_mono_8;
-                    }
-                    else if ( dinfo.di_bits == 16 )
-                    {
-                        transform = transform_stereo_8_to_mono_16;
-                    }
-                }
-                /* without bit conversion */
-                else
-                {
-                    if ( dinfo.di_bits == 8 )
-                    {
-                        transform = transform_stereo_8_to_mono_8;
-                    }
-                    else if ( dinfo.di_bits == 16 )
-                    {
-                        transform = transform_stereo_16_to_mono_16;
-                    }
-                }
-            }
-            /* mono to stereo conversion */
-            else if ( dinfo.di_channels == 2 )
-            {
-                /* with bit conversion */
-                if ( dinfo.di_bits != wc.wc_bits_per_sample )
-                {
-                    if ( dinfo.di_bits == 8 )
-                    {
-                        transform = transform_mono_16_to_stereo_8;
-                    }
-                    else if ( dinfo.di_bits == 16 )
-                    {
-                        transform = transform_mono_8_to_stereo_16;
-                    }
-                }
-                /* without bit conversion */
-                else
-                {
-                    if ( dinfo.di_bits == 8 )
-                    {
-                        transform = transform_mono_8_to_stereo_8;
-                    }
-                    else if ( dinfo.di_bits == 16 )
-                    {
-                        transform = transform_mono_16_to_stereo_16;
-                    }
-                }
-            }
+            SAL_free( device, p_mapping );
+            munmap( p_base, ( size_t ) st.st_size );
+            return err;
         }
+
+        (*pp_sample)->sample_data        = ( sal_byte_t * ) kp_data;
+        (*pp_sample)->sample_num_samples = wc.wc_data_size / dinfo.di_bytes_per_sample;
+
+        /* get the start of the sample in flight before the first play */
+        s_wave_advise( p_mapping, kp_data, 0, 2 * SALX_WAVE_READAHEAD_BYTES );
+
+        return SALERR_OK;
     }
 
-    if ( transform == 0 )
+    /* formats differ, so convert out of the mapping and let it go */
+    err = SALx_create_sample_from_wave( device, pp_sample, p_base, ( int ) st.st_size );
+
+    munmap( p_base, ( size_t ) st.st_size );
+
+    return err;
+#else
+    FILE *fp = 0;
+    long length;
+    void *p_buffer = 0;
+    sal_error_e err;
+
+    if ( device == 0 || pp_sample == 0 || kp_filename == 0 )
     {
-        return SALERR_INVALIDFORMAT;
+        return SALERR_INVALIDPARAM;
     }
 
-    /* # samples = num_frames * num_channels */
-    num_samples = ( wc.wc_data_size / ( wc.wc_bits_per_sample / 8 )) * dinfo.di_channels / wc.wc_num_channels;
+    *pp_sample = 0;
 
-    /* allocate new sample and zero it out */
-    SAL_create_sample( device, pp_sample, num_samples, _SAL_generic_decode_sample, _SAL_generic_destroy_sample, NULL );
+    if ( ( fp = fopen( kp_filename, "rb" ) ) == 0 )
+    {
+        _SAL_warning( device, "Could not open %s\n", kp_filename );
+        return SALERR_SYSTEMFAILURE;
+    }
+
+    fseek( fp, 0, SEEK_END );
+    length = ftell( fp );
+    fseek( fp, 0, SEEK_SET );
 
-    /* iterate over data, starting at kp_bytes, and transform into the data
-       buffer we allocated for this sample, a frame at a time */
-    for ( i = 0, p_dst = (*pp_sample)->sample_data; i < wc.wc_data_size; i += src_frame_size, p_dst += dinfo.di_bytes_per_frame )
+    if ( length <= 0 )
     {
-        transform( &kp_bytes[ i ], p_dst );
+        fclose( fp );
+        return SALERR_INVALIDPARAM;
     }
 
-    return SALERR_OK;
+    if ( ( err = SAL_alloc( device, &p_buffer, length ) ) != SALERR_OK )
+    {
+        fclose( fp );
+        return err;
+    }
+
+    if ( fread( p_buffer, length, 1, fp ) != 1 )
+    {
+        err = SALERR_SYSTEMFAILURE;
+    }
+    else
+    {
+        err = SALx_create_sample_from_wave( device, pp_sample, p_buffer, length );
+    }
+
+    SAL_free( device, p_buffer );
+    fclose( fp );
+
+    return err;
+#endif /* SALX_WAVE_MMAP */
 }
@@ -46,10 +46,33 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 extern "C" {
 #endif
 
+/** @brief Format and location of the PCM data in a WAV file, as returned by SALx_get_wave_info */
+typedef struct SALx_WaveInfo_s
+{
+    sal_i32_t   wi_channels;     /**< number of channels */
+    sal_i32_t   wi_bits;         /**< bits per sample */
+    sal_i32_t   wi_sample_rate;  /**< in frames/second */
+    sal_i32_t   wi_data_offset;  /**< offset of the PCM data from the start of the file, in bytes */
+    sal_i32_t   wi_data_size;    /**< size of the PCM data, in bytes */
+} SALx_WaveInfo;
+
+SAL_PUBLIC_API( sal_error_e ) SALx_get_wave_info( const void *kp_src,
+                                                  int src_size,
+                                                  SALx_WaveInfo *p_info );
 SAL_PUBLIC_API( sal_error_e ) SALx_create_sample_from_wave( SAL_Device *device,
                                                             SAL_Sample **pp_sample,
                                                             const void *kp_src,
                                                             int src_size );
+SAL_PUBLIC_API( sal_error_e ) SALx_create_sample_from_wave_file( SAL_Device *device,
+                                                                 SAL_Sample **pp_sample,
+                                                                 const char *kp_filename );
+SAL_PUBLIC_API( sal_error_e ) SALx_convert_pcm( const void *kp_src,
+                                                int src_channels,
+                                                int src_bits,
+                                                void *p_dst,
+                                                int dst_channels,
+                                                int dst_bits,
+                                                int num_frames );
 
 #ifdef __cplusplus
 }
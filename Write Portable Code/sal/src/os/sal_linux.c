@@ -45,12 +45,15 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
+#include <time.h>
 
-extern sal_error_e _SAL_create_thread_pthreads( SAL_Device *device, SAL_THREAD_FUNC fnc, void *args );
+extern sal_error_e _SAL_create_thread_pthreads( SAL_Device *device, SAL_THREAD_FUNC fnc, void *args, sal_u32_t flags );
 extern sal_error_e _SAL_create_mutex_pthreads( SAL_Device *device, sal_mutex_t *p_mtx );
 extern sal_error_e _SAL_lock_mutex_pthreads( SAL_Device *device, sal_mutex_t mutex );
 extern sal_error_e _SAL_unlock_mutex_pthreads( SAL_Device *device, sal_mutex_t mutex );
 extern sal_error_e _SAL_destroy_mutex_pthreads( SAL_Device *device, sal_mutex_t mutex );
+extern void        _SAL_configure_memory_posix( SAL_Device *device );
 
 extern
 sal_error_e
@@ -68,6 +71,14 @@ _SAL_create_device_data_oss( SAL_Device *device,
                              sal_u32_t desired_bits, 
                              sal_u32_t desired_sample_rate );
 
+extern 
+sal_error_e
+_SAL_create_device_data_null( SAL_Device *device, 
+                              const SAL_SystemParameters *kp_sp,
+                              sal_u32_t desired_channels, 
+                              sal_u32_t desired_bits, 
+                              sal_u32_t desired_sample_rate );
+
 static
 sal_error_e
 _SAL_sleep_linux( SAL_Device *device, sal_u32_t duration )
@@ -77,6 +88,38 @@ _SAL_sleep_linux( SAL_Device *device, sal_u32_t duration )
     return SALERR_OK;
 }
 
+static
+sal_u64_t
+_SAL_get_time_linux( SAL_Device *device )
+{
+    struct timespec ts;
+
+    device = device;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return ( sal_u64_t ) ts.tv_sec * 1000000000 + ( sal_u64_t ) ts.tv_nsec;
+}
+
+static
+sal_error_e
+_SAL_sleep_until_linux( SAL_Device *device, sal_u64_t deadline )
+{
+    struct timespec ts;
+    int result;
+
+    device = device;
+
+    ts.tv_sec  = ( time_t ) ( deadline / 1000000000 );
+    ts.tv_nsec = ( long ) ( deadline % 1000000000 );
+
+    /* absolute, so a signal just means going back to sleep */
+    while ( ( result = clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, 0 ) ) == EINTR )
+        ;
+
+    return ( result == 0 ) ? SALERR_OK : SALERR_SYSTEMFAILURE;
+}
+
 sal_error_e
 _SAL_create_device_data( SAL_Device *device, 
                          const SAL_SystemParameters *kp_sp, 
@@ -84,13 +127,33 @@ _SAL_create_device_data( SAL_Device *device,
                          sal_u32_t desired_bits, 
                          sal_u32_t desired_sample_rate )
 {
+    sal_error_e err;
+
     device->device_fnc_sleep          = _SAL_sleep_linux;
+    device->device_fnc_get_time       = _SAL_get_time_linux;
+    device->device_fnc_sleep_until    = _SAL_sleep_until_linux;
     device->device_fnc_create_thread  = _SAL_create_thread_pthreads;
     device->device_fnc_create_mutex   = _SAL_create_mutex_pthreads;
     device->device_fnc_destroy_mutex  = _SAL_destroy_mutex_pthreads;
     device->device_fnc_lock_mutex     = _SAL_lock_mutex_pthreads;
     device->device_fnc_unlock_mutex   = _SAL_unlock_mutex_pthreads;
 
+    _SAL_configure_memory_posix( device );
+
+    /* the backend may start its audio thread before it returns, and that
+       thread locks the device */
+    if ( ( err = _SAL_create_mutex( device, &device->device_mutex ) ) != SALERR_OK )
+    {
+        return err;
+    }
+
+#ifdef SAL_SUPPORT_NULL
+    if ( kp_sp->sp_flags & SAL_SPF_NULL )
+    {
+        return _SAL_create_device_data_null( device, kp_sp, desired_channels, desired_bits, desired_sample_rate );
+    }
+#endif
+
     if ( kp_sp->sp_flags & SAL_SPF_ALSA )
     {
 #ifdef SAL_SUPPORT_ALSA
@@ -44,8 +44,10 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #if defined POSH_OS_OSX || defined SAL_DOXYGEN
 
 #include <unistd.h>
+#include <mach/mach_time.h>
 
-extern sal_error_e _SAL_create_thread_pthreads( SAL_Device *device, SAL_THREAD_FUNC fnc, void *args );
+extern sal_error_e _SAL_create_thread_pthreads( SAL_Device *device, SAL_THREAD_FUNC fnc, void *args, sal_u32_t flags );
+extern void        _SAL_configure_memory_posix( SAL_Device *device );
 extern sal_error_e _SAL_create_mutex_osx( SAL_Device *device, sal_mutex_t *p_mutex );
 extern sal_error_e _SAL_lock_mutex_osx( SAL_Device *device, sal_mutex_t mtx );
 extern sal_error_e _SAL_destroy_mutex_osx( SAL_Device *device, sal_mutex_t mtx );
@@ -60,6 +62,36 @@ _SAL_sleep_osx( SAL_Device *device, sal_u32_t duration )
     return SALERR_OK;
 }
 
+static
+sal_u64_t
+_SAL_get_time_osx( SAL_Device *device )
+{
+    static mach_timebase_info_data_t s_timebase;
+    sal_u64_t ticks = mach_absolute_time();
+
+    if ( s_timebase.denom == 0 )
+    {
+        mach_timebase_info( &s_timebase );
+    }
+
+    /* split up so ticks * numer cannot overflow */
+    return ( ticks / s_timebase.denom ) * s_timebase.numer + ( ticks % s_timebase.denom ) * s_timebase.numer / s_timebase.denom;
+}
+
+static
+sal_error_e
+_SAL_sleep_until_osx( SAL_Device *device, sal_u64_t deadline )
+{
+    mach_timebase_info_data_t timebase;
+    sal_u64_t ticks;
+
+    mach_timebase_info( &timebase );
+
+    ticks = ( deadline / timebase.numer ) * timebase.denom + ( deadline % timebase.numer ) * timebase.denom / timebase.numer;
+
+    return ( mach_wait_until( ticks ) == KERN_SUCCESS ) ? SALERR_OK : SALERR_SYSTEMFAILURE;
+}
+
 extern
 sal_error_e
 _SAL_create_device_data_coreaudio( SAL_Device *device,
@@ -68,6 +100,14 @@ _SAL_create_device_data_coreaudio( SAL_Device *device,
                                    sal_u32_t desired_bits,
                                    sal_u32_t desired_sample_rate );
 
+extern
+sal_error_e
+_SAL_create_device_data_null( SAL_Device *device,
+                              const SAL_SystemParameters *kp_sp,
+                              sal_u32_t desired_channels,
+                              sal_u32_t desired_bits,
+                              sal_u32_t desired_sample_rate );
+
 sal_error_e
 _SAL_create_device_data( SAL_Device *device,
 			             const SAL_SystemParameters *kp_sp,
@@ -75,13 +115,33 @@ _SAL_create_device_data( SAL_Device *device,
 			             sal_u32_t desired_bits,
 			             sal_u32_t desired_sample_rate )
 {
+    sal_error_e err;
+
     device->device_fnc_sleep          = _SAL_sleep_osx;
+    device->device_fnc_get_time       = _SAL_get_time_osx;
+    device->device_fnc_sleep_until    = _SAL_sleep_until_osx;
     device->device_fnc_create_thread  = _SAL_create_thread_pthreads;
     device->device_fnc_create_mutex   = _SAL_create_mutex_osx;
     device->device_fnc_destroy_mutex  = _SAL_destroy_mutex_osx;
     device->device_fnc_lock_mutex     = _SAL_lock_mutex_osx;
     device->device_fnc_unlock_mutex   = _SAL_unlock_mutex_osx;
 
+    _SAL_configure_memory_posix( device );
+
+    /* the backend may start its audio thread before it returns, and that
+       thread locks the device */
+    if ( ( err = _SAL_create_mutex( device, &device->device_mutex ) ) != SALERR_OK )
+    {
+        return err;
+    }
+
+#ifdef SAL_SUPPORT_NULL
+    if ( kp_sp->sp_flags & SAL_SPF_NULL )
+    {
+        return _SAL_create_device_data_null( device, kp_sp, desired_channels, desired_bits, desired_sample_rate );
+    }
+#endif
+
     return _SAL_create_device_data_coreaudio( device, kp_sp, desired_channels, desired_bits, desired_sample_rate );
 }
 
@@ -36,12 +36,15 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 /** @file sal_pthread.c
     @brief pthreads implementation (Linux and OS X)
     @remarks SAL uses pthreads for Linux and OS X, however it only uses
-    pthread mutices on Linux since Linux provides recursive mutexes and
-    OS X does not.  For locking mutexes we use NSRecursiveMutex on OS X.
+    pthread mutices on Linux.  For locking mutexes we use NSRecursiveMutex
+    on OS X.
 */
 #ifndef SAL_DOXYGEN
 #  define SAL_BUILDING_LIB 1
 #endif
+#if defined __linux__ && !defined _GNU_SOURCE
+#  define _GNU_SOURCE 1 /* pthread_setaffinity_np, pthread_setname_np */
+#endif
 #include "../sal.h"
 
 #if defined POSH_OS_UNIX || defined POSH_OS_CYGWIN32 || defined POSH_OS_OSX || defined SAL_DOXYGEN
@@ -49,18 +52,144 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <pthread.h>
 #include <semaphore.h>
 #include <errno.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/mman.h>
 
 /** @defgroup pthreads Pthreads Implementation functions
     @ingroup Implementations
 */
 
+/** @internal
+    @brief what a new thread needs before it can call the backend's thread function
+    @ingroup pthreads */
+typedef struct 
+{
+   SAL_Device      *ts_device;
+   SAL_THREAD_FUNC  ts_fnc;
+   void            *ts_args;
+   sal_u32_t        ts_flags;
+} _SAL_ThreadStart;
+
+/** @internal
+    @brief applies the thread settings from the device's system parameters to
+    the calling thread
+    @remarks Every setting is optional and a failure only costs that setting,
+    the thread carries on at normal priority.
+    @ingroup pthreads */
+static
+void
+s_configure_thread( SAL_Device *device )
+{
+   const SAL_SystemParameters *kp_sp = &device->device_system_parameters;
+   int result;
+
+   if ( kp_sp->sp_thread_name )
+   {
+#if defined __linux__
+      char name[ 16 ]; /* Linux limits thread names to 15 characters */
+
+      strncpy( name, kp_sp->sp_thread_name, sizeof( name ) - 1 );
+      name[ sizeof( name ) - 1 ] = 0;
+      pthread_setname_np( pthread_self(), name );
+#elif defined POSH_OS_OSX
+      pthread_setname_np( kp_sp->sp_thread_name );
+#endif
+   }
+
+   if ( kp_sp->sp_cpu_affinity )
+   {
+#if defined __linux__
+      cpu_set_t cpus;
+      int i;
+
+      CPU_ZERO( &cpus );
+      for ( i = 0; i < 64 && i < CPU_SETSIZE; i++ )
+      {
+         if ( kp_sp->sp_cpu_affinity & ( ( ( sal_u64_t ) 1 ) << i ) )
+         {
+            CPU_SET( i, &cpus );
+         }
+      }
+
+      if ( ( result = pthread_setaffinity_np( pthread_self(), sizeof( cpus ), &cpus ) ) != 0 )
+      {
+         _SAL_warning( device, "Could not set the audio thread's CPU affinity (%s)\n", strerror( result ) );
+      }
+#else
+      _SAL_warning( device, "CPU affinity is not supported on this platform, ignoring it\n" );
+#endif
+   }
+
+   if ( kp_sp->sp_thread_policy == SAL_THREAD_POLICY_FIFO || kp_sp->sp_thread_policy == SAL_THREAD_POLICY_RR )
+   {
+      struct sched_param param;
+      int policy = ( kp_sp->sp_thread_policy == SAL_THREAD_POLICY_FIFO ) ? SCHED_FIFO : SCHED_RR;
+      int lo = sched_get_priority_min( policy );
+      int hi = sched_get_priority_max( policy );
+      int priority = kp_sp->sp_thread_priority;
+
+      if ( priority == 0 )
+      {
+         priority = ( lo + hi ) / 2;
+      }
+      else if ( priority < lo )
+      {
+         priority = lo;
+      }
+      else if ( priority > hi )
+      {
+         priority = hi;
+      }
+
+      memset( &param, 0, sizeof( param ) );
+      param.sched_priority = priority;
+
+      if ( ( result = pthread_setschedparam( pthread_self(), policy, &param ) ) != 0 )
+      {
+         _SAL_warning( device, 
+                       "Could not give the audio thread realtime priority %d (%s), it runs at normal priority. "
+                       "The process needs CAP_SYS_NICE or an RLIMIT_RTPRIO of at least %d.\n",
+                       priority, strerror( result ), priority );
+      }
+   }
+   else if ( kp_sp->sp_thread_policy != SAL_THREAD_POLICY_DEFAULT )
+   {
+      _SAL_warning( device, "Unknown thread policy %u, ignoring it\n", kp_sp->sp_thread_policy );
+   }
+}
+
+/** @internal
+    @brief entry point of every thread created by _SAL_create_thread_pthreads()
+    @remarks Only @ref SAL_THREAD_AUDIO threads are configured, loader and
+    streamer threads keep the process's normal scheduling.
+    @ingroup pthreads */
+static
+void *
+s_thread_start( void *args )
+{
+   _SAL_ThreadStart ts = *( _SAL_ThreadStart * ) args;
+
+   SAL_free( ts.ts_device, args );
+
+   if ( ts.ts_flags & SAL_THREAD_AUDIO )
+   {
+      s_configure_thread( ts.ts_device );
+   }
+
+   ts.ts_fnc( ts.ts_args );
+
+   return 0;
+}
+
 /** @brief pthreads implementation for _SAL_create_thread()  
     @ingroup pthreads */
 sal_error_e
-_SAL_create_thread_pthreads( SAL_Device *device, SAL_THREAD_FUNC fnc, void *args )
+_SAL_create_thread_pthreads( SAL_Device *device, SAL_THREAD_FUNC fnc, void *args, sal_u32_t flags )
 {
    pthread_attr_t attr;
    pthread_t tid;
+   _SAL_ThreadStart *p_ts = 0;
    int result;
 
    if ( device == 0 || fnc == 0 || args == 0 )
@@ -68,16 +197,76 @@ _SAL_create_thread_pthreads( SAL_Device *device, SAL_THREAD_FUNC fnc, void *args
       return SALERR_INVALIDPARAM;
    }
 
+   if ( SAL_alloc( device, ( void ** ) &p_ts, sizeof( *p_ts ) ) != SALERR_OK )
+   {
+      return SALERR_OUTOFMEMORY;
+   }
+
+   p_ts->ts_device = device;
+   p_ts->ts_fnc    = fnc;
+   p_ts->ts_args   = args;
+   p_ts->ts_flags  = flags;
+
    pthread_attr_init(&attr);
 
-   result = pthread_create( &tid, &attr, (void* (*)(void *))fnc, args );
+   result = pthread_create( &tid, &attr, s_thread_start, p_ts );
+
+   pthread_attr_destroy(&attr);
 
    if ( result != 0 )
    {
+      SAL_free( device, p_ts );
       return SALERR_SYSTEMFAILURE;
    }
 
    return SALERR_OK;
 }
 
+/** @internal
+    @brief mlock() implementation of device_fnc_lock_memory
+    @ingroup pthreads */
+static
+void
+s_lock_memory_posix( SAL_Device *device, const void *p, size_t sz )
+{
+   if ( mlock( p, sz ) != 0 )
+   {
+      _SAL_warning( device, "Could not lock SAL's buffers into memory (%s), they may be paged out. "
+                            "Raise RLIMIT_MEMLOCK to allow it.\n", strerror( errno ) );
+
+      /* one warning is enough, the rest would fail the same way */
+      device->device_fnc_lock_memory = 0;
+   }
+}
+
+/** @internal
+    @brief applies the memory locking requested in the device's system parameters
+    @remarks Must be called before the backend allocates its buffers.
+    @ingroup pthreads */
+void
+_SAL_configure_memory_posix( SAL_Device *device )
+{
+   switch ( device->device_system_parameters.sp_memory_lock )
+   {
+   case SAL_MEMLOCK_NONE:
+      break;
+
+   case SAL_MEMLOCK_BUFFERS:
+      device->device_fnc_lock_memory = s_lock_memory_posix;
+      break;
+
+   case SAL_MEMLOCK_ALL:
+      if ( mlockall( MCL_CURRENT | MCL_FUTURE ) != 0 )
+      {
+         _SAL_warning( device, "Could not lock the process into memory (%s), it may be paged out. "
+                               "Raise RLIMIT_MEMLOCK to allow it.\n", strerror( errno ) );
+      }
+      break;
+
+   default:
+      _SAL_warning( device, "Unknown memory lock mode %u, ignoring it\n", device->device_system_parameters.sp_memory_lock );
+      break;
+   }
+}
+
 #endif
@@ -36,12 +36,16 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 /** @file sal_pthread_mutex.c
     @brief pthreads mutex implementation (Linux-only)
     @remarks SAL uses pthreads for Linux and OS X, however it only uses
-    pthread mutices on Linux since Linux provides recursive mutices and
-    OS X does not.  For locking we use NSRecursiveMutex on OS X.
+    pthread mutices on Linux.  For locking we use NSRecursiveMutex on OS X.
+    SAL never locks a mutex it already holds, so on Linux they are glibc's
+    adaptive mutices, which spin briefly before sleeping on a futex.
 */
 #ifndef SAL_DOXYGEN
 #  define SAL_BUILDING_LIB 1
 #endif
+#if defined __linux__ && !defined _GNU_SOURCE
+#  define _GNU_SOURCE 1 /* PTHREAD_MUTEX_ADAPTIVE_NP */
+#endif
 #include "../sal.h"
 
 #if defined POSH_OS_LINUX || defined POSH_OS_CYGWIN32 || defined SAL_DOXYGEN
@@ -69,13 +73,16 @@ _SAL_create_mutex_pthreads( SAL_Device *device, sal_mutex_t *p_mtx )
         return SALERR_OUTOFMEMORY;
     }
 
-#if defined POSH_OS_LINUX 
+#if defined POSH_OS_LINUX && defined PTHREAD_ADAPTIVE_MUTEX_INITIALIZER_NP
     {
         pthread_mutexattr_t attr;
 
-        attr.__mutexkind = PTHREAD_MUTEX_RECURSIVE_NP;
+        pthread_mutexattr_init( &attr );
+        pthread_mutexattr_settype( &attr, PTHREAD_MUTEX_ADAPTIVE_NP );
 
         pthread_mutex_init( (pthread_mutex_t * ) (*p_mtx), &attr );
+
+        pthread_mutexattr_destroy( &attr );
     }
 #else
     pthread_mutex_init( (pthread_mutex_t * ) (*p_mtx), NULL );
@@ -128,6 +135,8 @@ _SAL_destroy_mutex_pthreads( SAL_Device *device, sal_mutex_t mutex )
 
     pthread_mutex_destroy( ( pthread_mutex_t * ) mutex );
 
+    device->device_callbacks.free( mutex );
+
     return SALERR_OK;
 }
 
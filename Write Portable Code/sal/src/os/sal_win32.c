@@ -52,10 +52,11 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 extern sal_error_e _SAL_create_device_data_dsound( SAL_Device *device, const SAL_SystemParameters *kp_sp, sal_u32_t desired_channels, sal_u32_t desired_bits, sal_u32_t desired_sample_rate );
 extern sal_error_e _SAL_create_device_data_waveout( SAL_Device *device, const SAL_SystemParameters *kp_sp, sal_u32_t desired_channels, sal_u32_t desired_bits, sal_u32_t desired_sample_rate );
+extern sal_error_e _SAL_create_device_data_null( SAL_Device *device, const SAL_SystemParameters *kp_sp, sal_u32_t desired_channels, sal_u32_t desired_bits, sal_u32_t desired_sample_rate );
 
 static
 sal_error_e
-_SAL_create_thread_win32( SAL_Device *device, SAL_THREAD_FUNC fnc, void *targs )
+_SAL_create_thread_win32( SAL_Device *device, SAL_THREAD_FUNC fnc, void *targs, sal_u32_t flags )
 {
     HANDLE hThread;
 
@@ -69,7 +70,10 @@ _SAL_create_thread_win32( SAL_Device *device, SAL_THREAD_FUNC fnc, void *targs )
         return SALERR_SYSTEMFAILURE;
     }
 
-    SetThreadPriority( hThread, THREAD_PRIORITY_HIGHEST );
+    if ( flags & SAL_THREAD_AUDIO )
+    {
+        SetThreadPriority( hThread, THREAD_PRIORITY_HIGHEST );
+    }
 
     return SALERR_OK;
 }
@@ -158,6 +162,8 @@ _SAL_sleep_win32( SAL_Device *device, sal_u32_t duration )
 sal_error_e
 _SAL_create_device_data( SAL_Device *device, const SAL_SystemParameters *kp_sp, sal_u32_t desired_channels, sal_u32_t desired_bits, sal_u32_t desired_sample_rate )
 {
+    sal_error_e err;
+
     device->device_fnc_create_thread = _SAL_create_thread_win32;
     device->device_fnc_create_mutex  = _SAL_create_mutex_win32;
     device->device_fnc_lock_mutex    = _SAL_lock_mutex_win32;
@@ -165,6 +171,20 @@ _SAL_create_device_data( SAL_Device *device, const SAL_SystemParameters *kp_sp,
     device->device_fnc_destroy_mutex = _SAL_destroy_mutex_win32;
     device->device_fnc_sleep         = _SAL_sleep_win32;
 
+    /* the backend may start its audio thread before it returns, and that
+       thread locks the device */
+    if ( ( err = _SAL_create_mutex( device, &device->device_mutex ) ) != SALERR_OK )
+    {
+        return err;
+    }
+
+#ifdef SAL_SUPPORT_NULL
+    if ( kp_sp->sp_flags & SAL_SPF_NULL )
+    {
+        return _SAL_create_device_data_null( device, kp_sp, desired_channels, desired_bits, desired_sample_rate );
+    }
+#endif
+
     if ( kp_sp->sp_flags & SAL_SPF_WAVEOUT )
     {
 #ifdef SAL_SUPPORT_WAVEOUT
@@ -79,7 +79,7 @@ WINAPI s_bridge_function( LPVOID lpParameter )
 
 static
 sal_error_e
-_SAL_create_thread_wince( SAL_Device *device, SAL_THREAD_FUNC fnc, void *targs )
+_SAL_create_thread_wince( SAL_Device *device, SAL_THREAD_FUNC fnc, void *targs, sal_u32_t flags )
 {
     HANDLE hThread;
     _SAL_WinCEBridgeFunctionParameters bfp;
@@ -102,7 +102,10 @@ _SAL_create_thread_wince( SAL_Device *device, SAL_THREAD_FUNC fnc, void *targs )
         return SALERR_SYSTEMFAILURE;
     }
 
-    SetThreadPriority( hThread, THREAD_PRIORITY_HIGHEST );
+    if ( flags & SAL_THREAD_AUDIO )
+    {
+        SetThreadPriority( hThread, THREAD_PRIORITY_HIGHEST );
+    }
 
     return SALERR_OK;
 }
@@ -191,6 +194,8 @@ _SAL_sleep_wince( SAL_Device *device, sal_u32_t duration )
 sal_error_e
 _SAL_create_device_data( SAL_Device *device, const SAL_SystemParameters *kp_sp, sal_u32_t desired_channels, sal_u32_t desired_bits, sal_u32_t desired_sample_rate )
 {
+    sal_error_e err;
+
     device->device_fnc_create_thread = _SAL_create_thread_wince;
     device->device_fnc_create_mutex  = _SAL_create_mutex_wince;
     device->device_fnc_lock_mutex    = _SAL_lock_mutex_wince;
@@ -198,6 +203,13 @@ _SAL_create_device_data( SAL_Device *device, const SAL_SystemParameters *kp_sp,
     device->device_fnc_destroy_mutex = _SAL_destroy_mutex_wince;
     device->device_fnc_sleep         = _SAL_sleep_wince;
 
+    /* the backend may start its audio thread before it returns, and that
+       thread locks the device */
+    if ( ( err = _SAL_create_mutex( device, &device->device_mutex ) ) != SALERR_OK )
+    {
+        return err;
+    }
+
     if ( kp_sp->sp_flags & SAL_SPF_WAVEOUT )
     {
 #ifdef SAL_SUPPORT_WAVEOUT
@@ -41,6 +41,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 #include "posh.h"
 
+#include <string.h>
+
 #if !defined FORCE_DOXYGEN
 
 #if !defined POSH_NO_FLOAT
@@ -734,6 +736,241 @@ POSH_ReadI64FromBig( const void *src )
 
 #endif /* POSH_64BIT_INTEGER */
 
+/* ---------------------------------------------------------------------------*/
+/*                             BULK CONVERSION                                */
+/* ---------------------------------------------------------------------------*/
+
+/* 
+ * Copies count 16-bit values, byte swapping them on the way.  When both
+ * buffers are 32-bit aligned two values are swapped per 32-bit word, which
+ * also gives the compiler a loop it can vectorize.
+ */
+static void
+s_swap16_block( void *dst, const void *src, int count )
+{
+   const posh_byte_t *s = ( const posh_byte_t * ) src;
+   posh_byte_t *d = ( posh_byte_t * ) dst;
+   int i = 0;
+
+   if ( ( ( ( size_t ) s | ( size_t ) d ) & 3 ) == 0 )
+   {
+      const posh_u32_t *s32 = ( const posh_u32_t * ) s;
+      posh_u32_t *d32 = ( posh_u32_t * ) d;
+      int pairs = count / 2;
+
+      for ( i = 0; i < pairs; i++ )
+      {
+         posh_u32_t v = s32[ i ];
+
+         d32[ i ] = ( ( v & 0x00FF00FF ) << 8 ) | ( ( v >> 8 ) & 0x00FF00FF );
+      }
+
+      i = pairs * 2;
+   }
+
+   for ( ; i < count; i++ )
+   {
+      posh_byte_t tmp = s[ i * 2 ];
+
+      d[ i * 2 ]     = s[ i * 2 + 1 ];
+      d[ i * 2 + 1 ] = tmp;
+   }
+}
+
+/* Copies count 32-bit values, byte swapping them on the way */
+static void
+s_swap32_block( void *dst, const void *src, int count )
+{
+   const posh_byte_t *s = ( const posh_byte_t * ) src;
+   posh_byte_t *d = ( posh_byte_t * ) dst;
+   int i;
+
+   if ( ( ( ( size_t ) s | ( size_t ) d ) & 3 ) == 0 )
+   {
+      const posh_u32_t *s32 = ( const posh_u32_t * ) s;
+      posh_u32_t *d32 = ( posh_u32_t * ) d;
+
+      for ( i = 0; i < count; i++ )
+      {
+         posh_u32_t v = s32[ i ];
+
+         v = ( ( v & 0x00FF00FF ) << 8 ) | ( ( v >> 8 ) & 0x00FF00FF );
+         d32[ i ] = ( v << 16 ) | ( v >> 16 );
+      }
+      return;
+   }
+
+   for ( i = 0; i < count; i++ )
+   {
+      posh_byte_t b0 = s[ i * 4 ], b1 = s[ i * 4 + 1 ];
+
+      d[ i * 4 ]     = s[ i * 4 + 3 ];
+      d[ i * 4 + 1 ] = s[ i * 4 + 2 ];
+      d[ i * 4 + 2 ] = b1;
+      d[ i * 4 + 3 ] = b0;
+   }
+}
+
+/* Copies count values of size bytes each, for when no swap is needed */
+static void
+s_copy_block( void *dst, const void *src, int count, int size )
+{
+   if ( dst != src )
+   {
+      memmove( dst, src, ( size_t ) count * size );
+   }
+}
+
+/**
+ * Byte swaps an array of 16-bit unsigned values
+
+   @param dst [out] destination array, may be the same as src
+   @param src [in] source array
+   @param count [in] number of values to swap
+   @remarks neither buffer needs to be aligned, but it goes faster if they are
+ */
+void
+POSH_SwapU16Array( posh_u16_t *dst, const posh_u16_t *src, int count )
+{
+   s_swap16_block( dst, src, count );
+}
+
+/**
+ * Byte swaps an array of 32-bit unsigned values
+
+   @param dst [out] destination array, may be the same as src
+   @param src [in] source array
+   @param count [in] number of values to swap
+   @remarks neither buffer needs to be aligned, but it goes faster if they are
+ */
+void
+POSH_SwapU32Array( posh_u32_t *dst, const posh_u32_t *src, int count )
+{
+   s_swap32_block( dst, src, count );
+}
+
+/**
+ * Reads an array of 16-bit values from a little-endian buffer
+
+   @param dst [out] host-endian destination array, may be the same as src
+   @param src [in] little-endian source buffer
+   @param count [in] number of values to read
+   @remarks this is a straight copy on little-endian hosts
+ */
+void
+POSH_ReadU16ArrayFromLittle( posh_u16_t *dst, const void *src, int count )
+{
+#if defined POSH_LITTLE_ENDIAN
+   s_copy_block( dst, src, count, 2 );
+#else
+   s_swap16_block( dst, src, count );
+#endif
+}
+
+/**
+ * Reads an array of 16-bit values from a big-endian buffer
+
+   @param dst [out] host-endian destination array, may be the same as src
+   @param src [in] big-endian source buffer
+   @param count [in] number of values to read
+   @remarks this is a straight copy on big-endian hosts
+ */
+void
+POSH_ReadU16ArrayFromBig( posh_u16_t *dst, const void *src, int count )
+{
+#if defined POSH_LITTLE_ENDIAN
+   s_swap16_block( dst, src, count );
+#else
+   s_copy_block( dst, src, count, 2 );
+#endif
+}
+
+/**
+ * Writes an array of host-endian 16-bit values to a little-endian buffer
+
+   @param dst [out] little-endian destination buffer, may be the same as src
+   @param src [in] host-endian source array
+   @param count [in] number of values to write
+ */
+void
+POSH_WriteU16ArrayToLittle( void *dst, const posh_u16_t *src, int count )
+{
+   POSH_ReadU16ArrayFromLittle( ( posh_u16_t * ) dst, src, count );
+}
+
+/**
+ * Writes an array of host-endian 16-bit values to a big-endian buffer
+
+   @param dst [out] big-endian destination buffer, may be the same as src
+   @param src [in] host-endian source array
+   @param count [in] number of values to write
+ */
+void
+POSH_WriteU16ArrayToBig( void *dst, const posh_u16_t *src, int count )
+{
+   POSH_ReadU16ArrayFromBig( ( posh_u16_t * ) dst, src, count );
+}
+
+/**
+ * Reads an array of 32-bit values from a little-endian buffer
+
+   @param dst [out] host-endian destination array, may be the same as src
+   @param src [in] little-endian source buffer
+   @param count [in] number of values to read
+ */
+void
+POSH_ReadU32ArrayFromLittle( posh_u32_t *dst, const void *src, int count )
+{
+#if defined POSH_LITTLE_ENDIAN
+   s_copy_block( dst, src, count, 4 );
+#else
+   s_swap32_block( dst, src, count );
+#endif
+}
+
+/**
+ * Reads an array of 32-bit values from a big-endian buffer
+
+   @param dst [out] host-endian destination array, may be the same as src
+   @param src [in] big-endian source buffer
+   @param count [in] number of values to read
+ */
+void
+POSH_ReadU32ArrayFromBig( posh_u32_t *dst, const void *src, int count )
+{
+#if defined POSH_LITTLE_ENDIAN
+   s_swap32_block( dst, src, count );
+#else
+   s_copy_block( dst, src, count, 4 );
+#endif
+}
+
+/**
+ * Writes an array of host-endian 32-bit values to a little-endian buffer
+
+   @param dst [out] little-endian destination buffer, may be the same as src
+   @param src [in] host-endian source array
+   @param count [in] number of values to write
+ */
+void
+POSH_WriteU32ArrayToLittle( void *dst, const posh_u32_t *src, int count )
+{
+   POSH_ReadU32ArrayFromLittle( ( posh_u32_t * ) dst, src, count );
+}
+
+/**
+ * Writes an array of host-endian 32-bit values to a big-endian buffer
+
+   @param dst [out] big-endian destination buffer, may be the same as src
+   @param src [in] host-endian source array
+   @param count [in] number of values to write
+ */
+void
+POSH_WriteU32ArrayToBig( void *dst, const posh_u32_t *src, int count )
+{
+   POSH_ReadU32ArrayFromBig( ( posh_u32_t * ) dst, src, count );
+}
+
 /* ---------------------------------------------------------------------------*/
 /*                           FLOATING POINT SUPPORT                           */
 /* ---------------------------------------------------------------------------*/
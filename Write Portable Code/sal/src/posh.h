@@ -935,6 +935,20 @@ extern posh_i16_t  POSH_ReadI16FromBig( const void *src );
 extern posh_u32_t  POSH_ReadU32FromBig( const void *src );
 extern posh_i32_t  POSH_ReadI32FromBig( const void *src );
 
+/* bulk versions of the above, for converting whole buffers at once */
+extern void        POSH_SwapU16Array( posh_u16_t *dst, const posh_u16_t *src, int count );
+extern void        POSH_SwapU32Array( posh_u32_t *dst, const posh_u32_t *src, int count );
+
+extern void        POSH_ReadU16ArrayFromLittle( posh_u16_t *dst, const void *src, int count );
+extern void        POSH_ReadU16ArrayFromBig( posh_u16_t *dst, const void *src, int count );
+extern void        POSH_WriteU16ArrayToLittle( void *dst, const posh_u16_t *src, int count );
+extern void        POSH_WriteU16ArrayToBig( void *dst, const posh_u16_t *src, int count );
+
+extern void        POSH_ReadU32ArrayFromLittle( posh_u32_t *dst, const void *src, int count );
+extern void        POSH_ReadU32ArrayFromBig( posh_u32_t *dst, const void *src, int count );
+extern void        POSH_WriteU32ArrayToLittle( void *dst, const posh_u32_t *src, int count );
+extern void        POSH_WriteU32ArrayToBig( void *dst, const posh_u32_t *src, int count );
+
 #if defined POSH_64BIT_INTEGER
 extern posh_u64_t *POSH_WriteU64ToLittle( void *dst, posh_u64_t value );
 extern posh_i64_t *POSH_WriteI64ToLittle( void *dst, posh_i64_t value );
@@ -163,6 +163,87 @@ SAL_free( SAL_Device *device, void *p )
     return SALERR_OK;
 }
 
+/** @brief Allocates memory aligned to a power of two boundary.
+    @ingroup Utility
+    @param[in] device pointer to output device
+    @param[out] pp address of pointer where the location of allocated memory should be stored
+    @param[in] sz number of bytes to be allocated
+    @param[in] alignment required alignment in bytes, a power of two.  Buffers that
+    the mixer or SIMD code work on should use @ref SAL_ALIGNMENT.
+    @retval SALERR_OK on success
+    @retval SALERR_OUTOFMEMORY if memory is exhausted
+    @retval SALERR_INVALIDPARAM if device or pp are NULL, or alignment is not a power of two
+    @remarks This uses the alloc_aligned callback if one was given to SAL_create_device(),
+    otherwise it over-allocates with the alloc callback.  The memory must be released
+    with SAL_free_aligned(), not SAL_free().
+    @sa SAL_free_aligned
+*/
+sal_error_e 
+SAL_alloc_aligned( SAL_Device *device, void **pp, size_t sz, size_t alignment )
+{
+    sal_byte_t *p_raw;
+    sal_byte_t *p;
+
+    if ( device == 0 || pp == 0 || alignment == 0 || ( alignment & ( alignment - 1 ) ) != 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    if ( device->device_callbacks.alloc_aligned )
+    {
+        if ( ( *pp = device->device_callbacks.alloc_aligned( ( sal_u32_t ) sz, ( sal_u32_t ) alignment ) ) == 0 )
+        {
+            return SALERR_OUTOFMEMORY;
+        }
+
+        return SALERR_OK;
+    }
+
+    if ( alignment < sizeof( void * ) )
+    {
+        alignment = sizeof( void * );
+    }
+
+    /* the pointer alloc returned is kept just in front of the aligned block */
+    if ( ( p_raw = ( sal_byte_t * ) device->device_callbacks.alloc( ( sal_u32_t ) ( sz + alignment + sizeof( void * ) ) ) ) == 0 )
+    {
+        return SALERR_OUTOFMEMORY;
+    }
+
+    p = ( sal_byte_t * ) ( ( ( size_t ) ( p_raw + sizeof( void * ) ) + alignment - 1 ) & ~( alignment - 1 ) );
+    ( ( void ** ) p )[ -1 ] = p_raw;
+
+    *pp = p;
+
+    return SALERR_OK;
+}
+
+/** @brief Frees memory allocated with SAL_alloc_aligned().
+    @ingroup Utility
+    @param[in] device pointer to output device
+    @param[in] p pointer to free
+    @sa SAL_alloc_aligned
+*/
+sal_error_e 
+SAL_free_aligned( SAL_Device *device, void *p )
+{
+    if ( device == 0 || p == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    if ( device->device_callbacks.free_aligned )
+    {
+        device->device_callbacks.free_aligned( p );
+    }
+    else
+    {
+        device->device_callbacks.free( ( ( void ** ) p )[ -1 ] );
+    }
+
+    return SALERR_OK;
+}
+
 /** @internal
     @ingroup Multithreading
     @brief Creates a mutex used for thread synchronization 
@@ -237,16 +318,18 @@ _SAL_unlock_mutex( SAL_Device *device, sal_mutex_t mtx )
     @param[in] device pointer to output device
     @param[in] fnc pointer to thread start function
     @param[in] targs arguments passed to the thread start function
+    @param[in] flags @ref SAL_THREAD_AUDIO for the threads that feed or mix
+    audio, 0 for helper threads that should run like any other
     @returns SALERR_OK on success, @ref sal_error_e on failure
 */
 sal_error_e 
-_SAL_create_thread( SAL_Device *device, SAL_THREAD_FUNC fnc, void *targs )
+_SAL_create_thread( SAL_Device *device, SAL_THREAD_FUNC fnc, void *targs, sal_u32_t flags )
 {
     if ( device == 0 || fnc == 0 )
     {
         return SALERR_INVALIDPARAM;
     }
-    return device->device_fnc_create_thread( device, fnc, targs );
+    return device->device_fnc_create_thread( device, fnc, targs, flags );
 }
 
 /** @ingroup Utility
@@ -265,6 +348,124 @@ SAL_sleep( SAL_Device *device, sal_u32_t duration )
     return device->device_fnc_sleep( device, duration );
 }
 
+/** @internal
+    @ingroup Timing
+    @brief Reads the device's monotonic clock.
+    @param[in] device pointer to output device
+    @returns time in nanoseconds from an arbitrary starting point, or 0 if the
+    platform has no monotonic clock
+*/
+sal_u64_t
+_SAL_get_time( SAL_Device *device )
+{
+    if ( device == 0 || device->device_fnc_get_time == 0 )
+    {
+        return 0;
+    }
+    return device->device_fnc_get_time( device );
+}
+
+/** @internal
+    @ingroup Timing
+    @brief Sleeps until the monotonic clock reaches an absolute deadline.
+    @param[in] device pointer to output device
+    @param[in] deadline time to wake up, as returned by _SAL_get_time()
+    @returns SALERR_OK on success, @ref sal_error_e on failure
+    @remarks Platforms without an absolute wait sleep for the time that is
+    left, rounded up to the next millisecond.
+*/
+sal_error_e
+_SAL_sleep_until( SAL_Device *device, sal_u64_t deadline )
+{
+    sal_u64_t now;
+
+    if ( device == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    if ( device->device_fnc_sleep_until )
+    {
+        return device->device_fnc_sleep_until( device, deadline );
+    }
+
+    now = _SAL_get_time( device );
+
+    if ( now >= deadline )
+    {
+        return SALERR_OK;
+    }
+
+    return SAL_sleep( device, ( sal_u32_t ) ( ( deadline - now + 999999 ) / 1000000 ) );
+}
+
+/** @internal
+    @ingroup Timing
+    @brief Waits for the next period of a timer driven audio thread.
+    @param[in] device pointer to output device
+    @param[in,out] p_deadline deadline of the previous period, set it to
+    _SAL_get_time() before the first call.  Advanced by one period.
+    @param[in] period length of a period in nanoseconds
+    @returns SALERR_OK on success, @ref sal_error_e on failure
+    @remarks Deadlines are absolute, so time spent mixing does not add up
+    and the thread wakes exactly once per period.  How late it woke is
+    recorded in the device statistics.  After a stall of more than a whole
+    period the deadlines restart from now instead of firing to catch up.
+    Without a monotonic clock this falls back to sleeping for one period.
+*/
+sal_error_e
+_SAL_wait_period( SAL_Device *device, sal_u64_t *p_deadline, sal_u64_t period )
+{
+    sal_u64_t now, late_us;
+    sal_error_e err;
+
+    if ( device == 0 || p_deadline == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    if ( device->device_fnc_get_time == 0 )
+    {
+        return SAL_sleep( device, ( sal_u32_t ) ( period / 1000000 ) );
+    }
+
+    *p_deadline += period;
+
+    if ( ( err = _SAL_sleep_until( device, *p_deadline ) ) != SALERR_OK )
+    {
+        return err;
+    }
+
+    now     = _SAL_get_time( device );
+    late_us = ( now > *p_deadline ) ? ( now - *p_deadline ) / 1000 : 0;
+
+    if ( now > *p_deadline + period )
+    {
+        *p_deadline = now;
+    }
+
+    _SAL_lock_device( device );
+
+    device->device_stats.ds_num_wakeups++;
+    if ( late_us * 1000 > period )
+    {
+        device->device_latency.lat_missed_deadline = 1;
+    }
+    device->device_stats.ds_wakeup_late_total_us += late_us;
+    if ( late_us > device->device_stats.ds_wakeup_late_max_us )
+    {
+        device->device_stats.ds_wakeup_late_max_us = ( sal_u32_t ) late_us;
+    }
+    if ( device->device_system_parameters.sp_flags & SAL_SPF_TRACE_LATENCY )
+    {
+        _SAL_record_wakeup_latency( device, late_us );
+    }
+
+    _SAL_unlock_device( device );
+
+    return SALERR_OK;
+}
+
 /** @def SAL_BUILDING_LIB
     Defined if we're building the library, synonym for POSH_BUILDING_LIB and used
     to control POSH_PUBLIC_API/SAL_PUBLIC_API when building as a dynamic library.
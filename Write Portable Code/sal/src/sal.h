@@ -101,6 +101,7 @@ typedef enum
     SALERR_ALREADYLOCKED   = 0x0005,       /**< tried to lock an already locked mutex */
     SALERR_INUSE           = 0x0006,       /**< attempted to destroy object that is currently in use */
     SALERR_INVALIDFORMAT   = 0x0007,       /**< mismatched sample formats */
+    SALERR_CANCELLED       = 0x0008,       /**< operation was cancelled before it completed */
 
     /* 0x0100 - 0x01FF = transient errors/warnings */
     SALERR_OUTOFVOICES     = 0x0101,       /**< out of voices */
@@ -116,9 +117,18 @@ typedef enum
 {
     SALVS_IDLE,                 /**< voice is done playing */
     SALVS_PLAYING,              /**< voice is currently playing */
-    SALVS_INVALIDSOUND          /**< illegal voice handle */
+    SALVS_INVALIDSOUND,         /**< illegal voice handle */
+    SALVS_SCHEDULED             /**< voice is waiting for its start frame, see SAL_play_sample_at */
 } sal_voice_status_e;
 
+/** voice event types, as reported by SAL_get_voice_events */
+typedef enum
+{
+    SALVE_ENDED,                /**< voice played out, its handle is now idle */
+    SALVE_LOOPED,               /**< voice wrapped from its loop end back to its loop start, at most one unread per voice */
+    SALVE_STARVED               /**< streamed voice ran out of data and is playing silence until more arrives */
+} sal_voice_event_e;
+
 typedef posh_byte_t sal_byte_t;   /**< unsigned 8-bit type */
 typedef posh_i16_t  sal_i16_t;    /**< signed 16-bit type */
 typedef posh_u16_t  sal_u16_t;    /**< unsigned 16-bit type */
@@ -138,6 +148,8 @@ typedef sal_i16_t   sal_pan_t;    /**< pan parameter, from -32768 (left) to 3276
 */
 #define SAL_INVALID_SOUND  -1       /**< default value for a sal_voice_t to indicate it's not valid */
 #define SAL_LOOP_ALWAYS    -1       /**< passed as num_repetitions parameter to SAL_play_voice() to loop always */
+#define SAL_MAX_VOICES     65536    /**< most voices a device can be created with */
+#define SAL_VOICE_EVENT_QUEUE_SIZE 256 /**< voice events a device holds until SAL_get_voice_events reads them */
 
 #define SAL_PAN_HARD_LEFT  -32767   /**< constant for panning to the hard left.  We could use SHRT_MIN instead */
 #define SAL_PAN_HARD_RIGHT  32767   /**< constant for panning to the hard right. */
@@ -166,8 +178,19 @@ typedef struct SAL_Callbacks
 
     void   (POSH_CDECL *warning)( const char *msg );   /**< warning/general output function */
     void   (POSH_CDECL *error)( const char *msg );     /**< error handling/output funciton */
+
+    void * (POSH_CDECL *alloc_aligned)( sal_u32_t sz, sal_u32_t alignment ); /**< aligned allocation function, must allocate sz bytes at a multiple of alignment, may be NULL */
+    void   (POSH_CDECL *free_aligned)( void *p );     /**< frees memory from alloc_aligned, NULL if and only if alloc_aligned is */
 } SAL_Callbacks;
 
+/** @brief Size of SAL_Callbacks before the aligned allocation callbacks were added.
+    SAL_create_device() still accepts it in cb_size and then aligns memory itself
+    on top of alloc and free.
+*/
+#define SAL_CALLBACKS_V1_SIZE offsetof( SAL_Callbacks, alloc_aligned )
+
+#define SAL_ALIGNMENT 64  /**< Alignment, in bytes, of mix buffers and sample data */
+
 #define SAL_DEVICEINFO_MAX_NAME 256  /**< Maximum length of a device's name */
 
 /** @brief Device information structure, retrieved by calling SAL_get_device_info */
@@ -180,8 +203,71 @@ typedef struct SAL_DeviceInfo_s
     sal_i32_t   di_bytes_per_sample;           /**< a sample is a single sample on one channel */
     sal_i32_t   di_bytes_per_frame;            /**< a frame consists of samples on all channels for one time slice */
     char        di_name[ SAL_DEVICEINFO_MAX_NAME ]; /**< name of the device */
+    sal_i32_t   di_period_frames;              /**< frames the device consumes between wakeups of the audio thread, 0 if unknown */
+    sal_i32_t   di_num_periods;                /**< periods in the device's buffer, 0 if unknown */
+    sal_u32_t   di_flags;                      /**< miscellaneous flags, as defined at @ref DIF */
 } SAL_DeviceInfo;
 
+/** @brief Size of SAL_DeviceInfo before the period and flag fields were added.
+    SAL_get_device_info() still accepts it in di_size and fills in the fields
+    up to di_name.
+*/
+#define SAL_DEVICEINFO_V1_SIZE offsetof( SAL_DeviceInfo, di_period_frames )
+
+/** @defgroup DIF Device Information Flags
+    @ingroup DeviceManagement
+    @{
+*/
+#define SAL_DIF_CONVERSION 0x00000001        /**< a software plugin converts or resamples between SAL and the hardware */
+/** @} */
+
+/** @brief Device statistics structure, retrieved by calling SAL_get_device_stats.
+    All counters start at 0 when the device is created.
+*/
+typedef struct SAL_DeviceStats_s
+{
+    sal_i32_t   ds_size;                       /**< size of the device statistics structure */
+    sal_u32_t   ds_num_wakeups;                /**< number of times the audio thread woke up to feed the device */
+    sal_u32_t   ds_wakeup_late_max_us;         /**< latest the audio thread has woken up after its deadline, in microseconds */
+    sal_u64_t   ds_wakeup_late_total_us;       /**< sum of all wakeup lateness, divide by ds_num_wakeups for the average */
+    sal_u32_t   ds_num_underruns;              /**< number of times the device ran dry and had to be restarted (ALSA, and OSS write mode) */
+    sal_u32_t   ds_num_mixes;                  /**< number of times the mixer ran */
+    sal_u32_t   ds_mix_time_max_us;            /**< longest the mixer has taken, in microseconds */
+    sal_u64_t   ds_mix_time_total_us;          /**< sum of all mix times, divide by ds_num_mixes for the average */
+    sal_u32_t   ds_latency_frames;             /**< frames the backend currently keeps queued, see @ref SAL_SPF_ADAPTIVE_LATENCY */
+    sal_u32_t   ds_num_pipeline_misses;        /**< times the backend found no pre-mixed period ready and played silence, see @ref SAL_SPF_MIX_AHEAD */
+    sal_u32_t   ds_num_lost_events;            /**< voice events dropped because SAL_get_voice_events wasn't called often enough */
+} SAL_DeviceStats;
+
+#define SAL_LATENCY_HISTOGRAM_BUCKETS 16     /**< buckets in each SAL_LatencyHistogram histogram */
+#define SAL_LATENCY_HISTOGRAM_BASE_US 250    /**< upper bound of the first SAL_LatencyHistogram bucket, in microseconds */
+
+/** @brief Latency histograms, retrieved by calling SAL_get_latency_histogram.
+    Only filled in for devices created with @ref SAL_SPF_TRACE_LATENCY.
+    Bucket 0 counts values below @ref SAL_LATENCY_HISTOGRAM_BASE_US, bucket
+    i counts values from BASE << (i-1) up to BASE << i, and the last bucket
+    also counts everything above that.
+*/
+typedef struct SAL_LatencyHistogram_s
+{
+    sal_i32_t   lh_size;                       /**< size of the latency histogram structure */
+    sal_u32_t   lh_num_voices;                 /**< voices measured in lh_trigger_buckets */
+    sal_u32_t   lh_min_us;                     /**< shortest trigger latency, in microseconds */
+    sal_u32_t   lh_max_us;                     /**< longest trigger latency, in microseconds */
+    sal_u64_t   lh_total_us;                   /**< sum of all trigger latencies, divide by lh_num_voices for the average */
+    sal_u32_t   lh_trigger_buckets[ SAL_LATENCY_HISTOGRAM_BUCKETS ]; /**< time from starting a voice to the mixer writing its first frame for the backend */
+    sal_u32_t   lh_wakeup_buckets[ SAL_LATENCY_HISTOGRAM_BUCKETS ];  /**< how late the audio thread woke up after each deadline */
+} SAL_LatencyHistogram;
+
+/** @brief Something that happened to a voice, retrieved by calling SAL_get_voice_events.
+*/
+typedef struct SAL_VoiceEvent_s
+{
+    sal_voice_t        ve_voice;               /**< handle the voice was started with */
+    sal_voice_event_e  ve_type;                /**< what happened */
+    sal_u64_t          ve_frame;               /**< frame clock at the start of the mix it happened in */
+} SAL_VoiceEvent;
+
 /* The system parameter flags are divided into four groups of eight bits
    each:
 
@@ -192,8 +278,55 @@ typedef struct SAL_DeviceInfo_s
     @ingroup DeviceManagement
     @{
 */
+#define SAL_SPF_ADAPTIVE_LATENCY 0x00000001  /**< start with two periods queued and adapt to underruns and mix cost, see SAL_set_latency_callback() */
+#define SAL_SPF_MIX_AHEAD        0x00000002  /**< mix sp_mix_ahead_periods periods ahead on a thread of their own (OSS and ALSA) */
+#define SAL_SPF_TRACE_LATENCY    0x00000004  /**< time every voice from start to first mixed frame, see SAL_get_latency_histogram() */
+#define SAL_SPF_NULL             0x00000008  /**< use the null backend, which mixes in real time and discards the result (needs SAL_SUPPORT_NULL) */
 #define SAL_SPF_WAVEOUT   0x00010000         /**< Windows only (default is DSOUND) */
 #define SAL_SPF_ALSA      0x00010000         /**< Linux only (default is OSS) */
+#define SAL_SPF_OSS_MMAP  0x00020000         /**< Linux only, OSS mixes straight into the memory mapped DMA buffer */
+/** @} */
+
+/** @defgroup ThreadPolicy Audio Thread Scheduling Policies
+    @ingroup DeviceManagement
+    @brief Values for SAL_SystemParametersDefault::sp_thread_policy
+    @{
+*/
+#define SAL_THREAD_POLICY_DEFAULT 0          /**< normal time sharing, like any other thread */
+#define SAL_THREAD_POLICY_FIFO    1          /**< SCHED_FIFO realtime scheduling */
+#define SAL_THREAD_POLICY_RR      2          /**< SCHED_RR realtime scheduling */
+/** @} */
+
+/** @defgroup LatencyProfile Latency Profiles
+    @ingroup DeviceManagement
+    @brief Values for SAL_SystemParametersDefault::sp_latency_profile, sp_period_frames
+    and sp_num_periods override the profile if they are set.
+    @{
+*/
+#define SAL_LATENCY_DEFAULT       0          /**< split sp_buffer_length_ms into periods */
+#define SAL_LATENCY_LOW           1          /**< 3 periods of 2.5 ms, for interactive feedback */
+#define SAL_LATENCY_BALANCED      2          /**< 4 periods of 10 ms */
+#define SAL_LATENCY_POWERSAVE     3          /**< 4 periods of 50 ms, for few wakeups */
+/** @} */
+
+/** @defgroup LatencyChange Latency Change Reasons
+    @ingroup DeviceManagement
+    @brief Reasons passed to a @ref sal_latency_fnc_t
+    @{
+*/
+#define SAL_LATENCYCHANGE_UNDERRUN 1         /**< grew because the device ran dry */
+#define SAL_LATENCYCHANGE_LATE     2         /**< grew because mixing or waking up took longer than a period */
+#define SAL_LATENCYCHANGE_STABLE   3         /**< shrank after a stable stretch with time to spare */
+/** @} */
+
+/** @defgroup MemoryLock Memory Locking
+    @ingroup DeviceManagement
+    @brief Values for SAL_SystemParametersDefault::sp_memory_lock
+    @{
+*/
+#define SAL_MEMLOCK_NONE          0          /**< memory may be paged out */
+#define SAL_MEMLOCK_BUFFERS       1          /**< lock the memory the mixer touches: device, voices, mix buffers and pooled objects, but not sample data */
+#define SAL_MEMLOCK_ALL           2          /**< lock the whole process, now and in future, with mlockall() */
 /** @} */
 
 /** 
@@ -210,12 +343,30 @@ struct SAL_SystemParametersWin32
 
 /** 
     @brief The default system parameters structure, used by Linux and OS X .
+
+    The audio thread settings apply to backends that feed the device from a
+    thread of their own (OSS and ALSA).  Settings the process isn't allowed
+    to use, typically realtime priority and memory locking without the
+    privileges for them, are reported through the warning callback and
+    otherwise ignored.  An older, shorter structure leaves them all at 0.
 */
 struct SAL_SystemParametersDefault
 {
     sal_i32_t   sp_size; /**< size of the system parameters structure */
     sal_u32_t   sp_flags; /**< miscellaneous flags, as defined at @ref SPF*/
     sal_i32_t   sp_buffer_length_ms; /**< length of the buffer, in milliseconds -- used by OSS */
+
+    sal_u32_t   sp_thread_policy;   /**< audio thread scheduling, as defined at @ref ThreadPolicy */
+    sal_i32_t   sp_thread_priority; /**< realtime priority, 0 for the middle of the allowed range */
+    sal_u64_t   sp_cpu_affinity;    /**< bit n lets the audio thread run on CPU n, 0 for any CPU (Linux only) */
+    const char *sp_thread_name;     /**< name for the audio thread, as shown by top and debuggers, may be NULL */
+    sal_u32_t   sp_memory_lock;     /**< what to lock into memory, as defined at @ref MemoryLock */
+
+    sal_u32_t   sp_num_periods;     /**< number of periods (OSS fragments) the buffer is split into, 0 for the default */
+    sal_u32_t   sp_period_frames;   /**< frames per period, 0 to split sp_buffer_length_ms evenly -- OSS rounds it to a power of two bytes */
+    const char *sp_device_name;     /**< device to open, NULL for the default (ALSA hw:0,0, OSS /dev/dsp) */
+    sal_u32_t   sp_latency_profile; /**< period sizing preset, as defined at @ref LatencyProfile */
+    sal_u32_t   sp_mix_ahead_periods; /**< periods kept pre-mixed with @ref SAL_SPF_MIX_AHEAD, 0 for 2 */
 };
 
 #ifdef POSH_OS_WIN32 
@@ -257,6 +408,8 @@ typedef struct SAL_opaque SAL_Sample;
 
 typedef void (POSH_CDECL * sal_sample_destroy_fnc_t)( SAL_Device *p_device, SAL_Sample *self );
 typedef int  (POSH_CDECL * sal_sample_decode_fnc_t)( SAL_Device *p_device, sal_voice_t voice, sal_byte_t *p_dst, int bytes_needed );
+typedef void (POSH_CDECL * sal_buffer_release_fnc_t)( SAL_Device *p_device, void *p_data, void *p_arg );
+typedef void (POSH_CDECL * sal_latency_fnc_t)( SAL_Device *p_device, sal_u32_t latency_frames, sal_u32_t reason, void *p_arg );
 
 #endif
 
@@ -266,6 +419,42 @@ typedef int  (POSH_CDECL * sal_sample_decode_fnc_t)( SAL_Device *p_device, sal_v
 
 #endif
 
+/** @brief One voice to start with SAL_play_samples.  The fields match the
+    parameters of SAL_play_sample.
+*/
+typedef struct SAL_PlayRequest_s
+{
+    SAL_Sample  *pr_sample;                    /**< sample to play */
+    sal_volume_t pr_volume;                    /**< volume of the sound (0 to SAL_VOLUME_MAX) */
+    sal_pan_t    pr_pan;                       /**< pan position (SAL_PAN_HARD_LEFT to SAL_PAN_HARD_RIGHT) */
+    sal_u32_t    pr_loop_start;                /**< loop start position */
+    sal_u32_t    pr_loop_end;                  /**< loop end position, 0 for the sample's end */
+    sal_i32_t    pr_num_repetitions;           /**< number of times to play the sound, or SAL_LOOP_ALWAYS */
+    sal_u64_t    pr_start_frame;               /**< frame clock value to start on as with SAL_play_sample_at, 0 for right away */
+    sal_voice_t  pr_voice;                     /**< [out] voice the sample is playing on */
+    sal_error_e  pr_result;                    /**< [out] what SAL_play_sample would have returned */
+} SAL_PlayRequest;
+
+/** @defgroup VPF Voice Parameter Flags
+    @ingroup VoiceManagement
+    Select which fields of a SAL_VoiceParams are applied.
+    @{
+*/
+#define SAL_VPF_VOLUME    0x00000001         /**< set the voice's volume to vp_volume */
+#define SAL_VPF_PAN       0x00000002         /**< set the voice's pan to vp_pan */
+/** @} */
+
+/** @brief One voice update for SAL_set_voice_params.
+*/
+typedef struct SAL_VoiceParams_s
+{
+    sal_voice_t  vp_voice;                     /**< voice to update */
+    sal_u32_t    vp_flags;                     /**< @ref VPF saying which of the fields below to apply */
+    sal_volume_t vp_volume;                    /**< new volume (0 to SAL_VOLUME_MAX) */
+    sal_pan_t    vp_pan;                       /**< new pan position (SAL_PAN_HARD_LEFT to SAL_PAN_HARD_RIGHT) */
+    sal_error_e  vp_result;                    /**< [out] SALERR_OK, or SALERR_INVALIDPARAM for a bad voice */
+} SAL_VoiceParams;
+
 /*
 ** ----------------------------------------------------------------------------
 ** function prototypes
@@ -283,6 +472,19 @@ SAL_PUBLIC_API( sal_error_e )  SAL_create_device( SAL_Device **pp_device,
 SAL_PUBLIC_API( sal_error_e )  SAL_destroy_device( SAL_Device *p_device );
 SAL_PUBLIC_API( sal_error_e )  SAL_get_device_info( SAL_Device *p_device,
                                                     SAL_DeviceInfo *p_info );
+SAL_PUBLIC_API( sal_error_e )  SAL_get_device_stats( SAL_Device *p_device,
+                                                     SAL_DeviceStats *p_stats );
+SAL_PUBLIC_API( sal_error_e )  SAL_set_latency_callback( SAL_Device *p_device,
+                                                         sal_latency_fnc_t fnc,
+                                                         void *p_arg );
+SAL_PUBLIC_API( sal_error_e )  SAL_get_frame_clock( SAL_Device *p_device,
+                                                    sal_u64_t *p_frame );
+SAL_PUBLIC_API( sal_error_e )  SAL_get_output_latency( SAL_Device *p_device,
+                                                       sal_u32_t *p_frames );
+SAL_PUBLIC_API( sal_error_e )  SAL_get_frames_played( SAL_Device *p_device,
+                                                      sal_u64_t *p_frames );
+SAL_PUBLIC_API( sal_error_e )  SAL_get_latency_histogram( SAL_Device *p_device,
+                                                          SAL_LatencyHistogram *p_histogram );
 
 /* Sample management */ 
 SAL_PUBLIC_API( sal_error_e )  SAL_create_sample( SAL_Device *p_device, 
@@ -291,12 +493,24 @@ SAL_PUBLIC_API( sal_error_e )  SAL_create_sample( SAL_Device *p_device,
                                                   sal_sample_decode_fnc_t decoder, 
                                                   sal_sample_destroy_fnc_t destroyer,
                                                   SAL_SampleArgs *p_sample_args );
+SAL_PUBLIC_API( sal_error_e )  SAL_create_sample_from_buffer( SAL_Device *p_device,
+                                                              SAL_Sample **pp_sample,
+                                                              void *p_data,
+                                                              size_t num_samples,
+                                                              sal_buffer_release_fnc_t release,
+                                                              void *release_arg );
 SAL_PUBLIC_API( sal_error_e )  SAL_destroy_sample( SAL_Device *p_device, SAL_Sample *p_sample );
 SAL_PUBLIC_API( sal_error_e )  SAL_get_sample_ref_count( SAL_Device *p_device, const SAL_Sample *p_sample, sal_i32_t *p_count );
 SAL_PUBLIC_API( sal_error_e )  SAL_get_sample_data( SAL_Device *p_device, SAL_Sample *p_sample, sal_byte_t **pp_bytes );
 SAL_PUBLIC_API( sal_error_e )  SAL_get_sample_args( SAL_Device *p_device, const SAL_Sample *p_sample, SAL_SampleArgs *args );
 
 SAL_PUBLIC_API( int )          _SAL_advance_voice( SAL_Device *device, sal_voice_t voice, int num_frames );
+SAL_PUBLIC_API( sal_error_e )  _SAL_get_voice_sample_locked( SAL_Device *p_device, 
+                                                             sal_voice_t sid,
+                                                             SAL_Sample **pp_sample );
+SAL_PUBLIC_API( sal_error_e )  _SAL_get_voice_cursor_locked( SAL_Device *p_device,
+                                                             sal_voice_t sid,
+                                                             int *p_cursor );
 SAL_PUBLIC_API( int )          _SAL_generic_decode_sample( SAL_Device *p_device, 
                                                            sal_voice_t voice,
                                                            sal_byte_t *p_dst, 
@@ -312,6 +526,18 @@ SAL_PUBLIC_API( sal_error_e )  SAL_play_sample( SAL_Device *p_device,
                                                 sal_u32_t loop_start,
                                                 sal_u32_t loop_end,
                                                 sal_i32_t num_repetitions );
+SAL_PUBLIC_API( sal_error_e )  SAL_play_sample_at( SAL_Device *p_device, 
+                                                   SAL_Sample *p_sample, 
+                                                   sal_voice_t *p_sid,
+                                                   sal_volume_t volume,
+                                                   sal_pan_t pan,
+                                                   sal_u32_t loop_start,
+                                                   sal_u32_t loop_end,
+                                                   sal_i32_t num_repetitions,
+                                                   sal_u64_t start_frame );
+SAL_PUBLIC_API( sal_error_e )  SAL_play_samples( SAL_Device *p_device,
+                                                 SAL_PlayRequest *p_requests,
+                                                 int num_requests );
 SAL_PUBLIC_API( sal_error_e )  SAL_stop_voice( SAL_Device *p_device, 
                                                sal_voice_t sid );
 SAL_PUBLIC_API( sal_error_e )  SAL_set_voice_volume( SAL_Device *p_device,
@@ -320,6 +546,13 @@ SAL_PUBLIC_API( sal_error_e )  SAL_set_voice_volume( SAL_Device *p_device,
 SAL_PUBLIC_API( sal_error_e )  SAL_set_voice_pan( SAL_Device *p_device,
                                                   sal_voice_t p_vid,
                                                   sal_pan_t   pan );
+SAL_PUBLIC_API( sal_error_e )  SAL_set_voice_params( SAL_Device *p_device,
+                                                     SAL_VoiceParams *p_params,
+                                                     int num_params );
+SAL_PUBLIC_API( sal_error_e )  SAL_get_voice_events( SAL_Device *p_device,
+                                                     SAL_VoiceEvent *p_events,
+                                                     int max_events,
+                                                     int *p_num_events );
 SAL_PUBLIC_API( sal_error_e )  SAL_get_voice_status( SAL_Device *p_device, 
                                                      sal_voice_t sid,
                                                      sal_voice_status_e *p_status );
@@ -335,6 +568,8 @@ SAL_PUBLIC_API( sal_u32_t )   SAL_get_version( void );
 SAL_PUBLIC_API( sal_error_e ) SAL_sleep( SAL_Device *device, sal_u32_t duration );
 SAL_PUBLIC_API( sal_error_e ) SAL_alloc( SAL_Device *device, void **pp, size_t sz );
 SAL_PUBLIC_API( sal_error_e ) SAL_free( SAL_Device *device, void *p );
+SAL_PUBLIC_API( sal_error_e ) SAL_alloc_aligned( SAL_Device *device, void **pp, size_t sz, size_t alignment );
+SAL_PUBLIC_API( sal_error_e ) SAL_free_aligned( SAL_Device *device, void *p );
 
 #ifdef __cplusplus
 }
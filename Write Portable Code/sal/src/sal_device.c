@@ -88,7 +88,7 @@ s_print( const char *kp_msg )
     may be 0 if you want it to use default preferences
     @param[in] desired_bits number of bits per sample, specify 0 for system default
     @param[in] desired_sample_rate desired sample rate, in samples/second, specify 0 for system default
-    @param[in] num_voices desired number of simultaneous voices that can be played.
+    @param[in] num_voices desired number of simultaneous voices that can be played, at most @ref SAL_MAX_VOICES.
     @retval SALERR_OK on success, @ref sal_error_e otherwise
 */
 sal_error_e
@@ -103,7 +103,7 @@ SAL_create_device( SAL_Device **pp_device,
     sal_error_e err;
     SAL_Device *p_device = 0;
 
-    if ( pp_device == 0 || kp_sp == 0 || num_voices <= 0 )
+    if ( pp_device == 0 || kp_sp == 0 || num_voices <= 0 || num_voices > SAL_MAX_VOICES )
     {
         return SALERR_INVALIDPARAM;
     }
@@ -120,7 +120,8 @@ SAL_create_device( SAL_Device **pp_device,
     }
     else
     {
-        if ( kp_cb->cb_size != sizeof( SAL_Callbacks ) )
+        /* callbacks from before alloc_aligned/free_aligned existed are still fine */
+        if ( kp_cb->cb_size != sizeof( SAL_Callbacks ) && kp_cb->cb_size != SAL_CALLBACKS_V1_SIZE )
         {
             return SALERR_WRONGVERSION;
         }
@@ -130,9 +131,15 @@ SAL_create_device( SAL_Device **pp_device,
             return SALERR_INVALIDPARAM;
         }
 
+        if ( kp_cb->cb_size == sizeof( SAL_Callbacks ) && ( kp_cb->alloc_aligned == 0 ) != ( kp_cb->free_aligned == 0 ) )
+        {
+            return SALERR_INVALIDPARAM;
+        }
+
         p_device = ( struct SAL_Device_s * ) kp_cb->alloc( sizeof( struct SAL_Device_s ) );
         memset( p_device, 0, sizeof( *p_device ) );
-        p_device->device_callbacks = *kp_cb;
+        memcpy( &p_device->device_callbacks, kp_cb, kp_cb->cb_size );
+        p_device->device_callbacks.cb_size = sizeof( SAL_Callbacks );
     }
 
     /* allocate voices */
@@ -140,17 +147,46 @@ SAL_create_device( SAL_Device **pp_device,
     memset( p_device->device_voices, 0, sizeof( struct SAL_Voice_s ) * num_voices );
     p_device->device_max_voices = num_voices;
 
-    if ( ( err = _SAL_create_device_data( p_device, kp_sp, desired_channels, desired_bits, desired_sample_rate ) ) != SALERR_OK )
+    if ( ( err = SAL_alloc_aligned( p_device, ( void ** ) &p_device->device_decode_buffer, SAL_DECODE_BUFFER_SIZE, SAL_ALIGNMENT ) ) != SALERR_OK )
     {
         p_device->device_callbacks.free( p_device->device_voices );
         p_device->device_callbacks.free( p_device );
         return err;
     }
 
-    _SAL_create_mutex( p_device, &(p_device->device_mutex));
+    /* keep a copy, fields a shorter (older) structure doesn't have stay 0 */
+    if ( kp_sp->sp_size > 0 && ( size_t ) kp_sp->sp_size < sizeof( SAL_SystemParameters ) )
+    {
+        memcpy( &p_device->device_system_parameters, kp_sp, kp_sp->sp_size );
+    }
+    else
+    {
+        memcpy( &p_device->device_system_parameters, kp_sp, sizeof( SAL_SystemParameters ) );
+    }
+    p_device->device_system_parameters.sp_size = sizeof( SAL_SystemParameters );
+
+    /* this also creates the device mutex, before any backend thread can need it */
+    if ( ( err = _SAL_create_device_data( p_device, &p_device->device_system_parameters, desired_channels, desired_bits, desired_sample_rate ) ) != SALERR_OK )
+    {
+        if ( p_device->device_mutex )
+        {
+            _SAL_destroy_mutex( p_device, p_device->device_mutex );
+        }
+        SAL_free_aligned( p_device, p_device->device_decode_buffer );
+        p_device->device_callbacks.free( p_device->device_voices );
+        p_device->device_callbacks.free( p_device );
+        return err;
+    }
+
+    /* the backend installs device_fnc_lock_memory if it was asked to */
+    _SAL_lock_memory( p_device, p_device, sizeof( *p_device ) );
+    _SAL_lock_memory( p_device, p_device->device_voices, sizeof( struct SAL_Voice_s ) * num_voices );
+    _SAL_lock_memory( p_device, p_device->device_decode_buffer, SAL_DECODE_BUFFER_SIZE );
+
+    /* the backend set up the mix-ahead ring if it was asked for */
+    _SAL_start_pipeline( p_device );
 
-    p_device->device_info.di_bytes_per_sample = p_device->device_info.di_bits / 8; 
-    p_device->device_info.di_bytes_per_frame  = p_device->device_info.di_bytes_per_sample * p_device->device_info.di_channels;
+    p_device->device_stats.ds_size = sizeof( p_device->device_stats );
 
     *pp_device = p_device;
 
@@ -163,19 +199,27 @@ SAL_create_device( SAL_Device **pp_device,
 sal_error_e
 SAL_destroy_device( SAL_Device *p_device )
 {
-    sal_voice_t v;
+    int v;
     if ( p_device == 0 )
     {
         return SALERR_INVALIDPARAM;
     }
 
-    /* stop all sounds */
+    /* stop all sounds, by index since we hold no handles */
+    _SAL_lock_device( p_device );
+
     for ( v = 0; v < p_device->device_max_voices; v++ )
     {
-        SAL_stop_voice( p_device, v );
+        _SAL_stop_voice_locked( p_device, v );
     }
+
+    _SAL_unlock_device( p_device );
 	
     p_device->device_fnc_destroy( p_device );
+
+    _SAL_destroy_pipeline( p_device );
+
+    _SAL_destroy_pool( p_device );
 	
     if ( p_device->device_mutex )
     {
@@ -183,6 +227,7 @@ SAL_destroy_device( SAL_Device *p_device )
         p_device->device_mutex = 0;
     }
 
+    SAL_free_aligned( p_device, p_device->device_decode_buffer );
     p_device->device_callbacks.free( p_device->device_voices );
     p_device->device_callbacks.free( p_device );
 
@@ -194,8 +239,9 @@ SAL_destroy_device( SAL_Device *p_device )
     @brief Locks access to the specified device.
     @param[in] device device to lock access to
     @returns SALERR_OK on success, @ref sal_error_e otherwise
-    The underlying mutex implementation is expected to be recursive, that is
-    the same thread may lock a mutex multiple times.  Unlocking the device
+    The underlying mutex need not be recursive, so a thread that holds the
+    lock must not lock the device again; code that runs with the device
+    locked calls the _locked variants instead.  Unlocking the device
     is achieved by calling _SAL_unlock_device().
 */
 sal_error_e
@@ -219,9 +265,7 @@ _SAL_lock_device( SAL_Device *device )
     @brief Unlocks access to the specified device.
     @param[in] device device to unlock access to
     @returns SALERR_OK on success, @ref sal_error_e otherwise
-    The underlying mutex implementation is expected to be recursive, that is
-    the same thread may lock a mutex multiple times.  Locking the device
-    is achieved by calling _SAL_lock_device().
+    Locking the device is achieved by calling _SAL_lock_device().
 */
 sal_error_e
 _SAL_unlock_device( SAL_Device *device )
@@ -246,7 +290,8 @@ _SAL_unlock_device( SAL_Device *device )
     <i>must</i> be filled in appropriately or a SALERR_WRONGVERSION will be
     returned!!
     @retval SALERR_OK on success
-    @retval SALERR_WRONGVERSION if the SAL_DeviceInfo's di_size member is not the expected value
+    @retval SALERR_WRONGVERSION if the SAL_DeviceInfo's di_size member is neither
+    sizeof( SAL_DeviceInfo ) nor @ref SAL_DEVICEINFO_V1_SIZE
     @remarks Here is an example of proper usage:
     @code
     SAL_DeviceInfo dinfo;
@@ -263,23 +308,260 @@ sal_error_e
 SAL_get_device_info( SAL_Device *p_device,
                      SAL_DeviceInfo *p_info )
 {
+    sal_i32_t size;
+
     if ( p_device == 0 || p_info == 0 )
     {
         return SALERR_INVALIDPARAM;
     }
 
-    if ( p_info->di_size != sizeof( SAL_DeviceInfo ) )
+    /* structures from before the period and flag fields were added are still fine */
+    if ( p_info->di_size != sizeof( SAL_DeviceInfo ) && p_info->di_size != SAL_DEVICEINFO_V1_SIZE )
     {
         return SALERR_WRONGVERSION;
     }
 
+    size = p_info->di_size;
+
     _SAL_lock_device( p_device );
 
-    *p_info = p_device->device_info;
+    memcpy( p_info, &p_device->device_info, size );
+    p_info->di_size = size;
 
     _SAL_unlock_device( p_device );
 
     return SALERR_OK;
 }
 
+/** @internal
+    @brief Works out the period size and count a backend should ask for
+    @param[in] kp_sp pointer to system parameters structure
+    @param[in] sample_rate sample rate the device will run at
+    @param[out] p_period_frames frames per period
+    @param[out] p_num_periods number of periods in the buffer
+    @remarks sp_period_frames and sp_num_periods win if they are set, then the
+    latency profile, and without a profile sp_buffer_length_ms (or the default
+    buffer length) is split into @ref DEFAULT_NUM_PERIODS periods.  The device
+    may round the result, backends report what they got in SAL_DeviceInfo.
+*/
+void
+_SAL_get_period_config( const SAL_SystemParameters *kp_sp, 
+                        sal_u32_t sample_rate, 
+                        sal_u32_t *p_period_frames, 
+                        sal_u32_t *p_num_periods )
+{
+    static const struct
+    {
+        sal_u32_t period_us;
+        sal_u32_t num_periods;
+    } s_profiles[] = 
+    {
+        { 0,     0 },    /* SAL_LATENCY_DEFAULT */
+        { 2500,  3 },    /* SAL_LATENCY_LOW */
+        { 10000, 4 },    /* SAL_LATENCY_BALANCED */
+        { 50000, 4 },    /* SAL_LATENCY_POWERSAVE */
+    };
+    sal_u32_t profile = kp_sp->sp_latency_profile;
+
+    if ( profile >= sizeof( s_profiles ) / sizeof( s_profiles[ 0 ] ) )
+    {
+        profile = SAL_LATENCY_DEFAULT;
+    }
+
+    if ( kp_sp->sp_num_periods )
+    {
+        *p_num_periods = kp_sp->sp_num_periods;
+    }
+    else
+    {
+        *p_num_periods = s_profiles[ profile ].num_periods ? s_profiles[ profile ].num_periods : DEFAULT_NUM_PERIODS;
+    }
+
+    if ( kp_sp->sp_period_frames )
+    {
+        *p_period_frames = kp_sp->sp_period_frames;
+    }
+    else if ( s_profiles[ profile ].period_us )
+    {
+        *p_period_frames = ( sal_u32_t ) ( ( sal_u64_t ) sample_rate * s_profiles[ profile ].period_us / 1000000 );
+    }
+    else
+    {
+        sal_u32_t buffer_ms = ( kp_sp->sp_buffer_length_ms > 0 ) ? ( sal_u32_t ) kp_sp->sp_buffer_length_ms : DEFAULT_BUFFER_DURATION;
+
+        *p_period_frames = ( sal_u32_t ) ( ( sal_u64_t ) sample_rate * buffer_ms / 1000 / *p_num_periods );
+    }
+
+    if ( *p_period_frames == 0 )
+    {
+        *p_period_frames = 1;
+    }
+}
+
+/** @brief Retrieves statistics about how well the device is being fed.
+    @param[in] p_device pointer to the output device
+    @param[out] p_stats pointer to a SAL_DeviceStats structure.  You must set
+    ds_size to sizeof( SAL_DeviceStats ) before calling this.
+    @returns SALERR_OK on success, @ref sal_error_e on failure
+    @remarks Backends that don't run an audio thread of their own leave the
+    wakeup counters at 0.
+*/
+sal_error_e 
+SAL_get_device_stats( SAL_Device *p_device,
+                      SAL_DeviceStats *p_stats )
+{
+    if ( p_device == 0 || p_stats == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    if ( p_stats->ds_size != sizeof( SAL_DeviceStats ) )
+    {
+        return SALERR_WRONGVERSION;
+    }
+
+    _SAL_lock_device( p_device );
+
+    *p_stats = p_device->device_stats;
+
+    _SAL_unlock_device( p_device );
+
+#ifdef SAL_LOAD_ACQUIRE
+    /* counted by the audio thread without the lock */
+    p_stats->ds_num_pipeline_misses = SAL_LOAD_ACQUIRE( &p_device->device_stats.ds_num_pipeline_misses );
+#endif
+
+    p_stats->ds_size = sizeof( SAL_DeviceStats );
+
+    return SALERR_OK;
+}
+
+/** @brief Reads the device's frame clock
+    @param[in] p_device pointer to the output device
+    @param[out] p_frame pointer to store the number of frames mixed so far
+    @returns SALERR_OK on success, @ref sal_error_e on failure
+    The clock starts at 0 when the device is created and advances by
+    one for every frame the mixer produces, so it never goes backwards.
+    It is the time base for SAL_play_sample_at().  It runs ahead of what
+    you hear by the device's output latency.  Where the compiler supports
+    it the clock is read without taking the device lock, so this is cheap
+    enough to call every frame.
+*/
+sal_error_e
+SAL_get_frame_clock( SAL_Device *p_device,
+                     sal_u64_t *p_frame )
+{
+    if ( p_device == 0 || p_frame == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+#ifdef SAL_LOAD_ACQUIRE
+    *p_frame = SAL_LOAD_ACQUIRE( &p_device->device_frame_clock );
+#else
+    _SAL_lock_device( p_device );
+
+    *p_frame = p_device->device_frame_clock;
+
+    _SAL_unlock_device( p_device );
+#endif
+
+    return SALERR_OK;
+}
+
+/** @internal
+    @brief Frames between the mixer and the speaker
+    @remarks Assumes the device is locked.
+*/
+static
+sal_error_e
+s_get_output_latency( SAL_Device *p_device,
+                      sal_u32_t *p_frames )
+{
+    sal_error_e err;
+    sal_u32_t   delay = 0;
+
+    if ( p_device->device_fnc_get_delay == 0 )
+    {
+        return SALERR_UNIMPLEMENTED;
+    }
+
+    if ( ( err = p_device->device_fnc_get_delay( p_device, &delay ) ) != SALERR_OK )
+    {
+        return err;
+    }
+
+    *p_frames = delay + _SAL_get_pipeline_delay( p_device );
+
+    return SALERR_OK;
+}
+
+/** @brief Reports how much mixed audio has not been heard yet
+    @param[in] p_device pointer to the output device
+    @param[out] p_frames pointer to store the latency, in frames
+    @returns SALERR_OK on success, @ref sal_error_e on failure
+    @retval SALERR_UNIMPLEMENTED if the backend can't measure it
+    This is what the backend has handed the driver and that hasn't
+    played yet, plus any periods waiting in the @ref SAL_SPF_MIX_AHEAD
+    ring.  It is measured each call, so it moves as the device drains and
+    is refilled.  A sound started now is heard about this many frames
+    from now.
+    @sa SAL_get_frames_played
+*/
+sal_error_e
+SAL_get_output_latency( SAL_Device *p_device,
+                        sal_u32_t *p_frames )
+{
+    sal_error_e err;
+
+    if ( p_device == 0 || p_frames == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    _SAL_lock_device( p_device );
+
+    err = s_get_output_latency( p_device, p_frames );
+
+    _SAL_unlock_device( p_device );
+
+    return err;
+}
+
+/** @brief Reads the frame clock of what is coming out of the speaker
+    @param[in] p_device pointer to the output device
+    @param[out] p_frames pointer to store the number of frames played so far
+    @returns SALERR_OK on success, @ref sal_error_e on failure
+    @retval SALERR_UNIMPLEMENTED if the backend can't measure its latency
+    This is SAL_get_frame_clock() less SAL_get_output_latency(), read
+    together under the device lock.  It is on the same time base as
+    SAL_play_sample_at(), so the frame being heard right now is this
+    value and a voice scheduled at frame f is heard once this passes f.
+    Only mixed frames are counted, so silence the device played during an
+    underrun doesn't advance it.
+*/
+sal_error_e
+SAL_get_frames_played( SAL_Device *p_device,
+                       sal_u64_t *p_frames )
+{
+    sal_error_e err;
+    sal_u32_t   latency;
+
+    if ( p_device == 0 || p_frames == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    _SAL_lock_device( p_device );
+
+    if ( ( err = s_get_output_latency( p_device, &latency ) ) == SALERR_OK )
+    {
+        *p_frames = ( p_device->device_frame_clock > latency ) ? p_device->device_frame_clock - latency : 0;
+    }
+
+    _SAL_unlock_device( p_device );
+
+    return err;
+}
+
 /** @} */
@@ -0,0 +1,329 @@
+/*
+Copyright (c) 2004, Brian Hook
+All rights reserved.
+
+http://www.bookofhook.com/sal
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+
+    * The names of this package'ss contributors contributors may not
+      be used to endorse or promote products derived from this
+      software without specific prior written permission.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/** @file sal_latency.c
+    @brief Simple Audio Library adaptive latency
+    @remarks Backends that can keep less than their whole buffer queued (OSS
+    and ALSA) ask _SAL_get_latency_frames() how much to keep queued and report
+    every wakeup to _SAL_update_latency().  With @ref SAL_SPF_ADAPTIVE_LATENCY
+    the target starts at @ref SAL_LATENCY_MIN_PERIODS periods, grows a period
+    whenever the device runs dry or a deadline is missed, and shrinks a period
+    after @ref SAL_LATENCY_STABLE_WINDOW milliseconds without trouble in which
+    mixing never took more than a quarter of a period.
+
+    With @ref SAL_SPF_TRACE_LATENCY this is also where trigger latency and
+    wakeup lateness are gathered into a SAL_LatencyHistogram.
+*/
+#ifndef SAL_DOXYGEN
+#  define SAL_BUILDING_LIB 1
+#endif
+#include "sal.h"
+
+/** @internal
+    @brief Moves the latency target and tells the application
+    @param[in] device pointer to output device, must be locked
+    @param[in] periods new target in periods
+    @param[in] reason why it changed, as defined at @ref LatencyChange
+*/
+static
+void
+s_set_latency( SAL_Device *device, sal_u32_t periods, sal_u32_t reason )
+{
+    _SAL_Latency *p_lat = &device->device_latency;
+
+    p_lat->lat_periods           = periods;
+    p_lat->lat_stable_frames     = 0;
+    p_lat->lat_window_mix_max_ns = 0;
+
+    device->device_stats.ds_latency_frames = periods * p_lat->lat_period_frames;
+
+    if ( p_lat->lat_fnc_callback )
+    {
+        p_lat->lat_fnc_callback( device, device->device_stats.ds_latency_frames, reason, p_lat->lat_callback_arg );
+    }
+}
+
+/** @internal
+    @brief Sets up latency management for a backend
+    @param[in] device pointer to output device
+    @param[in] sample_rate sample rate of the device
+    @param[in] period_frames frames per period, as granted by the device
+    @param[in] num_periods periods in the device's buffer, the most that can be queued
+    @param[in] adaptive 1 to adapt the target, 0 to always keep the whole buffer queued
+*/
+void
+_SAL_init_latency( SAL_Device *device, sal_u32_t sample_rate, sal_u32_t period_frames, sal_u32_t num_periods, int adaptive )
+{
+    _SAL_Latency *p_lat = &device->device_latency;
+
+    p_lat->lat_adaptive      = adaptive && num_periods > SAL_LATENCY_MIN_PERIODS;
+    p_lat->lat_period_frames = period_frames;
+    p_lat->lat_period_ns     = sample_rate ? ( sal_u64_t ) period_frames * 1000000000 / sample_rate : 0;
+    p_lat->lat_max_periods   = num_periods;
+    p_lat->lat_window_frames = ( sal_u32_t ) ( ( sal_u64_t ) sample_rate * SAL_LATENCY_STABLE_WINDOW / 1000 );
+    p_lat->lat_periods       = p_lat->lat_adaptive ? SAL_LATENCY_MIN_PERIODS : num_periods;
+
+    p_lat->lat_stable_frames     = 0;
+    p_lat->lat_window_mix_max_ns = 0;
+    p_lat->lat_missed_deadline   = 0;
+
+    device->device_stats.ds_latency_frames = p_lat->lat_periods * period_frames;
+}
+
+/** @internal
+    @brief Returns how many frames the backend should keep queued
+    @param[in] device pointer to output device
+*/
+sal_u32_t
+_SAL_get_latency_frames( SAL_Device *device )
+{
+    return device->device_latency.lat_periods * device->device_latency.lat_period_frames;
+}
+
+/** @internal
+    @brief Feeds one wakeup of the audio thread to the latency controller
+    @param[in] device pointer to output device, must be locked
+    @param[in] frames_delivered frames written to the device on this wakeup
+    @param[in] underrun 1 if the device ran dry since the last wakeup
+*/
+void
+_SAL_update_latency( SAL_Device *device, sal_u32_t frames_delivered, int underrun )
+{
+    _SAL_Latency *p_lat = &device->device_latency;
+    int late;
+
+    if ( !p_lat->lat_adaptive )
+    {
+        return;
+    }
+
+    late = p_lat->lat_missed_deadline || ( p_lat->lat_period_ns && p_lat->lat_last_mix_ns > p_lat->lat_period_ns );
+    p_lat->lat_missed_deadline = 0;
+
+    if ( underrun || late )
+    {
+        if ( p_lat->lat_periods < p_lat->lat_max_periods )
+        {
+            s_set_latency( device, p_lat->lat_periods + 1, underrun ? SAL_LATENCYCHANGE_UNDERRUN : SAL_LATENCYCHANGE_LATE );
+        }
+        else
+        {
+            p_lat->lat_stable_frames     = 0;
+            p_lat->lat_window_mix_max_ns = 0;
+        }
+        return;
+    }
+
+    if ( p_lat->lat_last_mix_ns > p_lat->lat_window_mix_max_ns )
+    {
+        p_lat->lat_window_mix_max_ns = p_lat->lat_last_mix_ns;
+    }
+
+    p_lat->lat_stable_frames += frames_delivered;
+
+    if ( p_lat->lat_stable_frames >= p_lat->lat_window_frames )
+    {
+        if ( p_lat->lat_periods > SAL_LATENCY_MIN_PERIODS && p_lat->lat_window_mix_max_ns < p_lat->lat_period_ns / 4 )
+        {
+            s_set_latency( device, p_lat->lat_periods - 1, SAL_LATENCYCHANGE_STABLE );
+        }
+        else
+        {
+            p_lat->lat_stable_frames     = 0;
+            p_lat->lat_window_mix_max_ns = 0;
+        }
+    }
+}
+
+/** @internal
+    @brief Records how long a mix took
+    @param[in] device pointer to output device, must be locked
+    @param[in] start _SAL_get_time() when the mix started, 0 if there is no clock
+*/
+void
+_SAL_record_mix_time( SAL_Device *device, sal_u64_t start )
+{
+    sal_u64_t elapsed;
+    sal_u32_t elapsed_us;
+
+    if ( start == 0 )
+    {
+        return;
+    }
+
+    elapsed    = _SAL_get_time( device ) - start;
+    elapsed_us = ( sal_u32_t ) ( elapsed / 1000 );
+
+    device->device_latency.lat_last_mix_ns = elapsed;
+
+    device->device_stats.ds_num_mixes++;
+    device->device_stats.ds_mix_time_total_us += elapsed_us;
+    if ( elapsed_us > device->device_stats.ds_mix_time_max_us )
+    {
+        device->device_stats.ds_mix_time_max_us = elapsed_us;
+    }
+}
+
+/** @internal
+    @brief Counts a value in a latency histogram
+    @param[in] buckets @ref SAL_LATENCY_HISTOGRAM_BUCKETS buckets
+    @param[in] us value in microseconds
+*/
+static
+void
+s_add_to_histogram( sal_u32_t *buckets, sal_u64_t us )
+{
+    int i = 0;
+
+    while ( i < SAL_LATENCY_HISTOGRAM_BUCKETS - 1 && us >= ( ( sal_u64_t ) SAL_LATENCY_HISTOGRAM_BASE_US << i ) )
+    {
+        i++;
+    }
+
+    buckets[ i ]++;
+}
+
+/** @internal
+    @brief Records the time from a voice being started to its first frame
+    being mixed, see @ref SAL_SPF_TRACE_LATENCY
+    @param[in] device pointer to output device, must be locked
+    @param[in] trigger_time _SAL_get_time() when the voice was started
+    @remarks With @ref SAL_SPF_MIX_AHEAD this is the time until the frame
+    was mixed into the queue, the queue's own delay comes on top.
+*/
+void
+_SAL_record_trigger_latency( SAL_Device *device, sal_u64_t trigger_time )
+{
+    SAL_LatencyHistogram *p_hist = &device->device_latency.lat_histogram;
+    sal_u64_t now = _SAL_get_time( device );
+    sal_u32_t us  = ( sal_u32_t ) ( ( now > trigger_time ) ? ( now - trigger_time ) / 1000 : 0 );
+
+    if ( p_hist->lh_num_voices == 0 || us < p_hist->lh_min_us )
+    {
+        p_hist->lh_min_us = us;
+    }
+    if ( us > p_hist->lh_max_us )
+    {
+        p_hist->lh_max_us = us;
+    }
+
+    p_hist->lh_num_voices++;
+    p_hist->lh_total_us += us;
+
+    s_add_to_histogram( p_hist->lh_trigger_buckets, us );
+}
+
+/** @internal
+    @brief Records how late the audio thread woke up, see @ref SAL_SPF_TRACE_LATENCY
+    @param[in] device pointer to output device, must be locked
+    @param[in] late_us time past the deadline, in microseconds
+*/
+void
+_SAL_record_wakeup_latency( SAL_Device *device, sal_u64_t late_us )
+{
+    s_add_to_histogram( device->device_latency.lat_histogram.lh_wakeup_buckets, late_us );
+}
+
+/** @addtogroup DeviceManagement
+    @{
+*/
+
+/** @brief Registers a function that is told when adaptive latency changes.
+    @param[in] p_device pointer to the output device
+    @param[in] fnc function to call, NULL to stop being told
+    @param[in] p_arg passed to fnc
+    @returns SALERR_OK on success, @ref sal_error_e on failure
+    @remarks The function is called from the audio thread with the device
+    locked, so it should only log or record the change; calling back into
+    SAL from it deadlocks.  It is only called for devices created with @ref SAL_SPF_ADAPTIVE_LATENCY.
+*/
+sal_error_e
+SAL_set_latency_callback( SAL_Device *p_device,
+                          sal_latency_fnc_t fnc,
+                          void *p_arg )
+{
+    if ( p_device == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    _SAL_lock_device( p_device );
+
+    p_device->device_latency.lat_fnc_callback = fnc;
+    p_device->device_latency.lat_callback_arg = p_arg;
+
+    _SAL_unlock_device( p_device );
+
+    return SALERR_OK;
+}
+
+/** @brief Retrieves the latency histograms gathered with @ref SAL_SPF_TRACE_LATENCY.
+    @param[in] p_device pointer to the output device
+    @param[out] p_histogram pointer to a SAL_LatencyHistogram structure.  You
+    must set lh_size to sizeof( SAL_LatencyHistogram ) before calling this.
+    @returns SALERR_OK on success, @ref sal_error_e on failure
+    @remarks Trigger latency runs from SAL_play_sample() or
+    SAL_play_samples() returning to the mixer writing the voice's first
+    frame for the backend, so it shows how much of a period a new voice
+    waits.  The device's own queue, SAL_get_output_latency(), comes on top.
+    Voices started with SAL_play_sample_at() are not counted.  Everything
+    is 0 for devices created without @ref SAL_SPF_TRACE_LATENCY.
+*/
+sal_error_e
+SAL_get_latency_histogram( SAL_Device *p_device,
+                           SAL_LatencyHistogram *p_histogram )
+{
+    if ( p_device == 0 || p_histogram == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    if ( p_histogram->lh_size != sizeof( SAL_LatencyHistogram ) )
+    {
+        return SALERR_WRONGVERSION;
+    }
+
+    _SAL_lock_device( p_device );
+
+    *p_histogram = p_device->device_latency.lat_histogram;
+
+    _SAL_unlock_device( p_device );
+
+    p_histogram->lh_size = sizeof( SAL_LatencyHistogram );
+
+    return SALERR_OK;
+}
+
+/** @} */
@@ -165,12 +165,13 @@ submix_buffer( SAL_Device *device,
 /** @internal
     @brief This is the core SAL chunk of code, responsible for iterating over all
     available voices and mixing them into the destination buffer.
-    @param[in] device pointer to output device
+    @param[in] device pointer to output device, must be locked
     @param[out] p_dst pointer to destination buffer
     @param[in] bytes_to_mix number of bytes we need to mix
     @returns SALERR_OK on success, @ref sal_error_e otherwise
 
-    This function mixes stuff.
+    This function mixes stuff.  The caller holds the device lock for the
+    whole chunk, and the sample decoders it calls rely on that.
 */
 sal_error_e
 _SAL_mix_chunk( SAL_Device *device, 
@@ -179,14 +180,25 @@ _SAL_mix_chunk( SAL_Device *device,
 {
     int i;
     sal_byte_t clear_value;
-    sal_byte_t decode_buffer[ 512 ];
+    sal_byte_t *decode_buffer = device->device_decode_buffer;
+    sal_u64_t mix_start;
+    sal_u64_t chunk_start  = device->device_frame_clock;
+    sal_u32_t chunk_frames;
 
-    /* lock the device */
-    _SAL_lock_device( device );
+    /* time the mix so adaptive latency knows how close we are to the deadline */
+    mix_start = _SAL_get_time( device );
 	
     /* clear out the chunk to zero or 0x80 first depending on bit depth */
     clear_value = ( device->device_info.di_bits == 8 ) ? 0x80 : 0;
     memset( p_dst, clear_value, bytes_to_mix );
+
+    /* a backend that hasn't filled in its format yet gets silence */
+    if ( device->device_info.di_bytes_per_frame == 0 )
+    {
+        return SALERR_OK;
+    }
+
+    chunk_frames = bytes_to_mix / device->device_info.di_bytes_per_frame;
 	
     /*
     ** iterate over all the voices and decode/submix their sample data
@@ -207,10 +219,30 @@ _SAL_mix_chunk( SAL_Device *device,
             int bytes_left = bytes_to_mix;
             int voice_ended = 0;
 
-            /* decode up to sizeof( decode_buffer ) bytes at a time */
+            /* a scheduled voice starts partway into the chunk it falls in */
+            if ( p_voice->voice_start_frame > chunk_start )
+            {
+                sal_u64_t delay = p_voice->voice_start_frame - chunk_start;
+
+                if ( delay >= chunk_frames )
+                {
+                    continue;
+                }
+
+                bytes_left -= ( int ) delay * device->device_info.di_bytes_per_frame;
+            }
+
+            /* the voice's first frame goes out with this chunk */
+            if ( p_voice->voice_trigger_time )
+            {
+                _SAL_record_trigger_latency( device, p_voice->voice_trigger_time );
+                p_voice->voice_trigger_time = 0;
+            }
+
+            /* decode up to SAL_DECODE_BUFFER_SIZE bytes at a time */
             while ( bytes_left > 0 )
             {
-                int bytes_to_decode = ( bytes_left > sizeof( decode_buffer ) ) ? sizeof( decode_buffer ) : bytes_left;
+                int bytes_to_decode = ( bytes_left > SAL_DECODE_BUFFER_SIZE ) ? SAL_DECODE_BUFFER_SIZE : bytes_left;
 
                 /* call the sample's specific decoding function, which returns 1 if the voice has
                    played out (i.e. reached end of the sample and there are no more loop repetitions
@@ -235,16 +267,23 @@ _SAL_mix_chunk( SAL_Device *device,
                     /* decrease the ref count on our source sample */
                     --p_voice->voice_sample->sample_ref_count;
 
-                    /* clear voice entry */
-                    memset( p_voice, 0, sizeof( *p_voice ) );
+                    /* tell the application, then clear voice entry */
+                    _SAL_post_voice_event( device, i, SALVE_ENDED );
+                    _SAL_clear_voice( device, i );
                     break;
                 }
             }
         }
     }
 	
-    /* unlock the device */
-	_SAL_unlock_device( device );
+    /* scheduled voices count on this advancing in step with the audio */
+#ifdef SAL_STORE_RELEASE
+    SAL_STORE_RELEASE( &device->device_frame_clock, chunk_start + chunk_frames );
+#else
+    device->device_frame_clock = chunk_start + chunk_frames;
+#endif
+
+    _SAL_record_mix_time( device, mix_start );
 
     return SALERR_OK;
 }
@@ -0,0 +1,311 @@
+/*
+Copyright (c) 2004, Brian Hook
+All rights reserved.
+
+http://www.bookofhook.com/sal
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+
+    * The names of this package'ss contributors contributors may not
+      be used to endorse or promote products derived from this
+      software without specific prior written permission.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/** @file sal_pipeline.c
+    @brief Simple Audio Library mix-ahead pipeline
+    @remarks Normally a backend's audio thread mixes each period just before
+    it hands it to the device, so one slow mix (a burst of voices, a stream
+    decoding a new page) makes it late.  With @ref SAL_SPF_MIX_AHEAD a second
+    thread keeps up to sp_mix_ahead_periods periods mixed in a ring, and the
+    audio thread only copies them out with _SAL_render_chunk(), without
+    taking the device lock, so it never waits on a mix or on the application.
+    The ring adds that many periods of latency.
+*/
+#ifndef SAL_DOXYGEN
+#  define SAL_BUILDING_LIB 1
+#endif
+#include "sal.h"
+
+#include <string.h>
+
+#ifdef SAL_STORE_RELEASE
+
+/** @internal
+    @brief Mixes periods into the ring whenever it has a free slot */
+static
+void
+s_pipeline_worker( void *args )
+{
+    SAL_Device *device = ( SAL_Device * ) args;
+    _SAL_Pipeline *p_pipe = device->device_pipeline;
+    sal_u32_t head;
+
+    while ( !SAL_LOAD_ACQUIRE( &p_pipe->pipe_kill_worker ) )
+    {
+        head = p_pipe->pipe_head;
+
+        if ( head - SAL_LOAD_ACQUIRE( &p_pipe->pipe_tail ) < p_pipe->pipe_num_slots )
+        {
+            _SAL_lock_device( device );
+            _SAL_mix_chunk( device, 
+                            p_pipe->pipe_buffer + ( head % p_pipe->pipe_num_slots ) * p_pipe->pipe_slot_size, 
+                            p_pipe->pipe_slot_size );
+            /* publish under the lock so the frame clock never counts a
+               period that _SAL_get_pipeline_delay() can't see */
+            SAL_STORE_RELEASE( &p_pipe->pipe_head, head + 1 );
+            _SAL_unlock_device( device );
+        }
+        else
+        {
+            /* full, the audio thread frees a slot every period */
+            _SAL_sleep_until( device, _SAL_get_time( device ) + p_pipe->pipe_period_ns / 2 );
+        }
+    }
+
+    SAL_STORE_RELEASE( &p_pipe->pipe_worker_running, 0 );
+}
+
+#endif
+
+/** @internal
+    @brief Sets up the mix-ahead ring if the device was asked for one
+    @param[in] device pointer to output device, device_info must be filled in
+    @param[in] period_frames frames the backend takes at a time
+    @returns SALERR_OK on success or if no ring was asked for, @ref sal_error_e on failure
+    @remarks Backends that call _SAL_render_chunk() call this at the end of
+    their creation function.  The mixing thread is started by _SAL_start_pipeline()
+    once the device is complete, until then _SAL_render_chunk() returns silence.
+*/
+sal_error_e
+_SAL_init_pipeline( SAL_Device *device, sal_u32_t period_frames )
+{
+    _SAL_Pipeline *p_pipe;
+    sal_u32_t num_slots = device->device_system_parameters.sp_mix_ahead_periods;
+    sal_error_e err;
+
+    if ( !( device->device_system_parameters.sp_flags & SAL_SPF_MIX_AHEAD ) )
+    {
+        return SALERR_OK;
+    }
+
+#ifndef SAL_STORE_RELEASE
+    _SAL_warning( device, "Mixing ahead is not supported by this compiler\n" );
+    return SALERR_UNIMPLEMENTED;
+#else
+    if ( period_frames == 0 || device->device_info.di_sample_rate == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    num_slots = ( num_slots == 0 ) ? SAL_PIPELINE_DEFAULT_PERIODS : num_slots;
+    num_slots = ( num_slots > SAL_PIPELINE_MAX_PERIODS ) ? SAL_PIPELINE_MAX_PERIODS : num_slots;
+
+    if ( ( p_pipe = ( _SAL_Pipeline * ) device->device_callbacks.alloc( sizeof( *p_pipe ) ) ) == 0 )
+    {
+        return SALERR_OUTOFMEMORY;
+    }
+
+    memset( p_pipe, 0, sizeof( *p_pipe ) );
+
+    p_pipe->pipe_slot_size = period_frames * device->device_info.di_bytes_per_frame;
+    p_pipe->pipe_num_slots = num_slots;
+    p_pipe->pipe_period_ns = ( sal_u64_t ) period_frames * 1000000000 / device->device_info.di_sample_rate;
+    p_pipe->pipe_silence   = ( device->device_info.di_bits == 8 ) ? 0x80 : 0;
+
+    if ( ( err = SAL_alloc_aligned( device, ( void ** ) &p_pipe->pipe_buffer, p_pipe->pipe_slot_size * num_slots, SAL_ALIGNMENT ) ) != SALERR_OK )
+    {
+        device->device_callbacks.free( p_pipe );
+        return err;
+    }
+
+    _SAL_lock_memory( device, p_pipe, sizeof( *p_pipe ) );
+    _SAL_lock_memory( device, p_pipe->pipe_buffer, p_pipe->pipe_slot_size * num_slots );
+
+    device->device_pipeline = p_pipe;
+
+    return SALERR_OK;
+#endif
+}
+
+/** @internal
+    @brief Starts mixing ahead
+    @param[in] device pointer to output device, must be fully created
+    @remarks If the mixing thread can't be started the ring is bypassed and
+    the backend goes back to mixing for itself.  The ring itself stays until
+    _SAL_destroy_pipeline(), since the audio thread may be reading it.
+*/
+void
+_SAL_start_pipeline( SAL_Device *device )
+{
+#ifdef SAL_STORE_RELEASE
+    _SAL_Pipeline *p_pipe = device->device_pipeline;
+
+    if ( p_pipe == 0 )
+    {
+        return;
+    }
+
+    p_pipe->pipe_worker_running = 1;
+
+    if ( _SAL_create_thread( device, s_pipeline_worker, device, SAL_THREAD_AUDIO ) != SALERR_OK )
+    {
+        _SAL_warning( device, "Could not start the mixing thread, mixing on the audio thread instead\n" );
+
+        p_pipe->pipe_worker_running = 0;
+        SAL_STORE_RELEASE( &p_pipe->pipe_bypass, 1 );
+    }
+#endif
+}
+
+/** @internal
+    @brief Stops the mixing thread and frees the ring
+    @param[in] device pointer to output device, its backend must already be destroyed
+*/
+void
+_SAL_destroy_pipeline( SAL_Device *device )
+{
+#ifdef SAL_STORE_RELEASE
+    _SAL_Pipeline *p_pipe = device->device_pipeline;
+
+    if ( p_pipe == 0 )
+    {
+        return;
+    }
+
+    SAL_STORE_RELEASE( &p_pipe->pipe_kill_worker, 1 );
+
+    while ( SAL_LOAD_ACQUIRE( &p_pipe->pipe_worker_running ) )
+    {
+        SAL_sleep( device, 1 );
+    }
+
+    device->device_pipeline = 0;
+
+    SAL_free_aligned( device, p_pipe->pipe_buffer );
+    device->device_callbacks.free( p_pipe );
+#endif
+}
+
+/** @internal
+    @brief Returns how many frames are mixed ahead and waiting in the ring
+    @param[in] device pointer to output device, must be locked
+*/
+sal_u32_t
+_SAL_get_pipeline_delay( SAL_Device *device )
+{
+#ifdef SAL_STORE_RELEASE
+    _SAL_Pipeline *p_pipe = device->device_pipeline;
+    sal_u32_t queued;
+
+    if ( p_pipe == 0 )
+    {
+        return 0;
+    }
+
+    /* both counts wrap, but their difference is never more than the ring */
+    queued = SAL_LOAD_ACQUIRE( &p_pipe->pipe_head ) * p_pipe->pipe_slot_size - SAL_LOAD_ACQUIRE( &p_pipe->pipe_bytes_read );
+
+    return queued / device->device_info.di_bytes_per_frame;
+#else
+    return 0;
+#endif
+}
+
+/** @internal
+    @brief Fills a buffer with the next bytes of output
+    @param[in] device pointer to output device, must NOT be locked
+    @param[out] p_dst destination buffer
+    @param[in] bytes_to_render number of bytes to fill, a whole number of frames
+    @returns SALERR_OK on success, @ref sal_error_e on failure
+    @remarks Without a mix-ahead ring this locks the device and calls
+    _SAL_mix_chunk().  With one it copies periods the mixing thread has
+    finished without taking the lock, and if that thread has fallen behind
+    the rest is silence rather than audio mixed out of order.  Only the
+    backend's audio thread may call it.
+*/
+sal_error_e
+_SAL_render_chunk( SAL_Device *device, sal_byte_t *p_dst, sal_u32_t bytes_to_render )
+{
+#ifdef SAL_STORE_RELEASE
+    _SAL_Pipeline *p_pipe = device->device_pipeline;
+    sal_u32_t head, tail, bytes;
+    sal_error_e err;
+
+    if ( p_pipe == 0 || SAL_LOAD_ACQUIRE( &p_pipe->pipe_bypass ) )
+    {
+        _SAL_lock_device( device );
+        err = _SAL_mix_chunk( device, p_dst, bytes_to_render );
+        _SAL_unlock_device( device );
+
+        return err;
+    }
+
+    while ( bytes_to_render > 0 )
+    {
+        head = SAL_LOAD_ACQUIRE( &p_pipe->pipe_head );
+        tail = p_pipe->pipe_tail;
+
+        if ( head == tail )
+        {
+            /* nothing mixed before the mixing thread first gets going isn't a miss */
+            if ( head != 0 )
+            {
+                SAL_ATOMIC_INCREMENT( &device->device_stats.ds_num_pipeline_misses );
+            }
+            memset( p_dst, p_pipe->pipe_silence, bytes_to_render );
+            break;
+        }
+
+        bytes = p_pipe->pipe_slot_size - p_pipe->pipe_read_offset;
+        bytes = ( bytes > bytes_to_render ) ? bytes_to_render : bytes;
+
+        memcpy( p_dst, 
+                p_pipe->pipe_buffer + ( tail % p_pipe->pipe_num_slots ) * p_pipe->pipe_slot_size + p_pipe->pipe_read_offset, 
+                bytes );
+
+        p_dst                    += bytes;
+        bytes_to_render          -= bytes;
+        p_pipe->pipe_read_offset += bytes;
+
+        SAL_STORE_RELEASE( &p_pipe->pipe_bytes_read, p_pipe->pipe_bytes_read + bytes );
+
+        if ( p_pipe->pipe_read_offset == p_pipe->pipe_slot_size )
+        {
+            p_pipe->pipe_read_offset = 0;
+            SAL_STORE_RELEASE( &p_pipe->pipe_tail, tail + 1 );
+        }
+    }
+
+    return SALERR_OK;
+#else
+    sal_error_e err;
+
+    _SAL_lock_device( device );
+    err = _SAL_mix_chunk( device, p_dst, bytes_to_render );
+    _SAL_unlock_device( device );
+
+    return err;
+#endif
+}
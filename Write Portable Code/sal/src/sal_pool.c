@@ -0,0 +1,235 @@
+/*
+Copyright (c) 2004, Brian Hook
+All rights reserved.
+
+http://www.bookofhook.com/sal
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+
+    * The names of this package'ss contributors contributors may not
+      be used to endorse or promote products derived from this
+      software without specific prior written permission.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/** @file sal_pool.c
+    @brief Simple Audio Library small object pool
+*/
+#ifndef SAL_DOXYGEN
+#  define SAL_BUILDING_LIB 1
+#endif
+#include "sal.h"
+
+/** @internal
+    @brief Returns the size class an object belongs to
+    @param[in] sz size of the object in bytes
+    @returns index into _SAL_Pool::pool_free, or -1 if the object is too big for the pool
+*/
+static
+int
+s_pool_class( size_t sz )
+{
+    size_t class_size = SAL_ALIGNMENT;
+    int c = 0;
+
+    while ( class_size < sz )
+    {
+        class_size <<= 1;
+        c++;
+    }
+
+    return c < SAL_POOL_NUM_CLASSES ? c : -1;
+}
+
+/** @internal
+    @brief Allocates a small object from the device's pool
+    @param[in] device pointer to output device
+    @param[in] sz size of the object in bytes
+    @returns pointer to @ref SAL_ALIGNMENT aligned memory, or NULL if memory is exhausted
+    @remarks Objects are carved out of slabs of @ref SAL_POOL_SLAB_SIZE bytes which
+    are only given back when the device is destroyed, so after the first few objects
+    creating and destroying them never reaches the allocation callbacks.  Objects
+    bigger than the largest size class go straight to SAL_alloc_aligned().  The
+    device is locked while the pool is touched.
+    @sa _SAL_pool_free
+*/
+void *
+_SAL_pool_alloc( SAL_Device *device, size_t sz )
+{
+    _SAL_Pool *p_pool = &device->device_pool;
+    int c = s_pool_class( sz );
+    void **p_object;
+
+    if ( c < 0 )
+    {
+        void *p = 0;
+
+        SAL_alloc_aligned( device, &p, sz, SAL_ALIGNMENT );
+
+        return p;
+    }
+
+    _SAL_lock_device( device );
+
+    if ( p_pool->pool_free[ c ] == 0 )
+    {
+        size_t object_size = ( size_t ) SAL_ALIGNMENT << c;
+        size_t i;
+        sal_byte_t *p_slab = 0;
+
+        if ( SAL_alloc_aligned( device, ( void ** ) &p_slab, SAL_POOL_SLAB_SIZE, SAL_ALIGNMENT ) != SALERR_OK )
+        {
+            _SAL_unlock_device( device );
+            return 0;
+        }
+
+        _SAL_lock_memory( device, p_slab, SAL_POOL_SLAB_SIZE );
+
+        /* the first SAL_ALIGNMENT bytes link the slabs, the rest is cut into objects */
+        *( void ** ) p_slab = p_pool->pool_slabs;
+        p_pool->pool_slabs  = p_slab;
+
+        for ( i = ( SAL_POOL_SLAB_SIZE - SAL_ALIGNMENT ) / object_size; i > 0; i-- )
+        {
+            void **p_free = ( void ** ) ( p_slab + SAL_ALIGNMENT + ( i - 1 ) * object_size );
+
+            *p_free = p_pool->pool_free[ c ];
+            p_pool->pool_free[ c ] = p_free;
+        }
+    }
+
+    p_object = ( void ** ) p_pool->pool_free[ c ];
+    p_pool->pool_free[ c ] = *p_object;
+    p_pool->pool_num_objects++;
+
+    _SAL_unlock_device( device );
+
+    return p_object;
+}
+
+/** @internal
+    @brief Returns a small object to the device's pool
+    @param[in] device pointer to output device
+    @param[in] p object from _SAL_pool_alloc(), may be NULL
+    @param[in] sz size the object was allocated with
+    @sa _SAL_pool_free_locked
+*/
+void
+_SAL_pool_free( SAL_Device *device, void *p, size_t sz )
+{
+    if ( p == 0 )
+    {
+        return;
+    }
+
+    if ( s_pool_class( sz ) < 0 )
+    {
+        SAL_free_aligned( device, p );
+        return;
+    }
+
+    _SAL_lock_device( device );
+    _SAL_pool_free_locked( device, p, sz );
+    _SAL_unlock_device( device );
+}
+
+/** @internal
+    @brief Returns a small object to the device's pool
+    @param[in] device pointer to output device, must be locked
+    @param[in] p object from _SAL_pool_alloc(), may be NULL
+    @param[in] sz size the object was allocated with
+    @remarks For sample destruction callbacks and anything else that runs
+    with the device already locked.
+*/
+void
+_SAL_pool_free_locked( SAL_Device *device, void *p, size_t sz )
+{
+    _SAL_Pool *p_pool = &device->device_pool;
+    int c = s_pool_class( sz );
+
+    if ( p == 0 )
+    {
+        return;
+    }
+
+    if ( c < 0 )
+    {
+        SAL_free_aligned( device, p );
+        return;
+    }
+
+    *( void ** ) p = p_pool->pool_free[ c ];
+    p_pool->pool_free[ c ] = p;
+    p_pool->pool_num_objects--;
+}
+
+/** @internal
+    @brief Gives all of the pool's slabs back to the allocator
+    @param[in] device pointer to output device
+    @remarks Called when the device is destroyed, anything still allocated from
+    the pool is gone after this.
+*/
+void
+_SAL_destroy_pool( SAL_Device *device )
+{
+    _SAL_Pool *p_pool = &device->device_pool;
+    int c;
+
+    if ( p_pool->pool_num_objects != 0 )
+    {
+        _SAL_warning( device, "%u pooled objects, such as samples, were still allocated when the device was destroyed\n", p_pool->pool_num_objects );
+    }
+
+    while ( p_pool->pool_slabs )
+    {
+        void *p_slab = p_pool->pool_slabs;
+
+        p_pool->pool_slabs = *( void ** ) p_slab;
+        SAL_free_aligned( device, p_slab );
+    }
+
+    for ( c = 0; c < SAL_POOL_NUM_CLASSES; c++ )
+    {
+        p_pool->pool_free[ c ] = 0;
+    }
+
+    p_pool->pool_num_objects = 0;
+}
+
+/** @internal
+    @brief Keeps memory the mixer touches from being paged out
+    @param[in] device pointer to output device
+    @param[in] p start of the memory, may be NULL
+    @param[in] sz size of the memory in bytes
+    @remarks Does nothing unless the device was created with @ref SAL_MEMLOCK_BUFFERS
+    and the platform supports it.  The memory is unlocked when it is unmapped.
+*/
+void
+_SAL_lock_memory( SAL_Device *device, const void *p, size_t sz )
+{
+    if ( device->device_fnc_lock_memory && p && sz )
+    {
+        device->device_fnc_lock_memory( device, p, sz );
+    }
+}
@@ -60,6 +60,25 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define DEFAULT_AUDIO_CHANNELS    2          /**< default number of channels */
 #define DEFAULT_AUDIO_SAMPLE_RATE 44100      /**< default sample rate */
 #define DEFAULT_BUFFER_DURATION   50         /**< default buffer length in milliseconds */
+#define DEFAULT_NUM_PERIODS       4          /**< default number of periods the buffer is split into */
+#define SAL_DECODE_BUFFER_SIZE    512        /**< most bytes the mixer asks a decoder for at once */
+
+#define SAL_POOL_NUM_CLASSES      6          /**< pool size classes, 64 bytes doubling up to 2048 */
+#define SAL_POOL_SLAB_SIZE        16384      /**< bytes the pool takes from the allocator at a time */
+
+#define SAL_LATENCY_MIN_PERIODS   2          /**< fewest periods adaptive latency keeps queued */
+#define SAL_LATENCY_STABLE_WINDOW 5000       /**< milliseconds without trouble before adaptive latency shrinks */
+
+#define SAL_PIPELINE_DEFAULT_PERIODS 2       /**< periods mixed ahead when sp_mix_ahead_periods is 0 */
+#define SAL_PIPELINE_MAX_PERIODS  4          /**< most periods that can be mixed ahead */
+
+/* Lock-free loads and stores for fields with a single writer.  Code that
+   uses them must fall back to the device lock when they aren't defined. */
+#if defined __GNUC__
+#  define SAL_LOAD_ACQUIRE( p )     __atomic_load_n( p, __ATOMIC_ACQUIRE )
+#  define SAL_STORE_RELEASE( p, v ) __atomic_store_n( p, v, __ATOMIC_RELEASE )
+#  define SAL_ATOMIC_INCREMENT( p ) __atomic_fetch_add( p, 1, __ATOMIC_RELAXED )
+#endif
 
 /*
 ** ----------------------------------------------------------------------------
@@ -70,6 +89,16 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 typedef void *sal_mutex_t; /**< mutex used for interthread synchronization */
 
+/* A sal_voice_t handed to the application holds the voice's index in the
+   low bits and the voice's generation above them, so a handle kept after
+   its voice ended no longer matches once the voice is reused.  Decoders
+   and the other internal functions work with plain indices. */
+#define SAL_VOICE_INDEX_BITS       16                                    /**< bits of a handle holding the index, enough for @ref SAL_MAX_VOICES */
+#define SAL_VOICE_GENERATION_MASK  0x7FFF                                /**< generations wrap here, keeping handles positive */
+#define SAL_VOICE_INDEX( sid )     ( ( sid ) & ( SAL_MAX_VOICES - 1 ) )   /**< voice index a handle refers to */
+#define SAL_VOICE_GENERATION( sid ) ( ( sal_u32_t ) ( sid ) >> SAL_VOICE_INDEX_BITS ) /**< generation a handle was issued for */
+#define SAL_VOICE_HANDLE( index, generation ) ( ( sal_voice_t ) ( ( ( generation ) << SAL_VOICE_INDEX_BITS ) | ( index ) ) ) /**< builds a handle */
+
 /** @internal 
     @brief Internal data structure used to keep track of a playing voice's state
 */
@@ -82,10 +111,90 @@ typedef struct SAL_Voice_s
     sal_u32_t    voice_loop_start;           /**< loop start position, default is 0 */
     sal_u32_t    voice_loop_end;             /**< loop end position, default is 0 which indicates end of sample */
     sal_i32_t    voice_num_repetitions;      /**< number of times to repeat.  A value of @ref SAL_LOOP_ALWAYS means indefinite */
+    sal_u64_t    voice_start_frame;          /**< device frame the voice starts on, see SAL_play_sample_at() */
+    sal_u64_t    voice_trigger_time;         /**< _SAL_get_time() when the voice was started, 0 once its first frame is mixed, see @ref SAL_SPF_TRACE_LATENCY */
+    sal_u32_t    voice_generation;           /**< bumped every time the voice is started and kept when it is cleared, see SAL_VOICE_HANDLE */
+    sal_u32_t    voice_looped_event;         /**< eq_head just after this voice's last SALVE_LOOPED was posted, 0 if none */
 } SAL_Voice;
 
 typedef void ( POSH_CDECL *SAL_THREAD_FUNC)( void *args ); /**< function pointer type passed to _SAL_create_thread() */
 
+#define SAL_THREAD_AUDIO          1          /**< _SAL_create_thread() flag for threads that feed or mix audio, which get the scheduling, affinity and name in the system parameters */
+
+/** @internal
+    @brief Slab allocator for small objects such as samples and decoder state,
+    so creating and destroying them does not go to the allocation callbacks
+    every time.  Objects are @ref SAL_ALIGNMENT aligned.
+*/
+typedef struct _SAL_Pool_s
+{
+    void      *pool_slabs;                          /**< slabs taken from the allocator, linked through their first word */
+    void      *pool_free[ SAL_POOL_NUM_CLASSES ];   /**< free objects of each size class, linked through their first word */
+    sal_u32_t  pool_num_objects;                    /**< objects handed out and not yet returned */
+} _SAL_Pool;
+
+struct SAL_Device_s;
+
+/** Latency change callback registered with SAL_set_latency_callback()
+    @param p_device[in] pointer to output device, locked
+    @param latency_frames[in] frames the backend now keeps queued
+    @param reason[in] why it changed, as defined at @ref LatencyChange
+    @param p_arg[in] p_arg given to SAL_set_latency_callback()
+*/
+typedef void (*sal_latency_fnc_t)( struct SAL_Device_s *p_device, sal_u32_t latency_frames, sal_u32_t reason, void *p_arg );
+
+/** @internal
+    @brief State of the adaptive latency controller, see @ref SAL_SPF_ADAPTIVE_LATENCY */
+typedef struct _SAL_Latency_s
+{
+    int                lat_adaptive;            /**< 1 if the target may change */
+    sal_u32_t          lat_period_frames;       /**< frames per period */
+    sal_u64_t          lat_period_ns;           /**< duration of a period */
+    sal_u32_t          lat_max_periods;         /**< periods in the device's buffer */
+    sal_u32_t          lat_periods;             /**< periods the backend keeps queued */
+    sal_u32_t          lat_stable_frames;       /**< frames delivered since the last change or trouble */
+    sal_u32_t          lat_window_frames;       /**< frames without trouble it takes to shrink */
+    sal_u64_t          lat_window_mix_max_ns;   /**< longest mix since lat_stable_frames was reset */
+    sal_u64_t          lat_last_mix_ns;         /**< duration of the most recent mix */
+    int                lat_missed_deadline;     /**< set when a wakeup came more than a period late */
+    SAL_LatencyHistogram lat_histogram;         /**< trigger and wakeup latencies, see @ref SAL_SPF_TRACE_LATENCY */
+    sal_latency_fnc_t  lat_fnc_callback;        /**< called when the target changes, may be NULL */
+    void              *lat_callback_arg;        /**< passed to lat_fnc_callback */
+} _SAL_Latency;
+
+/** @internal
+    @brief Single producer, single consumer queue of pre-mixed periods, see
+    @ref SAL_SPF_MIX_AHEAD.  pipe_head is only written by the mixing thread
+    and pipe_tail, pipe_read_offset and pipe_bytes_read only by the backend's
+    audio thread, so the audio thread copies periods out without taking the
+    device lock. */
+typedef struct _SAL_Pipeline_s
+{
+    sal_byte_t        *pipe_buffer;             /**< pipe_num_slots periods of mixed audio */
+    sal_u32_t          pipe_slot_size;          /**< size of a period, in bytes */
+    sal_u32_t          pipe_num_slots;          /**< periods that can be mixed ahead */
+    sal_u32_t          pipe_head;               /**< periods mixed so far, the slot being mixed is pipe_head % pipe_num_slots */
+    sal_u32_t          pipe_tail;               /**< periods played so far, the slot being read is pipe_tail % pipe_num_slots */
+    sal_u32_t          pipe_read_offset;        /**< bytes of the tail slot that have been played, private to the audio thread */
+    sal_u32_t          pipe_bytes_read;         /**< bytes played so far, wrapping, for _SAL_get_pipeline_delay() */
+    sal_u64_t          pipe_period_ns;          /**< duration of a period */
+    sal_byte_t         pipe_silence;            /**< byte value of silence in the device's format */
+    int                pipe_kill_worker;        /**< set to 1 when the mixing thread should quit */
+    int                pipe_worker_running;     /**< 1 while the mixing thread runs */
+    int                pipe_bypass;             /**< 1 if the mixing thread couldn't be started and the audio thread mixes for itself */
+} _SAL_Pipeline;
+
+/** @internal
+    @brief Single producer, single consumer queue of voice events.  The mixer
+    posts with the device locked and only writes eq_head, SAL_get_voice_events()
+    reads without the lock and only writes eq_tail. */
+typedef struct _SAL_EventQueue_s
+{
+    SAL_VoiceEvent     eq_events[ SAL_VOICE_EVENT_QUEUE_SIZE ]; /**< ring of events */
+    sal_u32_t          eq_head;                 /**< events posted so far, the next goes in eq_head % SAL_VOICE_EVENT_QUEUE_SIZE */
+    sal_u32_t          eq_tail;                 /**< events read so far */
+} _SAL_EventQueue;
+
 /** @internal 
     @brief Internal data structure used to keep track of a sound device's state */
 typedef struct SAL_Device_s
@@ -98,6 +207,16 @@ typedef struct SAL_Device_s
     struct SAL_Voice_s  *device_voices;        /**< array of voice entries */
     int                  device_max_voices;    /**< maximum number of simultaneous voices playing */
 
+    sal_byte_t     *device_decode_buffer;      /**< @ref SAL_DECODE_BUFFER_SIZE bytes the mixer decodes voices into */
+    _SAL_Pool       device_pool;               /**< small object allocator */
+
+    SAL_SystemParameters device_system_parameters; /**< copy of the parameters the device was created with */
+    SAL_DeviceStats device_stats;              /**< statistics, protected by the device lock except ds_num_pipeline_misses, which is counted atomically */
+    _SAL_Latency    device_latency;            /**< adaptive latency state, protected by the device lock */
+    _SAL_Pipeline  *device_pipeline;           /**< mix-ahead queue, NULL unless SAL_SPF_MIX_AHEAD was given */
+    sal_u64_t       device_frame_clock;        /**< frames mixed since the device was created, only written by _SAL_mix_chunk() */
+    _SAL_EventQueue device_events;             /**< voice events waiting for SAL_get_voice_events() */
+
     /** @defgroup ImplementationCallbacks Implementation Callbacks
         @ingroup Implementations
         @brief Function pointers that provide the raw platform specific implementations
@@ -107,26 +226,37 @@ typedef struct SAL_Device_s
     sal_error_e   (*device_fnc_destroy_mutex)( struct SAL_Device_s *device, sal_mutex_t mtx );   /**< destroys a mutex */
     sal_error_e   (*device_fnc_lock_mutex)( struct SAL_Device_s *device, sal_mutex_t mtx );      /**< locks a mutex */
     sal_error_e   (*device_fnc_unlock_mutex)( struct SAL_Device_s *device, sal_mutex_t mtx );    /**< unlocks a mutex */
-    sal_error_e   (*device_fnc_create_thread)( struct SAL_Device_s *device, SAL_THREAD_FUNC fnc, void *targs ); /**< creates a thread */
+    sal_error_e   (*device_fnc_create_thread)( struct SAL_Device_s *device, SAL_THREAD_FUNC fnc, void *targs, sal_u32_t flags ); /**< creates a thread */
     sal_error_e   (*device_fnc_sleep)( struct SAL_Device_s *device, sal_u32_t duration );        /**< sleeps for the specified duration in milliseconds */
+    sal_u64_t     (*device_fnc_get_time)( struct SAL_Device_s *device );                         /**< reads a monotonic clock in nanoseconds, may be NULL */
+    sal_error_e   (*device_fnc_sleep_until)( struct SAL_Device_s *device, sal_u64_t deadline );  /**< sleeps until device_fnc_get_time() reaches deadline, may be NULL */
+    void          (*device_fnc_lock_memory)( struct SAL_Device_s *device, const void *p, size_t sz ); /**< keeps memory from being paged out, may be NULL */
     /** @} */
 
     void          (*device_fnc_destroy)( struct SAL_Device_s *d ); /**< pointer to device destruction function */
+    sal_error_e   (*device_fnc_get_delay)( struct SAL_Device_s *d, sal_u32_t *p_frames ); /**< frames handed to the device that haven't been heard yet, called locked, may be NULL */
 } SAL_Device;
 
 /** Sample destruction callback function registered with SAL_create_sample() 
-    @param p_device[in] pointer to output device 
+    @param p_device[in] pointer to output device, locked
     @param self[in] pointer to sample to destroy
 */
 typedef void (*sal_sample_destroy_fnc_t)( SAL_Device *p_device, struct SAL_Sample_s *self );
 /** Sample decode callback function registered with SAL_create_sample() 
-    @param p_device[in] pointer to output device
+    @param p_device[in] pointer to output device, locked by the mixer, so only
+    the _locked accessors such as _SAL_get_voice_sample_locked() may be used
     @param voice[in] voice that is being decoded 
     @param p_dst[out] destination buffer for decoding 
     @param dst_stride_bytes[in] stride of destination between samples 
     @param bytes_needed[in] number of bytes we need to decode
 */
 typedef int (*sal_sample_decode_fnc_t)( SAL_Device *p_device, sal_voice_t voice, sal_byte_t *p_dst, int bytes_needed );
+/** Buffer release callback registered with SAL_create_sample_from_buffer()
+    @param p_device[in] pointer to output device, locked
+    @param p_data[in] the buffer the sample adopted
+    @param p_arg[in] release_arg given to SAL_create_sample_from_buffer()
+*/
+typedef void (*sal_buffer_release_fnc_t)( SAL_Device *p_device, void *p_data, void *p_arg );
 
 /** @internal
     @brief Internal data structure used to keep track of a sample's state */
@@ -135,9 +265,12 @@ typedef struct SAL_Sample_s
     sal_i32_t   sample_ref_count;      /**< ref count, when it drops to 0 it may be destroyed */
     sal_byte_t *sample_data;           /**< raw sample data */
     sal_i32_t   sample_num_samples;    /**< number of samples in sample_data */
+    sal_i32_t   sample_data_aligned;   /**< non-zero if sample_data came from SAL_alloc_aligned() */
 
     sal_sample_destroy_fnc_t sample_fnc_destroy;  /**< function used to destroy the sample */
     sal_sample_decode_fnc_t  sample_fnc_decoder;  /**< function used to decode a chunk from the sample */
+    sal_buffer_release_fnc_t sample_fnc_release;  /**< gives back sample_data adopted by SAL_create_sample_from_buffer(), may be NULL */
+    void                    *sample_release_arg;  /**< passed to sample_fnc_release */
 
 	SAL_SampleArgs           sample_args;         /**< arguments specified during SAL_create_sample */
 } SAL_Sample;
@@ -149,18 +282,65 @@ typedef struct SAL_Sample_s
 */
 sal_error_e _SAL_mix_chunk( SAL_Device *device, sal_byte_t *p_dst, sal_u32_t u_bytes_to_mix );
 void        _SAL_destroy_sample_raw( SAL_Device *p_device, SAL_Sample *p_sample );
+void        _SAL_stop_voice_locked( SAL_Device *device, int voice );
+void        _SAL_clear_voice( SAL_Device *device, int voice );
+void        _SAL_post_voice_event( SAL_Device *device, int voice, sal_voice_event_e type );
+sal_error_e _SAL_destroy_sample_locked( SAL_Device *p_device, SAL_Sample *p_sample );
+
+/*
+** ----------------------------------------------------------------------------
+** Internal APIs for memory management
+** ----------------------------------------------------------------------------
+*/
+void       *_SAL_pool_alloc( SAL_Device *device, size_t sz );
+void        _SAL_pool_free( SAL_Device *device, void *p, size_t sz );
+void        _SAL_pool_free_locked( SAL_Device *device, void *p, size_t sz );
+void        _SAL_destroy_pool( SAL_Device *device );
+void        _SAL_lock_memory( SAL_Device *device, const void *p, size_t sz );
 
 /*
 ** ----------------------------------------------------------------------------
 ** Internal APIs for multithreading
 ** ----------------------------------------------------------------------------
 */
-sal_error_e _SAL_create_thread( SAL_Device *device, SAL_THREAD_FUNC fnc, void *targs );
+sal_error_e _SAL_create_thread( SAL_Device *device, SAL_THREAD_FUNC fnc, void *targs, sal_u32_t flags );
 sal_error_e _SAL_create_mutex( SAL_Device *device, sal_mutex_t *p_mutex );
 sal_error_e _SAL_destroy_mutex( SAL_Device *device, sal_mutex_t mutex );
 sal_error_e _SAL_lock_mutex( SAL_Device *device, sal_mutex_t mutex );
 sal_error_e _SAL_unlock_mutex( SAL_Device *device, sal_mutex_t mutex );
 
+/*
+** ----------------------------------------------------------------------------
+** Internal APIs for timing
+** ----------------------------------------------------------------------------
+*/
+sal_u64_t   _SAL_get_time( SAL_Device *device );
+sal_error_e _SAL_sleep_until( SAL_Device *device, sal_u64_t deadline );
+sal_error_e _SAL_wait_period( SAL_Device *device, sal_u64_t *p_deadline, sal_u64_t period );
+
+/*
+** ----------------------------------------------------------------------------
+** Internal APIs for latency management
+** ----------------------------------------------------------------------------
+*/
+void        _SAL_init_latency( SAL_Device *device, sal_u32_t sample_rate, sal_u32_t period_frames, sal_u32_t num_periods, int adaptive );
+sal_u32_t   _SAL_get_latency_frames( SAL_Device *device );
+void        _SAL_update_latency( SAL_Device *device, sal_u32_t frames_delivered, int underrun );
+void        _SAL_record_mix_time( SAL_Device *device, sal_u64_t start );
+void        _SAL_record_trigger_latency( SAL_Device *device, sal_u64_t trigger_time );
+void        _SAL_record_wakeup_latency( SAL_Device *device, sal_u64_t late_us );
+
+/*
+** ----------------------------------------------------------------------------
+** Internal APIs for mixing ahead
+** ----------------------------------------------------------------------------
+*/
+sal_error_e _SAL_init_pipeline( SAL_Device *device, sal_u32_t period_frames );
+void        _SAL_start_pipeline( SAL_Device *device );
+void        _SAL_destroy_pipeline( SAL_Device *device );
+sal_u32_t   _SAL_get_pipeline_delay( SAL_Device *device );
+sal_error_e _SAL_render_chunk( SAL_Device *device, sal_byte_t *p_dst, sal_u32_t bytes_to_render );
+
 /*
 ** ----------------------------------------------------------------------------
 ** Internal APIs for other system specific stuff
@@ -184,6 +364,11 @@ sal_error_e _SAL_create_device_data( SAL_Device *device,
                                      sal_u32_t desired_bits, 
                                      sal_u32_t desired_sample_rate );
 
+void        _SAL_get_period_config( const SAL_SystemParameters *kp_sp, 
+                                    sal_u32_t sample_rate, 
+                                    sal_u32_t *p_period_frames, 
+                                    sal_u32_t *p_num_periods );
+
 sal_error_e _SAL_lock_device( SAL_Device *device );
 sal_error_e _SAL_unlock_device( SAL_Device *device );
 
@@ -79,14 +79,39 @@ SAL_get_sample_ref_count( SAL_Device *p_device, const SAL_Sample *p_sample, sal_
     @brief Frees memory/destroys a sample, assuming that the ref count is already 0
     @param[in] p_device pointer to output device
     @param[in] p_sample pointer to sample to destroy
-    @remarks This assumes the device is already locked.
+    @remarks This assumes the device is already locked, so the sample's
+    destruction callback runs with the device locked too.
 */
 void
 _SAL_destroy_sample_raw( SAL_Device *p_device,
                          SAL_Sample *p_sample )
 {
     p_sample->sample_fnc_destroy( p_device, p_sample );
-    p_device->device_callbacks.free( p_sample );
+    _SAL_pool_free_locked( p_device, p_sample, sizeof( *p_sample ) );
+}
+
+/** @internal
+    @brief SAL_destroy_sample() for code that already holds the device lock
+    @param[in] p_device pointer to output device, must be locked
+    @param[in] p_sample pointer to sample to destroy
+    @retval SALERR_OK if the sample was destroyed
+    @retval SALERR_INUSE if the sample is still being used
+*/
+sal_error_e
+_SAL_destroy_sample_locked( SAL_Device *p_device,
+                            SAL_Sample *p_sample )
+{
+    /* decrement ref count */
+    p_sample->sample_ref_count--;
+
+    /* destroy the sample if possible */
+    if ( p_sample->sample_ref_count <= 0 )
+    {
+        _SAL_destroy_sample_raw( p_device, p_sample );
+        return SALERR_OK;
+    }
+
+    return SALERR_INUSE;
 }
 
 /** @brief Destroys a sample, assuming its ref count is 0.
@@ -101,6 +126,8 @@ sal_error_e
 SAL_destroy_sample( SAL_Device *p_device,
                     SAL_Sample *p_sample )
 {
+    sal_error_e err;
+
     if ( p_device == 0 || p_sample == 0 )
     {
         return SALERR_INVALIDPARAM;
@@ -109,23 +136,12 @@ SAL_destroy_sample( SAL_Device *p_device,
     /* lock access to the device */
     _SAL_lock_device( p_device );
 
-    /* decrement ref count */
-    p_sample->sample_ref_count--;
-
-    /* destroy the sample if possible */
-    if ( p_sample->sample_ref_count <= 0 )
-    {
-        _SAL_destroy_sample_raw( p_device, p_sample );
-
-        /* unlock the device */
-		_SAL_unlock_device( p_device );
-        return SALERR_OK;
-    }
+    err = _SAL_destroy_sample_locked( p_device, p_sample );
 
     /* unlock the device */
     _SAL_unlock_device( p_device );
 
-    return SALERR_INUSE;
+    return err;
 }
 
 /**@internal
@@ -156,10 +172,10 @@ _SAL_generic_decode_sample( SAL_Device *p_device,
     int cursor;
 
     /* NOTE: we don't need to lock the device since this should be called from the mixer,
-       which locks the device for us */
+       which locks the device for us, so only the _locked accessors may be used */
     samples_needed = bytes_needed / p_device->device_info.di_bytes_per_sample;
 
-    SAL_get_voice_sample( p_device, voice, &sample );
+    _SAL_get_voice_sample_locked( p_device, voice, &sample );
     SAL_get_sample_data( p_device, sample, &sample_data );
 
     /* This code assumes that the source sample format matches the output 
@@ -168,7 +184,7 @@ _SAL_generic_decode_sample( SAL_Device *p_device,
     {
         for ( i = 0; i < samples_needed; i++ )
         {
-            SAL_get_voice_cursor( p_device, voice, &cursor );
+            _SAL_get_voice_cursor_locked( p_device, voice, &cursor );
             p_dst[ i ] = sample_data[ cursor ];
             if ( !_SAL_advance_voice( p_device, voice, 1 ) )
             {
@@ -183,7 +199,7 @@ _SAL_generic_decode_sample( SAL_Device *p_device,
 		
         for ( i = 0; i < samples_needed; i++)
         {
-            SAL_get_voice_cursor( p_device, voice, &cursor );
+            _SAL_get_voice_cursor_locked( p_device, voice, &cursor );
             dst16[i] = kp_src[ cursor ];
 
             if ( !_SAL_advance_voice( p_device, voice, 1 ) )
@@ -203,13 +219,22 @@ _SAL_generic_decode_sample( SAL_Device *p_device,
     @param[in] self pointer to sample
     This routine is used as the default sample destruction callback
     function.  It should never be called directly by an application.
+    Data that SAL_create_sample() allocated is freed with SAL_free_aligned(),
+    anything else in sample_data is assumed to come from the alloc callback.
 */
 void
 _SAL_generic_destroy_sample( SAL_Device *p_device, SAL_Sample *self )
 {
     if ( self->sample_data )
     {
-        p_device->device_callbacks.free( self->sample_data );
+        if ( self->sample_data_aligned )
+        {
+            SAL_free_aligned( p_device, self->sample_data );
+        }
+        else
+        {
+            p_device->device_callbacks.free( self->sample_data );
+        }
         self->sample_data = 0;
     }
 }
@@ -244,7 +269,10 @@ SAL_get_sample_data( SAL_Device *p_device, SAL_Sample *p_sample, sal_byte_t **pp
     @param[in] args pointer to a SAL_SampleArgs structure to associate with this 
     sample.  The contents are copied, so the pointer does not need to be persistent
     with the sample.  This parameter may be NULL.
-    @remarks Use SAL_get_sample_data() to modify the PCM data directly
+    @remarks Use SAL_get_sample_data() to modify the PCM data directly.  The data is
+    @ref SAL_ALIGNMENT aligned.  When num_samples is 0 no data is allocated, and
+    _SAL_generic_destroy_sample() frees whatever is put in its place with the
+    alloc callback's free, as it always has.
 */
 sal_error_e 
 SAL_create_sample( SAL_Device *p_device, 
@@ -267,18 +295,26 @@ SAL_create_sample( SAL_Device *p_device,
     dinfo.di_size = sizeof( dinfo );
     SAL_get_device_info( p_device, &dinfo );
 
-    p_sample = ( SAL_Sample * ) p_device->device_callbacks.alloc( sizeof( *p_sample ) );
+    if ( ( p_sample = ( SAL_Sample * ) _SAL_pool_alloc( p_device, sizeof( *p_sample ) ) ) == 0 )
+    {
+        return SALERR_OUTOFMEMORY;
+    }
+
     memset( p_sample, 0, sizeof( *p_sample ) );
     p_sample->sample_num_samples = num_samples;
     p_sample->sample_fnc_decoder = decoder;
     p_sample->sample_fnc_destroy = destroy;
     p_sample->sample_ref_count = 1;
 
-    if ( num_samples > 0 )
+    if ( num_samples > 0 && 
+         SAL_alloc_aligned( p_device, ( void ** ) &p_sample->sample_data, num_samples * dinfo.di_bytes_per_sample, SAL_ALIGNMENT ) != SALERR_OK )
     {
-        p_sample->sample_data = ( sal_byte_t * ) p_device->device_callbacks.alloc( num_samples * dinfo.di_bytes_per_sample );
+        _SAL_pool_free( p_device, p_sample, sizeof( *p_sample ) );
+        return SALERR_OUTOFMEMORY;
     }
 
+    p_sample->sample_data_aligned = ( num_samples > 0 );
+
     if ( args )
     {
         p_sample->sample_args = *args;
@@ -289,6 +325,75 @@ SAL_create_sample( SAL_Device *p_device,
     return SALERR_OK;
 }
 
+/** @internal
+    @brief Destruction callback for samples made by SAL_create_sample_from_buffer()
+    @param[in] p_device pointer to output device
+    @param[in] self pointer to sample
+*/
+static
+void
+s_destroy_adopted_sample( SAL_Device *p_device, SAL_Sample *self )
+{
+    if ( self->sample_fnc_release )
+    {
+        self->sample_fnc_release( p_device, self->sample_data, self->sample_release_arg );
+    }
+
+    /* the data was never ours to free */
+    self->sample_data = 0;
+}
+
+/** @brief Creates a sample that plays straight out of a buffer the caller already has.
+    @ingroup SampleManagement
+    @param[in] p_device pointer to output device
+    @param[out] pp_sample address of pointer to sample to store output in
+    @param[in] p_data PCM data in the device's format: interleaved to the device's
+    channel count, unsigned 8-bit or native endian signed 16-bit samples.  It must be
+    aligned to a whole sample, and @ref SAL_ALIGNMENT is best.
+    @param[in] num_samples number of samples (not frames) in p_data
+    @param[in] release called with p_data and release_arg when the sample is destroyed,
+    may be NULL if the caller keeps track of the buffer's lifetime some other way
+    @param[in] release_arg passed to release
+    @retval SALERR_OK on success
+    @retval SALERR_INVALIDPARAM if a pointer is NULL or p_data is misaligned
+    @retval @ref sal_error_e otherwise
+    @remarks The sample aliases p_data without copying it, so the buffer must stay valid
+    and unchanged until release is called.  If this fails the caller still owns the
+    buffer and release is not called.
+*/
+sal_error_e 
+SAL_create_sample_from_buffer( SAL_Device *p_device, 
+                               SAL_Sample **pp_sample, 
+                               void *p_data,
+                               size_t num_samples,
+                               sal_buffer_release_fnc_t release,
+                               void *release_arg )
+{
+    sal_error_e err;
+
+    if ( p_device == 0 || pp_sample == 0 || p_data == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    if ( ( ( size_t ) p_data % p_device->device_info.di_bytes_per_sample ) != 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    if ( ( err = SAL_create_sample( p_device, pp_sample, 0, _SAL_generic_decode_sample, s_destroy_adopted_sample, NULL ) ) != SALERR_OK )
+    {
+        return err;
+    }
+
+    (*pp_sample)->sample_data        = ( sal_byte_t * ) p_data;
+    (*pp_sample)->sample_num_samples = ( sal_i32_t ) num_samples;
+    (*pp_sample)->sample_fnc_release = release;
+    (*pp_sample)->sample_release_arg = release_arg;
+
+    return SALERR_OK;
+}
+
 /** @brief Returns the SAL_SampleArgs structure associated with the sample
     @ingroup SampleManagement
     @param[in] p_device pointer to output device
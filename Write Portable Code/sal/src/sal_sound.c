@@ -46,47 +46,52 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
     @{
 */
 
-/** @brief play a sample, returning a voice handle for further management
-    @param[in] device pointer to SAL_Device
-    @param[in] p_sample pointer to sample to use for this sound
-    @param[in] p_sid pointer to sal_voice_t to store the active voice's id
-    @param[in] volume volume of the sound (0 to SAL_VOLUME_MAX)
-    @param[in] pan pan position of the sound (SAL_PAN_HARD_LEFT to SAL_PAN_HARD_RIGHT)
-    @param[in] loop_start loop start position
-    @param[in] loop_end loop end position, can set to 0 if you want to just use the sample's end position
-    @param[in] num_repetitions number of times to play the sound, use SAL_LOOP_ALWAYS for infinite repeats 
-    This function starts playback of a previously loaded sample, returning an identifier for the voice in
-    the p_sid parameter.  Using that identifier an application can adjust the voice's parameters such as
-    pan and volume, along with stopping the voice.  One potentialy tricky area is that you can start playing
-    a sound, have it end, and then later use that "stale" voice handle only to find it bound to another
-    voice.  One way to fix this is to force the application to "free" a voice handle, but that seemed
-    far too cumbersome for a rare error.
-    @sa SAL_stop_voice, SAL_set_voice_volume, SAL_set_voice_pan, SAL_get_voice_status
+/** @internal
+    @brief Finds the voice a handle refers to
+    @remarks Assumes the device is locked and the handle's index is in range.
+    @returns the voice, or NULL if it has ended and been started again since
+    the handle was issued
 */
-sal_error_e
-SAL_play_sample( SAL_Device *device,
-                 SAL_Sample *p_sample, 
-                 sal_voice_t *p_sid,
-                 sal_volume_t volume,
-                 sal_pan_t pan,
-                 sal_u32_t loop_start,
-                 sal_u32_t loop_end,
-                 sal_i32_t num_repetitions )
+static
+SAL_Voice *
+s_get_voice_locked( SAL_Device *device, sal_voice_t sid )
 {
-    int i;
-    SAL_Voice *p_voice;
+    SAL_Voice *p_voice = &device->device_voices[ SAL_VOICE_INDEX( sid ) ];
 
-    if ( device == 0 || p_sample == 0 || p_sid == 0 || ( loop_start > loop_end ) )
+    if ( p_voice->voice_generation != SAL_VOICE_GENERATION( sid ) )
     {
-        return SALERR_INVALIDPARAM;
+        return 0;
     }
 
-    _SAL_lock_device( device );
+    return p_voice;
+}
+
+/** @internal
+    @brief Starts a sample on the first free voice at or after first_voice
+    @remarks Assumes the device is locked and the parameters were validated.
+    start_frame is a frame clock value, 0 starts the voice with the next mix.
+    @returns SALERR_OK or SALERR_OUTOFVOICES
+*/
+static
+sal_error_e
+s_play_sample_locked( SAL_Device *device,
+                      SAL_Sample *p_sample,
+                      sal_voice_t *p_sid,
+                      sal_volume_t volume,
+                      sal_pan_t pan,
+                      sal_u32_t loop_start,
+                      sal_u32_t loop_end,
+                      sal_i32_t num_repetitions,
+                      sal_u64_t start_frame,
+                      int first_voice )
+{
+    int i;
+    SAL_Voice *p_voice;
 
     /* find a free voice */
-    p_voice = device->device_voices;
+    p_voice = device->device_voices + first_voice;
 
-    for ( i = 0; i < device->device_max_voices; i++, p_voice++ )
+    for ( i = first_voice; i < device->device_max_voices; i++, p_voice++ )
     {
         if ( p_voice->voice_num_repetitions == 0 )
         {
@@ -96,7 +101,6 @@ SAL_play_sample( SAL_Device *device,
 
     if ( i == device->device_max_voices )
     {
-        _SAL_unlock_device( device );
         return SALERR_OUTOFVOICES;
     }
 
@@ -114,30 +118,188 @@ SAL_play_sample( SAL_Device *device,
     p_voice->voice_loop_start      = loop_start;
     p_voice->voice_loop_end        = loop_end;
     p_voice->voice_num_repetitions = num_repetitions;
+    p_voice->voice_start_frame     = start_frame;
+    p_voice->voice_trigger_time    = ( start_frame == 0 && ( device->device_system_parameters.sp_flags & SAL_SPF_TRACE_LATENCY ) ) ? _SAL_get_time( device ) : 0;
+    p_voice->voice_generation      = ( p_voice->voice_generation + 1 ) & SAL_VOICE_GENERATION_MASK;
 
     /* increment sample's ref count */
     p_sample->sample_ref_count++;
 
     /* store voice identifier */
-    *p_sid = i;
+    *p_sid = SAL_VOICE_HANDLE( i, p_voice->voice_generation );
+
+    return SALERR_OK;
+}
+
+/** @brief play a sample, returning a voice handle for further management
+    @param[in] device pointer to SAL_Device
+    @param[in] p_sample pointer to sample to use for this sound
+    @param[in] p_sid pointer to sal_voice_t to store the active voice's id
+    @param[in] volume volume of the sound (0 to SAL_VOLUME_MAX)
+    @param[in] pan pan position of the sound (SAL_PAN_HARD_LEFT to SAL_PAN_HARD_RIGHT)
+    @param[in] loop_start loop start position
+    @param[in] loop_end loop end position, can set to 0 if you want to just use the sample's end position
+    @param[in] num_repetitions number of times to play the sound, use SAL_LOOP_ALWAYS for infinite repeats 
+    This function starts playback of a previously loaded sample, returning an identifier for the voice in
+    the p_sid parameter.  Using that identifier an application can adjust the voice's parameters such as
+    pan and volume, along with stopping the voice.  Handles are never reused while the application
+    might still hold one: once the voice ends, its handle behaves as an idle voice for good, even
+    after another sound has taken over the voice.  SAL_get_voice_events reports when it ends.
+    @sa SAL_stop_voice, SAL_set_voice_volume, SAL_set_voice_pan, SAL_get_voice_status, SAL_get_voice_events
+*/
+sal_error_e
+SAL_play_sample( SAL_Device *device,
+                 SAL_Sample *p_sample, 
+                 sal_voice_t *p_sid,
+                 sal_volume_t volume,
+                 sal_pan_t pan,
+                 sal_u32_t loop_start,
+                 sal_u32_t loop_end,
+                 sal_i32_t num_repetitions )
+{
+    sal_error_e err;
+
+    if ( device == 0 || p_sample == 0 || p_sid == 0 || ( loop_start > loop_end ) )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    _SAL_lock_device( device );
+
+    err = s_play_sample_locked( device, p_sample, p_sid, volume, pan, loop_start, loop_end, num_repetitions, 0, 0 );
 
     /* unlock device */
     _SAL_unlock_device( device );
 
-    return SALERR_OK;
+    return err;
+}
+
+/** @brief play a sample starting on an exact frame of the device's frame clock
+    @param[in] device pointer to SAL_Device
+    @param[in] p_sample pointer to sample to use for this sound
+    @param[in] p_sid pointer to sal_voice_t to store the active voice's id
+    @param[in] volume volume of the sound (0 to SAL_VOLUME_MAX)
+    @param[in] pan pan position of the sound (SAL_PAN_HARD_LEFT to SAL_PAN_HARD_RIGHT)
+    @param[in] loop_start loop start position
+    @param[in] loop_end loop end position, can set to 0 if you want to just use the sample's end position
+    @param[in] num_repetitions number of times to play the sound, use SAL_LOOP_ALWAYS for infinite repeats 
+    @param[in] start_frame frame clock value the sound's first frame is mixed at
+    SAL_play_sample starts a voice with whichever mix runs next, so its
+    start time wobbles by up to a buffer.  This one holds the voice's first
+    frame back until start_frame, even if that lands in the middle of a
+    buffer, so sounds scheduled a fixed number of frames apart stay exactly
+    that far apart however large the buffers are.  Read the clock with
+    SAL_get_frame_clock and schedule at least a buffer ahead; a start_frame
+    that has already been mixed plays right away, like SAL_play_sample.
+    The voice is allocated straight away and SAL_get_voice_status reports
+    SALVS_SCHEDULED until it starts.
+    @sa SAL_play_sample, SAL_get_frame_clock
+*/
+sal_error_e
+SAL_play_sample_at( SAL_Device *device,
+                    SAL_Sample *p_sample, 
+                    sal_voice_t *p_sid,
+                    sal_volume_t volume,
+                    sal_pan_t pan,
+                    sal_u32_t loop_start,
+                    sal_u32_t loop_end,
+                    sal_i32_t num_repetitions,
+                    sal_u64_t start_frame )
+{
+    sal_error_e err;
+
+    if ( device == 0 || p_sample == 0 || p_sid == 0 || ( loop_start > loop_end ) )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    _SAL_lock_device( device );
+
+    err = s_play_sample_locked( device, p_sample, p_sid, volume, pan, loop_start, loop_end, num_repetitions, start_frame, 0 );
+
+    _SAL_unlock_device( device );
+
+    return err;
+}
+
+/** @brief plays several samples at once
+    @param[in] device pointer to SAL_Device
+    @param[in,out] p_requests array of samples to play, see SAL_PlayRequest
+    @param[in] num_requests number of entries in p_requests
+    @returns SALERR_OK if every sample started, otherwise the first failing request's pr_result
+    Does what calling SAL_play_sample on each request would, but takes the
+    device lock only once, so the mixer either sees all of the voices start
+    or none of them.  Each request's pr_result and pr_voice are filled in
+    the same way SAL_play_sample fills in its return value and p_sid, and a
+    failed request doesn't stop the ones after it.
+    @sa SAL_play_sample, SAL_set_voice_params
+*/
+sal_error_e
+SAL_play_samples( SAL_Device *device,
+                  SAL_PlayRequest *p_requests,
+                  int num_requests )
+{
+    sal_error_e err = SALERR_OK;
+    int first_voice = 0;
+    int i;
+
+    if ( device == 0 || p_requests == 0 || num_requests < 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    _SAL_lock_device( device );
+
+    for ( i = 0; i < num_requests; i++ )
+    {
+        SAL_PlayRequest *p_req = &p_requests[ i ];
+
+        p_req->pr_voice = SAL_INVALID_SOUND;
+
+        if ( p_req->pr_sample == 0 || p_req->pr_loop_start > p_req->pr_loop_end )
+        {
+            p_req->pr_result = SALERR_INVALIDPARAM;
+        }
+        else
+        {
+            p_req->pr_result = s_play_sample_locked( device,
+                                                     p_req->pr_sample,
+                                                     &p_req->pr_voice,
+                                                     p_req->pr_volume,
+                                                     p_req->pr_pan,
+                                                     p_req->pr_loop_start,
+                                                     p_req->pr_loop_end,
+                                                     p_req->pr_num_repetitions,
+                                                     p_req->pr_start_frame,
+                                                     first_voice );
+
+            /* every voice below the one we just took is busy */
+            first_voice = ( p_req->pr_result == SALERR_OK ) ? SAL_VOICE_INDEX( p_req->pr_voice ) + 1 : device->device_max_voices;
+        }
+
+        if ( err == SALERR_OK )
+        {
+            err = p_req->pr_result;
+        }
+    }
+
+    _SAL_unlock_device( device );
+
+    return err;
 }
 
 /** @brief stops a currently playing voice
     @param[in] p_device pointer to output device
     @param[in] sid handle to the currently playing voice
     @returns SALERR_OK on success, @ref sal_error_e on failure
-    Stops a currently playing voice
+    Stops a currently playing voice.  Stopping a voice that has already
+    ended does nothing, and no @ref SALVE_ENDED event is posted either way.
 */
 sal_error_e 
 SAL_stop_voice( SAL_Device *p_device, 
                 sal_voice_t sid )
 {
-    if ( p_device == 0 || sid < 0 || sid >= p_device->device_max_voices )
+    if ( p_device == 0 || sid < 0 || SAL_VOICE_INDEX( sid ) >= p_device->device_max_voices )
     {
         return SALERR_INVALIDPARAM;
     }
@@ -145,20 +307,177 @@ SAL_stop_voice( SAL_Device *p_device,
     /* lock the device */
     _SAL_lock_device( p_device );
 
-    if ( p_device->device_voices[ sid ].voice_num_repetitions != 0 )
+    if ( s_get_voice_locked( p_device, sid ) != 0 )
     {
-        /* decrement the ref count */
-        if ( --p_device->device_voices[ sid ].voice_sample->sample_ref_count <= 0 )
+        _SAL_stop_voice_locked( p_device, SAL_VOICE_INDEX( sid ) );
+    }
+
+    /* unlock the device */
+    _SAL_unlock_device( p_device );
+
+    return SALERR_OK;
+}
+
+/** @internal
+    @brief Stops whatever is playing on a voice, for code that has an index
+    rather than a handle
+    @param[in] device pointer to output device, must be locked
+    @param[in] voice voice index
+    @remarks Drops the voice's reference to its sample, destroying the sample
+    if that was the last one, and clears the voice.  A voice that isn't
+    playing is left as it is.
+*/
+void
+_SAL_stop_voice_locked( SAL_Device *device, int voice )
+{
+    SAL_Voice *p_voice = &device->device_voices[ voice ];
+
+    if ( p_voice->voice_num_repetitions != 0 )
+    {
+        _SAL_destroy_sample_locked( device, p_voice->voice_sample );
+    }
+
+    _SAL_clear_voice( device, voice );
+}
+
+/** @internal
+    @brief Clears a voice that has ended or been stopped, keeping its generation
+    @param[in] device pointer to output device, must be locked
+    @param[in] voice voice index
+*/
+void
+_SAL_clear_voice( SAL_Device *device, int voice )
+{
+    SAL_Voice *p_voice = &device->device_voices[ voice ];
+    sal_u32_t generation = p_voice->voice_generation;
+
+    memset( p_voice, 0, sizeof( *p_voice ) );
+
+    p_voice->voice_generation = generation;
+}
+
+/** @internal
+    @brief Tells the application something happened to a voice
+    @param[in] device pointer to output device, must be locked
+    @param[in] voice voice index
+    @param[in] type what happened
+    @remarks Only the mixer and the decoders it calls post events, so there
+    is a single producer.  If the application hasn't kept up the event is
+    dropped and counted in ds_num_lost_events.  A short loop wraps every
+    chunk, so a voice only has one unread SALVE_LOOPED at a time, and
+    SALVE_LOOPED is only posted while the queue is less than half full.
+    Looping voices can't fill the queue and make SALVE_ENDED get dropped.
+*/
+void
+_SAL_post_voice_event( SAL_Device *device, int voice, sal_voice_event_e type )
+{
+    _SAL_EventQueue *p_queue = &device->device_events;
+    SAL_Voice *p_voice = &device->device_voices[ voice ];
+    sal_u32_t head = p_queue->eq_head;
+    sal_u32_t tail;
+    SAL_VoiceEvent *p_event;
+
+#ifdef SAL_LOAD_ACQUIRE
+    tail = SAL_LOAD_ACQUIRE( &p_queue->eq_tail );
+#else
+    tail = p_queue->eq_tail;
+#endif
+
+    if ( type == SALVE_LOOPED )
+    {
+        /* the application hasn't read this voice's last one yet */
+        if ( p_voice->voice_looped_event != 0 && ( sal_i32_t ) ( tail - p_voice->voice_looped_event ) < 0 )
         {
-            _SAL_destroy_sample_raw( p_device, p_device->device_voices[ sid ].voice_sample );
+            return;
         }
+
+        /* keep the rest of the queue for events that aren't repeated */
+        if ( head - tail >= SAL_VOICE_EVENT_QUEUE_SIZE / 2 )
+        {
+            return;
+        }
+
+        p_voice->voice_looped_event = head + 1;
+    }
+
+    if ( head - tail >= SAL_VOICE_EVENT_QUEUE_SIZE )
+    {
+        device->device_stats.ds_num_lost_events++;
+        return;
     }
 
-    /* clear the voice */
-    memset( &p_device->device_voices[ sid ], 0, sizeof( p_device->device_voices[ 0 ] ) );
+    p_event = &p_queue->eq_events[ head % SAL_VOICE_EVENT_QUEUE_SIZE ];
 
-    /* unlock the device */
+    p_event->ve_voice = SAL_VOICE_HANDLE( voice, p_voice->voice_generation );
+    p_event->ve_type  = type;
+    p_event->ve_frame = device->device_frame_clock;
+
+    /* publish the event only once it's complete */
+#ifdef SAL_STORE_RELEASE
+    SAL_STORE_RELEASE( &p_queue->eq_head, head + 1 );
+#else
+    p_queue->eq_head = head + 1;
+#endif
+}
+
+/** @brief retrieves what has happened to voices since the last call
+    @param[in] p_device pointer to output device
+    @param[out] p_events array to store the events in, oldest first
+    @param[in] max_events number of entries in p_events
+    @param[out] p_num_events number of events stored
+    @returns SALERR_OK on success, @ref sal_error_e on failure
+    The mixer queues an event whenever a voice ends, wraps around its loop,
+    or (for streamed samples) runs out of data.  Each carries the handle
+    SAL_play_sample returned, so calling this once per frame replaces asking
+    SAL_get_voice_status about every voice.  Events that don't fit in
+    p_events stay queued for the next call.  The queue holds
+    @ref SAL_VOICE_EVENT_QUEUE_SIZE events; any more are dropped and counted
+    in ds_num_lost_events.  SALVE_LOOPED is not queued again for a voice
+    until the last one has been read, and never takes the second half of
+    the queue, so looping voices don't cause SALVE_ENDED to be lost.  This doesn't take the device lock, so it never
+    waits for the mixer, but it must only be called from one thread at a time.
+    @sa sal_voice_event_e, SAL_play_sample
+*/
+sal_error_e
+SAL_get_voice_events( SAL_Device *p_device,
+                      SAL_VoiceEvent *p_events,
+                      int max_events,
+                      int *p_num_events )
+{
+    _SAL_EventQueue *p_queue;
+    sal_u32_t head, tail;
+    int num_events = 0;
+
+    if ( p_device == 0 || p_events == 0 || max_events < 0 || p_num_events == 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    p_queue = &p_device->device_events;
+
+#ifdef SAL_LOAD_ACQUIRE
+    head = SAL_LOAD_ACQUIRE( &p_queue->eq_head );
+#else
+    _SAL_lock_device( p_device );
+    head = p_queue->eq_head;
+#endif
+    tail = p_queue->eq_tail;
+
+    while ( tail != head && num_events < max_events )
+    {
+        p_events[ num_events++ ] = p_queue->eq_events[ tail % SAL_VOICE_EVENT_QUEUE_SIZE ];
+        tail++;
+    }
+
+    /* hand the slots back to the mixer */
+#ifdef SAL_STORE_RELEASE
+    SAL_STORE_RELEASE( &p_queue->eq_tail, tail );
+#else
+    p_queue->eq_tail = tail;
     _SAL_unlock_device( p_device );
+#endif
+
+    *p_num_events = num_events;
 
     return SALERR_OK;
 }
@@ -169,14 +488,17 @@ SAL_stop_voice( SAL_Device *p_device,
     @param[in] p_status address of a sal_voice_status_e variable
     @returns SALERR_OK, @ref sal_error_e otherwise
     This function queries the status of an active voice.  It will be one of the
-    constants defined by the sal_voice_status_e enumerant.
+    constants defined by the sal_voice_status_e enumerant.  To find out when
+    voices end without asking about each one, use SAL_get_voice_events.
 */
 sal_error_e 
 SAL_get_voice_status( SAL_Device *p_device, 
                       sal_voice_t sid,
                       sal_voice_status_e *p_status )
 {
-    if ( p_device == 0 || p_status == 0 || sid < 0 || sid >= p_device->device_max_voices )
+    SAL_Voice *p_voice;
+
+    if ( p_device == 0 || p_status == 0 || sid < 0 || SAL_VOICE_INDEX( sid ) >= p_device->device_max_voices )
     {
         if ( p_status && p_device != 0 )
         {
@@ -189,10 +511,16 @@ SAL_get_voice_status( SAL_Device *p_device,
     /* we need to lock the device before we start inspecting things */
     _SAL_lock_device( p_device );
 
-    if ( p_device->device_voices[ sid ].voice_num_repetitions == 0 )
+    p_voice = s_get_voice_locked( p_device, sid );
+
+    if ( p_voice == 0 || p_voice->voice_num_repetitions == 0 )
     {
         *p_status = SALVS_IDLE;
     }
+    else if ( p_voice->voice_start_frame > p_device->device_frame_clock )
+    {
+        *p_status = SALVS_SCHEDULED;
+    }
     else
     {
         *p_status = SALVS_PLAYING;
@@ -213,14 +541,19 @@ SAL_get_voice_status( SAL_Device *p_device,
 sal_error_e 
 SAL_set_voice_volume( SAL_Device *p_device, sal_voice_t sid, sal_volume_t volume )
 {
-    if ( p_device == 0 || sid < 0 || sid >= p_device->device_max_voices )
+    SAL_Voice *p_voice;
+
+    if ( p_device == 0 || sid < 0 || SAL_VOICE_INDEX( sid ) >= p_device->device_max_voices )
     {
         return SALERR_INVALIDPARAM;
     }
 
     _SAL_lock_device( p_device );
 
-    p_device->device_voices[ sid ].voice_volume = volume;
+    if ( ( p_voice = s_get_voice_locked( p_device, sid ) ) != 0 )
+    {
+        p_voice->voice_volume = volume;
+    }
 
     _SAL_unlock_device( p_device );
 
@@ -236,20 +569,90 @@ SAL_set_voice_volume( SAL_Device *p_device, sal_voice_t sid, sal_volume_t volume
 sal_error_e 
 SAL_set_voice_pan( SAL_Device *p_device, sal_voice_t sid, sal_pan_t pan )
 {
-    if ( p_device == 0 || sid < 0 || sid >= p_device->device_max_voices )
+    SAL_Voice *p_voice;
+
+    if ( p_device == 0 || sid < 0 || SAL_VOICE_INDEX( sid ) >= p_device->device_max_voices )
     {
         return SALERR_INVALIDPARAM;
     }
 
     _SAL_lock_device( p_device );
 
-    p_device->device_voices[ sid ].voice_pan = pan;
+    if ( ( p_voice = s_get_voice_locked( p_device, sid ) ) != 0 )
+    {
+        p_voice->voice_pan = pan;
+    }
 
     _SAL_unlock_device( p_device );
 
     return SALERR_OK;
 }
 
+/** @brief Sets the parameters of several voices at once
+    @param[in] p_device pointer to output device
+    @param[in,out] p_params array of updates, see SAL_VoiceParams
+    @param[in] num_params number of entries in p_params
+    @returns SALERR_OK if every update was applied, otherwise the first failing update's vp_result
+    Applies each update's @ref VPF selected fields as SAL_set_voice_volume
+    and SAL_set_voice_pan would, but under a single device lock, so the
+    mixer never hears half of a frame's changes.  An update naming an
+    invalid voice gets SALERR_INVALIDPARAM in vp_result and the rest are
+    still applied.
+    @sa SAL_set_voice_volume, SAL_set_voice_pan, SAL_play_samples
+*/
+sal_error_e
+SAL_set_voice_params( SAL_Device *p_device,
+                      SAL_VoiceParams *p_params,
+                      int num_params )
+{
+    sal_error_e err = SALERR_OK;
+    int i;
+
+    if ( p_device == 0 || p_params == 0 || num_params < 0 )
+    {
+        return SALERR_INVALIDPARAM;
+    }
+
+    _SAL_lock_device( p_device );
+
+    for ( i = 0; i < num_params; i++ )
+    {
+        SAL_VoiceParams *p_vp = &p_params[ i ];
+        SAL_Voice *p_voice;
+
+        if ( p_vp->vp_voice < 0 || SAL_VOICE_INDEX( p_vp->vp_voice ) >= p_device->device_max_voices )
+        {
+            p_vp->vp_result = SALERR_INVALIDPARAM;
+
+            if ( err == SALERR_OK )
+            {
+                err = SALERR_INVALIDPARAM;
+            }
+            continue;
+        }
+
+        /* a voice that has ended is left alone, as SAL_set_voice_volume would */
+        if ( ( p_voice = s_get_voice_locked( p_device, p_vp->vp_voice ) ) != 0 )
+        {
+            if ( p_vp->vp_flags & SAL_VPF_VOLUME )
+            {
+                p_voice->voice_volume = p_vp->vp_volume;
+            }
+
+            if ( p_vp->vp_flags & SAL_VPF_PAN )
+            {
+                p_voice->voice_pan = p_vp->vp_pan;
+            }
+        }
+
+        p_vp->vp_result = SALERR_OK;
+    }
+
+    _SAL_unlock_device( p_device );
+
+    return err;
+}
+
 /** @brief Return the sample associated with a playing sound
     @param[in] p_device pointer to output device
     @param[in] sid sound id
@@ -261,20 +664,48 @@ SAL_get_voice_sample( SAL_Device *p_device,
                       sal_voice_t sid,
                       SAL_Sample **pp_sample )
 {
-    if ( p_device == 0 || sid < 0 || sid >= p_device->device_max_voices || pp_sample == 0 ) 
+    if ( p_device == 0 || sid < 0 || SAL_VOICE_INDEX( sid ) >= p_device->device_max_voices || pp_sample == 0 ) 
     {
         return SALERR_INVALIDPARAM;
     }
 
     _SAL_lock_device( p_device );
 
-    *pp_sample = p_device->device_voices[ sid ].voice_sample;
+    if ( s_get_voice_locked( p_device, sid ) != 0 )
+    {
+        _SAL_get_voice_sample_locked( p_device, SAL_VOICE_INDEX( sid ), pp_sample );
+    }
+    else
+    {
+        *pp_sample = 0;
+    }
 
     _SAL_unlock_device( p_device );
 
     return SALERR_OK;
 }
 
+/** @brief SAL_get_voice_sample() for code that already holds the device lock
+    @internal
+    Sample decoders run inside the mixer with the device locked, so they
+    must use this instead of SAL_get_voice_sample(), which would deadlock.
+
+    @param[in] p_device pointer to output device, must be locked
+    @param[in] sid voice index, as passed to the sample's decoder
+    @param[out] pp_sample address of pointer to sample to store the result
+    @returns SALERR_OK
+*/
+sal_error_e 
+_SAL_get_voice_sample_locked( SAL_Device *p_device, 
+                              sal_voice_t sid,
+                              SAL_Sample **pp_sample )
+{
+    /* parameter validation should have happened upstream */
+    *pp_sample = p_device->device_voices[ sid ].voice_sample;
+
+    return SALERR_OK;
+}
+
 /** @brief Returns the current cursor (in sample space) for the sound
     @param[in] p_device pointer to output device
     @param[in] sid sound id
@@ -286,28 +717,57 @@ SAL_get_voice_cursor( SAL_Device *p_device,
                       sal_voice_t sid,
                       int *p_cursor )
 {
-    if ( p_device == 0 || sid < 0 || sid >= p_device->device_max_voices || p_cursor == 0 ) 
+    if ( p_device == 0 || sid < 0 || SAL_VOICE_INDEX( sid ) >= p_device->device_max_voices || p_cursor == 0 ) 
     {
         return SALERR_INVALIDPARAM;
     }
 
     _SAL_lock_device( p_device );
 
-    *p_cursor = p_device->device_voices[ sid ].voice_cursor;
+    if ( s_get_voice_locked( p_device, sid ) != 0 )
+    {
+        _SAL_get_voice_cursor_locked( p_device, SAL_VOICE_INDEX( sid ), p_cursor );
+    }
+    else
+    {
+        *p_cursor = 0;
+    }
 
     _SAL_unlock_device( p_device );
 
     return SALERR_OK;
 }
+
+/** @brief SAL_get_voice_cursor() for code that already holds the device lock
+    @internal
+    Sample decoders run inside the mixer with the device locked, so they
+    must use this instead of SAL_get_voice_cursor(), which would deadlock.
+
+    @param[in] p_device pointer to output device, must be locked
+    @param[in] sid voice index, as passed to the sample's decoder
+    @param[out] p_cursor address of integer in which to store sample
+    @returns SALERR_OK
+*/
+sal_error_e 
+_SAL_get_voice_cursor_locked( SAL_Device *p_device,
+                              sal_voice_t sid,
+                              int *p_cursor )
+{
+    /* parameter validation should have happened upstream */
+    *p_cursor = p_device->device_voices[ sid ].voice_cursor;
+
+    return SALERR_OK;
+}
 /**@brief advances a voice's cursor, checking for loops and repetitions
    @internal
    This is an internal function that advances the given voice ahead by one
    frame.  If it reaches the loop end it decrements the 
-   number of repetitions and returns 0.  This is exposed in the public API
+   number of repetitions and returns 0, otherwise it posts a @ref SALVE_LOOPED
+   event.  This is exposed in the public API
    since it can be used by a user-defined sample type.
 
    @param[in] p_device pointer to output device
-   @param[in] sid sound id
+   @param[in] sid voice index, as passed to the sample's decoder
    @param[in] num_frames number of frames to advance the voice
    @returns 0 if the voice has ended playing
    @returns 1 if the voice is still playing
@@ -335,6 +795,8 @@ _SAL_advance_voice( SAL_Device *p_device, sal_voice_t sid, int num_frames )
                     return 0;
                 }
             }
+
+            _SAL_post_voice_event( p_device, sid, SALVE_LOOPED );
         }
     }
     /* no loop end marker */
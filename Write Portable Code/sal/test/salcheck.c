@@ -0,0 +1,834 @@
+/* salcheck -- decodes known vectors through SAL and checks the output
+
+   usage: salcheck
+
+   The checks create their samples on a device opened on the null backend,
+   so SAL has to be built with SAL_SUPPORT_NULL, but no sound hardware is
+   needed.  Each voice is scheduled so far ahead that the null backend's
+   mixer never reaches it, and the sample's decoder is then called directly
+   with the device locked, which hands back exactly what the mixer would
+   have submixed.  That needs SAL's internals, so salcheck is compiled
+   together with the library and extras sources instead of linked against
+   SAL.
+
+   Every failed check prints a line, and the exit code is 1 if any failed.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SAL_BUILDING_LIB 1
+#include "../src/sal.h"
+#include "../src/extras/salx_wave.h"
+#include "../src/extras/salx_adpcm.h"
+#include "../src/extras/salx_flac.h"
+
+#define CHECK_RATE      22050
+#define CHECK_CHUNK     1000        /* bytes per decoder call, deliberately not a power of two */
+#define CHECK_FOREVER   ( ( ~( sal_u64_t ) 0 ) >> 1 )
+
+static SAL_Device *s_device;
+static int         s_num_checks;
+static int         s_num_failed;
+
+static void
+s_check( int condition, const char *kp_what )
+{
+    s_num_checks++;
+
+    if ( !condition )
+    {
+        fprintf( stderr, "salcheck: FAILED %s\n", kp_what );
+        s_num_failed++;
+    }
+}
+
+/* decodes num_bytes of p_sample the way the mixer would, returns 1 if the
+   voice played out within them */
+static int
+s_decode( SAL_Sample *p_sample,
+          sal_u32_t loop_start,
+          sal_u32_t loop_end,
+          sal_i32_t num_repetitions,
+          sal_byte_t *p_dst,
+          int num_bytes )
+{
+    sal_voice_t voice;
+    int index;
+    int done = 0;
+    int ended = 0;
+
+    if ( SAL_play_sample_at( s_device, p_sample, &voice, 65535, 0,
+                             loop_start, loop_end, num_repetitions, CHECK_FOREVER ) != SALERR_OK )
+    {
+        return -1;
+    }
+
+    index = SAL_VOICE_INDEX( voice );
+
+    _SAL_lock_device( s_device );
+
+    while ( done < num_bytes && !ended )
+    {
+        int bytes = ( num_bytes - done > CHECK_CHUNK ) ? CHECK_CHUNK : num_bytes - done;
+
+        ended = p_sample->sample_fnc_decoder( s_device, index, p_dst + done, bytes );
+        done += bytes;
+    }
+
+    /* retire the voice the way the mixer does when a voice ends */
+    --p_sample->sample_ref_count;
+    _SAL_clear_voice( s_device, index );
+
+    _SAL_unlock_device( s_device );
+
+    return ended;
+}
+
+/* writes a canonical 44 byte WAV header followed by the data, returns the size */
+static int
+s_make_wave( sal_byte_t *p_dst, int channels, int bits, const void *kp_data, int data_size )
+{
+    static const sal_byte_t header[ 44 ] =
+    {
+        'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E',
+        'f', 'm', 't', ' ', 16, 0, 0, 0, 1, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        'd', 'a', 't', 'a', 0, 0, 0, 0
+    };
+    int block_align = channels * bits / 8;
+
+    memcpy( p_dst, header, sizeof( header ) );
+
+    POSH_WriteU32ToLittle( p_dst + 4, 36 + data_size );
+    POSH_WriteU16ToLittle( p_dst + 22, ( posh_u16_t ) channels );
+    POSH_WriteU32ToLittle( p_dst + 24, CHECK_RATE );
+    POSH_WriteU32ToLittle( p_dst + 28, CHECK_RATE * block_align );
+    POSH_WriteU16ToLittle( p_dst + 32, ( posh_u16_t ) block_align );
+    POSH_WriteU16ToLittle( p_dst + 34, ( posh_u16_t ) bits );
+    POSH_WriteU32ToLittle( p_dst + 40, data_size );
+
+    memcpy( p_dst + 44, kp_data, data_size );
+
+    return 44 + data_size;
+}
+
+/*
+** SALx_convert_pcm
+*/
+typedef struct
+{
+    int src_channels;
+    int src_bits;
+    int dst_channels;
+    int dst_bits;
+    int expected[ 8 ];
+} ConvertVector;
+
+/* both sources hold the samples 0x00, 0x80, 0xFF, 0x40 and
+   -32768, 0, 32767, 16384, as four mono or two stereo frames */
+static const sal_byte_t s_convert_src8[]  = { 0x00, 0x80, 0xFF, 0x40 };
+static const sal_byte_t s_convert_src16[] = { 0x00, 0x80, 0x00, 0x00, 0xFF, 0x7F, 0x00, 0x40 };
+
+static const ConvertVector s_convert_vectors[] =
+{
+    { 1,  8, 1,  8, { 0x00, 0x80, 0xFF, 0x40 } },
+    { 1,  8, 1, 16, { -32768, 128, 32767, -16320 } },
+    { 1, 16, 1, 16, { -32768, 0, 32767, 16384 } },
+    { 1, 16, 1,  8, { 0x00, 0x80, 0xFF, 0xC0 } },
+    { 2,  8, 2, 16, { -32768, 128, 32767, -16320 } },
+    { 2, 16, 2,  8, { 0x00, 0x80, 0xFF, 0xC0 } },
+    { 1,  8, 2,  8, { 0x00, 0x00, 0x80, 0x80, 0xFF, 0xFF, 0x40, 0x40 } },
+    { 1,  8, 2, 16, { -32768, -32768, 128, 128, 32767, 32767, -16320, -16320 } },
+    { 1, 16, 2, 16, { -32768, -32768, 0, 0, 32767, 32767, 16384, 16384 } },
+    { 1, 16, 2,  8, { 0x00, 0x00, 0x80, 0x80, 0xFF, 0xFF, 0xC0, 0xC0 } },
+    { 2,  8, 1,  8, { 0x40, 0x9F } },
+    { 2,  8, 1, 16, { -16320, 8095 } },
+    { 2, 16, 1, 16, { -16384, 24575 } },
+    { 2, 16, 1,  8, { 0x40, 0xDF } }
+};
+
+static void
+s_check_convert_pcm( void )
+{
+    int i, j;
+    char what[ 128 ];
+
+    for ( i = 0; i < ( int ) ( sizeof( s_convert_vectors ) / sizeof( s_convert_vectors[ 0 ] ) ); i++ )
+    {
+        const ConvertVector *kp_v = &s_convert_vectors[ i ];
+        const void *kp_src = ( kp_v->src_bits == 8 ) ? ( const void * ) s_convert_src8 : ( const void * ) s_convert_src16;
+        int num_frames = 4 / kp_v->src_channels;
+        int num_samples = num_frames * kp_v->dst_channels;
+        sal_i16_t dst16[ 8 ];
+        sal_byte_t *dst8 = ( sal_byte_t * ) dst16;
+        int ok;
+
+        sprintf( what, "SALx_convert_pcm %d/%d to %d/%d",
+                 kp_v->src_channels, kp_v->src_bits, kp_v->dst_channels, kp_v->dst_bits );
+
+        ok = ( SALx_convert_pcm( kp_src, kp_v->src_channels, kp_v->src_bits,
+                                 dst16, kp_v->dst_channels, kp_v->dst_bits, num_frames ) == SALERR_OK );
+
+        for ( j = 0; ok && j < num_samples; j++ )
+        {
+            ok = ( ( kp_v->dst_bits == 8 ) ? dst8[ j ] : dst16[ j ] ) == kp_v->expected[ j ];
+        }
+
+        s_check( ok, what );
+    }
+
+    {
+        sal_i16_t dst16[ 8 ];
+
+        s_check( SALx_convert_pcm( s_convert_src16, 1, 24, dst16, 1, 16, 2 ) == SALERR_INVALIDFORMAT,
+                 "SALx_convert_pcm rejects 24 bit sources" );
+        s_check( SALx_convert_pcm( s_convert_src16, 1, 16, dst16, 3, 16, 2 ) == SALERR_INVALIDFORMAT,
+                 "SALx_convert_pcm rejects three channels" );
+    }
+}
+
+/* an 8 bit mono WAV played on the 16 bit stereo device is converted on load */
+static void
+s_check_wave( void )
+{
+    enum { NUM_FRAMES = 1500 };
+    static sal_byte_t pcm[ NUM_FRAMES ];
+    static sal_byte_t wave[ 44 + NUM_FRAMES ];
+    static sal_i16_t out[ NUM_FRAMES * 2 ];
+    SAL_Sample *p_sample;
+    SAL_Sample *p_truncated;
+    int i, size, ok;
+
+    for ( i = 0; i < NUM_FRAMES; i++ )
+    {
+        pcm[ i ] = ( sal_byte_t ) ( i * 7 );
+    }
+
+    size = s_make_wave( wave, 1, 8, pcm, NUM_FRAMES );
+
+    if ( SALx_create_sample_from_wave( s_device, &p_sample, wave, size ) != SALERR_OK )
+    {
+        s_check( 0, "SALx_create_sample_from_wave" );
+        return;
+    }
+
+    ok = ( s_decode( p_sample, 0, 0, 1, ( sal_byte_t * ) out, sizeof( out ) ) == 1 );
+
+    for ( i = 0; ok && i < NUM_FRAMES; i++ )
+    {
+        sal_i16_t expected = ( sal_i16_t ) ( ( ( pcm[ i ] << 8 ) | pcm[ i ] ) - 32768 );
+
+        ok = ( out[ i * 2 ] == expected && out[ i * 2 + 1 ] == expected );
+    }
+
+    s_check( ok, "8 bit mono WAV decoded on a 16 bit stereo device" );
+
+    /* a truncated data chunk is refused rather than read past */
+    s_check( SALx_create_sample_from_wave( s_device, &p_truncated, wave, size - 1 ) != SALERR_OK,
+             "SALx_create_sample_from_wave rejects a truncated data chunk" );
+
+    SAL_destroy_sample( s_device, p_sample );
+}
+
+/*
+** IMA ADPCM
+*/
+static const int s_ima_steps[ 89 ] =
+{
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+    11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+    32767
+};
+
+static const int s_ima_index_adjust[ 16 ] =
+{
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+/* a plain one nibble at a time IMA ADPCM decoder to hold SAL's up against */
+static void
+s_ima_reference( const sal_byte_t *kp_blocks, int channels, int block_align, int num_frames, sal_i16_t *p_dst )
+{
+    int frames_per_block = SALx_get_adpcm_frames_per_block( channels, block_align );
+    int block_start, c, k;
+
+    for ( block_start = 0; block_start < num_frames; block_start += frames_per_block, kp_blocks += block_align )
+    {
+        for ( c = 0; c < channels; c++ )
+        {
+            int pred  = ( sal_i16_t ) ( kp_blocks[ c * 4 ] | ( kp_blocks[ c * 4 + 1 ] << 8 ) );
+            int index = kp_blocks[ c * 4 + 2 ];
+
+            p_dst[ block_start * channels + c ] = ( sal_i16_t ) pred;
+
+            for ( k = 0; k < frames_per_block - 1 && block_start + 1 + k < num_frames; k++ )
+            {
+                sal_byte_t byte = kp_blocks[ 4 * channels + ( k / 8 ) * 4 * channels + c * 4 + ( k % 8 ) / 2 ];
+                int nibble = ( k & 1 ) ? ( byte >> 4 ) : ( byte & 0x0F );
+                int step = s_ima_steps[ index ];
+                int diff = step >> 3;
+
+                if ( nibble & 4 ) diff += step;
+                if ( nibble & 2 ) diff += step >> 1;
+                if ( nibble & 1 ) diff += step >> 2;
+
+                pred += ( nibble & 8 ) ? -diff : diff;
+                pred  = ( pred > 32767 ) ? 32767 : ( ( pred < -32768 ) ? -32768 : pred );
+
+                index += s_ima_index_adjust[ nibble ];
+                index  = ( index > 88 ) ? 88 : ( ( index < 0 ) ? 0 : index );
+
+                p_dst[ ( block_start + 1 + k ) * channels + c ] = ( sal_i16_t ) pred;
+            }
+        }
+    }
+}
+
+/* encodes a sawtooth with some noise on it and decodes it again, straight
+   through and around a loop that starts and ends partway into blocks */
+static void
+s_check_adpcm( int channels )
+{
+    enum { NUM_FRAMES = 5000, LOOP_START = 1000, LOOP_END = 3000 };
+    static sal_i16_t src[ NUM_FRAMES * 2 ];
+    static sal_i16_t ref[ NUM_FRAMES * 2 ];
+    static sal_i16_t out[ NUM_FRAMES * 2 ];
+    static sal_byte_t blocks[ NUM_FRAMES * 2 ];
+    SALx_AdpcmFormat af;
+    SAL_Sample *p_sample;
+    sal_u32_t noise = 12345;
+    int block_align = 256 * channels;
+    int frames_per_block = SALx_get_adpcm_frames_per_block( channels, block_align );
+    int i, c, size, ok;
+    char what[ 128 ];
+
+    for ( i = 0; i < NUM_FRAMES * channels; i++ )
+    {
+        noise = noise * 1664525U + 1013904223U;
+        src[ i ] = ( sal_i16_t ) ( ( ( i / channels ) * ( 37 + 14 * ( i % channels ) ) % 2000 - 1000 ) * 12 + ( int ) ( noise >> 23 ) - 256 );
+    }
+
+    if ( SALx_get_adpcm_size( channels, block_align, NUM_FRAMES, &size ) != SALERR_OK ||
+         SALx_encode_adpcm( src, channels, block_align, NUM_FRAMES, blocks ) != SALERR_OK )
+    {
+        s_check( 0, "SALx_encode_adpcm" );
+        return;
+    }
+
+    s_ima_reference( blocks, channels, block_align, NUM_FRAMES, ref );
+
+    /* every block starts with its first frame verbatim */
+    for ( ok = 1, i = 0; ok && i < NUM_FRAMES; i += frames_per_block )
+    {
+        for ( c = 0; c < channels; c++ )
+        {
+            ok = ok && ( ref[ i * channels + c ] == src[ i * channels + c ] );
+        }
+    }
+
+    sprintf( what, "SALx_encode_adpcm %d channel block headers", channels );
+    s_check( ok, what );
+
+    af.af_channels    = channels;
+    af.af_sample_rate = CHECK_RATE;
+    af.af_block_align = block_align;
+    af.af_num_frames  = NUM_FRAMES;
+
+    if ( SALx_create_sample_from_adpcm( s_device, &p_sample, blocks, size, &af ) != SALERR_OK )
+    {
+        s_check( 0, "SALx_create_sample_from_adpcm" );
+        return;
+    }
+
+    /* straight through, the output matches the reference decoder exactly */
+    ok = ( s_decode( p_sample, 0, 0, 1, ( sal_byte_t * ) out, sizeof( out ) ) == 1 );
+
+    for ( i = 0; ok && i < NUM_FRAMES; i++ )
+    {
+        ok = ( out[ i * 2 ] == ref[ i * channels ] && out[ i * 2 + 1 ] == ref[ i * channels + channels - 1 ] );
+    }
+
+    sprintf( what, "%d channel ADPCM decoded straight through", channels );
+    s_check( ok, what );
+
+    /* once to the loop end, then back to the loop start for a second pass */
+    ok = ( s_decode( p_sample, LOOP_START * 2, LOOP_END * 2, 2, ( sal_byte_t * ) out,
+                     ( LOOP_END + LOOP_END - LOOP_START ) * 4 ) == 1 );
+
+    for ( i = 0; ok && i < LOOP_END + LOOP_END - LOOP_START; i++ )
+    {
+        int frame = ( i < LOOP_END ) ? i : i - ( LOOP_END - LOOP_START );
+
+        ok = ( out[ i * 2 ] == ref[ frame * channels ] && out[ i * 2 + 1 ] == ref[ frame * channels + channels - 1 ] );
+    }
+
+    sprintf( what, "%d channel ADPCM decoded around a loop", channels );
+    s_check( ok, what );
+
+    SAL_destroy_sample( s_device, p_sample );
+}
+
+/*
+** FLAC
+**
+** SAL has no FLAC encoder, so salcheck carries a minimal one that writes
+** every frame with exactly the channel assignment and subframe types it's
+** told to.  That way each of the decoder's paths gets a known input.
+*/
+#define FLAC_BLOCK      1024
+#define FLAC_FRAMES     7900        /* the last block is a short one */
+#define FLAC_MAX_SIZE   ( 64 * 1024 )
+
+enum
+{
+    SF_CONSTANT,
+    SF_VERBATIM,
+    SF_FIXED,
+    SF_LPC
+};
+
+typedef struct
+{
+    int assignment;     /* 0 or 1 for independent channels, 8 left/side, 9 right/side, 10 mid/side */
+    int type[ 2 ];      /* SF_xxx of each subframe */
+    int order[ 2 ];     /* predictor order of each subframe */
+} FlacFrame;
+
+/* one frame per block, covering every channel assignment and subframe
+   type; block 4 has its low bits cleared for wasted bits, and channel 0
+   is silent in block 5 */
+static const FlacFrame s_flac_stereo[] =
+{
+    {  1, { SF_VERBATIM, SF_FIXED }, { 0, 0 } },
+    {  8, { SF_FIXED, SF_FIXED }, { 2, 1 } },
+    {  9, { SF_LPC, SF_FIXED }, { 3, 4 } },
+    { 10, { SF_LPC, SF_LPC }, { 8, 12 } },
+    { 10, { SF_FIXED, SF_LPC }, { 3, 2 } },
+    {  1, { SF_CONSTANT, SF_LPC }, { 0, 32 } },
+    {  8, { SF_LPC, SF_VERBATIM }, { 1, 0 } },
+    {  9, { SF_FIXED, SF_LPC }, { 3, 2 } }
+};
+
+static const FlacFrame s_flac_mono[] =
+{
+    { 0, { SF_LPC }, { 5 } },
+    { 0, { SF_FIXED }, { 2 } },
+    { 0, { SF_LPC }, { 16 } },
+    { 0, { SF_FIXED }, { 4 } },
+    { 0, { SF_FIXED }, { 3 } },
+    { 0, { SF_CONSTANT }, { 0 } },
+    { 0, { SF_VERBATIM }, { 0 } },
+    { 0, { SF_LPC }, { 1 } }
+};
+
+typedef struct
+{
+    sal_byte_t *bw_data;
+    sal_u32_t   bw_bits;    /* bits written so far */
+} BitWriter;
+
+static void
+s_put_bits( BitWriter *p_bw, sal_u32_t value, int num_bits )
+{
+    while ( num_bits-- > 0 )
+    {
+        sal_byte_t *p_byte = p_bw->bw_data + ( p_bw->bw_bits >> 3 );
+        int bit = 7 - ( int ) ( p_bw->bw_bits & 7 );
+
+        *p_byte = ( sal_byte_t ) ( ( *p_byte & ~( 1 << bit ) ) | ( ( ( value >> num_bits ) & 1 ) << bit ) );
+        p_bw->bw_bits++;
+    }
+}
+
+static void
+s_put_unary( BitWriter *p_bw, sal_u32_t zeros )
+{
+    while ( zeros-- > 0 )
+    {
+        s_put_bits( p_bw, 0, 1 );
+    }
+
+    s_put_bits( p_bw, 1, 1 );
+}
+
+static sal_byte_t
+s_crc8( const sal_byte_t *kp_data, sal_u32_t size )
+{
+    sal_u32_t crc = 0;
+    int i;
+
+    while ( size-- > 0 )
+    {
+        crc ^= *kp_data++;
+
+        for ( i = 0; i < 8; i++ )
+        {
+            crc = ( crc & 0x80 ) ? ( ( crc << 1 ) ^ 0x07 ) & 0xFF : ( crc << 1 ) & 0xFF;
+        }
+    }
+
+    return ( sal_byte_t ) crc;
+}
+
+static sal_u32_t
+s_crc16( const sal_byte_t *kp_data, sal_u32_t size )
+{
+    sal_u32_t crc = 0;
+    int i;
+
+    while ( size-- > 0 )
+    {
+        crc ^= ( sal_u32_t ) *kp_data++ << 8;
+
+        for ( i = 0; i < 8; i++ )
+        {
+            crc = ( crc & 0x8000 ) ? ( ( crc << 1 ) ^ 0x8005 ) & 0xFFFF : ( crc << 1 ) & 0xFFFF;
+        }
+    }
+
+    return crc;
+}
+
+/* writes a partition order 0 residual with a Rice parameter that suits its size */
+static void
+s_put_residual( BitWriter *p_bw, const sal_i32_t *kp_residual, int count )
+{
+    sal_u64_t sum = 0;
+    int k = 0;
+    int i;
+
+    for ( i = 0; i < count; i++ )
+    {
+        sum += ( kp_residual[ i ] < 0 ) ? -( sal_i64_t ) kp_residual[ i ] : kp_residual[ i ];
+    }
+
+    while ( k < 14 && ( ( sal_u64_t ) count << ( k + 1 ) ) <= sum )
+    {
+        k++;
+    }
+
+    s_put_bits( p_bw, 0, 2 );       /* 4-bit Rice parameters */
+    s_put_bits( p_bw, 0, 4 );       /* partition order */
+    s_put_bits( p_bw, ( sal_u32_t ) k, 4 );
+
+    for ( i = 0; i < count; i++ )
+    {
+        sal_u32_t folded = ( kp_residual[ i ] < 0 ) ? ( ( sal_u32_t ) -kp_residual[ i ] << 1 ) - 1 : ( sal_u32_t ) kp_residual[ i ] << 1;
+
+        s_put_unary( p_bw, folded >> k );
+        s_put_bits( p_bw, folded & ( ( 1U << k ) - 1 ), k );
+    }
+}
+
+/* writes one subframe of count samples at bits per sample */
+static void
+s_put_subframe( BitWriter *p_bw, const sal_i32_t *kp_samples, int count, int bits, int type, int order )
+{
+    static sal_i32_t shifted[ FLAC_BLOCK ];
+    static sal_i32_t residual[ FLAC_BLOCK ];
+    sal_i32_t coefs[ 32 ];
+    sal_i32_t all = 0;
+    int wasted = 0;
+    int i, j;
+
+    /* low bits that are zero in every sample aren't stored */
+    for ( i = 0; i < count; i++ )
+    {
+        all |= kp_samples[ i ];
+    }
+
+    while ( all != 0 && wasted < 8 && ( all & ( 1 << wasted ) ) == 0 )
+    {
+        wasted++;
+    }
+
+    for ( i = 0; i < count; i++ )
+    {
+        shifted[ i ] = kp_samples[ i ] >> wasted;
+    }
+
+    bits -= wasted;
+
+    s_put_bits( p_bw, 0, 1 );
+    s_put_bits( p_bw, ( type == SF_CONSTANT ) ? 0 : ( type == SF_VERBATIM ) ? 1 : ( type == SF_FIXED ) ? 8 + order : 31 + order, 6 );
+    s_put_bits( p_bw, wasted != 0, 1 );
+
+    if ( wasted )
+    {
+        s_put_unary( p_bw, ( sal_u32_t ) wasted - 1 );
+    }
+
+    if ( type == SF_CONSTANT )
+    {
+        s_put_bits( p_bw, ( sal_u32_t ) shifted[ 0 ], bits );
+        return;
+    }
+
+    /* verbatim samples, or the warm-up samples of a predictor */
+    for ( i = 0; i < ( ( type == SF_VERBATIM ) ? count : order ); i++ )
+    {
+        s_put_bits( p_bw, ( sal_u32_t ) shifted[ i ], bits );
+    }
+
+    if ( type == SF_VERBATIM )
+    {
+        return;
+    }
+
+    if ( type == SF_FIXED )
+    {
+        for ( i = order; i < count; i++ )
+        {
+            const sal_i32_t *x = shifted + i;
+
+            switch ( order )
+            {
+            case 0: residual[ i - order ] = x[ 0 ]; break;
+            case 1: residual[ i - order ] = x[ 0 ] - x[ -1 ]; break;
+            case 2: residual[ i - order ] = x[ 0 ] - 2 * x[ -1 ] + x[ -2 ]; break;
+            case 3: residual[ i - order ] = x[ 0 ] - 3 * x[ -1 ] + 3 * x[ -2 ] - x[ -3 ]; break;
+            default: residual[ i - order ] = x[ 0 ] - 4 * x[ -1 ] + 6 * x[ -2 ] - 4 * x[ -3 ] + x[ -4 ]; break;
+            }
+        }
+    }
+    else
+    {
+        /* 15-bit coefficients with a shift of 12: the fixed predictor of the
+           same order (up to 3), nudged so no two are alike */
+        static const sal_i32_t kp_base[ 3 ][ 3 ] = { { 1, 0, 0 }, { 2, -1, 0 }, { 3, -3, 1 } };
+        const sal_i32_t *kp_row = kp_base[ ( order > 3 ? 3 : order ) - 1 ];
+
+        s_put_bits( p_bw, 15 - 1, 4 );
+        s_put_bits( p_bw, 12, 5 );
+
+        for ( j = 0; j < order; j++ )
+        {
+            coefs[ j ] = ( ( j < 3 ) ? kp_row[ j ] * 4096 : 0 ) + ( j * 7 ) % 5 - 2;
+            s_put_bits( p_bw, ( sal_u32_t ) coefs[ j ], 15 );
+        }
+
+        for ( i = order; i < count; i++ )
+        {
+            sal_i64_t sum = 0;
+
+            for ( j = 0; j < order; j++ )
+            {
+                sum += ( sal_i64_t ) coefs[ j ] * shifted[ i - 1 - j ];
+            }
+
+            residual[ i - order ] = shifted[ i ] - ( sal_i32_t ) ( sum >> 12 );
+        }
+    }
+
+    s_put_residual( p_bw, residual, count - order );
+}
+
+/* the test signal: two triangle waves and a little noise, smooth enough
+   that the predictors have something to do */
+static sal_i32_t
+s_flac_signal( int channel, int frame )
+{
+    sal_u32_t noise = ( sal_u32_t ) frame * 2654435761U + ( sal_u32_t ) channel * 40503U;
+    int a = ( frame * ( 3 + channel ) ) % 4000;
+    int b = ( frame * 17 ) % 600;
+    sal_i32_t value;
+
+    a = ( ( a < 2000 ) ? a : 4000 - a ) - 1000;
+    b = ( ( b < 300 ) ? b : 600 - b ) - 150;
+    value = a * 24 + b * 20 + ( sal_i32_t ) ( noise >> 27 ) - 16;
+
+    if ( frame / FLAC_BLOCK == 4 )
+    {
+        value &= ~3;
+    }
+    else if ( frame / FLAC_BLOCK == 5 && channel == 0 )
+    {
+        value = -1234;
+    }
+
+    return value;
+}
+
+/* builds a 16-bit FLAC stream out of s_flac_signal, returns its size */
+static int
+s_make_flac( sal_byte_t *p_dst, int channels, const FlacFrame *kp_frames )
+{
+    static sal_i32_t samples[ 2 ][ FLAC_BLOCK ];
+    static const sal_byte_t kp_info[ 18 ] =
+    {
+        FLAC_BLOCK >> 8, FLAC_BLOCK & 0xFF, FLAC_BLOCK >> 8, FLAC_BLOCK & 0xFF,
+        0, 0, 0, 0, 0, 0,
+        ( CHECK_RATE >> 12 ) & 0xFF, ( CHECK_RATE >> 4 ) & 0xFF, 0, 0,
+        ( FLAC_FRAMES >> 24 ) & 0xFF, ( FLAC_FRAMES >> 16 ) & 0xFF, ( FLAC_FRAMES >> 8 ) & 0xFF, FLAC_FRAMES & 0xFF
+    };
+    BitWriter bw;
+    int start, n, c, i;
+
+    memset( p_dst, 0, FLAC_MAX_SIZE );
+    bw.bw_data = p_dst;
+    bw.bw_bits = 0;
+
+    /* STREAMINFO, with no MD5 */
+    s_put_bits( &bw, 0x664C6143, 32 );
+    s_put_bits( &bw, 0, 8 );
+    s_put_bits( &bw, 34, 24 );
+
+    for ( i = 0; i < 18; i++ )
+    {
+        sal_u32_t byte = kp_info[ i ];
+
+        /* rate low bits, channels, bits per sample and the top of the frame count */
+        if ( i == 12 )
+        {
+            byte = ( ( CHECK_RATE & 0x0F ) << 4 ) | ( ( channels - 1 ) << 1 ) | ( ( 16 - 1 ) >> 4 );
+        }
+        else if ( i == 13 )
+        {
+            byte = ( ( 16 - 1 ) & 0x0F ) << 4;
+        }
+
+        s_put_bits( &bw, byte, 8 );
+    }
+
+    bw.bw_bits += 16 * 8;
+
+    /* a SEEKTABLE with one real point and one placeholder, which the decoder
+       has to skip since it builds its own */
+    s_put_bits( &bw, 0x83, 8 );
+    s_put_bits( &bw, 2 * 18, 24 );
+    bw.bw_bits += 16 * 8;
+    s_put_bits( &bw, FLAC_BLOCK, 16 );
+    s_put_bits( &bw, 0xFFFFFFFF, 32 );
+    s_put_bits( &bw, 0xFFFFFFFF, 32 );
+    bw.bw_bits += 10 * 8;
+
+    for ( start = 0, n = 0; start < FLAC_FRAMES; start += FLAC_BLOCK, n++ )
+    {
+        const FlacFrame *kp_frame = &kp_frames[ n ];
+        int count = ( FLAC_FRAMES - start < FLAC_BLOCK ) ? FLAC_FRAMES - start : FLAC_BLOCK;
+        sal_u32_t header = bw.bw_bits >> 3;
+
+        s_put_bits( &bw, 0x3FFE, 14 );
+        s_put_bits( &bw, 0, 2 );                        /* reserved, fixed block size */
+        s_put_bits( &bw, 7, 4 );                        /* block size follows the frame number */
+        s_put_bits( &bw, 0, 4 );                        /* rate from STREAMINFO */
+        s_put_bits( &bw, ( sal_u32_t ) kp_frame->assignment, 4 );
+        s_put_bits( &bw, 4, 3 );                        /* 16 bits per sample */
+        s_put_bits( &bw, 0, 1 );
+        s_put_bits( &bw, ( sal_u32_t ) n, 8 );          /* frame number, < 128 so a single byte */
+        s_put_bits( &bw, ( sal_u32_t ) count - 1, 16 );
+        s_put_bits( &bw, s_crc8( p_dst + header, ( bw.bw_bits >> 3 ) - header ), 8 );
+
+        for ( i = 0; i < count; i++ )
+        {
+            sal_i32_t left  = s_flac_signal( 0, start + i );
+            sal_i32_t right = s_flac_signal( 1, start + i );
+
+            switch ( kp_frame->assignment )
+            {
+            case 8:  samples[ 0 ][ i ] = left;                    samples[ 1 ][ i ] = left - right; break;
+            case 9:  samples[ 0 ][ i ] = left - right;            samples[ 1 ][ i ] = right;        break;
+            case 10: samples[ 0 ][ i ] = ( left + right ) >> 1;   samples[ 1 ][ i ] = left - right; break;
+            default: samples[ 0 ][ i ] = left;                    samples[ 1 ][ i ] = right;        break;
+            }
+        }
+
+        for ( c = 0; c < channels; c++ )
+        {
+            /* the side channel needs an extra bit */
+            int side = ( kp_frame->assignment == 8 || kp_frame->assignment == 10 ) ? ( c == 1 ) : ( kp_frame->assignment == 9 && c == 0 );
+
+            s_put_subframe( &bw, samples[ c ], count, 16 + side, kp_frame->type[ c ], kp_frame->order[ c ] );
+        }
+
+        bw.bw_bits = ( bw.bw_bits + 7 ) & ~7U;
+        s_put_bits( &bw, s_crc16( p_dst + header, ( bw.bw_bits >> 3 ) - header ), 16 );
+    }
+
+    return ( int ) ( bw.bw_bits >> 3 );
+}
+
+/* decodes the stream straight through and around a loop, which makes the
+   decoder find frames in its seek table partway through the sample */
+static void
+s_check_flac( int channels )
+{
+    enum { LOOP_START = 2500, LOOP_END = 6100 };
+    static sal_byte_t flac[ FLAC_MAX_SIZE ];
+    static sal_i16_t out[ ( LOOP_END + LOOP_END - LOOP_START ) * 2 ];
+    SAL_Sample *p_sample;
+    int size, i, ok;
+    char what[ 128 ];
+
+    size = s_make_flac( flac, channels, ( channels == 2 ) ? s_flac_stereo : s_flac_mono );
+
+    if ( SALx_create_sample_from_flac( s_device, &p_sample, flac, size ) != SALERR_OK )
+    {
+        sprintf( what, "SALx_create_sample_from_flac with %d channels", channels );
+        s_check( 0, what );
+        return;
+    }
+
+    sprintf( what, "%d channel FLAC length", channels );
+    s_check( p_sample->sample_num_samples == FLAC_FRAMES * 2, what );
+
+    ok = ( s_decode( p_sample, 0, 0, 1, ( sal_byte_t * ) out, sizeof( out ) ) == 1 );
+
+    for ( i = 0; ok && i < FLAC_FRAMES; i++ )
+    {
+        ok = ( out[ i * 2 ] == s_flac_signal( 0, i ) && out[ i * 2 + 1 ] == s_flac_signal( channels - 1, i ) );
+    }
+
+    sprintf( what, "%d channel FLAC decoded straight through", channels );
+    s_check( ok, what );
+
+    ok = ( s_decode( p_sample, LOOP_START * 2, LOOP_END * 2, 2, ( sal_byte_t * ) out,
+                     ( LOOP_END + LOOP_END - LOOP_START ) * 4 ) == 1 );
+
+    for ( i = 0; ok && i < LOOP_END + LOOP_END - LOOP_START; i++ )
+    {
+        int frame = ( i < LOOP_END ) ? i : i - ( LOOP_END - LOOP_START );
+
+        ok = ( out[ i * 2 ] == s_flac_signal( 0, frame ) && out[ i * 2 + 1 ] == s_flac_signal( channels - 1, frame ) );
+    }
+
+    sprintf( what, "%d channel FLAC decoded around a loop", channels );
+    s_check( ok, what );
+
+    SAL_destroy_sample( s_device, p_sample );
+}
+
+int
+main( void )
+{
+    SAL_SystemParameters sp;
+
+    memset( &sp, 0, sizeof( sp ) );
+    sp.sp_size  = sizeof( sp );
+    sp.sp_flags = SAL_SPF_NULL;
+
+    if ( SAL_create_device( &s_device, 0, &sp, 2, 16, CHECK_RATE, 8 ) != SALERR_OK )
+    {
+        fprintf( stderr, "salcheck: could not create a null device, is SAL built with SAL_SUPPORT_NULL?\n" );
+        return 1;
+    }
+
+    s_check_convert_pcm();
+    s_check_wave();
+    s_check_adpcm( 1 );
+    s_check_adpcm( 2 );
+    s_check_flac( 1 );
+    s_check_flac( 2 );
+
+    SAL_destroy_device( s_device );
+
+    printf( "salcheck: %d of %d checks passed\n", s_num_checks - s_num_failed, s_num_checks );
+
+    return s_num_failed ? 1 : 0;
+}
@@ -0,0 +1,486 @@
+/* salbank -- builds a SAL sound bank out of a directory of WAV and Ogg files
+
+   usage: salbank [-c channels] [-b bits] [-r rate] [-a alignment] [-i block_align] bank.salb directory
+
+   WAV files are converted to the bank's channels and bits so they can be
+   played straight out of the mapping, Ogg files are stored as they are.
+   With -i, WAV files are instead encoded as IMA ADPCM in blocks of
+   block_align bytes, which must be a multiple of 4 * channels; 256 bytes
+   per channel is typical.  ADPCM sounds take about a quarter of the space
+   of 16-bit PCM but are copied out of the bank when they're loaded.
+   Each sound is named after its file, minus the directory and extension.
+   The bank format is described in src/extras/salx_bank.h.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/sal.h"
+#include "../src/extras/salx_wave.h"
+#include "../src/extras/salx_adpcm.h"
+#include "../src/extras/salx_bank.h"
+
+#if defined POSH_OS_WIN32
+#  include <windows.h>
+#else
+#  include <dirent.h>
+#endif
+
+typedef struct
+{
+    char       *name;        /* sound name */
+    char       *path;        /* file the sound comes from */
+    sal_u32_t   hash;        /* SALx_hash_bank_name( name ) */
+    sal_u32_t   encoding;    /* salx_bank_encoding_e */
+    sal_u32_t   name_offset; /* offset into the name table */
+    sal_u32_t   offset;      /* offset of the payload in the bank */
+    sal_u32_t   size;        /* size of the payload */
+    sal_u32_t   num_frames;  /* number of PCM frames */
+    sal_u32_t   block_align; /* size of an ADPCM block, 0 if the sound isn't ADPCM */
+} Sound;
+
+static Sound *s_sounds;
+static int    s_num_sounds;
+static int    s_max_sounds;
+
+static int    s_channels  = 2;
+static int    s_bits      = 16;
+static int    s_rate      = 44100;
+static int    s_alignment = 4096;
+static int    s_block_align = 0;
+
+static void *
+s_read_file( const char *path, long *p_length )
+{
+    FILE *fp;
+    void *p_buffer;
+
+    if ( ( fp = fopen( path, "rb" ) ) == 0 )
+    {
+        fprintf( stderr, "Could not open %s\n", path );
+        return 0;
+    }
+
+    fseek( fp, 0, SEEK_END );
+    *p_length = ftell( fp );
+    fseek( fp, 0, SEEK_SET );
+
+    if ( *p_length <= 0 || ( p_buffer = malloc( *p_length ) ) == 0 )
+    {
+        fclose( fp );
+        return 0;
+    }
+
+    if ( fread( p_buffer, *p_length, 1, fp ) != 1 )
+    {
+        fprintf( stderr, "Could not read %s\n", path );
+        free( p_buffer );
+        p_buffer = 0;
+    }
+
+    fclose( fp );
+
+    return p_buffer;
+}
+
+/* loads a sound's payload in the form it's stored in the bank, also filling in its size and frame count */
+static void *
+s_load_payload( Sound *p_sound )
+{
+    long length;
+    void *p_file;
+    sal_byte_t *p_payload;
+    SALx_WaveInfo wi;
+    int bits = ( p_sound->encoding == SALX_BANK_ENCODING_ADPCM ) ? 16 : s_bits;
+    int frame_size = s_channels * ( bits / 8 );
+
+    if ( ( p_file = s_read_file( p_sound->path, &length ) ) == 0 )
+    {
+        return 0;
+    }
+
+    if ( p_sound->encoding == SALX_BANK_ENCODING_OGG )
+    {
+        p_sound->size       = ( sal_u32_t ) length;
+        p_sound->num_frames = 0;
+        return p_file;
+    }
+
+    if ( SALx_get_wave_info( p_file, ( int ) length, &wi ) != SALERR_OK )
+    {
+        fprintf( stderr, "%s is not a WAV file SAL can read\n", p_sound->path );
+        free( p_file );
+        return 0;
+    }
+
+    if ( wi.wi_sample_rate != s_rate )
+    {
+        fprintf( stderr, "%s is %d Hz, the bank is %d Hz\n", p_sound->path, wi.wi_sample_rate, s_rate );
+        free( p_file );
+        return 0;
+    }
+
+    /* SALx_get_wave_info doesn't hold the data chunk to the file's length */
+    if ( wi.wi_data_offset < 0 || wi.wi_data_offset > length || wi.wi_data_size > length - wi.wi_data_offset )
+    {
+        fprintf( stderr, "%s is truncated\n", p_sound->path );
+        free( p_file );
+        return 0;
+    }
+
+    p_sound->num_frames = ( sal_u32_t ) ( wi.wi_data_size / ( wi.wi_channels * ( wi.wi_bits / 8 ) ) );
+    p_sound->size       = p_sound->num_frames * frame_size;
+
+    if ( ( p_payload = ( sal_byte_t * ) malloc( p_sound->size + 1 ) ) == 0 )
+    {
+        free( p_file );
+        return 0;
+    }
+
+    if ( SALx_convert_pcm( ( sal_byte_t * ) p_file + wi.wi_data_offset, wi.wi_channels, wi.wi_bits,
+                           p_payload, s_channels, bits, ( int ) p_sound->num_frames ) != SALERR_OK )
+    {
+        fprintf( stderr, "%s is %d channel %d bit, which SAL can't convert\n", p_sound->path, wi.wi_channels, wi.wi_bits );
+        free( p_payload );
+        free( p_file );
+        return 0;
+    }
+
+    free( p_file );
+
+    /* ADPCM is encoded from host order 16-bit PCM in the bank's channels */
+    if ( p_sound->encoding == SALX_BANK_ENCODING_ADPCM )
+    {
+        int size;
+        sal_byte_t *p_blocks = 0;
+
+        if ( p_sound->num_frames == 0 ||
+             SALx_get_adpcm_size( s_channels, s_block_align, ( int ) p_sound->num_frames, &size ) != SALERR_OK ||
+             ( p_blocks = ( sal_byte_t * ) malloc( size ) ) == 0 ||
+             SALx_encode_adpcm( ( const sal_i16_t * ) p_payload, s_channels, s_block_align, ( int ) p_sound->num_frames, p_blocks ) != SALERR_OK )
+        {
+            fprintf( stderr, "Could not encode %s as ADPCM\n", p_sound->path );
+            free( p_blocks );
+            free( p_payload );
+            return 0;
+        }
+
+        free( p_payload );
+
+        p_sound->size        = ( sal_u32_t ) size;
+        p_sound->block_align = ( sal_u32_t ) s_block_align;
+
+        return p_blocks;
+    }
+
+    /* the converted data is host order and banks are little-endian */
+    if ( s_bits == 16 )
+    {
+        POSH_WriteU16ArrayToLittle( p_payload, ( posh_u16_t * ) p_payload, ( int ) p_sound->num_frames * s_channels );
+    }
+
+    return p_payload;
+}
+
+static int
+s_add_file( const char *dir, const char *file )
+{
+    const char *ext = strrchr( file, '.' );
+    Sound *p_sound;
+    size_t length;
+
+    if ( ext == 0 || ext == file )
+    {
+        return 0;
+    }
+
+    if ( s_num_sounds == s_max_sounds )
+    {
+        s_max_sounds = s_max_sounds ? s_max_sounds * 2 : 256;
+
+        if ( ( s_sounds = ( Sound * ) realloc( s_sounds, s_max_sounds * sizeof( Sound ) ) ) == 0 )
+        {
+            fprintf( stderr, "Out of memory\n" );
+            return -1;
+        }
+    }
+
+    p_sound = &s_sounds[ s_num_sounds ];
+    memset( p_sound, 0, sizeof( *p_sound ) );
+
+    if ( !strcmp( ext, ".wav" ) || !strcmp( ext, ".WAV" ) )
+    {
+        p_sound->encoding = s_block_align ? SALX_BANK_ENCODING_ADPCM : SALX_BANK_ENCODING_PCM;
+    }
+    else if ( !strcmp( ext, ".ogg" ) || !strcmp( ext, ".OGG" ) )
+    {
+        p_sound->encoding = SALX_BANK_ENCODING_OGG;
+    }
+    else
+    {
+        return 0;
+    }
+
+    length        = ext - file;
+    p_sound->name = ( char * ) malloc( length + 1 );
+    p_sound->path = ( char * ) malloc( strlen( dir ) + strlen( file ) + 2 );
+
+    if ( p_sound->name == 0 || p_sound->path == 0 )
+    {
+        fprintf( stderr, "Out of memory\n" );
+        return -1;
+    }
+
+    memcpy( p_sound->name, file, length );
+    p_sound->name[ length ] = 0;
+    sprintf( p_sound->path, "%s/%s", dir, file );
+    p_sound->hash = SALx_hash_bank_name( p_sound->name );
+
+    s_num_sounds++;
+
+    return 0;
+}
+
+static int
+s_scan_directory( const char *dir )
+{
+#if defined POSH_OS_WIN32
+    char pattern[ MAX_PATH ];
+    WIN32_FIND_DATA fd;
+    HANDLE h;
+
+    sprintf( pattern, "%s\\*", dir );
+
+    if ( ( h = FindFirstFile( pattern, &fd ) ) == INVALID_HANDLE_VALUE )
+    {
+        fprintf( stderr, "Could not read directory %s\n", dir );
+        return -1;
+    }
+
+    do
+    {
+        if ( !( fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) && s_add_file( dir, fd.cFileName ) != 0 )
+        {
+            FindClose( h );
+            return -1;
+        }
+    } while ( FindNextFile( h, &fd ) );
+
+    FindClose( h );
+#else
+    DIR *p_dir;
+    struct dirent *p_ent;
+
+    if ( ( p_dir = opendir( dir ) ) == 0 )
+    {
+        fprintf( stderr, "Could not read directory %s\n", dir );
+        return -1;
+    }
+
+    while ( ( p_ent = readdir( p_dir ) ) != 0 )
+    {
+        if ( s_add_file( dir, p_ent->d_name ) != 0 )
+        {
+            closedir( p_dir );
+            return -1;
+        }
+    }
+
+    closedir( p_dir );
+#endif
+
+    return 0;
+}
+
+static int
+s_compare_sounds( const void *a, const void *b )
+{
+    const Sound *p_a = ( const Sound * ) a;
+    const Sound *p_b = ( const Sound * ) b;
+
+    if ( p_a->hash != p_b->hash )
+    {
+        return p_a->hash < p_b->hash ? -1 : 1;
+    }
+
+    return strcmp( p_a->name, p_b->name );
+}
+
+static void
+s_write_u32( FILE *fp, sal_u32_t value )
+{
+    sal_byte_t buf[ 4 ];
+
+    POSH_WriteU32ToLittle( buf, value );
+    fwrite( buf, 4, 1, fp );
+}
+
+static void
+s_pad( FILE *fp, sal_u32_t *p_offset )
+{
+    while ( *p_offset % s_alignment )
+    {
+        fputc( 0, fp );
+        ( *p_offset )++;
+    }
+}
+
+static int
+s_write_bank( const char *filename )
+{
+    FILE *fp;
+    int i;
+    sal_u32_t names_size = 0;
+    sal_u32_t offset;
+    sal_u32_t index_offset = SALX_BANK_HEADER_SIZE;
+    sal_u32_t names_offset = index_offset + s_num_sounds * SALX_BANK_ENTRY_SIZE;
+
+    if ( ( fp = fopen( filename, "wb" ) ) == 0 )
+    {
+        fprintf( stderr, "Could not create %s\n", filename );
+        return -1;
+    }
+
+    /* lay out the names and then the payloads, one aligned run after another */
+    for ( i = 0; i < s_num_sounds; i++ )
+    {
+        s_sounds[ i ].name_offset = names_size;
+        names_size += ( sal_u32_t ) strlen( s_sounds[ i ].name ) + 1;
+    }
+
+    offset = names_offset + names_size;
+
+    /* payload sizes are only known once they're converted, so write the
+       payloads first and come back for the header and index */
+    fseek( fp, offset, SEEK_SET );
+
+    for ( i = 0; i < s_num_sounds; i++ )
+    {
+        void *p_payload;
+
+        s_pad( fp, &offset );
+
+        if ( ( p_payload = s_load_payload( &s_sounds[ i ] ) ) == 0 )
+        {
+            fclose( fp );
+            remove( filename );
+            return -1;
+        }
+
+        s_sounds[ i ].offset = offset;
+        fwrite( p_payload, s_sounds[ i ].size, 1, fp );
+        offset += s_sounds[ i ].size;
+
+        free( p_payload );
+    }
+
+    fseek( fp, 0, SEEK_SET );
+
+    fwrite( SALX_BANK_MAGIC, 4, 1, fp );
+    s_write_u32( fp, SALX_BANK_VERSION );
+    s_write_u32( fp, ( sal_u32_t ) s_num_sounds );
+    s_write_u32( fp, ( sal_u32_t ) s_channels );
+    s_write_u32( fp, ( sal_u32_t ) s_bits );
+    s_write_u32( fp, ( sal_u32_t ) s_rate );
+    s_write_u32( fp, ( sal_u32_t ) s_alignment );
+    s_write_u32( fp, index_offset );
+    s_write_u32( fp, names_offset );
+    s_write_u32( fp, names_size );
+
+    for ( i = 0; i < s_num_sounds; i++ )
+    {
+        s_write_u32( fp, s_sounds[ i ].hash );
+        s_write_u32( fp, s_sounds[ i ].name_offset );
+        s_write_u32( fp, s_sounds[ i ].encoding );
+        s_write_u32( fp, s_sounds[ i ].offset );
+        s_write_u32( fp, s_sounds[ i ].size );
+        s_write_u32( fp, s_sounds[ i ].num_frames );
+        s_write_u32( fp, s_sounds[ i ].block_align );
+    }
+
+    for ( i = 0; i < s_num_sounds; i++ )
+    {
+        fwrite( s_sounds[ i ].name, strlen( s_sounds[ i ].name ) + 1, 1, fp );
+    }
+
+    if ( ferror( fp ) )
+    {
+        fprintf( stderr, "Could not write %s\n", filename );
+        fclose( fp );
+        remove( filename );
+        return -1;
+    }
+
+    fclose( fp );
+
+    printf( "%s: %d sounds, %u bytes\n", filename, s_num_sounds, offset );
+
+    return 0;
+}
+
+static void
+s_usage( void )
+{
+    fprintf( stderr, "usage: salbank [-c channels] [-b bits] [-r rate] [-a alignment] [-i block_align] bank.salb directory\n" );
+    exit( 1 );
+}
+
+int
+main( int argc, const char *argv[] )
+{
+    int i;
+
+    for ( i = 1; i < argc - 2; i += 2 )
+    {
+        if ( strcmp( argv[ i ], "-c" ) == 0 )
+        {
+            s_channels = atoi( argv[ i + 1 ] );
+        }
+        else if ( strcmp( argv[ i ], "-b" ) == 0 )
+        {
+            s_bits = atoi( argv[ i + 1 ] );
+        }
+        else if ( strcmp( argv[ i ], "-r" ) == 0 )
+        {
+            s_rate = atoi( argv[ i + 1 ] );
+        }
+        else if ( strcmp( argv[ i ], "-a" ) == 0 )
+        {
+            s_alignment = atoi( argv[ i + 1 ] );
+        }
+        else if ( strcmp( argv[ i ], "-i" ) == 0 )
+        {
+            s_block_align = atoi( argv[ i + 1 ] );
+        }
+        else
+        {
+            s_usage();
+        }
+    }
+
+    if ( i != argc - 2 ||
+         ( s_channels != 1 && s_channels != 2 ) ||
+         ( s_bits != 8 && s_bits != 16 ) ||
+         s_rate <= 0 || s_alignment <= 0 ||
+         ( s_block_align != 0 && SALx_get_adpcm_frames_per_block( s_channels, s_block_align ) == 0 ) )
+    {
+        s_usage();
+    }
+
+    if ( s_scan_directory( argv[ argc - 1 ] ) != 0 )
+    {
+        return 1;
+    }
+
+    qsort( s_sounds, s_num_sounds, sizeof( Sound ), s_compare_sounds );
+
+    for ( i = 1; i < s_num_sounds; i++ )
+    {
+        if ( strcmp( s_sounds[ i - 1 ].name, s_sounds[ i ].name ) == 0 )
+        {
+            fprintf( stderr, "More than one file is named %s\n", s_sounds[ i ].name );
+            return 1;
+        }
+    }
+
+    return s_write_bank( argv[ argc - 2 ] ) != 0;
+}
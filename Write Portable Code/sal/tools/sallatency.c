@@ -0,0 +1,213 @@
+/* sallatency -- measures SAL's trigger-to-output latency over a range of buffer settings
+
+   usage: sallatency [-d null|oss|alsa] [-a] [-m] [-n voices] [-i interval_ms] [-r rate]
+
+   For every combination of period size and period count a device is created
+   with SAL_SPF_TRACE_LATENCY, a short click is started every interval_ms
+   milliseconds, and the resulting SAL_LatencyHistogram is summarized on one
+   line: trigger latency (start of a voice to its first frame being mixed)
+   and audio thread wakeup lateness, both in microseconds, plus the frames
+   the device keeps queued after mixing.  Percentiles are the upper bound of
+   the histogram bucket they fall in.
+
+   -d picks the backend, the default is null, which needs SAL built with
+   SAL_SUPPORT_NULL.  -a adds SAL_SPF_ADAPTIVE_LATENCY and -m adds
+   SAL_SPF_MIX_AHEAD.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/sal.h"
+
+#define CLICK_FRAMES 256
+
+static const sal_u32_t s_period_frames[] = { 64, 128, 256, 512, 1024 };
+static const sal_u32_t s_num_periods[]   = { 2, 4 };
+
+static sal_u32_t s_flags      = SAL_SPF_NULL;
+static int       s_num_voices = 200;
+static int       s_interval   = 20;
+static int       s_rate       = 48000;
+
+static sal_i16_t s_click[ CLICK_FRAMES * 2 ];
+
+/* upper bound of the bucket the given fraction of the counts falls in */
+static sal_u32_t
+s_percentile( const sal_u32_t *buckets, double fraction )
+{
+    sal_u32_t total = 0, count = 0;
+    int i;
+
+    for ( i = 0; i < SAL_LATENCY_HISTOGRAM_BUCKETS; i++ )
+    {
+        total += buckets[ i ];
+    }
+
+    if ( total == 0 )
+    {
+        return 0;
+    }
+
+    for ( i = 0; i < SAL_LATENCY_HISTOGRAM_BUCKETS - 1; i++ )
+    {
+        count += buckets[ i ];
+        if ( count >= total * fraction )
+        {
+            break;
+        }
+    }
+
+    return SAL_LATENCY_HISTOGRAM_BASE_US << i;
+}
+
+/* runs one configuration and prints its line, returns 0 if the device couldn't be created */
+static int
+s_measure( sal_u32_t period_frames, sal_u32_t num_periods )
+{
+    SAL_Device *p_device;
+    SAL_Sample *p_sample;
+    SAL_SystemParameters sp;
+    SAL_DeviceInfo info;
+    SAL_DeviceStats stats;
+    SAL_LatencyHistogram hist;
+    sal_u32_t output_latency = 0;
+    sal_voice_t voice;
+    sal_error_e err;
+    int i;
+
+    memset( &sp, 0, sizeof( sp ) );
+    sp.sp_size  = sizeof( sp );
+    sp.sp_flags = s_flags | SAL_SPF_TRACE_LATENCY;
+#ifdef POSH_OS_WIN32
+    sp.sp_buffer_length_ms = ( sal_i32_t ) ( period_frames * num_periods * 1000 / s_rate );
+#else
+    sp.sp_period_frames = period_frames;
+    sp.sp_num_periods   = num_periods;
+#endif
+
+    if ( ( err = SAL_create_device( &p_device, 0, &sp, 2, 16, s_rate, 4 ) ) != SALERR_OK )
+    {
+        fprintf( stderr, "Could not create a device with %u x %u frames (%d)\n", num_periods, period_frames, err );
+        return 0;
+    }
+
+    if ( ( err = SAL_create_sample_from_buffer( p_device, &p_sample, s_click, CLICK_FRAMES * 2, 0, 0 ) ) != SALERR_OK )
+    {
+        fprintf( stderr, "Could not create the click (%d)\n", err );
+        SAL_destroy_device( p_device );
+        return 0;
+    }
+
+    /* let the audio thread settle before the first voice */
+    SAL_sleep( p_device, 100 );
+
+    for ( i = 0; i < s_num_voices; i++ )
+    {
+        SAL_play_sample( p_device, p_sample, &voice, 65535, 0, 0, 0, 1 );
+
+        /* stagger the triggers so they land all over the period */
+        SAL_sleep( p_device, s_interval + i % 7 );
+    }
+
+    /* give the last voices time to reach the mixer */
+    SAL_sleep( p_device, 100 + period_frames * num_periods * 1000 / s_rate );
+
+    memset( &info, 0, sizeof( info ) );
+    info.di_size = sizeof( info );
+    memset( &stats, 0, sizeof( stats ) );
+    stats.ds_size = sizeof( stats );
+    memset( &hist, 0, sizeof( hist ) );
+    hist.lh_size = sizeof( hist );
+
+    SAL_get_device_info( p_device, &info );
+    SAL_get_device_stats( p_device, &stats );
+    SAL_get_latency_histogram( p_device, &hist );
+    SAL_get_output_latency( p_device, &output_latency );
+
+    printf( "%6u %7u %6u | %6u %6u %6u %6u %6u | %6u %6u %6u | %6u\n",
+            info.di_period_frames,
+            info.di_num_periods,
+            hist.lh_num_voices,
+            hist.lh_min_us,
+            hist.lh_num_voices ? ( sal_u32_t ) ( hist.lh_total_us / hist.lh_num_voices ) : 0,
+            s_percentile( hist.lh_trigger_buckets, 0.5 ),
+            s_percentile( hist.lh_trigger_buckets, 0.99 ),
+            hist.lh_max_us,
+            stats.ds_num_wakeups ? ( sal_u32_t ) ( stats.ds_wakeup_late_total_us / stats.ds_num_wakeups ) : 0,
+            s_percentile( hist.lh_wakeup_buckets, 0.99 ),
+            stats.ds_wakeup_late_max_us,
+            output_latency );
+
+    SAL_destroy_sample( p_device, p_sample );
+    SAL_destroy_device( p_device );
+
+    return 1;
+}
+
+static void
+s_usage( void )
+{
+    fprintf( stderr, "usage: sallatency [-d null|oss|alsa] [-a] [-m] [-n voices] [-i interval_ms] [-r rate]\n" );
+    exit( 1 );
+}
+
+int
+main( int argc, char *argv[] )
+{
+    size_t p, f;
+    int i;
+
+    for ( i = 1; i < argc; i++ )
+    {
+        if ( !strcmp( argv[ i ], "-d" ) && i + 1 < argc )
+        {
+            i++;
+            s_flags &= ~( SAL_SPF_NULL | SAL_SPF_ALSA );
+            if ( !strcmp( argv[ i ], "null" ) )
+                s_flags |= SAL_SPF_NULL;
+            else if ( !strcmp( argv[ i ], "alsa" ) )
+                s_flags |= SAL_SPF_ALSA;
+            else if ( strcmp( argv[ i ], "oss" ) )
+                s_usage();
+        }
+        else if ( !strcmp( argv[ i ], "-a" ) )
+            s_flags |= SAL_SPF_ADAPTIVE_LATENCY;
+        else if ( !strcmp( argv[ i ], "-m" ) )
+            s_flags |= SAL_SPF_MIX_AHEAD;
+        else if ( !strcmp( argv[ i ], "-n" ) && i + 1 < argc )
+            s_num_voices = atoi( argv[ ++i ] );
+        else if ( !strcmp( argv[ i ], "-i" ) && i + 1 < argc )
+            s_interval = atoi( argv[ ++i ] );
+        else if ( !strcmp( argv[ i ], "-r" ) && i + 1 < argc )
+            s_rate = atoi( argv[ ++i ] );
+        else
+            s_usage();
+    }
+
+    if ( s_num_voices <= 0 || s_interval < 0 || s_rate <= 0 )
+    {
+        s_usage();
+    }
+
+    /* a decaying square wave, loud enough to hear when a real backend is used */
+    for ( i = 0; i < CLICK_FRAMES; i++ )
+    {
+        sal_i16_t v = ( sal_i16_t ) ( ( ( i / 8 ) & 1 ? 8000 : -8000 ) * ( CLICK_FRAMES - i ) / CLICK_FRAMES );
+
+        s_click[ i * 2 ]     = v;
+        s_click[ i * 2 + 1 ] = v;
+    }
+
+    printf( "                      | trigger latency (us)               | wakeup lateness (us) | queued\n" );
+    printf( "period periods voices |    min    avg   p50<   p99<    max |    avg   p99<    max | frames\n" );
+
+    for ( p = 0; p < sizeof( s_num_periods ) / sizeof( s_num_periods[ 0 ] ); p++ )
+    {
+        for ( f = 0; f < sizeof( s_period_frames ) / sizeof( s_period_frames[ 0 ] ); f++ )
+        {
+            s_measure( s_period_frames[ f ], s_num_periods[ p ] );
+        }
+    }
+
+    return 0;
+}